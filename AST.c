@@ -1,13 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "AST.h"
-#define DEBUG_MEMORY(msg, ptr) printf("DEBUG MEMORY: %s %p\n", msg, (void*)ptr)
+#include "compiler.h"
+#include "trace.h"
+#define DEBUG_MEMORY(msg, ptr) TRACE(TRACE_PARSE, TRACE_LEVEL_VERBOSE, "DEBUG MEMORY: %s %p\n", msg, (void*)ptr)
 
 // Add this line
-void freeNode(ASTNode* node);
-void debugPrintFunctionNode(ASTNode* node);
-char* generateTempVariable();
+void debugPrintFunctionNode(CompilerContext* ctx, ASTNode* node);
+Atom generateTempVariable(CompilerContext* ctx);
 
 const char* typeToString(NodeType type) {
     switch (type) {
@@ -37,87 +37,67 @@ const char* typeToString(NodeType type) {
 }
 
 // Helper function to allocate a new node
-ASTNode* createNode() {
-    ASTNode* node = (ASTNode*)malloc(sizeof(ASTNode));
+ASTNode* createNode(CompilerContext* ctx) {
+    ASTNode* node = (ASTNode*)arena_alloc(&ctx->ast_arena, sizeof(ASTNode));
+    ctx->ast_node_count++;
     DEBUG_MEMORY("Allocated node", node);
-
-    if (node == NULL) {
-        fprintf(stderr, "Memory allocation failed\n");
-        return NULL;
-    }
     
-    // Initialize all fields
+    // Zero every field: NULL children, ATOM_NONE names, empty union
+    memset(node, 0, sizeof(ASTNode));
     node->type = NODE_TYPE_UNDEFINED; // Set to a default or undefined value
-    node->op = NULL;                   // Initialize operator to NULL
-    node->value.intValue = 0; 
-    node->value.floatValue = 0.0;                  // Set default value (could be another sentinel value)
-    node->id = NULL;                   // Initialize identifier to NULL
-    node->left = NULL;                 // Initialize left child
-    node->right = NULL;                // Initialize right child
-    node->temp_var = -1;               // Default for temp_var (indicate uninitialized)
-    node->temp_var_name = NULL;        // Initialize temporary variable name to NULL
-    node->boolean_val = NULL;          // Initialize boolean value to NULL
-    node->arrayIndex = NULL;           // Initialize array index to NULL
-    node->assignedValue = NULL;        // Initialize assigned value to NULL
-
-    // Initialize union fields appropriately
-    node->statements.count = 0;        // Initialize statement count
-    node->varDecl.arraySize = 0;       // Default array size
-    node->parameters.count = 0;        // Initialize parameter count
-    node->funcDecl.identifier = NULL;  // Initialize funcDecl fields to NULL
-    node->funcDecl.parameters = NULL;
-    node->funcDecl.returnType = NULL;
-    node->funcDecl.body = NULL;
-    node->param.identifier = NULL;      // Initialize param fields to NULL
-    node->param.paramType = NULL;
 
     return node;
 }
 
-
-// Create a node for statements
-ASTNode* createStatementsNode(ASTNode** stmts, int count) {
-    ASTNode* node = createNode();
-    if (!node) return NULL;
-    
-    node->type = NODE_TYPE_STATEMENT;
+// Start a list holding a copy of items[0..count)
+void nodeListInit(CompilerContext* ctx, NodeList* list, ASTNode** items, int count) {
+    list->count = count;
+    list->capacity = count;
+    list->items = NULL;
     if (count > 0) {
-        node->statements.stmts = malloc(count * sizeof(ASTNode*));
-        if (!node->statements.stmts) {
-            free(node);
-            return NULL;
-        }
-        
-        for (int i = 0; i < count; i++) {
-            node->statements.stmts[i] = stmts[i];
+        list->items = arena_alloc(&ctx->ast_arena, count * sizeof(ASTNode*));
+        memcpy(list->items, items, count * sizeof(ASTNode*));
+    }
+}
+
+// Append with geometric growth. The outgrown array is left in the arena,
+// which bounds the waste by the final capacity and needs no shrink step.
+void nodeListAppend(CompilerContext* ctx, NodeList* list, ASTNode* node) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 4;
+        ASTNode** items = arena_alloc(&ctx->ast_arena, capacity * sizeof(ASTNode*));
+        if (list->count > 0) {
+            memcpy(items, list->items, list->count * sizeof(ASTNode*));
         }
-        node->statements.count = count;
-    } else {
-        node->statements.stmts = NULL;
-        node->statements.count = 0;
+        list->items = items;
+        list->capacity = capacity;
     }
+    list->items[list->count++] = node;
+}
+
+// Create a node for statements
+ASTNode* createStatementsNode(CompilerContext* ctx, ASTNode** stmts, int count) {
+    ASTNode* node = createNode(ctx);
     
+    node->type = NODE_TYPE_STATEMENT;
+    nodeListInit(ctx, &node->statements, stmts, count);
     return node;
 }
 
 // Create a program node with statements
-ASTNode* createProgramNode(ASTNode* stmtList) {
-    printf("DEBUG: Entering createProgramNode\n");
-    ASTNode* node = createNode();
+ASTNode* createProgramNode(CompilerContext* ctx, ASTNode* stmtList) {
+    TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Entering createProgramNode\n");
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_PROGRAM;
-    node->statements = stmtList->statements;
-
-    // Do not free stmtList here if you're still using it
-    free(stmtList);  // Free stmtList after transferring ownership
-    stmtList = NULL; // Prevent accidental use after freeing
+    node->statements = stmtList->statements;  // stmtList itself stays in the arena
 
-    printf("DEBUG: Exiting createProgramNode\n");
+    TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Exiting createProgramNode\n");
     return node;
 }
 
 // Create a declaration node with an identifier
-ASTNode* createDeclarationNode(ASTNode* type, ASTNode* id) {
-    ASTNode* node = createNode();
+ASTNode* createDeclarationNode(CompilerContext* ctx, ASTNode* type, ASTNode* id) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_DECLARATION; // Set node type
     node->left = type;  // Type goes to left child 
     node->right = id;   // Identifier goes to right child
@@ -125,25 +105,21 @@ ASTNode* createDeclarationNode(ASTNode* type, ASTNode* id) {
 }
 
 // Create a function prototype node
-ASTNode* createFunctionPrototypeNode(ASTNode* identifier, ASTNode* parameters, ASTNode* returnType) {
-    ASTNode* node = createNode();
-    if (!node) {
-        printf("Memory allocation failed for function prototype node\n");
-        exit(1);
-    }
+ASTNode* createFunctionPrototypeNode(CompilerContext* ctx, ASTNode* identifier, ASTNode* parameters, ASTNode* returnType) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_FUNCTION_PROTOTYPE;  // Set the correct node type
     node->funcProto.identifier = identifier;
     node->funcProto.parameters = parameters;
     node->funcProto.returnType = returnType;
 
-    printf("DEBUG: Function prototype node created with identifier: %s\n", identifier->id);
+    TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Function prototype node created with identifier: %s\n", atom_name(&ctx->atoms, identifier->atom));
 
     return node;
 }
 
 // Create an assignment node linking the identifier and expression
-ASTNode* createAssignmentNode(ASTNode* id, ASTNode* expr) {
-    ASTNode* node = createNode();
+ASTNode* createAssignmentNode(CompilerContext* ctx, ASTNode* id, ASTNode* expr) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_ASSIGNMENT; // Set node type
     node->left = id;  // Identifier as left child
     node->right = expr; // Expression as right child
@@ -151,16 +127,16 @@ ASTNode* createAssignmentNode(ASTNode* id, ASTNode* expr) {
 }
 
 // Create a write node
-ASTNode* createWriteNode(ASTNode* expr) {
-    ASTNode* node = createNode();
+ASTNode* createWriteNode(CompilerContext* ctx, ASTNode* expr) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_WRITE; // Set node type
     node->left = expr; // Assuming expression to write is stored in left
     return node;
 }
 
 // Create an if node
-ASTNode* createIfNode(ASTNode* cond, ASTNode* thenStmt, ASTNode* elseStmt) {
-    ASTNode* node = createNode();
+ASTNode* createIfNode(CompilerContext* ctx, ASTNode* cond, ASTNode* thenStmt, ASTNode* elseStmt) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_IF; // Set node type
     node->left = cond; // Condition stored in left
     node->right = thenStmt; // Then statement stored in right
@@ -169,8 +145,8 @@ ASTNode* createIfNode(ASTNode* cond, ASTNode* thenStmt, ASTNode* elseStmt) {
     return node;
 }
 
-ASTNode* createWhileNode(ASTNode* cond, ASTNode* stmts) {
-    ASTNode* node = createNode();
+ASTNode* createWhileNode(CompilerContext* ctx, ASTNode* cond, ASTNode* stmts) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_WHILE;
     node->left = cond;
     node->right = stmts;
@@ -178,41 +154,42 @@ ASTNode* createWhileNode(ASTNode* cond, ASTNode* stmts) {
 }
 
 // Create a return node
-ASTNode* createReturnNode(ASTNode* expr) {
-    ASTNode* node = createNode();
+ASTNode* createReturnNode(CompilerContext* ctx, ASTNode* expr) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_RETURN; // Set node type
     node->left = expr; // Expression to return stored in left
     return node;
 }
 
 // Create a number node
-ASTNode* createIntegerNode(int value) {
-    ASTNode* node = createNode();
+ASTNode* createIntegerNode(CompilerContext* ctx, int value) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_INTEGER; // Set node type
     node->value.intValue = value;
     return node;
 }
 
-ASTNode* createFloatNode(float value) {
-    ASTNode* node = createNode();
+ASTNode* createFloatNode(CompilerContext* ctx, float value) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_FLOAT; // Set node type
     node->value.floatValue = value; // Store float value
     return node;
 }
 
 // Create an identifier node
-ASTNode* createIdentifierNode(char* id) {
-    ASTNode* node = createNode();
+ASTNode* createIdentifierNode(CompilerContext* ctx, Atom id) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_IDENTIFIER; // Set node type
-    node->id = strdup(id);  // Duplicate string
+    node->atom = id;
+    node->value.symbol = -1;
     return node;
 }
 
 // Create boolean node
-ASTNode* createBooleanNode(char* value) {
-    ASTNode* node = createNode();
+ASTNode* createBooleanNode(CompilerContext* ctx, Atom value) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_BOOLEAN;  // Set node type to boolean
-    node->boolean_val = strdup(value);  // Store boolean value as a string
+    node->atom = value;              // ATOM_TRUE or ATOM_FALSE
     return node;
 }
 
@@ -220,169 +197,168 @@ ASTNode* createBooleanNode(char* value) {
 // Function to create a binary operation node
 
 // Function to generate a unique temporary variable name
-char* generateTempVariable() {
-    static int tempVarCounter = 0;
-    char* tempVarName = (char*)malloc(20); // Allocate space for the name
-    snprintf(tempVarName, 20, "t%d", tempVarCounter++); // Generate unique name
-    return tempVarName;
+Atom generateTempVariable(CompilerContext* ctx) {
+    char tempVarName[20];
+    snprintf(tempVarName, 20, "t%d", ctx->ast_temp_count++); // Generate unique name
+    return intern(&ctx->atoms, tempVarName);
 }
 
 
-ASTNode* createBinaryOpNode(char* op, ASTNode* left, ASTNode* right) {
-    printf("DEBUG: Creating binary op node with op '%s'\n", op ? op : "NULL");
-    ASTNode* node = createNode();
+ASTNode* createBinaryOpNode(CompilerContext* ctx, const char* op, ASTNode* left, ASTNode* right) {
+    TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Creating binary op node with op '%s'\n", op ? op : "NULL");
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_BINARY_OP; // Set node type
     if (op) {
-        node->op = strdup(op);
+        strncpy(node->op, op, sizeof(node->op) - 1);
     }
     node->left = left;  // Set left operand
     node->right = right; // Set right operand
 
     // Generate a temporary variable for the result
-    node->temp_var_name = generateTempVariable();
+    node->temp_var = generateTempVariable(ctx);
 
     // Log the temporary variable creation
-    printf("DEBUG: Temporary variable created for binary op: %s\n", node->temp_var_name);
+    TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Temporary variable created for binary op: %s\n", atom_name(&ctx->atoms, node->temp_var));
 
     return node;
 }
 
 
 // Example usage in processing expressions
-void processExpression(ASTNode* node) {
+void processExpression(CompilerContext* ctx, ASTNode* node) {
     if (!node) return;
 
     switch (node->type) {
         case NODE_TYPE_BINARY_OP:
-            processExpression(node->left);
-            processExpression(node->right);
+            processExpression(ctx, node->left);
+            processExpression(ctx, node->right);
             // Generate TAC for binary operation
-            printf("TAC: %s = %s %s %s\n", 
-                   node->temp_var_name, 
-                   node->left->temp_var_name, 
+            TRACE(TRACE_TAC, TRACE_LEVEL_DEBUG, "TAC: %s = %s %s %s\n", 
+                   atom_name(&ctx->atoms, node->temp_var), 
+                   atom_name(&ctx->atoms, node->left->temp_var), 
                    node->op, 
-                   node->right->temp_var_name);
+                   atom_name(&ctx->atoms, node->right->temp_var));
             break;
 
         case NODE_TYPE_UNARY_OP:
-            processExpression(node->left); // Process the expression
+            processExpression(ctx, node->left); // Process the expression
             // Generate TAC for unary operation
-            printf("TAC: %s = %s %s\n", 
-                   node->temp_var_name, 
-                   node->left->temp_var_name, 
+            TRACE(TRACE_TAC, TRACE_LEVEL_DEBUG, "TAC: %s = %s %s\n", 
+                   atom_name(&ctx->atoms, node->temp_var), 
+                   atom_name(&ctx->atoms, node->left->temp_var), 
                    node->op); // Ensure op is set correctly
             break;
 
 
         case NODE_TYPE_INTEGER:
             // Directly use the number value
-            node->temp_var_name = generateTempVariable();
-            printf("TAC: %s = %d\n", 
-                   node->temp_var_name, 
+            node->temp_var = generateTempVariable(ctx);
+            TRACE(TRACE_TAC, TRACE_LEVEL_DEBUG, "TAC: %s = %d\n", 
+                   atom_name(&ctx->atoms, node->temp_var), 
                    node->value);
             break;
         case NODE_TYPE_FLOAT:
 
             // Directly use the number value
-            node->temp_var_name = generateTempVariable();
-            printf("TAC: %s = %d\n", 
-                   node->temp_var_name, 
+            node->temp_var = generateTempVariable(ctx);
+            TRACE(TRACE_TAC, TRACE_LEVEL_DEBUG, "TAC: %s = %d\n", 
+                   atom_name(&ctx->atoms, node->temp_var), 
                    node->value);
             break;
             
 
         case NODE_TYPE_IDENTIFIER:
             // Use the identifier directly
-            node->temp_var_name = strdup(node->id); // No need for a temporary variable
+            node->temp_var = node->atom; // No need for a temporary variable
             break;
 
         case NODE_TYPE_ASSIGNMENT:
-            processExpression(node->right); // Process the expression
-            printf("TAC: %s = %s\n", 
-                   node->left->id, // The identifier name
-                   node->right->temp_var_name);
+            processExpression(ctx, node->right); // Process the expression
+            TRACE(TRACE_TAC, TRACE_LEVEL_DEBUG, "TAC: %s = %s\n", 
+                   atom_name(&ctx->atoms, node->left->atom), // The identifier name
+                   atom_name(&ctx->atoms, node->right->temp_var));
             break;
 
       case NODE_TYPE_FUNCTION_CALL:
-    if (strcmp(node->id, "add") == 0) {
+    if (node->atom == ATOM_ADD) {
         // Process arguments first
-        processExpression(node->funcCall.arguments->argumentList.args[0]);
-        processExpression(node->funcCall.arguments->argumentList.args[1]);
+        processExpression(ctx, node->funcCall.arguments->argumentList.items[0]);
+        processExpression(ctx, node->funcCall.arguments->argumentList.items[1]);
         
         // Generate TAC for function call with proper argument handling
-        printf("TAC: %s = %s(%s, %s)\n", 
-            node->temp_var_name,
-            node->id,
-            node->funcCall.arguments->argumentList.args[0]->temp_var_name,
-            node->funcCall.arguments->argumentList.args[1]->temp_var_name);
+        TRACE(TRACE_TAC, TRACE_LEVEL_DEBUG, "TAC: %s = %s(%s, %s)\n", 
+            atom_name(&ctx->atoms, node->temp_var),
+            atom_name(&ctx->atoms, node->atom),
+            atom_name(&ctx->atoms, node->funcCall.arguments->argumentList.items[0]->temp_var),
+            atom_name(&ctx->atoms, node->funcCall.arguments->argumentList.items[1]->temp_var));
         
         // Generate addition operation
-        printf("TAC: %s = %s + %s\n",
-            node->temp_var_name,
-            node->funcCall.arguments->argumentList.args[0]->temp_var_name,
-            node->funcCall.arguments->argumentList.args[1]->temp_var_name);
+        TRACE(TRACE_TAC, TRACE_LEVEL_DEBUG, "TAC: %s = %s + %s\n",
+            atom_name(&ctx->atoms, node->temp_var),
+            atom_name(&ctx->atoms, node->funcCall.arguments->argumentList.items[0]->temp_var),
+            atom_name(&ctx->atoms, node->funcCall.arguments->argumentList.items[1]->temp_var));
     }
     break;
 
 
         default:
-            printf("DEBUG: Unknown expression type\n");
+            TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Unknown expression type\n");
             break;
     }
 }
 
-void processFunctionCall(ASTNode* node) {
+void processFunctionCall(CompilerContext* ctx, ASTNode* node) {
     if (node->funcCall.arguments) {
-        processExpression(node->funcCall.arguments);
+        processExpression(ctx, node->funcCall.arguments);
     }
     // Generate TAC for the function call
-    printf("TAC: CALL %s\n", node->id);
+    TRACE(TRACE_TAC, TRACE_LEVEL_DEBUG, "TAC: CALL %s\n", atom_name(&ctx->atoms, node->atom));
 }
 
-void processStatement(ASTNode* node) {
+void processStatement(CompilerContext* ctx, ASTNode* node) {
     if (!node) return;
 
     switch (node->type) {
         case NODE_TYPE_WRITE:
-            processExpression(node->left);
-            printf("TAC: WRITE %s\n", node->left->temp_var_name);
+            processExpression(ctx, node->left);
+            TRACE(TRACE_TAC, TRACE_LEVEL_DEBUG, "TAC: WRITE %s\n", atom_name(&ctx->atoms, node->left->temp_var));
             break;
 
         case NODE_TYPE_RETURN:
-            processExpression(node->left);
-            printf("TAC: RETURN %s\n", node->left->temp_var_name);
+            processExpression(ctx, node->left);
+            TRACE(TRACE_TAC, TRACE_LEVEL_DEBUG, "TAC: RETURN %s\n", atom_name(&ctx->atoms, node->left->temp_var));
             break;
 
         default:
-            printf("DEBUG: Unknown statement type\n");
+            TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Unknown statement type\n");
             break;
     }
 }
 
-void processAST(ASTNode* root) {
+void processAST(CompilerContext* ctx, ASTNode* root) {
     if (!root) return;
 
     // Example for processing a program node
     if (root->type == NODE_TYPE_PROGRAM) {
         for (int i = 0; i < root->statements.count; i++) {
-            processStatement(root->statements.stmts[i]);
+            processStatement(ctx, root->statements.items[i]);
         }
     } else {
-        processExpression(root);
+        processExpression(ctx, root);
     }
 }
 
 // Create a unary operation node
-ASTNode* createUnaryOpNode(ASTNode* expr) {
-    ASTNode* node = createNode();
+ASTNode* createUnaryOpNode(CompilerContext* ctx, ASTNode* expr) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_UNARY_OP; // Set node type
     node->left = expr; // Assuming unary operation uses a single expression
     return node;
 }
 
 // Create a variable declaration node
-ASTNode* createVariableDeclarationNode(ASTNode* identifier, ASTNode* type) {
-    ASTNode* node = createNode();
+ASTNode* createVariableDeclarationNode(CompilerContext* ctx, ASTNode* identifier, ASTNode* type) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_VARIABLE_DECLARATION;
     node->varDecl.identifier = identifier;
     node->varDecl.varType = type;
@@ -390,137 +366,113 @@ ASTNode* createVariableDeclarationNode(ASTNode* identifier, ASTNode* type) {
 }
 
 // Function declaration node creation with body management
-ASTNode* createFunctionDeclarationNode(ASTNode* identifier, ASTNode* parameters, ASTNode* returnType, ASTNode* body) {
+ASTNode* createFunctionDeclarationNode(CompilerContext* ctx, ASTNode* identifier, ASTNode* parameters, ASTNode* returnType, ASTNode* body) {
 
-    printf("DEBUG: Creating function declaration node with body at %p\n", (void*)body);
+    TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Creating function declaration node with body at %p\n", (void*)body);
 
-    ASTNode* node = createNode();
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_FUNCTION_DECLARATION;
-    node->id = strdup(identifier->id);
+    node->atom = identifier->atom;
+    node->value.symbol = -1;
     node->left = parameters;
     node->right = returnType;
     
     if (body && body->statements.count > 0) {
-        printf("DEBUG: Body has %d statements\n", body->statements.count);
-        node->statements.count = body->statements.count;
-        node->statements.stmts = malloc(sizeof(ASTNode*) * body->statements.count);
-        
-        for (int i = 0; i < body->statements.count; i++) {
-            printf("DEBUG: Copying statement %d from %p\n", i, (void*)body->statements.stmts[i]);
-            node->statements.stmts[i] = body->statements.stmts[i];
-            printf("DEBUG: Statement %d copied to %p\n", i, (void*)node->statements.stmts[i]);
-        }
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Body has %d statements\n", body->statements.count);
+        node->statements = body->statements;  // Share the body's list, both live in the arena
     }
-    
-    // Don't free the body node here - let the caller handle it
-    printf("DEBUG: Function declaration node creation complete\n");
+
+    TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Function declaration node creation complete\n");
     return node;
 }
 
 // Add a new function for debugging AST nodes
 void debugPrintNode(ASTNode* node, const char* message) {
     if (node == NULL) {
-        printf("DEBUG: %s is NULL\n", message);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: %s is NULL\n", message);
         return;
     }
-    printf("DEBUG: %s - Type: %d, Address: %p\n", message, node->type, (void*)node);
+    TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: %s - Type: %d, Address: %p\n", message, node->type, (void*)node);
 }
 
 // Add the new debug function here
-void debugPrintFunctionNode(ASTNode* node) {
-    printf("DEBUG: Function Node Details:\n");
-    printf("Address: %p\n", (void*)node);
-    printf("Type: %d\n", node->type);
-    printf("ID: %s\n", node->id ? node->id : "NULL");
-    printf("Statements count: %d\n", node->statements.count);
+void debugPrintFunctionNode(CompilerContext* ctx, ASTNode* node) {
+    TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Function Node Details:\n");
+    TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Address: %p\n", (void*)node);
+    TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Type: %d\n", node->type);
+    TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "ID: %s\n", node->atom != ATOM_NONE ? atom_name(&ctx->atoms, node->atom) : "NULL");
+    TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Statements count: %d\n", node->statements.count);
 }
 
 // Create a parameter node
-ASTNode* createParameterNode(ASTNode* identifier, ASTNode* type) {
+ASTNode* createParameterNode(CompilerContext* ctx, ASTNode* identifier, ASTNode* type) {
      if (identifier == NULL || type == NULL) {
-        fprintf(stderr, "Error: NULL identifier or type in parameter creation\n");
+        fprintf(ctx->diagnostics, "Error: NULL identifier or type in parameter creation\n");
         return NULL;
     }
 
-    ASTNode* node = createNode();
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_PARAMETER;
     node->param.identifier = identifier;
     node->param.paramType = type;
-        printf("DEBUG: Created parameter node with identifier: %s, type: %s\n",
-           identifier->id, type->id);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Created parameter node with identifier: %s, type: %s\n",
+           atom_name(&ctx->atoms, identifier->atom), atom_name(&ctx->atoms, type->atom));
     return node;
 }
 
 // Create a parameters node
-ASTNode* createParametersNode(ASTNode** params, int count) {
+ASTNode* createParametersNode(CompilerContext* ctx, ASTNode** params, int count) {
 
-    ASTNode* node = createNode();
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_PARAMETERS;
-    node->statements.count = count;
-    node->statements.stmts = malloc(sizeof(ASTNode*) * count);
-    if (node->statements.stmts == NULL) {
-        fprintf(stderr, "Memory allocation failed for parameters array\n");
-        free(node);
-        return NULL;
-    }
-    for (int i = 0; i < count; i++) {
-        node->statements.stmts[i] = params[i];
-    }
+    nodeListInit(ctx, &node->parameters, params, count);
     return node;
 }
 
 // Create a function call node
-ASTNode* createFunctionCallNode(char* identifier, ASTNode* arguments) {
-    ASTNode* node = createNode();
+ASTNode* createFunctionCallNode(CompilerContext* ctx, Atom identifier, ASTNode* arguments) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_FUNCTION_CALL;
-    node->id = strdup(identifier);
+    node->atom = identifier;
+    node->value.symbol = -1;
     node->funcCall.arguments = arguments;
-    node->temp_var_name = generateTempVariable();
+    node->temp_var = generateTempVariable(ctx);
     return node;
 }
 
 
 // Create an argument list node
-ASTNode* createArgumentListNode(ASTNode** args, int count) {
-    ASTNode* node = createNode();
+ASTNode* createArgumentListNode(CompilerContext* ctx, ASTNode** args, int count) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_ARGUMENT_LIST;
-    node->argumentList.count = count;
-    node->argumentList.args = malloc(sizeof(ASTNode*) * count);
-    if (node->argumentList.args == NULL) {
-        fprintf(stderr, "Memory allocation failed for argument list array\n");
-        free(node);
-        return NULL;
-    }
-    for (int i = 0; i < count; i++) {
-        node->argumentList.args[i] = args[i];
-    }
+    nodeListInit(ctx, &node->argumentList, args, count);
     return node;
 }
 
-ASTNode* createArrayDeclarationNode(ASTNode* identifier, char* typeNode, int arraySize) {
-    ASTNode* node = createNode();
+ASTNode* createArrayDeclarationNode(CompilerContext* ctx, Atom identifier, Atom type, int arraySize) {
+    ASTNode* node = createNode(ctx);
     node->type = NODE_TYPE_ARRAY_DECLARATION;
-    node->id = identifier;        // Identifier (variable name)
-    node->varDecl.varType = typeNode;     // Type (int, float, etc.)
+    node->atom = identifier;
+    node->varDecl.varType = createIdentifierNode(ctx, type);     // Type (int, float, etc.)
     node->varDecl.arraySize = arraySize;  // Array size
 
     return node;
 }
 
-ASTNode* createArrayAccessNode(ASTNode* identifier, ASTNode* indexNode) {
-    ASTNode* node = createNode(); 
+ASTNode* createArrayAccessNode(CompilerContext* ctx, Atom identifier, ASTNode* indexNode) {
+    ASTNode* node = createNode(ctx); 
     node->type = NODE_TYPE_ARRAY_ACCESS;
-    node->id  = identifier;        // Identifier (array name)
+    node->atom = identifier;
     node->value.intValue = indexNode;
     node->arrayIndex;    // Index to access
 
     return node;
 }
 
-ASTNode* createArrayAssignmentNode(char* id, ASTNode* index, ASTNode* value) {
-    ASTNode* node = createNode();  // Create a new node
+ASTNode* createArrayAssignmentNode(CompilerContext* ctx, Atom id, ASTNode* index, ASTNode* value) {
+    ASTNode* node = createNode(ctx);  // Create a new node
     node->type = NODE_TYPE_ARRAY_ASSIGNMENT;  // Set the node type
-    node->id = strdup(id);  // Store the identifier for the array
+    node->atom = id;
     node->value.intValue = index->value.intValue;  // Store the index expression
     node->assignedValue = value;  // Store the value to assign
     return node;  // Return the created node
@@ -528,21 +480,16 @@ ASTNode* createArrayAssignmentNode(char* id, ASTNode* index, ASTNode* value) {
 
 
 // Append an argument node to an existing list
-ASTNode* appendArgumentNode(ASTNode* list, ASTNode* arg) {
+ASTNode* appendArgumentNode(CompilerContext* ctx, ASTNode* list, ASTNode* arg) {
     if (list->type != NODE_TYPE_ARGUMENT_LIST) {
-        fprintf(stderr, "Error: Node is not an argument list\n");
-        return NULL;
-    }
-    list->argumentList.args = realloc(list->argumentList.args, (list->argumentList.count + 1) * sizeof(ASTNode*));
-    if (list->argumentList.args == NULL) {
-        fprintf(stderr, "Memory allocation failed when appending argument\n");
+        fprintf(ctx->diagnostics, "Error: Node is not an argument list\n");
         return NULL;
     }
-    list->argumentList.args[list->argumentList.count++] = arg;
+    nodeListAppend(ctx, &list->argumentList, arg);
     return list;
 }
 
-void printAST(ASTNode* node, int indentLevel) {
+void printAST(CompilerContext* ctx, ASTNode* node, int indentLevel) {
     if (node == NULL) return;
 
     for (int i = 0; i < indentLevel; i++) {
@@ -554,13 +501,13 @@ void printAST(ASTNode* node, int indentLevel) {
 
             printf("Program:\n");
             for (int i = 0; i < node->statements.count; i++) {
-                printAST(node->statements.stmts[i], indentLevel + 1);
+                printAST(ctx, node->statements.items[i], indentLevel + 1);
             }
             return; // Return here to avoid processing left and right children        case NODE_TYPE_STATEMENT:
             printf("DEBUG: Node type: Statement\n");
             printf("DEBUG: Processing %d statements\n", node->statements.count);
             for (int i = 0; i < node->statements.count; i++) {
-                printAST(node->statements.stmts[i], indentLevel + 1);
+                printAST(ctx, node->statements.items[i], indentLevel + 1);
             }
             break;
         case NODE_TYPE_DECLARATION:
@@ -591,7 +538,7 @@ void printAST(ASTNode* node, int indentLevel) {
             break;
         case NODE_TYPE_IDENTIFIER:
             printf("DEBUG: Node type: Identifier\n");
-            printf("DEBUG: Identifier value: %s\n", node->id);
+            printf("DEBUG: Identifier value: %s\n", atom_name(&ctx->atoms, node->atom));
             break;
         case NODE_TYPE_BOOLEAN:  // Handle boolean nodes
             printf("DEBUG: Node type: Boolean\n");
@@ -606,123 +553,50 @@ void printAST(ASTNode* node, int indentLevel) {
             break;
         case NODE_TYPE_ARRAY_DECLARATION:
             printf("DEBUG: Node type: Array Declaration\n");
-            printf("DEBUG: Identifier value: %s\n", node->id);
-            printf("DEBUG: Type: %s\n", node->varDecl.varType);
+            printf("DEBUG: Identifier value: %s\n", atom_name(&ctx->atoms, node->atom));
+            printf("DEBUG: Type: %s\n", atom_name(&ctx->atoms, node->varDecl.varType->atom));
             printf("DEBUG: Array size: %d\n", node->varDecl.arraySize);
             break;
         case NODE_TYPE_ARRAY_ASSIGNMENT:
             printf("DEBUG: Node type: Array Assignment\n");
-            printf("DEBUG: Array identifier: %s\n", node->id);
+            printf("DEBUG: Array identifier: %s\n", atom_name(&ctx->atoms, node->atom));
             printf("DEBUG: Index:\n");
-            printAST(node->arrayIndex, indentLevel + 1);
+            printAST(ctx, node->arrayIndex, indentLevel + 1);
             printf("DEBUG: Value to assign:\n");
-            printAST(node->assignedValue, indentLevel + 1);
+            printAST(ctx, node->assignedValue, indentLevel + 1);
             break;
         case NODE_TYPE_ARRAY_ACCESS:
             printf("DEBUG: Node type: Array Access\n");
-            printf("DEBUG: Array identifier: %s\n", node->id);
+            printf("DEBUG: Array identifier: %s\n", atom_name(&ctx->atoms, node->atom));
             printf("DEBUG: Index:\n");
-            printAST(node->arrayIndex, indentLevel + 1);
+            printAST(ctx, node->arrayIndex, indentLevel + 1);
             break;
         default:
             printf("Unknown Node Type\n");
             break;
     }
 
-    if (node->left) printAST(node->left, indentLevel + 1);
-    if (node->right) printAST(node->right, indentLevel + 1);
-}
-
-// Function to free the identifier string in an AST node
-void freeIdentifier(ASTNode* node) {
-    if (node->type == NODE_TYPE_IDENTIFIER && node->id != NULL) {
-        free(node->id);
-        node->id = NULL;
-    }
-}
-
-void freeNode(ASTNode* node) {
-    if (!node) return;
-
-    // Free child nodes
-    if (node->left) {
-        freeNode(node->left);
-        node->left = NULL;
-    }
-    
-    if (node->right) {
-        freeNode(node->right);
-        node->right = NULL;
-    }
-
-    // Free statements
-    if (node->statements.stmts) {
-        for (int i = 0; i < node->statements.count; i++) {
-            if (node->statements.stmts[i]) {
-                freeNode(node->statements.stmts[i]);
-            }
-        }
-        free(node->statements.stmts);
-        node->statements.stmts = NULL;
-    }
-
-    // Free the identifier string if applicable
-    freeIdentifier(node);
-
-    // Free other string members
-    if (node->op) free(node->op);
-    
-    free(node);
-}
-
-void freeAST(ASTNode* root) {
-    if (!root) return;
-
-    printf("DEBUG: Starting AST cleanup for node type %d at %p\n", root->type, (void*)root);
-    
-    // Track statement ownership before cleanup
-    if (root->statements.count > 0) {
-        printf("DEBUG: Node %p has %d statements\n", (void*)root, root->statements.count);
-        for (int i = 0; i < root->statements.count; i++) {
-            printf("DEBUG: Statement %d at %p with type %d\n", 
-                   i, (void*)root->statements.stmts[i], 
-                   root->statements.stmts[i]->type);
-        }
-    }
-
-    // Track child nodes
-    if (root->left) {
-        printf("DEBUG: Processing left child at %p\n", (void*)root->left);
-        freeAST(root->left);
-    }
-    if (root->right) {
-        printf("DEBUG: Processing right child at %p\n", (void*)root->right);
-        freeAST(root->right);
-    }
-    
-    printf("DEBUG: Freeing node %p with type %d\n", (void*)root, root->type);
-    freeNode(root);
-}
-
-
-void freeASTNode(ASTNode* node) {
-    if (node == NULL) return;  // Base case: nothing to free
-
-    // Recursively free children
-    freeASTNode(node->left);
-    freeASTNode(node->right);
-    
-    // Free dynamically allocated fields
-    free(node->op);                 // Free operator string
-    free(node->id);                 // Free identifier string
-    free(node->temp_var_name);      // Free temporary variable name string
-    free(node->boolean_val);        // Free boolean value string
-    freeASTNode(node->arrayIndex);  // Free array index node
-    freeASTNode(node->assignedValue); // Free assigned value node
-
-    // Free union members if they point to dynamic memory
-    // (Since the union does not require explicit freeing if they are NULL, skip this)
-
-    // Free the node itself
-    free(node);
+    if (node->left) printAST(ctx, node->left, indentLevel + 1);
+    if (node->right) printAST(ctx, node->right, indentLevel + 1);
+}
+
+void initAST(CompilerContext* ctx) {
+    arena_init(&ctx->ast_arena, 0);
+    ctx->ast_node_count = 0;
+    ctx->ast_bytes_start = 0;
+    ctx->ast_temp_count = 0;
+}
+
+// Release the whole tree at once by resetting the arena. The bytes per node
+// are those this compilation allocated, not the arena's lifetime total.
+void freeAST(CompilerContext* ctx) {
+    size_t bytes = ctx->ast_arena.bytes_total - ctx->ast_bytes_start;
+    DEBUG_MEMORY("Releasing AST arena", ctx->ast_arena.head);
+    TRACE(TRACE_PARSE, TRACE_LEVEL_INFO,
+          "DEBUG MEMORY: AST arena high-water mark %zu bytes in %d chunks, %d nodes, %.1f bytes per node\n",
+          ctx->ast_arena.high_water, ctx->ast_arena.chunk_count, ctx->ast_node_count,
+          ctx->ast_node_count ? (double)bytes / ctx->ast_node_count : 0.0);
+    arena_reset(&ctx->ast_arena);
+    ctx->ast_node_count = 0;
+    ctx->ast_bytes_start = ctx->ast_arena.bytes_total;
 }
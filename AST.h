@@ -1,6 +1,13 @@
 #ifndef AST_H
 #define AST_H
 
+#include "intern.h"
+#include "arena.h"
+
+// Everything belonging to one compilation, defined in compiler.h. Every
+// phase takes it as its first argument.
+typedef struct CompilerContext CompilerContext;
+
 // Enum to define node types in the AST
 typedef enum {
     NODE_TYPE_UNDEFINED,
@@ -30,40 +37,43 @@ typedef enum {
     NODE_TYPE_ARRAY_ASSIGNMENT
 } NodeType;
 
-// ASTNode structure for representing AST nodes
+// Growable list of child nodes. The items array lives in the AST arena and
+// doubles when full, so appending n nodes copies O(n) pointers in total.
+typedef struct {
+    struct ASTNode** items;
+    int count;
+    int capacity;
+} NodeList;
+
+// ASTNode structure for representing AST nodes. Names are kept as atoms
+// (use atom_name() for the text) and every kind-specific field shares one
+// union, so a node is 56 bytes on a 64-bit host.
 typedef struct ASTNode {
     NodeType type;  // Node type (e.g., program, statement, etc.)
-    char* op;       // For operators (e.g., +, -, *)
-
+    Atom atom;      // Interned name for identifiers, calls and declarations
+    Atom temp_var;  // Interned name of the temporary holding this node's value
     union {
         int intValue; // For integer values
         float floatValue; // For float values
+        int symbol;   // Identifiers, calls and functions: symbol index set by the resolver, -1 if unbound
     } value;
-    char* id;       // For identifiers
     struct ASTNode* left;    // Left child
     struct ASTNode* right;   // Right child
-    struct ASTNode* elseNode;
-    int temp_var;         // <-- Add this line to store the temporary variable number.
-    char* temp_var_name;  // New field to store the temporary variable name
-    char* boolean_val;   // true or false
-    struct ASTNode* arrayIndex; // Index for array access
-    struct ASTNode* assignedValue; // Value to assign to the array
     union {
+        char op[4];          // Binary operators (e.g., +, ==, AND)
+        struct {
+            struct ASTNode* elseNode;  // Else branch of an if
+        };
         struct {
-            struct ASTNode** stmts;  // Array of statements
-            int count;               // Count of statements
-        } statements;
+            struct ASTNode* arrayIndex;    // Index for array access
+            struct ASTNode* assignedValue; // Value to assign to the array
+        };
+        NodeList statements;         // Statements of a block or program
         struct {
             struct ASTNode* identifier;
             struct ASTNode* varType;
             int arraySize;
         } varDecl;
-        struct {
-            struct ASTNode* identifier;  // Function identifier (function name)
-            struct ASTNode* parameters;  // Function parameters
-            struct ASTNode* returnType;  // Function return type
-            struct ASTNode* body;        // Function body (statements)
-        } funcDecl;
         struct {
             struct ASTNode* identifier;  // Function identifier (for prototype)
             struct ASTNode* parameters;  // Function parameters
@@ -73,57 +83,57 @@ typedef struct ASTNode {
             struct ASTNode* identifier;  // Parameter identifier (e.g., variable name)
             struct ASTNode* paramType;   // Parameter type (e.g., int, float)
         } param;
-        struct {
-            struct ASTNode** params;  // Array of parameters
-            int count;                // Count of parameters
-        } parameters;
+        NodeList parameters;         // Parameters of a function
         struct {
             struct ASTNode* functionName;  // Function name for calls
             struct ASTNode* arguments;     // Arguments for the function call
         } funcCall;  // Added for function calls
-        struct {
-            struct ASTNode** args;  // Array of arguments
-            int count;              // Count of arguments
-        } argumentList;  // Added for argument lists
+        NodeList argumentList;       // Arguments of a function call
     };
 } ASTNode;
 
 // Function declarations for creating AST nodes
 const char* typeToString(NodeType type);
-ASTNode* createProgramNode(ASTNode* stmtList);
-ASTNode* createDeclarationNode(ASTNode* type, ASTNode* id);
-ASTNode* createAssignmentNode(ASTNode* id, ASTNode* expr);
-ASTNode* createWriteNode(ASTNode* expr);
-ASTNode* createIfNode(ASTNode* cond, ASTNode* thenStmt, ASTNode* elseStmt);
-ASTNode* createWhileNode(ASTNode* cond, ASTNode* stmts);
-ASTNode* createReturnNode(ASTNode* expr);
-ASTNode* createIntegerNode(int value);
-ASTNode* createFloatNode(float value);
-ASTNode* createIdentifierNode(char* id);
-ASTNode* createBooleanNode(char* value);
-ASTNode* createBinaryOpNode(char* op, ASTNode* left, ASTNode* right);
-ASTNode* createUnaryOpNode(ASTNode* expr);
-ASTNode* createVariableDeclarationNode(ASTNode* identifier, ASTNode* type);
-ASTNode* createFunctionDeclarationNode(ASTNode* identifier, ASTNode* parameters, ASTNode* returnType, ASTNode* body);
-ASTNode* createFunctionPrototypeNode(ASTNode* identifier, ASTNode* parameters, ASTNode* returnType);
-ASTNode* createParameterNode(ASTNode* identifier, ASTNode* type);
+ASTNode* createProgramNode(CompilerContext* ctx, ASTNode* stmtList);
+ASTNode* createDeclarationNode(CompilerContext* ctx, ASTNode* type, ASTNode* id);
+ASTNode* createAssignmentNode(CompilerContext* ctx, ASTNode* id, ASTNode* expr);
+ASTNode* createWriteNode(CompilerContext* ctx, ASTNode* expr);
+ASTNode* createIfNode(CompilerContext* ctx, ASTNode* cond, ASTNode* thenStmt, ASTNode* elseStmt);
+ASTNode* createWhileNode(CompilerContext* ctx, ASTNode* cond, ASTNode* stmts);
+ASTNode* createReturnNode(CompilerContext* ctx, ASTNode* expr);
+ASTNode* createIntegerNode(CompilerContext* ctx, int value);
+ASTNode* createFloatNode(CompilerContext* ctx, float value);
+ASTNode* createIdentifierNode(CompilerContext* ctx, Atom id);
+ASTNode* createBooleanNode(CompilerContext* ctx, Atom value);
+ASTNode* createBinaryOpNode(CompilerContext* ctx, const char* op, ASTNode* left, ASTNode* right);
+ASTNode* createUnaryOpNode(CompilerContext* ctx, ASTNode* expr);
+ASTNode* createVariableDeclarationNode(CompilerContext* ctx, ASTNode* identifier, ASTNode* type);
+ASTNode* createFunctionDeclarationNode(CompilerContext* ctx, ASTNode* identifier, ASTNode* parameters, ASTNode* returnType, ASTNode* body);
+ASTNode* createFunctionPrototypeNode(CompilerContext* ctx, ASTNode* identifier, ASTNode* parameters, ASTNode* returnType);
+ASTNode* createParameterNode(CompilerContext* ctx, ASTNode* identifier, ASTNode* type);
+
+ASTNode* createParametersNode(CompilerContext* ctx, ASTNode** params, int count);
 
-ASTNode* createParametersNode(ASTNode** params, int count);
+ASTNode* createArrayDeclarationNode(CompilerContext* ctx, Atom identifier, Atom type, int arraySize);
+ASTNode* createArrayAccessNode(CompilerContext* ctx, Atom identifier, ASTNode* indexNode);
+ASTNode* createArrayAssignmentNode(CompilerContext* ctx, Atom id, ASTNode* index, ASTNode* value);
+ASTNode* createStatementsNode(CompilerContext* ctx, ASTNode** stmts, int count);
+ASTNode* createFunctionCallNode(CompilerContext* ctx, Atom identifier, ASTNode* arguments);  // Added for function calls
+ASTNode* createArgumentListNode(CompilerContext* ctx, ASTNode** args, int count);  // Added for argument lists
+ASTNode* appendArgumentNode(CompilerContext* ctx, ASTNode* list, ASTNode* arg);  // Added for appending arguments
 
-ASTNode* createArrayDeclarationNode(ASTNode* identifier, char* typeNode, int arraySize);
-ASTNode* createArrayAccessNode(ASTNode* identifier, ASTNode* indexNode);
-ASTNode* createArrayAssignmentNode(char* id, ASTNode* index, ASTNode* value);
-ASTNode* createStatementsNode(ASTNode** stmts, int count);
-ASTNode* createFunctionCallNode(char* identifier, ASTNode* arguments);  // Added for function calls
-ASTNode* createArgumentListNode(ASTNode** args, int count);  // Added for argument lists
-ASTNode* appendArgumentNode(ASTNode* list, ASTNode* arg);  // Added for appending arguments
+void nodeListInit(CompilerContext* ctx, NodeList* list, ASTNode** items, int count);
+void nodeListAppend(CompilerContext* ctx, NodeList* list, ASTNode* node);
 
 // Function for printing the AST (ensure this is implemented in AST.c)
-void printAST(ASTNode* node, int indentLevel);
-void freeASTNode(ASTNode* node);
+void printAST(CompilerContext* ctx, ASTNode* node, int indentLevel);
+
+// All nodes are allocated from the context's AST arena and released together
+void initAST(CompilerContext* ctx);
+void freeAST(CompilerContext* ctx);
 
 // In AST.h or another appropriate header file
-char** extractParamTypes(ASTNode** params, int count);
+Atom* extractParamTypes(CompilerContext* ctx, ASTNode** params, int count);
 
 
 #endif  // AST_H
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_DEFAULT_CHUNK_SIZE 65536
+#define ARENA_ALIGN sizeof(void*)
+
+static ArenaChunk* new_chunk(Arena* arena, size_t size) {
+    ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + size);
+    if (chunk == NULL) {
+        fprintf(stderr, "Memory allocation failed for arena chunk\n");
+        exit(1);
+    }
+    chunk->next = NULL;
+    chunk->used = 0;
+    chunk->size = size;
+    arena->bytes_reserved += sizeof(ArenaChunk) + size;
+    arena->chunk_count++;
+    return chunk;
+}
+
+void arena_init(Arena* arena, size_t chunk_size) {
+    arena->head = NULL;
+    arena->large = NULL;
+    arena->chunk_size = chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK_SIZE;
+    arena->bytes_used = 0;
+    arena->high_water = 0;
+    arena->bytes_total = 0;
+    arena->bytes_reserved = 0;
+    arena->chunk_count = 0;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (arena->chunk_size == 0) {
+        arena_init(arena, 0);
+    }
+
+    ArenaChunk* chunk = arena->head;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        if (size > arena->chunk_size / 4 && chunk != NULL) {
+            // Oversized request: give it a chunk of its own on the large list
+            // so the space left in the current chunk is not wasted
+            ArenaChunk* big = new_chunk(arena, size);
+            big->next = arena->large;
+            arena->large = big;
+            chunk = big;
+        } else {
+            chunk = new_chunk(arena, size > arena->chunk_size ? size : arena->chunk_size);
+            chunk->next = arena->head;
+            arena->head = chunk;
+        }
+    }
+
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->bytes_used += size;
+    arena->bytes_total += size;
+    if (arena->bytes_used > arena->high_water) {
+        arena->high_water = arena->bytes_used;
+    }
+    return ptr;
+}
+
+char* arena_strdup(Arena* arena, const char* str) {
+    size_t length = strlen(str) + 1;
+    char* copy = arena_alloc(arena, length);
+    memcpy(copy, str, length);
+    return copy;
+}
+
+static void release_chunk(Arena* arena, ArenaChunk* chunk) {
+    arena->bytes_reserved -= sizeof(ArenaChunk) + chunk->size;
+    arena->chunk_count--;
+    free(chunk);
+}
+
+ArenaMark arena_mark(Arena* arena) {
+    ArenaMark mark;
+    mark.chunk = arena->head;
+    mark.used = arena->head != NULL ? arena->head->used : 0;
+    mark.large = arena->large;
+    mark.bytes_used = arena->bytes_used;
+    return mark;
+}
+
+// Free every chunk opened after the mark and rewind the chunk that was
+// current when it was taken. Chunks are only ever pushed on the front of
+// their list, so everything ahead of the marked chunk is newer than it.
+void arena_release(Arena* arena, ArenaMark mark) {
+    while (arena->head != mark.chunk) {
+        ArenaChunk* next = arena->head->next;
+        release_chunk(arena, arena->head);
+        arena->head = next;
+    }
+    if (arena->head != NULL) {
+        arena->head->used = mark.used;
+    }
+    while (arena->large != mark.large) {
+        ArenaChunk* next = arena->large->next;
+        release_chunk(arena, arena->large);
+        arena->large = next;
+    }
+    arena->bytes_used = mark.bytes_used;
+}
+
+// Drop everything allocated so far. The oldest regular chunk is kept for
+// reuse so a reset arena does not go straight back to malloc.
+void arena_reset(Arena* arena) {
+    ArenaChunk* keep = NULL;
+    ArenaChunk* chunk = arena->head;
+    while (chunk != NULL) {
+        ArenaChunk* next = chunk->next;
+        if (next == NULL && chunk->size == arena->chunk_size) {
+            keep = chunk;
+        } else {
+            release_chunk(arena, chunk);
+        }
+        chunk = next;
+    }
+    while (arena->large != NULL) {
+        ArenaChunk* next = arena->large->next;
+        release_chunk(arena, arena->large);
+        arena->large = next;
+    }
+    if (keep != NULL) {
+        keep->used = 0;
+    }
+    arena->head = keep;
+    arena->bytes_used = 0;
+}
+
+void arena_free(Arena* arena) {
+    while (arena->head != NULL) {
+        ArenaChunk* next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+    while (arena->large != NULL) {
+        ArenaChunk* next = arena->large->next;
+        free(arena->large);
+        arena->large = next;
+    }
+    arena->bytes_used = 0;
+    arena->bytes_reserved = 0;
+    arena->chunk_count = 0;
+}
+
+void grow_array(void** data, int* capacity, int needed, size_t size) {
+    if (needed <= *capacity) {
+        return;
+    }
+    int new_capacity = *capacity ? *capacity : 256;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    *data = realloc(*data, new_capacity * size);
+    if (*data == NULL) {
+        fprintf(stderr, "Memory allocation failed for %d elements of %zu bytes\n", new_capacity, size);
+        exit(1);
+    }
+    *capacity = new_capacity;
+}
@@ -0,0 +1,48 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator. Memory comes out of large chunks and is never freed one
+// object at a time; arena_reset() or arena_free() releases everything at once
+// and arena_release() rolls back to an earlier arena_mark().
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t used;
+    size_t size;
+    char data[];
+} ArenaChunk;
+
+typedef struct {
+    ArenaChunk* head;      // Chunk currently being filled, older chunks follow
+    ArenaChunk* large;     // Oversized blocks, newest first
+    size_t chunk_size;     // Size of a regular chunk
+    size_t bytes_used;     // Bytes handed out since the last reset
+    size_t high_water;     // Largest bytes_used seen so far
+    size_t bytes_total;    // Bytes handed out over the arena's lifetime
+    size_t bytes_reserved; // Bytes obtained from malloc, including headers
+    int chunk_count;
+} Arena;
+
+// Position in an arena. Releasing to a mark frees everything allocated
+// after it while leaving older allocations in place.
+typedef struct {
+    ArenaChunk* chunk;
+    size_t used;
+    ArenaChunk* large;
+    size_t bytes_used;
+} ArenaMark;
+
+void arena_init(Arena* arena, size_t chunk_size);
+void* arena_alloc(Arena* arena, size_t size);
+char* arena_strdup(Arena* arena, const char* str);
+ArenaMark arena_mark(Arena* arena);
+void arena_release(Arena* arena, ArenaMark mark);
+void arena_reset(Arena* arena);
+void arena_free(Arena* arena);
+
+// Make room for needed elements of size bytes in the malloc()ed *data,
+// doubling *capacity from 256 until they fit. Exits when memory runs out.
+void grow_array(void** data, int* capacity, int needed, size_t size);
+
+#endif // ARENA_H
@@ -0,0 +1,391 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cfg.h"
+#include "arena.h"
+
+// label_blocks may hold entries of an earlier graph, so the block is
+// checked to really start with that label
+int cfg_label_block(CFG* cfg, TACBuffer* tac, TACOperand label) {
+    if (label.number < 0 || label.number >= cfg->label_capacity) {
+        return -1;
+    }
+    int b = cfg->label_blocks[label.number];
+    if (b < 0 || b >= cfg->block_count) {
+        return -1;
+    }
+    TACInstruction* first = &tac->items[cfg->blocks[b].first];
+    if (first->opcode != TAC_LABEL || first->arg1.number != label.number) {
+        return -1;
+    }
+    return b;
+}
+
+// Split [start, tac->count) into blocks and connect them
+static void find_blocks(CFG* cfg, TACBuffer* tac, int start, int label_count) {
+    grow_array((void**) &cfg->label_blocks, &cfg->label_capacity, label_count, sizeof(int));
+    cfg->block_count = 0;
+    for (int i = start; i < tac->count; i++) {
+        TACInstruction* instr = &tac->items[i];
+        if (i == start || instr->opcode == TAC_LABEL ||
+            tac->items[i - 1].opcode == TAC_JUMP || tac->items[i - 1].opcode == TAC_IFFALSE) {
+            grow_array((void**) &cfg->blocks, &cfg->block_capacity, cfg->block_count + 1, sizeof(BasicBlock));
+            cfg->blocks[cfg->block_count].first = i;
+            cfg->block_count++;
+        }
+        cfg->blocks[cfg->block_count - 1].end = i + 1;
+        if (instr->opcode == TAC_LABEL && instr->arg1.number >= 0 && instr->arg1.number < label_count) {
+            cfg->label_blocks[instr->arg1.number] = cfg->block_count - 1;
+        }
+    }
+
+    cfg->edge_count = 0;
+    for (int b = 0; b < cfg->block_count; b++) {
+        BasicBlock* block = &cfg->blocks[b];
+        block->predecessor_count = 0;
+        block->rpo = -1;
+        block->idom = -1;
+        block->child_count = 0;
+        block->loop = -1;
+        block->loop_depth = 0;
+    }
+    for (int b = 0; b < cfg->block_count; b++) {
+        BasicBlock* block = &cfg->blocks[b];
+        TACInstruction* last = &tac->items[block->end - 1];
+        int next = b + 1 < cfg->block_count ? b + 1 : -1;
+        block->successors[0] = next;
+        block->successors[1] = -1;
+        if (last->opcode == TAC_JUMP) {
+            block->successors[0] = cfg_label_block(cfg, tac, last->arg1);
+        } else if (last->opcode == TAC_IFFALSE) {
+            int target = cfg_label_block(cfg, tac, last->arg2);
+            if (next < 0) {
+                block->successors[0] = target;
+            } else if (target != next) {
+                block->successors[1] = target;
+            }
+        }
+        for (int s = 0; s < 2; s++) {
+            if (block->successors[s] >= 0) {
+                cfg->blocks[block->successors[s]].predecessor_count++;
+                cfg->edge_count++;
+            }
+        }
+    }
+
+    // Predecessor lists, one slice per block
+    grow_array((void**) &cfg->predecessors, &cfg->predecessor_capacity, cfg->edge_count, sizeof(int));
+    int offset = 0;
+    for (int b = 0; b < cfg->block_count; b++) {
+        cfg->blocks[b].predecessor_start = offset;
+        offset += cfg->blocks[b].predecessor_count;
+        cfg->blocks[b].predecessor_count = 0;
+    }
+    for (int b = 0; b < cfg->block_count; b++) {
+        for (int s = 0; s < 2; s++) {
+            int succ = cfg->blocks[b].successors[s];
+            if (succ >= 0) {
+                BasicBlock* target = &cfg->blocks[succ];
+                cfg->predecessors[target->predecessor_start + target->predecessor_count++] = b;
+            }
+        }
+    }
+}
+
+// Depth-first search from the entry, without recursion since a program can
+// have millions of blocks. Numbers the reachable blocks in reverse postorder.
+static void order_blocks(CFG* cfg) {
+    grow_array((void**) &cfg->rpo_order, &cfg->rpo_capacity, cfg->block_count, sizeof(int));
+    grow_array((void**) &cfg->scratch, &cfg->scratch_capacity, 2 * cfg->block_count, sizeof(int));
+    cfg->reachable_count = 0;
+    if (cfg->block_count == 0) {
+        return;
+    }
+
+    // scratch holds the stack of blocks, each with the index of its next
+    // successor to visit; rpo marks the blocks already entered
+    int* stack = cfg->scratch;
+    int depth = 0;
+    int postorder = cfg->block_count;
+    stack[0] = 0;
+    stack[1] = 0;
+    depth = 1;
+    cfg->blocks[0].rpo = 0;
+    while (depth > 0) {
+        int b = stack[2 * (depth - 1)];
+        int s = stack[2 * (depth - 1) + 1]++;
+        if (s < 2) {
+            int succ = cfg->blocks[b].successors[s];
+            if (succ >= 0 && cfg->blocks[succ].rpo < 0) {
+                cfg->blocks[succ].rpo = 0;
+                stack[2 * depth] = succ;
+                stack[2 * depth + 1] = 0;
+                depth++;
+            }
+        } else {
+            cfg->rpo_order[--postorder] = b;
+            depth--;
+        }
+    }
+
+    // The reachable blocks were stored from the end of rpo_order down
+    cfg->reachable_count = cfg->block_count - postorder;
+    memmove(cfg->rpo_order, cfg->rpo_order + postorder, cfg->reachable_count * sizeof(int));
+    for (int i = 0; i < cfg->reachable_count; i++) {
+        cfg->blocks[cfg->rpo_order[i]].rpo = i;
+    }
+}
+
+static int intersect(CFG* cfg, int a, int b) {
+    while (a != b) {
+        while (cfg->blocks[a].rpo > cfg->blocks[b].rpo) {
+            a = cfg->blocks[a].idom;
+        }
+        while (cfg->blocks[b].rpo > cfg->blocks[a].rpo) {
+            b = cfg->blocks[b].idom;
+        }
+    }
+    return a;
+}
+
+// Immediate dominators by the iterative algorithm of Cooper, Harvey and
+// Kennedy over reverse postorder, which converges in a couple of passes on
+// the graphs structured code produces. Then the dominator tree's children.
+static void find_dominators(CFG* cfg) {
+    if (cfg->reachable_count == 0) {
+        return;
+    }
+    cfg->blocks[0].idom = 0;
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 1; i < cfg->reachable_count; i++) {
+            int b = cfg->rpo_order[i];
+            BasicBlock* block = &cfg->blocks[b];
+            int idom = -1;
+            for (int p = 0; p < block->predecessor_count; p++) {
+                int pred = cfg->predecessors[block->predecessor_start + p];
+                if (cfg->blocks[pred].idom < 0) {
+                    continue;   // Unreachable, or not processed yet
+                }
+                idom = idom < 0 ? pred : intersect(cfg, pred, idom);
+            }
+            if (block->idom != idom) {
+                block->idom = idom;
+                changed = 1;
+            }
+        }
+    }
+    cfg->blocks[0].idom = -1;
+
+    grow_array((void**) &cfg->dom_children, &cfg->dom_children_capacity, cfg->reachable_count, sizeof(int));
+    for (int i = 1; i < cfg->reachable_count; i++) {
+        cfg->blocks[cfg->blocks[cfg->rpo_order[i]].idom].child_count++;
+    }
+    int offset = 0;
+    for (int i = 0; i < cfg->reachable_count; i++) {
+        BasicBlock* block = &cfg->blocks[cfg->rpo_order[i]];
+        block->child_start = offset;
+        offset += block->child_count;
+        block->child_count = 0;
+    }
+    for (int i = 1; i < cfg->reachable_count; i++) {
+        int b = cfg->rpo_order[i];
+        BasicBlock* parent = &cfg->blocks[cfg->blocks[b].idom];
+        cfg->dom_children[parent->child_start + parent->child_count++] = b;
+    }
+
+    // Preorder of the dominator tree, children in reverse postorder
+    grow_array((void**) &cfg->dom_order, &cfg->dom_order_capacity, cfg->reachable_count, sizeof(int));
+    int* stack = cfg->scratch;
+    int depth = 0;
+    int count = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        BasicBlock* block = &cfg->blocks[stack[--depth]];
+        cfg->dom_order[count++] = block - cfg->blocks;
+        for (int c = block->child_count - 1; c >= 0; c--) {
+            stack[depth++] = cfg->dom_children[block->child_start + c];
+        }
+    }
+}
+
+static int compare_loop_size(const void* a, const void* b) {
+    const Loop* x = a;
+    const Loop* y = b;
+    if (x->block_count != y->block_count) {
+        return y->block_count - x->block_count;
+    }
+    return x->header - y->header;
+}
+
+// A back edge goes from a block to one that dominates it. For each header
+// the blocks that reach one of its back edges without passing through it
+// form its loop.
+static void find_loops(CFG* cfg) {
+    cfg->loop_count = 0;
+    cfg->loop_block_count = 0;
+    if (cfg->reachable_count == 0) {
+        return;
+    }
+    int* mark = cfg->scratch;                       // Loop number + 1 of the walk that added a block
+    int* worklist = cfg->scratch + cfg->block_count;
+    memset(mark, 0, cfg->block_count * sizeof(int));
+
+    for (int i = 0; i < cfg->reachable_count; i++) {
+        int header = cfg->rpo_order[i];
+        BasicBlock* block = &cfg->blocks[header];
+        int latch = -1;
+        for (int p = 0; p < block->predecessor_count; p++) {
+            int pred = cfg->predecessors[block->predecessor_start + p];
+            if (cfg->blocks[pred].rpo >= 0 && cfg_dominates(cfg, header, pred)) {
+                latch = pred;
+            }
+        }
+        if (latch < 0) {
+            continue;
+        }
+
+        grow_array((void**) &cfg->loops, &cfg->loop_capacity, cfg->loop_count + 1, sizeof(Loop));
+        Loop* loop = &cfg->loops[cfg->loop_count++];
+        loop->header = header;
+        loop->latch = latch;
+        loop->parent = -1;
+        loop->block_start = cfg->loop_block_count;
+        int stamp = cfg->loop_count;
+
+        // Walk backwards from the latches; each block enters the loop once
+        grow_array((void**) &cfg->loop_blocks, &cfg->loop_block_capacity, cfg->loop_block_count + 1, sizeof(int));
+        cfg->loop_blocks[cfg->loop_block_count++] = header;
+        mark[header] = stamp;
+        int top = 0;
+        for (int p = 0; p < block->predecessor_count; p++) {
+            int pred = cfg->predecessors[block->predecessor_start + p];
+            if (mark[pred] != stamp && cfg->blocks[pred].rpo >= 0 && cfg_dominates(cfg, header, pred)) {
+                mark[pred] = stamp;
+                worklist[top++] = pred;
+                grow_array((void**) &cfg->loop_blocks, &cfg->loop_block_capacity, cfg->loop_block_count + 1,
+                           sizeof(int));
+                cfg->loop_blocks[cfg->loop_block_count++] = pred;
+            }
+        }
+        while (top > 0) {
+            BasicBlock* member = &cfg->blocks[worklist[--top]];
+            for (int p = 0; p < member->predecessor_count; p++) {
+                int pred = cfg->predecessors[member->predecessor_start + p];
+                if (cfg->blocks[pred].rpo >= 0 && mark[pred] != stamp) {
+                    mark[pred] = stamp;
+                    worklist[top++] = pred;
+                    grow_array((void**) &cfg->loop_blocks, &cfg->loop_block_capacity, cfg->loop_block_count + 1,
+                               sizeof(int));
+                    cfg->loop_blocks[cfg->loop_block_count++] = pred;
+                }
+            }
+        }
+        loop->block_count = cfg->loop_block_count - loop->block_start;
+    }
+
+    // Outer loops are larger than the loops they contain, so visiting the
+    // loops by decreasing size leaves each block with its innermost loop,
+    // and finds a loop's parent as the loop its header was in until then
+    if (cfg->loop_count > 1) {
+        qsort(cfg->loops, cfg->loop_count, sizeof(Loop), compare_loop_size);
+    }
+    for (int l = 0; l < cfg->loop_count; l++) {
+        Loop* loop = &cfg->loops[l];
+        loop->parent = cfg->blocks[loop->header].loop;
+        for (int i = 0; i < loop->block_count; i++) {
+            BasicBlock* block = &cfg->blocks[cfg->loop_blocks[loop->block_start + i]];
+            block->loop = l;
+            block->loop_depth++;
+        }
+    }
+}
+
+void cfg_build(CFG* cfg, TACBuffer* tac, int start, int label_count) {
+    find_blocks(cfg, tac, start, label_count);
+    order_blocks(cfg);
+    find_dominators(cfg);
+    find_loops(cfg);
+}
+
+void cfg_free(CFG* cfg) {
+    free(cfg->blocks);
+    free(cfg->predecessors);
+    free(cfg->dom_children);
+    free(cfg->dom_order);
+    free(cfg->rpo_order);
+    free(cfg->loops);
+    free(cfg->loop_blocks);
+    free(cfg->label_blocks);
+    free(cfg->scratch);
+    memset(cfg, 0, sizeof(CFG));
+}
+
+int cfg_dominates(CFG* cfg, int a, int b) {
+    if (cfg->blocks[a].rpo < 0 || cfg->blocks[b].rpo < 0) {
+        return 0;
+    }
+    // Dominators come before the blocks they dominate in reverse postorder
+    while (b >= 0 && cfg->blocks[b].rpo > cfg->blocks[a].rpo) {
+        b = cfg->blocks[b].idom;
+    }
+    return b == a;
+}
+
+int cfg_block_of(CFG* cfg, int instruction) {
+    int low = 0;
+    int high = cfg->block_count - 1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        if (instruction < cfg->blocks[middle].first) {
+            high = middle - 1;
+        } else if (instruction >= cfg->blocks[middle].end) {
+            low = middle + 1;
+        } else {
+            return middle;
+        }
+    }
+    return -1;
+}
+
+// Write text as the inside of a dot string
+static void write_escaped(FILE* file, const char* text) {
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+        }
+        fputc(*c, file);
+    }
+}
+
+void cfg_write_dot(FILE* file, InternTable* atoms, CFG* cfg, TACBuffer* tac, const char* name) {
+    char line[256];
+    fprintf(file, "digraph \"%s\" {\n", name);
+    fprintf(file, "    node [shape=box, fontname=\"monospace\"];\n");
+    for (int b = 0; b < cfg->block_count; b++) {
+        BasicBlock* block = &cfg->blocks[b];
+        fprintf(file, "    B%d [label=\"B%d", b, b);
+        if (block->rpo < 0) {
+            fprintf(file, " (unreachable)");
+        } else if (block->loop >= 0 && cfg->loops[block->loop].header == b) {
+            fprintf(file, " (loop header, depth %d)", block->loop_depth);
+        }
+        fprintf(file, "\\l");
+        for (int i = block->first; i < block->end; i++) {
+            tac_format(atoms, &tac->items[i], line, sizeof(line));
+            write_escaped(file, line);
+            fprintf(file, "\\l");
+        }
+        fprintf(file, "\"];\n");
+    }
+    for (int b = 0; b < cfg->block_count; b++) {
+        for (int s = 0; s < 2; s++) {
+            int succ = cfg->blocks[b].successors[s];
+            if (succ >= 0) {
+                fprintf(file, "    B%d -> B%d%s;\n", b, succ, cfg_dominates(cfg, succ, b) ? " [style=dashed]" : "");
+            }
+        }
+    }
+    fprintf(file, "}\n");
+}
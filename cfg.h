@@ -0,0 +1,86 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include <stdio.h>
+#include "tac.h"
+
+// Control-flow graph of a range of TAC. A block starts at the first
+// instruction, at every label and after every jump or ifFalse. Blocks are
+// numbered in program order and block 0 is the entry.
+typedef struct {
+    int first;              // First instruction, an index into the TACBuffer
+    int end;                // One past the last instruction
+    int successors[2];      // Fall-through (or j target) first, then the ifFalse target; -1 when absent
+    int predecessor_start;  // Slice of CFG.predecessors
+    int predecessor_count;
+    int rpo;                // Position in reverse postorder, -1 when unreachable
+    int idom;               // Immediate dominator, -1 for the entry and unreachable blocks
+    int child_start;        // Slice of CFG.dom_children: the blocks this one immediately dominates
+    int child_count;
+    int loop;               // Innermost natural loop containing the block, -1 for none
+    int loop_depth;
+} BasicBlock;
+
+// A natural loop: the header and every block that reaches a back edge to
+// it without passing through the header. Back edges with the same header
+// make one loop.
+typedef struct {
+    int header;
+    int latch;              // Source of a back edge; the last one when there are several
+    int parent;             // Innermost enclosing loop, -1 for an outermost one
+    int block_start;        // Slice of CFG.loop_blocks, the header first
+    int block_count;
+} Loop;
+
+// Built by cfg_build() and rebuilt for each range; the arrays are kept and
+// reused. Indices into the TACBuffer go stale when instructions are
+// inserted or removed, so a pass that does either rebuilds the graph.
+typedef struct {
+    BasicBlock* blocks;
+    int block_count;
+    int block_capacity;
+    int edge_count;
+
+    int* predecessors;
+    int predecessor_capacity;
+    int* dom_children;
+    int dom_children_capacity;
+    int* dom_order;         // Reachable blocks in preorder of the dominator tree
+    int dom_order_capacity;
+    int* rpo_order;         // Reachable blocks in reverse postorder
+    int reachable_count;
+    int rpo_capacity;
+
+    Loop* loops;            // Outer loops before the loops they contain
+    int loop_count;
+    int loop_capacity;
+    int* loop_blocks;
+    int loop_block_count;
+    int loop_block_capacity;
+
+    // Scratch, indexed by label number and by block
+    int* label_blocks;
+    int label_capacity;
+    int* scratch;
+    int scratch_capacity;
+} CFG;
+
+// Build the graph of instructions [start, tac->count). label_count bounds
+// the numbers of the labels they use.
+void cfg_build(CFG* cfg, TACBuffer* tac, int start, int label_count);
+void cfg_free(CFG* cfg);
+
+// True when every path from the entry to block b goes through block a
+int cfg_dominates(CFG* cfg, int a, int b);
+
+// Index of the block holding instruction, -1 if it is outside the graph
+int cfg_block_of(CFG* cfg, int instruction);
+
+// The block starting with label, -1 if the label is not in the graph
+int cfg_label_block(CFG* cfg, TACBuffer* tac, TACOperand label);
+
+// Write the graph in Graphviz dot syntax, one node per block listing its
+// instructions. Back edges are dashed and loop headers say so.
+void cfg_write_dot(FILE* file, InternTable* atoms, CFG* cfg, TACBuffer* tac, const char* name);
+
+#endif // CFG_H
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Client for "./compiler --serve=SOCKET", see server.h for the protocol.
+// Sends each file to the server, writes its assembly next to it (a.cm gives
+// a.asm) and prints the diagnostics and the server's compile time. With
+// -n it sends the whole list that many times and only reports totals, which
+// is how the server is benchmarked against spawning ./compiler per file.
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s SOCKET [--stream] [-n REPEAT] <source file>...\n", program);
+    fprintf(stderr, "       %s SOCKET --shutdown\n", program);
+}
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static char* read_file(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    size_t capacity = 65536;
+    char* data = malloc(capacity);
+    size_t n;
+    *length = 0;
+    while (data != NULL && (n = fread(data + *length, 1, capacity - *length, file)) > 0) {
+        *length += n;
+        if (*length == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+    }
+    fclose(file);
+    return data;
+}
+
+// The input path with its extension replaced by extension
+static char* output_path(const char* input, const char* extension) {
+    const char* base = strrchr(input, '/');
+    const char* dot = strrchr(base != NULL ? base : input, '.');
+    size_t stem = dot != NULL ? (size_t)(dot - input) : strlen(input);
+    char* path = malloc(stem + strlen(extension) + 1);
+    memcpy(path, input, stem);
+    strcpy(path + stem, extension);
+    return path;
+}
+
+// Send one request and read the response. Returns the compile status, or
+// -1 if the connection failed.
+static int compile_remote(FILE* in, FILE* out, const char* source, size_t length, int stream_mode,
+                          const char* asm_path, long* microseconds) {
+    fprintf(out, "compile %zu%s\n", length, stream_mode ? " stream" : "");
+    fwrite(source, 1, length, out);
+    if (fflush(out) != 0) {
+        return -1;
+    }
+
+    char header[128];
+    int status;
+    size_t assembly_length, diagnostics_length;
+    if (fgets(header, sizeof(header), in) == NULL ||
+        sscanf(header, "result %d %zu %zu %ld", &status, &assembly_length, &diagnostics_length, microseconds) != 4) {
+        return -1;
+    }
+
+    char* body = malloc(assembly_length + diagnostics_length + 1);
+    if (body == NULL || fread(body, 1, assembly_length + diagnostics_length, in) != assembly_length + diagnostics_length) {
+        free(body);
+        return -1;
+    }
+    if (asm_path != NULL) {
+        FILE* file = fopen(asm_path, "w");
+        if (file != NULL) {
+            fwrite(body, 1, assembly_length, file);
+            fclose(file);
+        } else {
+            perror(asm_path);
+        }
+        fwrite(body + assembly_length, 1, diagnostics_length, stderr);
+    }
+    free(body);
+    return status;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int stream_mode = 0;
+    int repeat = 0;
+    int shutdown_server = 0;
+    char** inputs = malloc(argc * sizeof(char*));
+    int input_count = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--stream") == 0) {
+            stream_mode = 1;
+        } else if (strcmp(argv[i], "--shutdown") == 0) {
+            shutdown_server = 1;
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            inputs[input_count++] = argv[i];
+        }
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, argv[1], sizeof(address.sun_path) - 1);
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0 || connect(connection, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    FILE* in = fdopen(connection, "r");
+    FILE* out = fdopen(dup(connection), "w");
+
+    if (shutdown_server) {
+        fprintf(out, "shutdown\n");
+        fclose(out);
+        fclose(in);
+        return 0;
+    }
+
+    char** sources = malloc(input_count * sizeof(char*));
+    size_t* lengths = malloc(input_count * sizeof(size_t));
+    for (int i = 0; i < input_count; i++) {
+        sources[i] = read_file(inputs[i], &lengths[i]);
+        if (sources[i] == NULL) {
+            perror(inputs[i]);
+            return 1;
+        }
+    }
+
+    int rounds = repeat > 0 ? repeat : 1;
+    int requests = 0;
+    int failed = 0;
+    long server_microseconds = 0;
+    double start = now_seconds();
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < input_count; i++) {
+            char* asm_path = repeat > 0 ? NULL : output_path(inputs[i], ".asm");
+            long microseconds = 0;
+            int status = compile_remote(in, out, sources[i], lengths[i], stream_mode, asm_path, &microseconds);
+            free(asm_path);
+            if (status < 0) {
+                fprintf(stderr, "Lost the connection to the server\n");
+                return 1;
+            }
+            if (repeat == 0) {
+                printf("%s: status %d, compiled in %ld us\n", inputs[i], status, microseconds);
+            }
+            failed += status != 0;
+            server_microseconds += microseconds;
+            requests++;
+        }
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("%d requests (%d failed) in %f seconds: %.1f requests/s, %f seconds compiling in the server\n",
+           requests, failed, elapsed, elapsed > 0 ? requests / elapsed : 0.0, server_microseconds / 1e6);
+
+    for (int i = 0; i < input_count; i++) {
+        free(sources[i]);
+    }
+    free(sources);
+    free(lengths);
+    free(inputs);
+    fclose(out);
+    fclose(in);
+    return failed != 0;
+}
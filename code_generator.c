@@ -1,23 +1,12 @@
-#include "code_generator.h"
+#include "compiler.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdarg.h>
 #include <stdio.h> // Include for debugging output
 
-#define MAX_VARIABLES 500
-#define MAX_TAC_INSTRUCTIONS 1000
-
-struct {
-    char* name;
-    int offset;
-    int is_float; // Track if the variable is a float
-} variables[MAX_VARIABLES];
-int variable_count = 0;
-
-TACInstruction tac_instructions[MAX_TAC_INSTRUCTIONS];
-int tac_instruction_count = 0;
-
-void generateCode(const char* tac_filename, FILE* output_file) {
+void beginCodeGeneration(FILE* output_file) {
     fprintf(output_file, ".data\n");
     fprintf(output_file, "newline: .asciiz \"\\n\"\n");
     fprintf(output_file, ".text\n");
@@ -26,174 +15,130 @@ void generateCode(const char* tac_filename, FILE* output_file) {
 
     // Add this line to initialize stack pointer
     fprintf(output_file, "addi $sp, $sp, -500\n");  // Allocate stack space
+}
 
-    printf("Generating code from TAC file: %s\n", tac_filename);
-    readTACFile(tac_filename);
-    generateTACCode(output_file);
-    
+// Translate ctx->tac from instruction start on. Variable slots are kept
+// across calls, so a program emitted one segment at a time uses the same
+// stack layout as one emitted in a single pass.
+void generateCodeSegment(CompilerContext* ctx, int start, FILE* output_file) {
+    TRACE(TRACE_CODEGEN, TRACE_LEVEL_INFO, "Generating code from TAC instruction %d\n", start);
+    generateTACCode(ctx, start, output_file);
+}
+
+void endCodeGeneration(FILE* output_file) {
     fprintf(output_file, "li $v0, 10\n");
     fprintf(output_file, "syscall\n");
-    printf("Code generation completed.\n");
+    TRACE(TRACE_CODEGEN, TRACE_LEVEL_INFO, "Code generation completed.\n");
 }
 
-void readTACFile(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        fprintf(stderr, "Error opening TAC file\n");
-        exit(1);
-    }
+void generateCode(CompilerContext* ctx, FILE* output_file) {
+    beginCodeGeneration(output_file);
+    generateCodeSegment(ctx, 0, output_file);
+    endCodeGeneration(output_file);
+}
 
-    printf("Reading TAC file: %s\n", filename);
-    char line[100];
-    while (fgets(line, sizeof(line), file) && tac_instruction_count < MAX_TAC_INSTRUCTIONS) {
-        TACInstruction* instr = &tac_instructions[tac_instruction_count];
-        if (sscanf(line, "%s = %s %s %s", instr->result, instr->arg1, instr->op, instr->arg2) == 4) {
-            printf("Parsed instruction: %s = %s %s %s\n", instr->result, instr->arg1, instr->op, instr->arg2);
-            tac_instruction_count++;
-        } else if (sscanf(line, "%s = %s", instr->result, instr->arg1) == 2) {
-            instr->op[0] = '\0';
-            instr->arg2[0] = '\0';
-            printf("Parsed assignment: %s = %s\n", instr->result, instr->arg1);
-            tac_instruction_count++;
-        } else if (sscanf(line, "print %s", instr->arg1) == 1) {
-            strcpy(instr->result, "print");
-            instr->op[0] = '\0';
-            instr->arg2[0] = '\0';
-            printf("Parsed print instruction: %s\n", instr->arg1);
-            tac_instruction_count++;
-        } else if (sscanf(line, "ifFalse %s goto %s", instr->arg1, instr->arg2) == 2) {
-            strcpy(instr->result, "ifFalse");
-            instr->op[0] = '\0';
-            printf("Parsed ifFalse instruction: %s goto %s\n", instr->arg1, instr->arg2);
-            tac_instruction_count++;
-        } else if (sscanf(line, "label %s::", instr->arg1) == 1) {
-            // Label instruction
-            strcpy(instr->result, "label");  // Set result to "label"
-            instr->op[0] = '\0';             // Clear out op
-            instr->arg2[0] = '\0';           // Clear out arg2
-            printf("Parsed label: %s\n", instr->arg1);  // Show label name
-            tac_instruction_count++;
-        } else if (sscanf(line, "j %s", instr->arg1) == 1) {
-            // Jump instruction
-            strcpy(instr->result, "j");  // Set result to "j"
-            instr->op[0] = '\0';         // Clear out op
-            instr->arg2[0] = '\0';       // Clear out arg2
-            printf("Parsed jump: j %s\n", instr->arg1);  // Log the jump
-            tac_instruction_count++;
+void generateTACCode(CompilerContext* ctx, int start, FILE* output_file) {
+    char label[64];
+    TRACE(TRACE_CODEGEN, TRACE_LEVEL_INFO, "Generating TAC code...\n");
+    for (int i = start; i < ctx->tac.count; i++) {
+        TACInstruction* instr = &ctx->tac.items[i];
+        if (TRACE_ON(TRACE_CODEGEN, TRACE_LEVEL_DEBUG)) {
+            char line[256];
+            tac_format(&ctx->atoms, instr, line, sizeof(line));
+            trace_printf("####### Instruction %d: %s\n", i, line);
         }
-    }
 
-    fclose(file);
-    printf("Finished reading TAC file. Total instructions: %d\n", tac_instruction_count);
-}
-
-void generateTACCode(FILE* output_file) {
-    printf("Generating TAC code...\n");
-    for (int i = 0; i < tac_instruction_count; i++) {
-        TACInstruction* instr = &tac_instructions[i];
-        printf("####### Instruction %d: result='%s', arg1='%s', op='%s', arg2='%s'\n", 
-                i, 
-                instr->result, 
-                instr->arg1, 
-                instr->op, 
-                instr->arg2);
-
-        if (strcmp(instr->result, "print") == 0) {
-            generateWriteCode(instr->arg1, output_file);
-        } else if (strncmp(instr->result, "f", 1) == 0) {
-            // Generate comparison code
-            int offset1 = getVariableLocation(instr->arg1);
-            int offset2 = getVariableLocation(instr->arg2);
-            fprintf(output_file, "lw $t1, %d($sp)\n", offset1);    // Load x
-            fprintf(output_file, "lw $t2, %d($sp)\n", offset2);    // Load y
-
-            if (strcmp(instr->op, "<") == 0) {
-                fprintf(output_file, "slt $t0, $t1, $t2\n");
-            }else if (strcmp(instr->op, ">") == 0) {
-                fprintf(output_file, "slt $t0, $t2, $t1\n");
-            } else if (strcmp(instr->op, "==") == 0) {
-                fprintf(output_file, "sub $t3, $t1, $t2\n");       // t3 = t1 - t2
-                fprintf(output_file, "seq $t0, $t3, $zero\n");     // t0 = (t3 == 0)
-            } else if (strcmp(instr->op, "!=") == 0) {
-                fprintf(output_file, "sub $t3, $t1, $t2\n");       // t3 = t1 - t2
-                fprintf(output_file, "sne $t0, $t3, $zero\n");     // t0 = (t3 != 0)
-            } else if (strcmp(instr->op, "+") == 0 || strcmp(instr->op, "-") == 0 ||
-                        strcmp(instr->op, "*") == 0|| strcmp(instr->op, "/") == 0) {
-                generateBinaryOpCode(instr, output_file);
-            } else if (instr->op[0] == '\0') {
-                generateAssignmentCode(instr, output_file);
-            } else {
-                fprintf(stderr, "Unsupported operator: %s\n", instr->op);
-                exit(1);
-            }
-
-            fprintf(output_file, "sw $t0, %d($sp)\n", getVariableLocation(instr->result));
-        } else if (strcmp(instr->result, "ifFalse") == 0) {
-            // Load condition value into $t0
-            int offset = getVariableLocation(instr->arg1);
-            fprintf(output_file, "lw $t0, %d($sp)\n", offset);
-
-            // Branch to the label if $t0 is zero
-            fprintf(output_file, "beq $t0, $zero, %s\n", instr->arg2);
-            printf("Generated ifFalse: branch to %s if %s is 0\n", instr->arg2, instr->arg1);
-        } else if (strcmp(instr->result, "label") == 0) {
-            fprintf(output_file, "%s:\n", instr->arg1);
-            printf("Generated label: %s\n", instr->arg1);
-        } else if (strcmp(instr->result, "j") == 0) {
-            // Handle unconditional jump
-            fprintf(output_file, "j %s\n", instr->arg1);
-            printf("Generated jump: jump to %s\n", instr->arg1);
-        } else if (instr->op[0] != '\0') {
-            generateBinaryOpCode(instr, output_file);
-        } else {
-            generateAssignmentCode(instr, output_file);
+        switch (instr->opcode) {
+            case TAC_COPY:
+                generateAssignmentCode(ctx, instr, output_file);
+                break;
+            case TAC_ADD:
+            case TAC_SUB:
+            case TAC_MUL:
+            case TAC_DIV:
+                generateBinaryOpCode(ctx, instr, output_file);
+                break;
+            case TAC_LT:
+            case TAC_GT:
+            case TAC_EQ:
+            case TAC_NE:
+                generateComparisonCode(ctx, instr, output_file);
+                break;
+            case TAC_PRINT:
+                generateWriteCode(ctx, instr->arg1, output_file);
+                break;
+            case TAC_IFFALSE:
+                // Load condition value into $t0
+                loadOperand(ctx, instr->arg1, "$t0", output_file);
+
+                // Branch to the label if $t0 is zero
+                tac_operand_text(&ctx->atoms, instr->arg2, label, sizeof(label));
+                fprintf(output_file, "beq $t0, $zero, %s\n", label);
+                TRACE(TRACE_CODEGEN, TRACE_LEVEL_DEBUG, "Generated ifFalse: branch to %s\n", label);
+                break;
+            case TAC_LABEL:
+                tac_operand_text(&ctx->atoms, instr->arg1, label, sizeof(label));
+                fprintf(output_file, "%s:\n", label);
+                TRACE(TRACE_CODEGEN, TRACE_LEVEL_DEBUG, "Generated label: %s\n", label);
+                break;
+            case TAC_JUMP:
+                tac_operand_text(&ctx->atoms, instr->arg1, label, sizeof(label));
+                fprintf(output_file, "j %s\n", label);
+                TRACE(TRACE_CODEGEN, TRACE_LEVEL_DEBUG, "Generated jump: jump to %s\n", label);
+                break;
+            case TAC_PARAM:
+            case TAC_RETURN:
+                break;  // Calls are not translated yet
+            default:
+                fprintf(ctx->diagnostics, "Unsupported operator: %s\n", tac_opcode_symbol(instr->opcode));
+                compiler_fatal(ctx);
         }
     }
-    printf("TAC code generation completed.\n");
+    TRACE(TRACE_CODEGEN, TRACE_LEVEL_INFO, "TAC code generation completed.\n");
 }
 
 
+// Load an integer operand into reg: an immediate with li, anything else
+// from its stack slot
+void loadOperand(CompilerContext* ctx, TACOperand operand, const char* reg, FILE* output_file) {
+    if (operand.kind == OPERAND_INT) {
+        fprintf(output_file, "li %s, %d\n", reg, operand.int_value);
+    } else {
+        fprintf(output_file, "lw %s, %d($sp)\n", reg, getVariableLocation(ctx, operand));
+    }
+}
 
-
-void generateAssignmentCode(TACInstruction* instr, FILE* output_file) {
-    printf("Generating assignment code for: %s = %s\n", instr->result, instr->arg1);
-    if (is_int(instr->arg1)) {
-        fprintf(output_file, "li $t0, %s\n", instr->arg1);
-        printf("Loaded integer literal into $t0: %s\n", instr->arg1);
-    } else if (is_float(instr->arg1)) {
-        fprintf(output_file, "li.s $f0, %s\n", instr->arg1);
-        printf("Loaded float literal into $f0: %s\n", instr->arg1);
+void generateAssignmentCode(CompilerContext* ctx, TACInstruction* instr, FILE* output_file) {
+    int is_float = instr->arg1.kind == OPERAND_FLOAT;
+    if (instr->arg1.kind == OPERAND_INT) {
+        fprintf(output_file, "li $t0, %d\n", instr->arg1.int_value);
+        TRACE(TRACE_CODEGEN, TRACE_LEVEL_VERBOSE, "Loaded integer literal into $t0: %d\n", instr->arg1.int_value);
+    } else if (is_float) {
+        fprintf(output_file, "li.s $f0, %f\n", instr->arg1.float_value);
+        TRACE(TRACE_CODEGEN, TRACE_LEVEL_VERBOSE, "Loaded float literal into $f0: %f\n", instr->arg1.float_value);
     } else {
         // Load variable value
-        int offset = getVariableLocation(instr->arg1);
-        if (is_float(instr->arg1)) {
-            fprintf(output_file, "l.s $f0, %d($sp)\n", offset);
-            printf("Loaded float variable into $f0 from offset: %d\n", offset);
-        } else {
-            fprintf(output_file, "lw $t0, %d($sp)\n", offset);
-            printf("Loaded integer variable into $t0 from offset: %d\n", offset);
-        }
+        int offset = getVariableLocation(ctx, instr->arg1);
+        fprintf(output_file, "lw $t0, %d($sp)\n", offset);
+        TRACE(TRACE_CODEGEN, TRACE_LEVEL_VERBOSE, "Loaded integer variable into $t0 from offset: %d\n", offset);
     }
 
-    int result_offset = getVariableLocation(instr->result);
-    if (is_float(instr->arg1)) {
+    int result_offset = getVariableLocation(ctx, instr->result);
+    if (is_float) {
         fprintf(output_file, "s.s $f0, %d($sp)\n", result_offset);
-        printf("Stored float result into offset: %d\n", result_offset);
+        TRACE(TRACE_CODEGEN, TRACE_LEVEL_VERBOSE, "Stored float result into offset: %d\n", result_offset);
     } else {
         fprintf(output_file, "sw $t0, %d($sp)\n", result_offset);
-        printf("Stored integer result into offset: %d\n", result_offset);
+        TRACE(TRACE_CODEGEN, TRACE_LEVEL_VERBOSE, "Stored integer result into offset: %d\n", result_offset);
     }
 }
 
-void generateWriteCode(const char* arg, FILE* output_file) {
-    printf("Generating write code for: %s\n", arg);
-    if (is_float(arg)) {
-        int offset = getVariableLocation(arg);
-        fprintf(output_file, "l.s $f0, %d($sp)\n", offset);
+void generateWriteCode(CompilerContext* ctx, TACOperand arg, FILE* output_file) {
+    if (arg.kind == OPERAND_FLOAT) {
+        fprintf(output_file, "li.s $f0, %f\n", arg.float_value);
         fprintf(output_file, "li $v0, 2\n"); // Print float
     } else {
-        int offset = getVariableLocation(arg);
-        fprintf(output_file, "lw $a0, %d($sp)\n", offset);
+        loadOperand(ctx, arg, "$a0", output_file);
         fprintf(output_file, "li $v0, 1\n"); // Print integer
     }
     fprintf(output_file, "syscall\n");
@@ -202,131 +147,352 @@ void generateWriteCode(const char* arg, FILE* output_file) {
     fprintf(output_file, "syscall\n");
 }
 
-void generateBinaryOpCode(TACInstruction* instr, FILE* output_file) {
-    printf("Generating binary operation code for: %s = %s %s %s\n", instr->result, instr->arg1, instr->op, instr->arg2);
-    int offset1 = getVariableLocation(instr->arg1);
-    int offset2 = getVariableLocation(instr->arg2);
-    
-    if (is_float(instr->arg1)) {
-        fprintf(output_file, "l.s $f1, %d($sp)\n", offset1);
-        printf("Loaded float variable into $f1 from offset: %d\n", offset1);
-    } else {
-        fprintf(output_file, "lw $t1, %d($sp)\n", offset1);
-        printf("Loaded integer variable into $t1 from offset: %d\n", offset1);
+// Comparisons leave 1 or 0 in $t0
+void generateComparisonCode(CompilerContext* ctx, TACInstruction* instr, FILE* output_file) {
+    loadOperand(ctx, instr->arg1, "$t1", output_file);    // Load x
+    loadOperand(ctx, instr->arg2, "$t2", output_file);    // Load y
+
+    switch (instr->opcode) {
+        case TAC_LT:
+            fprintf(output_file, "slt $t0, $t1, $t2\n");
+            break;
+        case TAC_GT:
+            fprintf(output_file, "slt $t0, $t2, $t1\n");
+            break;
+        case TAC_EQ:
+            fprintf(output_file, "sub $t3, $t1, $t2\n");       // t3 = t1 - t2
+            fprintf(output_file, "seq $t0, $t3, $zero\n");     // t0 = (t3 == 0)
+            break;
+        default:
+            fprintf(output_file, "sub $t3, $t1, $t2\n");       // t3 = t1 - t2
+            fprintf(output_file, "sne $t0, $t3, $zero\n");     // t0 = (t3 != 0)
+            break;
     }
 
-    if (is_float(instr->arg2)) {
-        fprintf(output_file, "l.s $f2, %d($sp)\n", offset2);
-        printf("Loaded float variable into $f2 from offset: %d\n", offset2);
+    fprintf(output_file, "sw $t0, %d($sp)\n", getVariableLocation(ctx, instr->result));
+}
+
+// Load an operand of a float operation into reg
+static void loadFloatOperand(CompilerContext* ctx, TACOperand operand, const char* reg, FILE* output_file) {
+    if (operand.kind == OPERAND_FLOAT) {
+        fprintf(output_file, "li.s %s, %f\n", reg, operand.float_value);
     } else {
-        fprintf(output_file, "lw $t2, %d($sp)\n", offset2);
-        printf("Loaded integer variable into $t2 from offset: %d\n", offset2);
+        fprintf(output_file, "l.s %s, %d($sp)\n", reg, getVariableLocation(ctx, operand));
     }
+}
 
-    if (strcmp(instr->op, "+") == 0) {
-        if (is_float(instr->arg1) || is_float(instr->arg2)) {
-            fprintf(output_file, "add.s $f0, $f1, $f2\n");
-            printf("Performed float addition: $f0 = $f1 + $f2\n");
-        } else {
-            fprintf(output_file, "add $t0, $t1, $t2\n");
-            printf("Performed integer addition: $t0 = $t1 + $t2\n");
+// Cycles until the result can be used, by kind of instruction, for deciding
+// when a multiply or divide by a constant is worth replacing with simpler
+// instructions
+typedef enum {
+    COST_ALU,               // addu, subu, sll, sra, srl, move, mfhi and li of 16 bits
+    COST_LI,                // li of a constant that needs lui and ori
+    COST_MUL,               // mul and mult
+    COST_DIV
+} InstructionCost;
+
+static const int instructionCycles[] = {
+    [COST_ALU] = 1,
+    [COST_LI] = 2,
+    [COST_MUL] = 10,
+    [COST_DIV] = 35
+};
+
+// Write an instruction unless output_file is NULL, which only counts it.
+// Returns its cycles.
+static int emitInstruction(FILE* output_file, InstructionCost cost, const char* format, ...) {
+    if (output_file != NULL) {
+        va_list args;
+        va_start(args, format);
+        vfprintf(output_file, format, args);
+        va_end(args);
+    }
+    return instructionCycles[cost];
+}
+
+static InstructionCost loadImmediateCost(int value) {
+    return value >= -32768 && value <= 65535 ? COST_ALU : COST_LI;
+}
+
+// $t0 = $t1 * magnitude, negated when negate is set, as one shift and one
+// addition or subtraction for each nonzero digit of magnitude in
+// non-adjacent form, so a run of ones costs a subtraction and an addition.
+// The result wraps like mul's. Returns the cycles, only counting them when
+// output_file is NULL.
+static int emitMultiplySequence(unsigned int magnitude, int negate, FILE* output_file) {
+    if (magnitude == 0) {
+        return emitInstruction(output_file, COST_ALU, "move $t0, $zero\n");
+    }
+    int positions[33];
+    int signs[33];
+    int count = 0;
+    for (long long n = magnitude, bit = 0; n != 0; n >>= 1, bit++) {
+        if (n & 1) {
+            signs[count] = (n & 3) == 1 ? 1 : -1;
+            positions[count++] = bit;
+            n -= signs[count - 1];
         }
-    } else if (strcmp(instr->op, "-") == 0) {
-        if (is_float(instr->arg1) || is_float(instr->arg2)) {
-            fprintf(output_file, "sub.s $f0, $f1, $f2\n");
-            printf("Performed float subtraction: $f0 = $f1 - $f2\n");
+    }
+    // The top digit is always positive
+    int top = positions[count - 1];
+    int cycles = top == 0 ? emitInstruction(output_file, COST_ALU, "move $t0, $t1\n")
+                          : emitInstruction(output_file, COST_ALU, "sll $t0, $t1, %d\n", top);
+    for (int d = count - 2; d >= 0; d--) {
+        const char* op = signs[d] > 0 ? "addu" : "subu";
+        if (positions[d] == 0) {
+            cycles += emitInstruction(output_file, COST_ALU, "%s $t0, $t0, $t1\n", op);
         } else {
-            fprintf(output_file, "sub $t0, $t1, $t2\n");
-            printf("Performed integer subtraction: $t0 = $t1 - $t2\n");
+            cycles += emitInstruction(output_file, COST_ALU, "sll $t3, $t1, %d\n", positions[d]);
+            cycles += emitInstruction(output_file, COST_ALU, "%s $t0, $t0, $t3\n", op);
         }
-    } else if (strcmp(instr->op, "*") == 0) {
-        if (is_float(instr->arg1) || is_float(instr->arg2)) {
-            fprintf(output_file, "mul.s $f0, $f1, $f2\n");
-            printf("Performed float multiplication: $f0 = $f1 * $f2\n");
-        } else {
-            fprintf(output_file, "mul $t0, $t1, $t2\n");
-            printf("Performed integer multiplication: $t0 = $t1 * $t2\n");
+    }
+    if (negate) {
+        cycles += emitInstruction(output_file, COST_ALU, "subu $t0, $zero, $t0\n");
+    }
+    return cycles;
+}
+
+// The magic number and shift for signed division by divisor, which is
+// neither 0, 1, -1 nor a power of two or its negation (Hacker's Delight,
+// figure 10-1)
+static void divisionMagic(int divisor, int* magic, int* shift) {
+    const unsigned int two31 = 0x80000000u;
+    unsigned int ad = divisor < 0 ? 0u - (unsigned int) divisor : (unsigned int) divisor;
+    unsigned int t = two31 + ((unsigned int) divisor >> 31);
+    unsigned int anc = t - 1 - t % ad;      // |nc|, the largest multiple of ad minus 1
+    int p = 31;
+    unsigned int q1 = two31 / anc;
+    unsigned int r1 = two31 - q1 * anc;
+    unsigned int q2 = two31 / ad;
+    unsigned int r2 = two31 - q2 * ad;
+    unsigned int delta;
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
         }
-    } else if (strcmp(instr->op, "/") == 0) {
-        if (is_float(instr->arg1) || is_float(instr->arg2)) {
-            fprintf(output_file, "div.s $f0, $f1, $f2\n");
-            printf("Performed float division: $f0 = $f1 / $f2\n");
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    *magic = (int) (q2 + 1);
+    if (divisor < 0) {
+        *magic = -*magic;
+    }
+    *shift = p - 32;
+}
+
+// $t0 = $t1 / divisor for a divisor other than 0 and -1, rounded toward
+// zero like div. A power of two is an arithmetic shift, after adding divisor - 1 to a
+// negative dividend; anything else takes the high word of the product with
+// a magic number, corrected by the dividend and the quotient's sign.
+// Returns the cycles, only counting them when output_file is NULL.
+static int emitDivideSequence(int divisor, FILE* output_file) {
+    unsigned int magnitude = divisor < 0 ? 0u - (unsigned int) divisor : (unsigned int) divisor;
+    if (divisor == 1) {
+        return emitInstruction(output_file, COST_ALU, "move $t0, $t1\n");
+    }
+    int cycles = 0;
+    if ((magnitude & (magnitude - 1)) == 0) {
+        int k = 0;
+        while ((1u << k) != magnitude) {
+            k++;
+        }
+        if (k == 1) {
+            cycles += emitInstruction(output_file, COST_ALU, "srl $t3, $t1, 31\n");
         } else {
-            fprintf(output_file, "div $t0, $t1, $t2\n");
-            printf("Performed integer division: $t0 = $t1 / $t2\n");
+            cycles += emitInstruction(output_file, COST_ALU, "sra $t3, $t1, 31\n");
+            cycles += emitInstruction(output_file, COST_ALU, "srl $t3, $t3, %d\n", 32 - k);
+        }
+        cycles += emitInstruction(output_file, COST_ALU, "addu $t3, $t1, $t3\n");
+        cycles += emitInstruction(output_file, COST_ALU, "sra $t0, $t3, %d\n", k);
+        if (divisor < 0) {
+            cycles += emitInstruction(output_file, COST_ALU, "subu $t0, $zero, $t0\n");
         }
+        return cycles;
     }
 
-    int result_offset = getVariableLocation(instr->result);
-    if (is_float(instr->arg1) || is_float(instr->arg2)) {
-        fprintf(output_file, "s.s $f0, %d($sp)\n", result_offset);
-        printf("Stored float result into offset: %d\n", result_offset);
-    } else {
-        fprintf(output_file, "sw $t0, %d($sp)\n", result_offset);
-        printf("Stored integer result into offset: %d\n", result_offset);
+    int magic;
+    int shift;
+    divisionMagic(divisor, &magic, &shift);
+    cycles += emitInstruction(output_file, loadImmediateCost(magic), "li $t3, %d\n", magic);
+    cycles += emitInstruction(output_file, COST_MUL, "mult $t1, $t3\n");
+    cycles += emitInstruction(output_file, COST_ALU, "mfhi $t0\n");
+    if (divisor > 0 && magic < 0) {
+        cycles += emitInstruction(output_file, COST_ALU, "addu $t0, $t0, $t1\n");
+    } else if (divisor < 0 && magic > 0) {
+        cycles += emitInstruction(output_file, COST_ALU, "subu $t0, $t0, $t1\n");
+    }
+    if (shift > 0) {
+        cycles += emitInstruction(output_file, COST_ALU, "sra $t0, $t0, %d\n", shift);
     }
+    // Add 1 to a negative quotient, rounding it toward zero
+    cycles += emitInstruction(output_file, COST_ALU, "srl $t3, $t0, 31\n");
+    cycles += emitInstruction(output_file, COST_ALU, "addu $t0, $t0, $t3\n");
+    return cycles;
 }
 
-int is_int(const char* str) {
-    char* endptr;
-    strtol(str, &endptr, 10);
-    int result = *endptr == '\0';
-    printf("is_int(%s) = %d\n", str, result);
-    return result;
+// Leave the result of an integer multiply by a constant or divide by a
+// nonzero constant in $t0 with shifts and additions, when the cost table
+// puts that below loading the constant and using mul or div. Division by
+// -1 stays a div, which traps on INT_MIN / -1 where a negation would wrap.
+// Returns 0, having written nothing, when it does not.
+static int lowerConstantOperation(CompilerContext* ctx, TACInstruction* instr, FILE* output_file) {
+    int constant;
+    TACOperand operand;
+    int cycles;
+    if (instr->opcode == TAC_MUL && (instr->arg1.kind == OPERAND_INT || instr->arg2.kind == OPERAND_INT)) {
+        int first = instr->arg1.kind == OPERAND_INT;
+        constant = first ? instr->arg1.int_value : instr->arg2.int_value;
+        operand = first ? instr->arg2 : instr->arg1;
+        unsigned int magnitude = constant < 0 ? 0u - (unsigned int) constant : (unsigned int) constant;
+        cycles = emitMultiplySequence(magnitude, constant < 0, NULL);
+        if (cycles >= instructionCycles[loadImmediateCost(constant)] + instructionCycles[COST_MUL]) {
+            return 0;
+        }
+        loadOperand(ctx, operand, "$t1", output_file);
+        emitMultiplySequence(magnitude, constant < 0, output_file);
+    } else if (instr->opcode == TAC_DIV && instr->arg2.kind == OPERAND_INT && instr->arg2.int_value != 0 &&
+               instr->arg2.int_value != -1) {
+        constant = instr->arg2.int_value;
+        cycles = emitDivideSequence(constant, NULL);
+        if (cycles >= instructionCycles[loadImmediateCost(constant)] + instructionCycles[COST_DIV]) {
+            return 0;
+        }
+        loadOperand(ctx, instr->arg1, "$t1", output_file);
+        emitDivideSequence(constant, output_file);
+    } else {
+        return 0;
+    }
+    TRACE(TRACE_CODEGEN, TRACE_LEVEL_VERBOSE, "Lowered integer operation: $t0 = $t1 %s %d in %d cycles\n",
+          tac_opcode_symbol(instr->opcode), constant, cycles);
+    return 1;
 }
 
-int is_float(const char* str) {
-    char* endptr;
-
-    // Use strtof to convert the string to a float
-    strtof(str, &endptr);
+void generateBinaryOpCode(CompilerContext* ctx, TACInstruction* instr, FILE* output_file) {
+    static const char* int_instructions[] = { "add", "sub", "mul", "div" };
+    static const char* wrapping_instructions[] = { "addu", "subu" };
+    static const char* float_instructions[] = { "add.s", "sub.s", "mul.s", "div.s" };
+    int is_float = instr->arg1.kind == OPERAND_FLOAT || instr->arg2.kind == OPERAND_FLOAT;
+    int index = instr->opcode - TAC_ADD;
+
+    if (is_float) {
+        loadFloatOperand(ctx, instr->arg1, "$f1", output_file);
+        loadFloatOperand(ctx, instr->arg2, "$f2", output_file);
+        fprintf(output_file, "%s $f0, $f1, $f2\n", float_instructions[index]);
+        TRACE(TRACE_CODEGEN, TRACE_LEVEL_VERBOSE, "Performed float operation: $f0 = $f1 %s $f2\n", tac_opcode_symbol(instr->opcode));
+    } else if (!lowerConstantOperation(ctx, instr, output_file)) {
+        loadOperand(ctx, instr->arg1, "$t1", output_file);
+        loadOperand(ctx, instr->arg2, "$t2", output_file);
+        fprintf(output_file, "%s $t0, $t1, $t2\n", instr->wraps ? wrapping_instructions[index] : int_instructions[index]);
+        TRACE(TRACE_CODEGEN, TRACE_LEVEL_VERBOSE, "Performed integer operation: $t0 = $t1 %s $t2\n", tac_opcode_symbol(instr->opcode));
+    }
 
-    // Check if the conversion consumed the entire string
-    // Check for the presence of a decimal point and ensure there are digits after it
-    int result = (*endptr == '\0') && (strchr(str, '.') != NULL);
+    int result_offset = getVariableLocation(ctx, instr->result);
+    if (is_float) {
+        fprintf(output_file, "s.s $f0, %d($sp)\n", result_offset);
+        TRACE(TRACE_CODEGEN, TRACE_LEVEL_VERBOSE, "Stored float result into offset: %d\n", result_offset);
+    } else {
+        fprintf(output_file, "sw $t0, %d($sp)\n", result_offset);
+        TRACE(TRACE_CODEGEN, TRACE_LEVEL_VERBOSE, "Stored integer result into offset: %d\n", result_offset);
+    }
+}
 
-    // Additional check to ensure there are digits after the decimal point
-    if (result) {
-        char* decimal_point = strchr(str, '.');
-        if (decimal_point != NULL) {
-            if (strlen(decimal_point) == 1 || !isdigit(*(decimal_point + 1))) {
-                result = 0; // No digits after the decimal point
-            }
+// Grow a slot table so that index fits, marking the new entries unused
+static int* growSlots(CompilerContext* ctx, int** slots, int* capacity, int index) {
+    if (index >= *capacity) {
+        int new_capacity = *capacity ? *capacity : 256;
+        while (new_capacity <= index) {
+            new_capacity *= 2;
+        }
+        *slots = realloc(*slots, new_capacity * sizeof(int));
+        if (*slots == NULL) {
+            fprintf(ctx->diagnostics, "Memory allocation failed for variable slots\n");
+            exit(1);
         }
+        for (int i = *capacity; i < new_capacity; i++) {
+            (*slots)[i] = -1;
+        }
+        *capacity = new_capacity;
     }
-
-    printf("is_float(%s) = %d\n", str, result);
-    return result;
+    return &(*slots)[index];
 }
 
-void allocateVariable(const char* identifier, int is_float) {
-    if (variable_count >= MAX_VARIABLES) {
-        fprintf(stderr, "Too many variables\n");
-        exit(1);
+// The entry of the slot table for an operand that lives in memory
+static int* operandSlot(CompilerContext* ctx, TACOperand operand) {
+    CodeGenState* cg = &ctx->codegen;
+    switch (operand.kind) {
+        case OPERAND_VARIABLE:
+        case OPERAND_ELEMENT:
+            return growSlots(ctx, &cg->variable_slots, &cg->variable_slot_capacity, operand.name);
+        case OPERAND_TEMP:
+        case OPERAND_FLOAT_TEMP:
+            return growSlots(ctx, &cg->temp_slots, &cg->temp_slot_capacity, operand.number);
     }
-    variables[variable_count].name = strdup(identifier);
-    variables[variable_count].offset = -4 * (variable_count + 1);
-    variables[variable_count].is_float = is_float;
-    printf("Allocated variable: %s, offset: %d, is_float: %d\n", identifier, variables[variable_count].offset, is_float);
-    variable_count++;
+    char text[64];
+    fprintf(ctx->diagnostics, "Error: %s has no stack slot\n", tac_operand_text(&ctx->atoms, operand, text, sizeof(text)));
+    compiler_fatal(ctx);
+    return NULL;
 }
 
-int getVariableLocation(const char* identifier) {
-    for (int i = 0; i < variable_count; i++) {
-        if (strcmp(variables[i].name, identifier) == 0) {
-            printf("Found variable %s at offset: %d\n", identifier, variables[i].offset);
-            return variables[i].offset;
+void allocateVariable(CompilerContext* ctx, TACOperand operand) {
+    CodeGenState* cg = &ctx->codegen;
+    if (cg->variable_count >= cg->variable_capacity) {
+        cg->variable_capacity = cg->variable_capacity ? cg->variable_capacity * 2 : 256;
+        cg->variables = realloc(cg->variables, cg->variable_capacity * sizeof(CodeGenVariable));
+        if (cg->variables == NULL) {
+            fprintf(ctx->diagnostics, "Memory allocation failed for variables\n");
+            exit(1);
         }
     }
-    allocateVariable(identifier, is_float(identifier));
-    printf("Allocated new variable %s at offset: %d\n", identifier, variables[variable_count - 1].offset);
-    return variables[variable_count - 1].offset;
+    *operandSlot(ctx, operand) = cg->variable_count;
+    cg->variables[cg->variable_count].operand = operand;
+    cg->variables[cg->variable_count].offset = -4 * (cg->variable_count + 1);
+    if (TRACE_ON(TRACE_CODEGEN, TRACE_LEVEL_VERBOSE)) {
+        char text[64];
+        trace_printf("Allocated variable: %s, offset: %d\n", tac_operand_text(&ctx->atoms, operand, text, sizeof(text)), cg->variables[cg->variable_count].offset);
+    }
+    cg->variable_count++;
+}
+
+int getVariableLocation(CompilerContext* ctx, TACOperand operand) {
+    CodeGenState* cg = &ctx->codegen;
+    int i = *operandSlot(ctx, operand);
+    if (i < 0) {
+        allocateVariable(ctx, operand);
+        i = cg->variable_count - 1;
+    }
+    return cg->variables[i].offset;
 }
 
-void freeCodeGenSymbolTable() {
-    for (int i = 0; i < variable_count; i++) {
-        free(variables[i].name);
+// Forget the previous program's variables but keep the memory of both
+// tables for the next one
+void resetCodeGenSymbolTable(CompilerContext* ctx) {
+    CodeGenState* cg = &ctx->codegen;
+    for (int i = 0; i < cg->variable_count; i++) {
+        *operandSlot(ctx, cg->variables[i].operand) = -1;
     }
-    variable_count = 0;
-    printf("Freed symbol table.\n");
+    cg->variable_count = 0;
+}
+
+void freeCodeGenSymbolTable(CompilerContext* ctx) {
+    CodeGenState* cg = &ctx->codegen;
+    free(cg->variables);
+    cg->variables = NULL;
+    cg->variable_capacity = 0;
+    free(cg->variable_slots);
+    cg->variable_slots = NULL;
+    cg->variable_slot_capacity = 0;
+    free(cg->temp_slots);
+    cg->temp_slots = NULL;
+    cg->temp_slot_capacity = 0;
+    cg->variable_count = 0;
+    TRACE(TRACE_CODEGEN, TRACE_LEVEL_DEBUG, "Freed symbol table.\n");
 }
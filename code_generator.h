@@ -2,25 +2,45 @@
 #define CODE_GENERATOR_H
 
 #include <stdio.h>
+#include "AST.h"
+#include "tac.h"
 
 typedef struct {
-    char result[10];
-    char arg1[10];
-    char op[4];
-    char arg2[10];
-} TACInstruction;
+    TACOperand operand;     // A variable, array element or temporary
+    int offset;
+} CodeGenVariable;
 
-void generateCode(const char* tac_filename, FILE* output_file);
-void readTACFile(const char* filename);
-void generateTACCode(FILE* output_file);
-void generateAssignmentCode(TACInstruction* instr, FILE* output_file);
-void generateWriteCode(const char* arg, FILE* output_file);
-void generateBinaryOpCode(TACInstruction* instr, FILE* output_file);
+// Per-compilation state of the code generator
+typedef struct {
+    // Grows on demand: in streaming mode every segment of the program adds
+    // its temporaries here
+    CodeGenVariable* variables;
+    int variable_count;
+    int variable_capacity;
+
+    // Index into variables[] for each atom naming a variable or array
+    // element, and for each temporary by number; -1 when there is no slot yet
+    int* variable_slots;
+    int variable_slot_capacity;
+    int* temp_slots;
+    int temp_slot_capacity;
+} CodeGenState;
+
+// Translate ctx->tac
+void generateCode(CompilerContext* ctx, FILE* output_file);
+void beginCodeGeneration(FILE* output_file);
+void generateCodeSegment(CompilerContext* ctx, int start, FILE* output_file);
+void endCodeGeneration(FILE* output_file);
+void generateTACCode(CompilerContext* ctx, int start, FILE* output_file);
+void generateAssignmentCode(CompilerContext* ctx, TACInstruction* instr, FILE* output_file);
+void generateWriteCode(CompilerContext* ctx, TACOperand arg, FILE* output_file);
+void generateBinaryOpCode(CompilerContext* ctx, TACInstruction* instr, FILE* output_file);
+void generateComparisonCode(CompilerContext* ctx, TACInstruction* instr, FILE* output_file);
+void loadOperand(CompilerContext* ctx, TACOperand operand, const char* reg, FILE* output_file);
 
-int is_number_cg(const char* str);
-int is_float(const char* str);
-void allocateVariable(const char* identifier, int is_float);
-int getVariableLocation(const char* identifier);
-void freeCodeGenSymbolTable();
+void allocateVariable(CompilerContext* ctx, TACOperand operand);
+int getVariableLocation(CompilerContext* ctx, TACOperand operand);
+void resetCodeGenSymbolTable(CompilerContext* ctx);
+void freeCodeGenSymbolTable(CompilerContext* ctx);
 
 #endif // CODE_GENERATOR_H
@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "compiler.h"
+
+void compiler_init(CompilerContext* ctx) {
+    memset(ctx, 0, sizeof(CompilerContext));
+    ctx->diagnostics = stderr;
+    intern_init(&ctx->atoms);
+    initAST(ctx);
+    init_symbol_table(&ctx->symbols, &ctx->atoms, ctx->diagnostics);
+    ctx->current_scope = ATOM_GLOBAL;
+    ctx->tac_path = "output.tac";
+    ctx->optimized_path = "optimized.tac";
+    ctx->cfg_path = "cfg.dot";
+    ctx->asm_path = "output.asm";
+    ctx->stream.segment_start = -1;
+}
+
+// Get a context that has compiled a program ready for the next one. The
+// intern table, the arena's first chunk, the TAC buffer and the code
+// generator's tables are kept, so a warm context skips most of the setup a
+// fresh one pays for. Options, output paths and the diagnostics stream are left as they are.
+void compiler_reset(CompilerContext* ctx) {
+    compiler_close_outputs(ctx);
+    OutputBuffer* outputs[] = { &ctx->tac_output, &ctx->optimized_output, &ctx->cfg_output, &ctx->asm_output };
+    for (int i = 0; i < 4; i++) {
+        free(outputs[i]->data);
+        outputs[i]->data = NULL;
+        outputs[i]->length = 0;
+    }
+    source_close(&ctx->source);
+
+    clean_up_symbol_table(&ctx->symbols);
+    resetCodeGenSymbolTable(ctx);
+    freeAST(ctx);
+    if (intern_memory_used(&ctx->atoms) > COMPILER_WARM_INTERN_LIMIT) {
+        // Atoms index the code generator's slot table and the analyzer's
+        // table of temporaries, so they go too
+        freeCodeGenSymbolTable(ctx);
+        freeSemanticState(ctx);
+        intern_free(&ctx->atoms);
+        intern_init(&ctx->atoms);
+    }
+
+    ctx->scanner = NULL;
+    ctx->token_offset = 0;
+    ctx->ast_temp_count = 0;
+    ctx->root = NULL;
+    ctx->current_scope = ATOM_GLOBAL;
+    memset(&ctx->resolve, 0, sizeof(ResolveState));
+    // The temporaries are numbered afresh, and a name that was one may be a
+    // variable's in the next program
+    if (ctx->sema.temp_operands != NULL) {
+        memset(ctx->sema.temp_operands, 0, ctx->sema.temp_operand_capacity * sizeof(TACOperand));
+    }
+    ctx->sema.temp_var_count = 0;
+    tac_truncate(&ctx->tac, 0);
+    memset(&ctx->stream, 0, sizeof(StreamState));
+    ctx->stream.segment_start = -1;
+    ctx->fatal_jump = NULL;
+}
+
+// Release everything the context owns, including any output files still
+// open and the buffers of memory outputs nobody took over
+void compiler_free(CompilerContext* ctx) {
+    compiler_close_outputs(ctx);
+    free_symbol_table(&ctx->symbols);
+    tac_free(&ctx->tac);
+    free(ctx->tac_output.data);
+    free(ctx->optimized_output.data);
+    free(ctx->cfg_output.data);
+    free(ctx->asm_output.data);
+    cfg_free(&ctx->cfg);
+    ssa_free(&ctx->ssa);
+    sccp_free(&ctx->sccp);
+    liveness_free(&ctx->live);
+    licm_free(&ctx->licm);
+    induction_free(&ctx->induction);
+    pre_free(&ctx->pre);
+    freeCodeGenSymbolTable(ctx);
+    freeSemanticState(ctx);
+    free_optimizer_state(ctx);
+    freeAST(ctx);
+    arena_free(&ctx->ast_arena);
+    intern_free(&ctx->atoms);
+    source_close(&ctx->source);
+}
+
+// Abandon the compilation after an error has been reported. The driver
+// catches this so that one bad input does not end the other compilations
+// running in the same process.
+void compiler_fatal(CompilerContext* ctx) {
+    if (ctx->fatal_jump != NULL) {
+        longjmp(*ctx->fatal_jump, 1);
+    }
+    exit(1);
+}
+
+// Open an output file, or a memory stream in memory_outputs mode. Failing
+// to create it abandons the compilation.
+FILE* compiler_open_output(CompilerContext* ctx, const char* path, OutputBuffer* buffer) {
+    FILE* file;
+    if (ctx->memory_outputs) {
+        file = open_memstream(&buffer->data, &buffer->length);
+    } else {
+        file = fopen(path, "w");
+    }
+    if (file == NULL) {
+        fprintf(ctx->diagnostics, "Error opening output file %s: %s\n", path, strerror(errno));
+        compiler_fatal(ctx);
+    }
+    return file;
+}
+
+// Open the assembly output and whichever dumps were asked for
+void compiler_open_outputs(CompilerContext* ctx) {
+    if (ctx->dump_tac) {
+        ctx->tac_file = compiler_open_output(ctx, ctx->tac_path, &ctx->tac_output);
+    }
+    if (ctx->dump_optimized) {
+        ctx->optimized_file = compiler_open_output(ctx, ctx->optimized_path, &ctx->optimized_output);
+    }
+    if (ctx->dump_cfg) {
+        ctx->cfg_file = compiler_open_output(ctx, ctx->cfg_path, &ctx->cfg_output);
+    }
+    ctx->asm_file = compiler_open_output(ctx, ctx->asm_path, &ctx->asm_output);
+}
+
+void compiler_close_outputs(CompilerContext* ctx) {
+    FILE** files[] = { &ctx->tac_file, &ctx->optimized_file, &ctx->cfg_file, &ctx->asm_file };
+    for (int i = 0; i < 4; i++) {
+        if (*files[i] != NULL) {
+            fclose(*files[i]);
+            *files[i] = NULL;
+        }
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdio.h>
+#include <setjmp.h>
+#include <time.h>
+#include "intern.h"
+#include "arena.h"
+#include "source.h"
+#include "symbol_table.h"
+#include "AST.h"
+#include "resolver.h"
+#include "tac.h"
+#include "cfg.h"
+#include "ssa.h"
+#include "sccp.h"
+#include "licm.h"
+#include "induction.h"
+#include "pre.h"
+#include "semantic_analyzer.h"
+#include "optimizer.h"
+#include "code_generator.h"
+
+// A warm context starts over with a fresh intern table once the names of
+// earlier compilations take up more than this
+#define COMPILER_WARM_INTERN_LIMIT (64 << 20)
+
+// Output collected in memory when CompilerContext.memory_outputs is set
+typedef struct {
+    char* data;
+    size_t length;
+} OutputBuffer;
+
+// Bookkeeping for --stream, see compileTopLevel() in parser.y
+typedef struct {
+    int segment_start;    // First TAC instruction of the pending segment, -1 when none
+    int item_count;
+    int segment_count;
+    int found_main;
+    clock_t sema_time;
+    clock_t opt_time;
+    clock_t codegen_time;
+} StreamState;
+
+// Everything one compilation owns. No phase keeps per-compilation data in
+// globals, so any number of contexts can exist, and compile, at the same
+// time. Only the trace settings are shared, and they are read-only once
+// the options have been parsed.
+struct CompilerContext {
+    // Input and scanner
+    SourceBuffer source;
+    void* scanner;          // flex yyscan_t, created by lexer_init()
+    size_t token_offset;    // Offset of the current token in source
+
+    // Parser and AST
+    InternTable atoms;
+    Arena ast_arena;
+    int ast_node_count;
+    size_t ast_bytes_start; // ast_arena.bytes_total when ast_node_count last restarted
+    int ast_temp_count;
+    ASTNode* root;
+    Atom current_scope;
+
+    // Later phases
+    SymbolTable symbols;
+    ResolveState resolve;
+    SemanticState sema;
+    TACBuffer tac;
+    CFG cfg;                // Of the segment being optimized, see cfg_build()
+    SSAForm ssa;            // Of the same, see ssa_build()
+    ConstantPropagation sccp; // Of the same, see sccp_run()
+    Liveness live;          // Of the same, see liveness_build()
+    LoopInvariantMotion licm; // Of the same, see licm_run()
+    InductionVariables induction; // Of the same, see induction_run()
+    PartialRedundancy pre;  // Of the same, see pre_run()
+    OptimizerState opt;
+    CodeGenState codegen;
+
+    // Outputs. The TAC listings before and after optimization and the
+    // optimized control-flow graph are only written when dump_tac,
+    // dump_optimized and dump_cfg ask for them; the phases
+    // themselves pass the TAC along in ctx->tac. With memory_outputs set
+    // nothing touches the disk: every output is a memory stream collected in
+    // the matching OutputBuffer and the paths are ignored.
+    int dump_tac;
+    int dump_optimized;
+    int dump_cfg;
+    const char* tac_path;
+    const char* optimized_path;
+    const char* cfg_path;
+    const char* asm_path;
+    FILE* tac_file;
+    FILE* optimized_file;
+    FILE* cfg_file;
+    FILE* asm_file;
+    int memory_outputs;
+    OutputBuffer tac_output;
+    OutputBuffer optimized_output;
+    OutputBuffer cfg_output;
+    OutputBuffer asm_output;
+    FILE* diagnostics;      // Errors and warnings, stderr by default
+
+    int stream_mode;
+    ArenaMark top_level_mark;   // AST arena position after the program's list
+    StreamState stream;
+
+    // Where compiler_fatal() returns to, NULL to exit the process instead
+    jmp_buf* fatal_jump;
+};
+
+void compiler_init(CompilerContext* ctx);
+void compiler_reset(CompilerContext* ctx);
+void compiler_free(CompilerContext* ctx);
+void compiler_fatal(CompilerContext* ctx);
+
+FILE* compiler_open_output(CompilerContext* ctx, const char* path, OutputBuffer* buffer);
+void compiler_open_outputs(CompilerContext* ctx);
+void compiler_close_outputs(CompilerContext* ctx);
+
+// Run the whole pipeline over ctx->source, defined in parser.y. Returns 0
+// on success.
+int compileSource(CompilerContext* ctx);
+
+// Scanner entry points, defined in lexer.l
+void lexer_init(CompilerContext* ctx);
+void lexer_free(CompilerContext* ctx);
+
+#endif // COMPILER_H
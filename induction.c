@@ -0,0 +1,766 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "induction.h"
+#include "arena.h"
+
+// Make room for keys below key_count; the new ones carry no mark
+static void grow_keys(InductionVariables* ind, int key_count) {
+    if (key_count <= ind->key_capacity) {
+        return;
+    }
+    int old_capacity = ind->key_capacity;
+    int capacity = old_capacity;
+    grow_array((void**) &ind->stamp, &capacity, key_count, sizeof(int));
+    capacity = old_capacity;
+    grow_array((void**) &ind->assignments, &capacity, key_count, sizeof(int));
+    capacity = old_capacity;
+    grow_array((void**) &ind->assigned_by, &capacity, key_count, sizeof(int));
+    capacity = old_capacity;
+    grow_array((void**) &ind->exposed, &capacity, key_count, sizeof(char));
+    capacity = old_capacity;
+    grow_array((void**) &ind->member_of, &capacity, key_count, sizeof(int));
+    capacity = old_capacity;
+    grow_array((void**) &ind->member_steps, &capacity, key_count, sizeof(int));
+    capacity = old_capacity;
+    grow_array((void**) &ind->offset_by, &capacity, key_count, sizeof(int));
+    memset(ind->stamp + old_capacity, 0, (capacity - old_capacity) * sizeof(int));
+    ind->key_capacity = capacity;
+}
+
+// A new temporary, with room for its key
+static TACOperand new_temp(InductionVariables* ind, int* temp_count) {
+    TACOperand temp = tac_operand(OPERAND_TEMP, (*temp_count)++);
+    grow_keys(ind, 2 * *temp_count + 2);
+    return temp;
+}
+
+static int compare_ints(const void* a, const void* b) {
+    return *(const int*) a - *(const int*) b;
+}
+
+static TACInstruction instruction(TACOpcode opcode, TACOperand result, TACOperand arg1, TACOperand arg2) {
+    TACInstruction instr;
+    instr.opcode = opcode;
+    instr.is_dead = 0;
+    instr.is_optimized = 1;
+    // The reduced temporaries run one step past the multiplications they
+    // stand for, so all their arithmetic wraps
+    instr.wraps = opcode == TAC_ADD || opcode == TAC_SUB;
+    instr.result = result;
+    instr.arg1 = arg1;
+    instr.arg2 = arg2;
+    return instr;
+}
+
+// The per-key facts of the loop being done, cleared the first time a key
+// is seen
+static void touch(InductionVariables* ind, int key) {
+    if (ind->stamp[key] != ind->mark) {
+        ind->stamp[key] = ind->mark;
+        ind->assignments[key] = 0;
+        ind->assigned_by[key] = -1;
+        ind->exposed[key] = 0;
+        ind->member_of[key] = -1;
+    }
+}
+
+static void touch_operand(InductionVariables* ind, TACOperand operand) {
+    int key = tac_operand_key(operand);
+    if (key >= 0) {
+        touch(ind, key);
+    }
+}
+
+// True when instruction a runs before instruction b on every path to b
+static int runs_before(InductionVariables* ind, CFG* cfg, int start, int a, int b) {
+    int block_a = ind->instruction_block[a - start];
+    int block_b = ind->instruction_block[b - start];
+    return block_a == block_b ? a < b : cfg_dominates(cfg, block_a, block_b);
+}
+
+// Mark operand exposed when its assignment in the loop may not have run
+// by the time instruction reads it
+static void check_read(InductionVariables* ind, CFG* cfg, int start, TACOperand operand, int instruction) {
+    int key = tac_operand_key(operand);
+    if (key >= 0 && ind->assignments[key] > 0 &&
+        (ind->assignments[key] > 1 || !runs_before(ind, cfg, start, ind->assigned_by[key], instruction))) {
+        ind->exposed[key] = 1;
+    }
+}
+
+// An integer with the same value everywhere in the loop
+static int is_invariant(InductionVariables* ind, TACOperand operand, int has_call) {
+    int key = tac_operand_key(operand);
+    if (key < 0) {
+        return operand.kind == OPERAND_INT;
+    }
+    if (has_call && !tac_is_temp(operand)) {
+        return 0;
+    }
+    return ind->stamp[key] != ind->mark || ind->assignments[key] == 0;
+}
+
+// Induction variable whose family operand is in, -1 for none
+static int family(InductionVariables* ind, TACOperand operand) {
+    int key = tac_operand_key(operand);
+    return key >= 0 && ind->stamp[key] == ind->mark ? ind->member_of[key] : -1;
+}
+
+// Steps the value of member is ahead of the variable where instruction
+// reads it: members are ahead of the start of the iteration by
+// member_steps, the variable itself by one from its update on
+static int steps_ahead(InductionVariables* ind, CFG* cfg, int start, TACOperand member, int instruction) {
+    int key = tac_operand_key(member);
+    InductionVariable* iv = &ind->ivs[ind->member_of[key]];
+    int updated = runs_before(ind, cfg, start, iv->update, instruction);
+    return (ind->member_steps[key] < 0 ? updated : ind->member_steps[key]) - updated;
+}
+
+static TACOpcode inverse(TACOpcode opcode) {
+    return opcode == TAC_ADD ? TAC_SUB : TAC_ADD;
+}
+
+// Queue instr to go after instruction position
+static void insert_after(InductionVariables* ind, int start, int position, TACInstruction instr) {
+    int capacity = ind->insert_capacity;
+    grow_array((void**) &ind->inserts, &capacity, ind->insert_count + 1, sizeof(TACInstruction));
+    capacity = ind->insert_capacity;
+    grow_array((void**) &ind->insert_next, &capacity, ind->insert_count + 1, sizeof(int));
+    ind->insert_capacity = capacity;
+    ind->inserts[ind->insert_count] = instr;
+    ind->insert_next[ind->insert_count] = -1;
+    if (ind->insert_head[position - start] < 0) {
+        ind->insert_head[position - start] = ind->insert_count;
+    } else {
+        ind->insert_next[ind->insert_tail[position - start]] = ind->insert_count;
+    }
+    ind->insert_tail[position - start] = ind->insert_count++;
+}
+
+// Queue instr for the end of the preheader, ahead of a jump there
+static void insert_in_preheader(InductionVariables* ind, CFG* cfg, TACBuffer* tac, int preheader,
+                                TACInstruction instr) {
+    BasicBlock* block = &cfg->blocks[preheader];
+    int last = block->end - 1;
+    insert_after(ind, cfg->blocks[0].first, tac->items[last].opcode == TAC_JUMP ? last - 1 : last, instr);
+}
+
+// An operand holding a op b for TAC_ADD, TAC_SUB or TAC_MUL, computed in the
+// preheader unless it folds. Literals fold the way the machine wraps.
+static TACOperand preheader_value(InductionVariables* ind, CFG* cfg, TACBuffer* tac, int preheader,
+                                  TACOpcode opcode, TACOperand a, TACOperand b, int* temp_count) {
+    if (a.kind == OPERAND_INT && b.kind == OPERAND_INT) {
+        unsigned int x = (unsigned int) a.int_value;
+        unsigned int y = (unsigned int) b.int_value;
+        return tac_int((int) (opcode == TAC_ADD ? x + y : opcode == TAC_SUB ? x - y : x * y));
+    }
+    if (opcode == TAC_MUL && a.kind == OPERAND_INT && a.int_value == 1) {
+        return b;
+    }
+    if (b.kind == OPERAND_INT && b.int_value == (opcode == TAC_MUL ? 1 : 0)) {
+        return a;
+    }
+    TACOperand temp = new_temp(ind, temp_count);
+    insert_in_preheader(ind, cfg, tac, preheader, instruction(opcode, temp, a, b));
+    return temp;
+}
+
+static int same_operand(TACOperand a, TACOperand b) {
+    return a.kind == b.kind && a.number == b.number;
+}
+
+// The reduced temporary of (variable offset_opcode offset) * factor, for
+// no offset when that is OPERAND_NONE, made the first time it is asked for
+// when make is set, NULL when it is not
+static ReducedVariable* reduced_variable(InductionVariables* ind, CFG* cfg, TACBuffer* tac, int preheader,
+                                         int iv, TACOperand factor, TACOperand offset, TACOpcode offset_opcode,
+                                         int make, int* temp_count) {
+    TACOperand increment = tac_none();
+    for (int r = 0; r < ind->reduced_count; r++) {
+        ReducedVariable* reduced = &ind->reduced[r];
+        if (reduced->iv == iv && same_operand(reduced->factor, factor)) {
+            if (same_operand(reduced->offset, offset) && reduced->offset_opcode == offset_opcode) {
+                return reduced;
+            }
+            increment = reduced->increment;
+        }
+    }
+    if (!make) {
+        return NULL;
+    }
+    InductionVariable* var = &ind->ivs[iv];
+    if (increment.kind == OPERAND_NONE) {
+        increment = preheader_value(ind, cfg, tac, preheader, TAC_MUL, var->step, factor, temp_count);
+    }
+    TACOperand start = var->variable;
+    if (offset.kind != OPERAND_NONE) {
+        start = preheader_value(ind, cfg, tac, preheader, offset_opcode, start, offset, temp_count);
+    }
+    grow_array((void**) &ind->reduced, &ind->reduced_capacity, ind->reduced_count + 1, sizeof(ReducedVariable));
+    ReducedVariable* reduced = &ind->reduced[ind->reduced_count++];
+    reduced->iv = iv;
+    reduced->factor = factor;
+    reduced->offset = offset;
+    reduced->offset_opcode = offset_opcode;
+    reduced->temp = new_temp(ind, temp_count);
+    reduced->increment = increment;
+    insert_in_preheader(ind, cfg, tac, preheader, instruction(TAC_MUL, reduced->temp, start, factor));
+    insert_after(ind, cfg->blocks[0].first, var->update,
+                 instruction(var->opcode, reduced->temp, reduced->temp, reduced->increment));
+    ind->temporaries++;
+    return reduced;
+}
+
+// True when block runs on every iteration of the loop with this header:
+// it dominates each block that goes back to the header
+static int dominates_latches(InductionVariables* ind, CFG* cfg, int header, int block) {
+    BasicBlock* head = &cfg->blocks[header];
+    for (int p = 0; p < head->predecessor_count; p++) {
+        int pred = cfg->predecessors[head->predecessor_start + p];
+        if (ind->in_loop[pred] == ind->mark && !cfg_dominates(cfg, block, pred)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// If instr is variable +/- step or step + variable for an invariant
+// step, fill in iv and return 1
+static int is_step(InductionVariables* ind, TACInstruction* instr, TACOperand variable, int has_call,
+                   InductionVariable* iv) {
+    if (instr->opcode == TAC_ADD && tac_same(instr->arg2, variable) && is_invariant(ind, instr->arg1, has_call)) {
+        iv->step = instr->arg1;
+    } else if ((instr->opcode == TAC_ADD || instr->opcode == TAC_SUB) && tac_same(instr->arg1, variable) &&
+               is_invariant(ind, instr->arg2, has_call)) {
+        iv->step = instr->arg2;
+    } else {
+        return 0;
+    }
+    iv->variable = variable;
+    iv->opcode = instr->opcode;
+    return 1;
+}
+
+// Find the basic induction variable instruction i updates, if it is one.
+// The update must run once on every iteration, so its block is in no inner
+// loop and dominates each block that goes back to the header.
+static void find_iv(InductionVariables* ind, CFG* cfg, TACBuffer* tac, int header, int i, int has_call) {
+    TACInstruction* instr = &tac->items[i];
+    int key = tac_operand_key(instr->result);
+    if (key < 0 || instr->result.kind == OPERAND_ELEMENT || ind->assignments[key] != 1 ||
+        (has_call && !tac_is_temp(instr->result))) {
+        return;
+    }
+    int start = cfg->blocks[0].first;
+    InductionVariable iv;
+    iv.update = i;
+    iv.step_def = -1;
+    if (!is_step(ind, instr, instr->result, has_call, &iv)) {
+        // t = variable +/- step just before, in the same block
+        int t = tac_operand_key(instr->arg1);
+        if (instr->opcode != TAC_COPY || !tac_is_temp(instr->arg1) || ind->assignments[t] != 1 ||
+            ind->exposed[t] || ind->assigned_by[t] > i ||
+            ind->instruction_block[ind->assigned_by[t] - start] != ind->instruction_block[i - start] ||
+            !is_step(ind, &tac->items[ind->assigned_by[t]], instr->result, has_call, &iv)) {
+            return;
+        }
+        iv.step_def = ind->assigned_by[t];
+    }
+
+    int block = ind->instruction_block[i - start];
+    if (cfg->blocks[block].loop != cfg->blocks[header].loop || !dominates_latches(ind, cfg, header, block)) {
+        return;
+    }
+
+    grow_array((void**) &ind->ivs, &ind->iv_capacity, ind->iv_count + 1, sizeof(InductionVariable));
+    ind->ivs[ind->iv_count] = iv;
+    ind->member_of[key] = ind->iv_count;
+    ind->member_steps[key] = -1;
+    ind->offset_by[key] = -1;
+    if (iv.step_def >= 0) {
+        int t = tac_operand_key(instr->arg1);
+        ind->member_of[t] = ind->iv_count;
+        ind->member_steps[t] = 1;
+        ind->offset_by[t] = -1;
+    }
+    ind->iv_count++;
+    ind->basic++;
+}
+
+// Replace instruction i by an addition to a reduced temporary if it
+// multiplies a family member by a factor the loop does not change, making
+// the temporary when make is set. Returns 1 when it did.
+static int reduce_multiplication(InductionVariables* ind, CFG* cfg, TACBuffer* tac, int preheader, int i,
+                                 int make, int has_call, int* temp_count) {
+    TACInstruction* instr = &tac->items[i];
+    if (instr->opcode != TAC_MUL) {
+        return 0;
+    }
+    int first = family(ind, instr->arg1) >= 0;
+    TACOperand member = first ? instr->arg1 : instr->arg2;
+    TACOperand factor = first ? instr->arg2 : instr->arg1;
+    int iv = family(ind, member);
+    if (iv < 0 || family(ind, factor) >= 0 || !is_invariant(ind, factor, has_call)) {
+        return 0;
+    }
+    // member * factor is the temporary for its offset plus the increment
+    // for each step member is ahead of the variable
+    TACOperand offset = tac_none();
+    TACOpcode offset_opcode = TAC_ADD;
+    int offset_by = ind->offset_by[tac_operand_key(member)];
+    if (offset_by >= 0) {
+        TACInstruction* sum = &tac->items[offset_by];
+        offset = family(ind, sum->arg1) >= 0 ? sum->arg2 : sum->arg1;
+        offset_opcode = sum->opcode;
+    }
+    ReducedVariable* reduced = reduced_variable(ind, cfg, tac, preheader, iv, factor, offset, offset_opcode, make,
+                                                temp_count);
+    if (reduced == NULL) {
+        return 0;
+    }
+    int steps = steps_ahead(ind, cfg, cfg->blocks[0].first, member, i);
+    TACOpcode opcode = ind->ivs[iv].opcode;
+    if (steps == 0) {
+        *instr = instruction(TAC_COPY, instr->result, reduced->temp, tac_none());
+    } else {
+        *instr = instruction(steps > 0 ? opcode : inverse(opcode), instr->result, reduced->temp, reduced->increment);
+    }
+    return 1;
+}
+
+// The literal variable holds on the way into block: what the last
+// assignment to it on the one path there copies, if that is a literal.
+// Returns 0 when it may be anything else.
+static int entry_value(CFG* cfg, TACBuffer* tac, int block, TACOperand variable, long long* value) {
+    for (int n = 0; n < cfg->block_count; n++) {
+        BasicBlock* b = &cfg->blocks[block];
+        for (int i = b->end - 1; i >= b->first; i--) {
+            TACInstruction* instr = &tac->items[i];
+            if (instr->opcode == TAC_PARAM) {
+                return 0;   // A call may assign it
+            }
+            if (tac_is_assignment(instr) && tac_same(instr->result, variable)) {
+                *value = instr->arg1.int_value;
+                return instr->opcode == TAC_COPY && instr->arg1.kind == OPERAND_INT;
+            }
+        }
+        int from = -1;
+        for (int p = 0; p < b->predecessor_count; p++) {
+            int pred = cfg->predecessors[b->predecessor_start + p];
+            if (cfg->blocks[pred].rpo >= 0) {
+                if (from >= 0) {
+                    return 0;
+                }
+                from = pred;
+            }
+        }
+        if (from < 0) {
+            return 0;
+        }
+        block = from;
+    }
+    return 0;
+}
+
+static int in_int_range(long long value) {
+    return value >= -2147483647LL - 1 && value <= 2147483647LL;
+}
+
+// Replace the exit test of loop l on basic induction variable iv by one on
+// a reduced temporary of it, and remove the update of the variable, when
+// the loop reads the variable nowhere else. The variable must start out as
+// a literal and be tested against one, so the number of iterations and
+// the value the variable leaves with are known: the exit assigns that
+// instead. Every value the variable and the temporary take must be in
+// range, or the two tests could differ. Returns 1 when it replaced it.
+static int replace_exit_test(InductionVariables* ind, CFG* cfg, TACBuffer* tac, int l, int preheader, int iv) {
+    InductionVariable* var = &ind->ivs[iv];
+    Loop* loop = &cfg->loops[l];
+    int* blocks = &cfg->loop_blocks[loop->block_start];
+    int start = cfg->blocks[0].first;
+    if (var->step.kind != OPERAND_INT || var->step.int_value == 0) {
+        return 0;
+    }
+    long long delta = var->opcode == TAC_ADD ? var->step.int_value : -(long long) var->step.int_value;
+    ReducedVariable* reduced = NULL;
+    for (int r = 0; r < ind->reduced_count && reduced == NULL; r++) {
+        if (ind->reduced[r].iv == iv && ind->reduced[r].offset.kind == OPERAND_NONE &&
+            ind->reduced[r].factor.kind == OPERAND_INT && ind->reduced[r].factor.int_value != 0) {
+            reduced = &ind->reduced[r];
+        }
+    }
+    if (reduced == NULL) {
+        return 0;
+    }
+
+    // The loop leaves only from the ifFalse that ends one block, which
+    // runs on every iteration, to a block nothing else goes to
+    int exiting = -1;
+    int exit = -1;
+    for (int k = 0; k < loop->block_count; k++) {
+        BasicBlock* block = &cfg->blocks[blocks[k]];
+        for (int s = 0; s < 2; s++) {
+            if (block->successors[s] >= 0 && ind->in_loop[block->successors[s]] != ind->mark) {
+                if (exiting >= 0 || s != 1) {
+                    return 0;
+                }
+                exiting = blocks[k];
+                exit = block->successors[s];
+            }
+        }
+    }
+    if (exiting < 0 || cfg->blocks[exiting].loop != l || !dominates_latches(ind, cfg, loop->header, exiting)) {
+        return 0;
+    }
+    for (int p = 0, from = cfg->blocks[exit].predecessor_start; p < cfg->blocks[exit].predecessor_count; p++) {
+        int pred = cfg->predecessors[from + p];
+        if (pred != exiting && cfg->blocks[pred].rpo >= 0) {
+            return 0;
+        }
+    }
+
+    // The test is member < literal or member > literal in that block, after
+    // the update, on the variable or t after its step
+    int branch = cfg->blocks[exiting].end - 1;
+    int key = tac_operand_key(tac->items[branch].arg1);
+    if (key < 0 || !tac_is_temp(tac->items[branch].arg1) || ind->assignments[key] != 1) {
+        return 0;
+    }
+    int test = ind->assigned_by[key];
+    TACInstruction* instr = &tac->items[test];
+    TACOperand stepped = var->step_def >= 0 ? tac->items[var->step_def].result : var->variable;
+    int first = tac_same(instr->arg1, var->variable) || tac_same(instr->arg1, stepped);
+    TACOperand member = first ? instr->arg1 : instr->arg2;
+    TACOperand bound = first ? instr->arg2 : instr->arg1;
+    if (ind->instruction_block[test - start] != exiting || (instr->opcode != TAC_LT && instr->opcode != TAC_GT) ||
+        !(tac_same(member, var->variable) || tac_same(member, stepped)) || bound.kind != OPERAND_INT ||
+        !runs_before(ind, cfg, start, var->update, test)) {
+        return 0;
+    }
+    int below = (instr->opcode == TAC_LT) == first;  // member < bound
+    if ((delta > 0) != below) {
+        return 0;
+    }
+    for (int k = 0; k < loop->block_count; k++) {
+        BasicBlock* block = &cfg->blocks[blocks[k]];
+        for (int i = block->first; i < block->end; i++) {
+            TACInstruction* reader = &tac->items[i];
+            if (i != test && i != var->update && i != var->step_def &&
+                (tac_same(reader->arg1, var->variable) || tac_same(reader->arg2, var->variable) ||
+                 tac_same(reader->arg1, stepped) || tac_same(reader->arg2, stepped))) {
+                return 0;
+            }
+        }
+    }
+
+    // The body runs once before the first test, so the loop leaves after
+    // the first step that fails it, and at least one
+    long long first_value;
+    if (!entry_value(cfg, tac, preheader, var->variable, &first_value)) {
+        return 0;
+    }
+    long long distance = below ? bound.int_value - first_value : first_value - bound.int_value;
+    long long magnitude = delta > 0 ? delta : -delta;
+    long long iterations = distance <= 0 ? 1 : (distance + magnitude - 1) / magnitude;
+    long long last = first_value + iterations * delta;
+    long long factor = reduced->factor.int_value;
+    if (!in_int_range(last) || !in_int_range(first_value * factor) || !in_int_range(last * factor) ||
+        !in_int_range(bound.int_value * factor)) {
+        return 0;
+    }
+
+    // A negative factor turns the comparison around
+    TACOpcode opcode = below == (factor > 0) ? TAC_LT : TAC_GT;
+    *instr = instruction(opcode, instr->result, reduced->temp, tac_int((int) (bound.int_value * factor)));
+    tac->items[var->update].is_dead = 1;
+    int label = cfg->blocks[exit].first;
+    if (var->step_def >= 0) {
+        tac->items[var->step_def].is_dead = 1;
+        insert_after(ind, start, label, instruction(TAC_COPY, stepped, tac_int((int) last), tac_none()));
+    }
+    insert_after(ind, start, label, instruction(TAC_COPY, var->variable, tac_int((int) last), tac_none()));
+    ind->removed++;
+    ind->tests++;
+    return 1;
+}
+
+// Reduce the multiplications by induction variables in natural loop l,
+// whose preheader is block preheader. Returns how many it replaced.
+static int reduce_loop(InductionVariables* ind, CFG* cfg, TACBuffer* tac, int l, int preheader, int* temp_count) {
+    Loop* loop = &cfg->loops[l];
+    int start = cfg->blocks[0].first;
+    int* blocks = &cfg->loop_blocks[loop->block_start];
+    ind->mark++;
+    ind->iv_count = 0;
+    ind->reduced_count = 0;
+
+    int has_call = 0;
+    for (int k = 0; k < loop->block_count; k++) {
+        ind->in_loop[blocks[k]] = ind->mark;
+    }
+    for (int k = 0; k < loop->block_count; k++) {
+        BasicBlock* block = &cfg->blocks[blocks[k]];
+        for (int i = block->first; i < block->end; i++) {
+            TACInstruction* instr = &tac->items[i];
+            touch_operand(ind, instr->arg1);
+            touch_operand(ind, instr->arg2);
+            has_call |= instr->opcode == TAC_PARAM;
+            int key = tac_operand_key(instr->result);
+            if (key >= 0) {
+                touch(ind, key);
+                ind->assignments[key]++;
+                ind->assigned_by[key] = i;
+            }
+        }
+    }
+    for (int k = 0; k < loop->block_count; k++) {
+        BasicBlock* block = &cfg->blocks[blocks[k]];
+        for (int i = block->first; i < block->end; i++) {
+            check_read(ind, cfg, start, tac->items[i].arg1, i);
+            check_read(ind, cfg, start, tac->items[i].arg2, i);
+        }
+    }
+    for (int k = 0; k < loop->block_count; k++) {
+        BasicBlock* block = &cfg->blocks[blocks[k]];
+        for (int i = block->first; i < block->end; i++) {
+            find_iv(ind, cfg, tac, loop->header, i, has_call);
+        }
+    }
+    if (ind->iv_count == 0) {
+        return 0;
+    }
+
+    // Copies join the family of what they copy, and so do sums of a member
+    // and something the loop does not change, with that as the offset.
+    // Going through the loop in dominator order finds them after the
+    // member.
+    grow_array((void**) &ind->order, &ind->order_capacity, loop->block_count, sizeof(int));
+    for (int k = 0; k < loop->block_count; k++) {
+        ind->order[k] = ind->dom_position[blocks[k]];
+    }
+    qsort(ind->order, loop->block_count, sizeof(int), compare_ints);
+    for (int k = 0; k < loop->block_count; k++) {
+        BasicBlock* block = &cfg->blocks[cfg->dom_order[ind->order[k]]];
+        for (int i = block->first; i < block->end; i++) {
+            TACInstruction* instr = &tac->items[i];
+            int key = tac_operand_key(instr->result);
+            if (key < 0 || instr->result.kind == OPERAND_ELEMENT || family(ind, instr->result) >= 0 ||
+                ind->assignments[key] != 1 || ind->exposed[key] || (has_call && !tac_is_temp(instr->result))) {
+                continue;
+            }
+            TACOperand member = instr->arg1;
+            int offset_by = -1;
+            if (instr->opcode == TAC_COPY) {
+                if (family(ind, member) < 0) {
+                    continue;
+                }
+                offset_by = ind->offset_by[tac_operand_key(member)];
+            } else if (instr->opcode == TAC_ADD || instr->opcode == TAC_SUB) {
+                TACOperand offset = instr->arg2;
+                if (instr->opcode == TAC_ADD && family(ind, member) < 0) {
+                    member = instr->arg2;
+                    offset = instr->arg1;
+                }
+                if (family(ind, member) < 0 || ind->offset_by[tac_operand_key(member)] >= 0 ||
+                    family(ind, offset) >= 0 || !is_invariant(ind, offset, has_call)) {
+                    continue;
+                }
+                offset_by = i;
+            } else {
+                continue;
+            }
+            ind->member_of[key] = ind->member_of[tac_operand_key(member)];
+            ind->member_steps[key] = steps_ahead(ind, cfg, start, member, i) +
+                                     runs_before(ind, cfg, start, ind->ivs[ind->member_of[key]].update, i);
+            ind->offset_by[key] = offset_by;
+        }
+    }
+
+    // Replace member * factor, first where that makes temporaries and then
+    // where it only shares them
+    int replaced = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int k = 0; k < loop->block_count; k++) {
+            BasicBlock* block = &cfg->blocks[blocks[k]];
+            int b = blocks[k];
+            for (int inner = block->loop; inner != l; inner = cfg->loops[inner].parent) {
+                b = cfg->loops[inner].header;
+            }
+            int every_iteration = dominates_latches(ind, cfg, loop->header, b);
+            if (pass == 0 && !every_iteration) {
+                continue;
+            }
+            for (int i = block->first; i < block->end; i++) {
+                replaced += reduce_multiplication(ind, cfg, tac, preheader, i, pass == 0, has_call, temp_count);
+            }
+        }
+    }
+    ind->multiplies += replaced;
+    if (replaced > 0) {
+        for (int iv = 0; iv < ind->iv_count; iv++) {
+            replace_exit_test(ind, cfg, tac, l, preheader, iv);
+        }
+    }
+    return replaced;
+}
+
+// One pass over the recorded loops, inner ones first. A loop containing
+// one that changed waits for the next round, on a graph that matches the
+// instructions again. Returns nonzero when anything changed.
+static int reduce_round(InductionVariables* ind, CFG* cfg, TACBuffer* tac, TACLoop* loops, int loop_count,
+                        int* temp_count) {
+    int start = cfg->blocks[0].first;
+    int count = tac->count - start;
+    int capacity = ind->instruction_capacity;
+    grow_array((void**) &ind->instruction_block, &capacity, count, sizeof(int));
+    capacity = ind->instruction_capacity;
+    grow_array((void**) &ind->insert_head, &capacity, count, sizeof(int));
+    capacity = ind->instruction_capacity;
+    grow_array((void**) &ind->insert_tail, &capacity, count, sizeof(int));
+    ind->instruction_capacity = capacity;
+    int block_capacity = ind->block_capacity;
+    grow_array((void**) &ind->in_loop, &block_capacity, cfg->block_count, sizeof(int));
+    block_capacity = ind->block_capacity;
+    grow_array((void**) &ind->changed, &block_capacity, cfg->block_count, sizeof(int));
+    block_capacity = ind->block_capacity;
+    grow_array((void**) &ind->dom_position, &block_capacity, cfg->block_count, sizeof(int));
+    ind->block_capacity = block_capacity;
+
+    for (int b = 0; b < cfg->block_count; b++) {
+        ind->in_loop[b] = 0;
+        ind->changed[b] = 0;
+        for (int i = cfg->blocks[b].first; i < cfg->blocks[b].end; i++) {
+            ind->instruction_block[i - start] = b;
+            ind->insert_head[i - start] = -1;
+        }
+    }
+    for (int d = 0; d < cfg->reachable_count; d++) {
+        ind->dom_position[cfg->dom_order[d]] = d;
+    }
+
+    int changed = 0;
+    ind->insert_count = 0;
+    for (int k = loop_count - 1; k >= 0; k--) {
+        int header = cfg_label_block(cfg, tac, loops[k].header);
+        int preheader = cfg_label_block(cfg, tac, loops[k].preheader);
+        if (header < 0 || preheader < 0 || cfg->blocks[header].rpo < 0) {
+            continue;   // Optimized away
+        }
+        int l = cfg->blocks[header].loop;
+        BasicBlock* block = &cfg->blocks[preheader];
+        if (l < 0 || cfg->loops[l].header != header ||
+            block->successors[0] != header || block->successors[1] >= 0) {
+            continue;
+        }
+        // Control must come into the loop through the preheader only
+        int entries = 0;
+        BasicBlock* head = &cfg->blocks[header];
+        for (int p = 0; p < head->predecessor_count; p++) {
+            int pred = cfg->predecessors[head->predecessor_start + p];
+            if (cfg->blocks[pred].rpo >= 0 && !cfg_dominates(cfg, header, pred)) {
+                entries++;
+            }
+        }
+        if (entries != 1 || cfg_dominates(cfg, header, preheader)) {
+            continue;
+        }
+        if (ind->rounds == 1) {
+            ind->loops++;
+        }
+        Loop* loop = &cfg->loops[l];
+        int* blocks = &cfg->loop_blocks[loop->block_start];
+        int waits = 0;
+        for (int b = 0; b < loop->block_count && !waits; b++) {
+            waits = ind->changed[blocks[b]];
+        }
+        if (waits) {
+            changed = 1;    // Next round
+        } else if (reduce_loop(ind, cfg, tac, l, preheader, temp_count) > 0) {
+            for (int b = 0; b < loop->block_count; b++) {
+                ind->changed[blocks[b]] = 1;
+            }
+            changed = 1;
+        }
+    }
+
+    if (!changed) {
+        return 0;
+    }
+
+    // Open up room at the end and move the instructions down into it from
+    // the back, adding the queued ones after their positions
+    int old_count = tac->count;
+    for (int n = 0; n < ind->insert_count; n++) {
+        tac_append(tac, TAC_COPY, tac_none(), tac_none(), tac_none());
+    }
+    int w = tac->count;
+    for (int i = old_count - 1; i >= start; i--) {
+        int head = ind->insert_head[i - start];
+        if (head >= 0) {
+            // The list runs forwards, so write it out from its end
+            int n = 0;
+            for (int x = head; x >= 0; x = ind->insert_next[x]) {
+                n++;
+            }
+            w -= n;
+            for (int x = head, at = w; x >= 0; x = ind->insert_next[x]) {
+                tac->items[at++] = ind->inserts[x];
+            }
+        }
+        tac->items[--w] = tac->items[i];
+    }
+    if (ind->removed > 0) {
+        tac_compact(tac, start);
+        ind->removed = 0;
+    }
+    return 1;
+}
+
+int induction_run(InductionVariables* ind, CFG* cfg, TACBuffer* tac, TACLoop* loops, int loop_count,
+                  int key_count, int* temp_count) {
+    ind->loops = 0;
+    ind->basic = 0;
+    ind->temporaries = 0;
+    ind->multiplies = 0;
+    ind->tests = 0;
+    ind->rounds = 0;
+    ind->removed = 0;
+    if (cfg->block_count == 0 || cfg->loop_count == 0 || loop_count == 0) {
+        return 0;
+    }
+    int start = cfg->blocks[0].first;
+    grow_keys(ind, key_count);
+    int changed = 0;
+    for (;;) {
+        ind->rounds++;
+        if (!reduce_round(ind, cfg, tac, loops, loop_count, temp_count)) {
+            break;
+        }
+        changed = 1;
+        cfg_build(cfg, tac, start, *temp_count);
+    }
+    return changed;
+}
+
+void induction_free(InductionVariables* ind) {
+    free(ind->stamp);
+    free(ind->assignments);
+    free(ind->assigned_by);
+    free(ind->exposed);
+    free(ind->member_of);
+    free(ind->member_steps);
+    free(ind->offset_by);
+    free(ind->in_loop);
+    free(ind->changed);
+    free(ind->dom_position);
+    free(ind->order);
+    free(ind->instruction_block);
+    free(ind->insert_head);
+    free(ind->insert_tail);
+    free(ind->ivs);
+    free(ind->reduced);
+    free(ind->inserts);
+    free(ind->insert_next);
+    memset(ind, 0, sizeof(InductionVariables));
+}
@@ -0,0 +1,123 @@
+#ifndef INDUCTION_H
+#define INDUCTION_H
+
+#include "cfg.h"
+
+// A basic induction variable of a loop: assigned once per iteration, by
+// variable = variable +/- step or by t = variable +/- step followed by
+// variable = t, where step does not change in the loop
+typedef struct {
+    TACOperand variable;
+    TACOperand step;
+    unsigned char opcode;   // TAC_ADD or TAC_SUB
+    int update;             // The instruction assigning variable
+    int step_def;           // The one assigning t, -1 for none
+} InductionVariable;
+
+// (variable + offset) * factor kept in temp, which the loop adds increment
+// to (or subtracts it from, after TAC_SUB) right after each update of the
+// variable
+typedef struct {
+    int iv;
+    TACOperand factor;
+    TACOperand offset;      // OPERAND_NONE for none
+    unsigned char offset_opcode; // TAC_ADD or TAC_SUB
+    TACOperand temp;
+    TACOperand increment;   // step * factor
+} ReducedVariable;
+
+// Strength reduction of the induction variables of the while loops
+// semantic analysis recorded. Reads of a basic induction variable, of t
+// and of copies of either are its family: each holds the variable's value
+// at the start of the iteration, plus one step from the update on for
+// the variable itself and t. So are sums of a member and an offset the
+// loop does not change, such as i * 30 + j in a loop over j. A
+// multiplication of a family member by a factor the loop does not change
+// becomes a copy of the reduced temporary for its offset and factor, or
+// the temporary plus or minus the increment where the member is a step
+// ahead of it. The temporary starts out as (variable + offset) * factor at
+// the end of the preheader. Members with the same offset multiplied by the
+// same factor share one temporary. It costs an addition on every
+// iteration, so only a multiplication that runs on every iteration (or in
+// an inner loop that does) makes one.
+//
+// Integer multiplication wraps and the rewrites are exact under wrapping.
+// The temporary steps once more than the multiplications it replaces ran,
+// though, so it can leave the range where they stayed in it. The additions
+// and subtractions made here are therefore marked wraps, and the code
+// generator lowers them to addu and subu, which do not trap.
+//
+// Every variable that steps from one iteration to the next is a named one,
+// which later code may read, so a basic variable can only go when the
+// value it leaves the loop with is known. That is so when it starts out
+// as a literal, steps by a literal and the loop's one exit tests it
+// against a literal, after the update. If the loop reads it nowhere else
+// once its multiplications are reduced, the test moves to a reduced
+// temporary with a literal factor, the update goes and the exit assigns
+// the final value. The literals must keep every value the two take in
+// range, so that the tests agree.
+//
+// Like loop-invariant code motion, a loop with a call may change any named
+// variable, so named variables neither step nor scale there. Inner loops
+// are done first; the temporaries they start in their preheaders are
+// multiplications of the loop around them, reduced in turn once the graph
+// is rebuilt.
+typedef struct {
+    // Indexed by tac_operand_key(); valid only where stamp holds the mark
+    // of the loop being done
+    int* stamp;
+    int* assignments;       // In the loop
+    int* assigned_by;       // The instruction, when there is only one
+    char* exposed;          // Read in the loop where assigned_by may not have run
+    int* member_of;         // Induction variable whose family it is in, -1 for none
+    int* member_steps;      // Steps ahead of the start of the iteration, -1 for the variable itself
+    int* offset_by;         // The sum adding an offset to the member, -1 for none
+    int key_capacity;
+
+    // Indexed by block
+    int* in_loop;           // Mark of the loop being done
+    int* changed;           // A loop containing it changed this round
+    int* dom_position;      // In CFG.dom_order
+    int block_capacity;
+    int* order;             // Positions of the loop's blocks in dom_order, sorted
+    int order_capacity;
+
+    // Indexed by instruction from the graph's first on
+    int* instruction_block;
+    int* insert_head;       // Instructions to add after it, -1 for none
+    int* insert_tail;
+    int instruction_capacity;
+
+    InductionVariable* ivs; // Of the loop being done
+    int iv_count;
+    int iv_capacity;
+    ReducedVariable* reduced;
+    int reduced_count;
+    int reduced_capacity;
+    TACInstruction* inserts;
+    int* insert_next;
+    int insert_count;
+    int insert_capacity;
+    int removed;            // Updates marked is_dead this round
+    int mark;
+
+    // What induction_run() did
+    int loops;              // Recorded loops found in the graph
+    int basic;              // Basic induction variables, counting each round
+    int temporaries;        // Reduced temporaries made
+    int multiplies;         // Multiplications replaced
+    int tests;              // Exit tests replaced, and the updates they read removed
+    int rounds;
+} InductionVariables;
+
+// Reduce the multiplications by induction variables in loops of the
+// instructions cfg was built from. key_count bounds tac_operand_key() of
+// their operands; new temporaries are numbered from *temp_count on, which
+// also bounds the label numbers. The graph is rebuilt after each round that
+// changes anything, so it matches the instructions on return. Returns
+// nonzero when they changed.
+int induction_run(InductionVariables* ind, CFG* cfg, TACBuffer* tac, TACLoop* loops, int loop_count,
+                  int key_count, int* temp_count);
+void induction_free(InductionVariables* ind);
+
+#endif // INDUCTION_H
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "trace.h"
+
+#define INTERN_CHUNK_SIZE 65536
+#define INTERN_INITIAL_SLOTS 1024
+
+// Interned characters live in fixed chunks that never move, so the pointer
+// returned by atom_name() stays valid until intern_free().
+struct InternChunk {
+    struct InternChunk* next;
+    size_t used;
+    size_t size;
+    char data[];
+};
+
+struct InternEntry {
+    const char* str;
+    int length;
+    unsigned int hash;
+};
+
+static const char* builtin_names[ATOM_BUILTIN_COUNT] = {
+    "", "int", "char", "void", "float", "boolean", "true", "false",
+    "function", "main", "add", "global"
+};
+
+static unsigned int hash_string(const char* str, int length) {
+    unsigned int hash = 2166136261u;  // FNV-1a
+    for (int i = 0; i < length; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static char* store_string(InternTable* table, const char* str, int length) {
+    size_t needed = (size_t)length + 1;
+    InternChunk* chunks = table->chunks;
+    if (chunks == NULL || chunks->size - chunks->used < needed) {
+        size_t size = needed > INTERN_CHUNK_SIZE ? needed : INTERN_CHUNK_SIZE;
+        InternChunk* chunk = malloc(sizeof(InternChunk) + size);
+        if (chunk == NULL) {
+            fprintf(stderr, "Memory allocation failed for intern pool\n");
+            exit(1);
+        }
+        chunk->next = chunks;
+        chunk->used = 0;
+        chunk->size = size;
+        chunks = table->chunks = chunk;
+        table->chunk_bytes += sizeof(InternChunk) + size;
+    }
+    char* copy = chunks->data + chunks->used;
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    chunks->used += needed;
+    return copy;
+}
+
+static void grow_slots(InternTable* table) {
+    int new_capacity = table->slot_capacity ? table->slot_capacity * 2 : INTERN_INITIAL_SLOTS;
+    Atom* new_slots = calloc(new_capacity, sizeof(Atom));
+    if (new_slots == NULL) {
+        fprintf(stderr, "Memory allocation failed for intern table\n");
+        exit(1);
+    }
+    for (Atom atom = 1; atom < table->entry_count; atom++) {
+        unsigned int i = table->entries[atom].hash & (new_capacity - 1);
+        while (new_slots[i] != ATOM_NONE) {
+            i = (i + 1) & (new_capacity - 1);
+        }
+        new_slots[i] = atom;
+    }
+    free(table->slots);
+    table->slots = new_slots;
+    table->slot_capacity = new_capacity;
+}
+
+static Atom add_entry(InternTable* table, const char* str, int length, unsigned int hash) {
+    if (table->entry_count == table->entry_capacity) {
+        table->entry_capacity = table->entry_capacity ? table->entry_capacity * 2 : INTERN_INITIAL_SLOTS;
+        table->entries = realloc(table->entries, table->entry_capacity * sizeof(InternEntry));
+        if (table->entries == NULL) {
+            fprintf(stderr, "Memory allocation failed for intern entries\n");
+            exit(1);
+        }
+    }
+    Atom atom = table->entry_count++;
+    InternEntry* entry = &table->entries[atom];
+    entry->str = store_string(table, str, length);
+    entry->length = length;
+    entry->hash = hash;
+    return atom;
+}
+
+// Set up an empty pool holding only the builtin atoms
+void intern_init(InternTable* table) {
+    memset(table, 0, sizeof(InternTable));
+    add_entry(table, "", 0, hash_string("", 0));  // ATOM_NONE
+    grow_slots(table);
+    for (int i = 1; i < ATOM_BUILTIN_COUNT; i++) {
+        intern(table, builtin_names[i]);
+    }
+}
+
+Atom intern_n(InternTable* table, const char* str, int length) {
+    if (length == 0) {
+        return ATOM_NONE;
+    }
+
+    unsigned int hash = hash_string(str, length);
+    unsigned int mask = table->slot_capacity - 1;
+    unsigned int i = hash & mask;
+    while (table->slots[i] != ATOM_NONE) {
+        InternEntry* entry = &table->entries[table->slots[i]];
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(entry->str, str, length) == 0) {
+            return table->slots[i];
+        }
+        i = (i + 1) & mask;
+    }
+
+    Atom atom = add_entry(table, str, length, hash);
+    table->slots[i] = atom;
+    if (table->entry_count * 2 > table->slot_capacity) {
+        grow_slots(table);
+    }
+    TRACE(TRACE_LEX, TRACE_LEVEL_VERBOSE, "Interned '%s' as atom %d\n", table->entries[atom].str, atom);
+    return atom;
+}
+
+Atom intern(InternTable* table, const char* str) {
+    return intern_n(table, str, (int)strlen(str));
+}
+
+const char* atom_name(InternTable* table, Atom atom) {
+    if (atom <= ATOM_NONE || atom >= table->entry_count) {
+        return NULL;
+    }
+    return table->entries[atom].str;
+}
+
+int atom_length(InternTable* table, Atom atom) {
+    if (atom <= ATOM_NONE || atom >= table->entry_count) {
+        return 0;
+    }
+    return table->entries[atom].length;
+}
+
+int atom_count(InternTable* table) {
+    return table->entry_count;
+}
+
+// Bytes held by the pool: string chunks plus the entry and slot arrays
+size_t intern_memory_used(InternTable* table) {
+    return table->chunk_bytes + (size_t)table->entry_capacity * sizeof(InternEntry) +
+           (size_t)table->slot_capacity * sizeof(Atom);
+}
+
+void intern_free(InternTable* table) {
+    while (table->chunks != NULL) {
+        InternChunk* next = table->chunks->next;
+        free(table->chunks);
+        table->chunks = next;
+    }
+    free(table->entries);
+    free(table->slots);
+    memset(table, 0, sizeof(InternTable));
+}
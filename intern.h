@@ -0,0 +1,52 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+// An Atom is a small integer standing for an interned string. Two names are
+// equal exactly when their atoms are equal, so later phases never need strcmp.
+typedef int Atom;
+
+// Atoms for names the compiler itself needs to recognise. They are interned
+// first, in this order, by intern_init().
+enum {
+    ATOM_NONE = 0,
+    ATOM_INT,
+    ATOM_CHAR,
+    ATOM_VOID,
+    ATOM_FLOAT,
+    ATOM_BOOLEAN,
+    ATOM_TRUE,
+    ATOM_FALSE,
+    ATOM_FUNCTION,
+    ATOM_MAIN,
+    ATOM_ADD,
+    ATOM_GLOBAL,
+    ATOM_BUILTIN_COUNT
+};
+
+typedef struct InternChunk InternChunk;
+typedef struct InternEntry InternEntry;
+
+// One pool of interned names. Each compilation owns its own table, so
+// atoms from different compilations must not be mixed.
+typedef struct {
+    InternChunk* chunks;
+    InternEntry* entries;  // Indexed by atom
+    int entry_count;
+    int entry_capacity;
+    Atom* slots;           // Open addressing table, ATOM_NONE marks an empty slot
+    int slot_capacity;
+    size_t chunk_bytes;
+} InternTable;
+
+void intern_init(InternTable* table);
+Atom intern(InternTable* table, const char* str);
+Atom intern_n(InternTable* table, const char* str, int length);
+const char* atom_name(InternTable* table, Atom atom);
+int atom_length(InternTable* table, Atom atom);
+int atom_count(InternTable* table);
+size_t intern_memory_used(InternTable* table);
+void intern_free(InternTable* table);
+
+#endif // INTERN_H
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libcompiler.h"
+#include "compiler.h"
+
+// Hand a memory output over to the caller
+static void take_output(OutputBuffer* output, char** data, size_t* length) {
+    *data = output->data;
+    *length = output->length;
+    output->data = NULL;
+    output->length = 0;
+}
+
+struct CompileSession {
+    CompilerContext ctx;
+    int used;            // The context has compiled before and needs a reset
+};
+
+CompileSession* compile_session_create(void) {
+    CompileSession* session = malloc(sizeof(CompileSession));
+    if (session == NULL) {
+        return NULL;
+    }
+    compiler_init(&session->ctx);
+    session->ctx.memory_outputs = 1;
+    session->used = 0;
+    return session;
+}
+
+int compile_session_run(CompileSession* session, const char* source, size_t length,
+                        const CompileOptions* options, CompileResult* result) {
+    CompilerContext* ctx = &session->ctx;
+    memset(result, 0, sizeof(CompileResult));
+    result->status = 1;
+    if (session->used) {
+        compiler_reset(ctx);
+    }
+    session->used = 1;
+    ctx->stream_mode = options != NULL ? options->stream_mode : 0;
+    ctx->dump_tac = options != NULL ? options->dump_tac : 0;
+    ctx->dump_optimized = options != NULL ? options->dump_optimized : 0;
+    ctx->dump_cfg = options != NULL ? options->dump_cfg : 0;
+
+    FILE* diagnostics = open_memstream(&result->diagnostics, &result->diagnostics_length);
+    if (diagnostics == NULL) {
+        return result->status;
+    }
+    ctx->diagnostics = diagnostics;
+    ctx->symbols.errors = diagnostics;
+
+    if (source_from_buffer(&ctx->source, source, length) == 0) {
+        result->status = compileSource(ctx);
+    }
+
+    // compileSource() has closed the streams, so the buffers are final
+    take_output(&ctx->tac_output, &result->tac, &result->tac_length);
+    take_output(&ctx->optimized_output, &result->optimized_tac, &result->optimized_tac_length);
+    take_output(&ctx->cfg_output, &result->cfg, &result->cfg_length);
+    take_output(&ctx->asm_output, &result->assembly, &result->assembly_length);
+    ctx->diagnostics = stderr;
+    ctx->symbols.errors = stderr;
+    fclose(diagnostics);
+    return result->status;
+}
+
+void compile_session_free(CompileSession* session) {
+    if (session == NULL) {
+        return;
+    }
+    compiler_free(&session->ctx);
+    free(session);
+}
+
+int compile_buffer(const char* source, size_t length, const CompileOptions* options, CompileResult* result) {
+    CompileSession* session = compile_session_create();
+    if (session == NULL) {
+        memset(result, 0, sizeof(CompileResult));
+        result->status = 1;
+        return result->status;
+    }
+    compile_session_run(session, source, length, options, result);
+    compile_session_free(session);
+    return result->status;
+}
+
+void compile_result_free(CompileResult* result) {
+    free(result->assembly);
+    free(result->tac);
+    free(result->optimized_tac);
+    free(result->cfg);
+    free(result->diagnostics);
+    memset(result, 0, sizeof(CompileResult));
+}
@@ -0,0 +1,49 @@
+#ifndef LIBCOMPILER_H
+#define LIBCOMPILER_H
+
+#include <stddef.h>
+
+// Public interface of libcompiler.a. Compiles a program held in memory and
+// returns the results in memory; no files are read or written. Each call
+// has its own state, so calls may run concurrently on different threads.
+
+typedef struct {
+    int stream_mode;      // Compile each top-level statement as soon as it is parsed
+    int dump_tac;         // Also return the three-address code
+    int dump_optimized;   // Also return the optimized three-address code
+    int dump_cfg;         // Also return its control-flow graph in Graphviz dot syntax
+} CompileOptions;
+
+// Every buffer is NUL-terminated, malloc'd and owned by the result until
+// compile_result_free(). A buffer is NULL if compilation stopped before
+// producing it, or if it is a dump the options did not ask for.
+typedef struct {
+    int status;                  // 0 when the program compiled
+    char* assembly;              // MIPS assembly, what output.asm would hold
+    size_t assembly_length;
+    char* tac;                   // Three-address code, as in output.tac
+    size_t tac_length;
+    char* optimized_tac;         // As in optimized.tac
+    size_t optimized_tac_length;
+    char* cfg;                   // As in cfg.dot
+    size_t cfg_length;
+    char* diagnostics;           // Errors and warnings, as printed to stderr
+    size_t diagnostics_length;
+} CompileResult;
+
+// Compile length bytes of source. options may be NULL for the defaults.
+// Returns result->status.
+int compile_buffer(const char* source, size_t length, const CompileOptions* options, CompileResult* result);
+void compile_result_free(CompileResult* result);
+
+// A session compiles one program after another and stays warm in between:
+// interned names and allocator memory are kept and only per-program state
+// is reset. A session must not be used by two threads at once.
+typedef struct CompileSession CompileSession;
+
+CompileSession* compile_session_create(void);
+int compile_session_run(CompileSession* session, const char* source, size_t length,
+                        const CompileOptions* options, CompileResult* result);
+void compile_session_free(CompileSession* session);
+
+#endif // LIBCOMPILER_H
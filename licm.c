@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "licm.h"
+#include "arena.h"
+
+// The per-key counts of the loop being done, cleared the first time a key
+// is seen
+static void touch(LoopInvariantMotion* licm, int key) {
+    if (licm->stamp[key] != licm->mark) {
+        licm->stamp[key] = licm->mark;
+        licm->assignments[key] = 0;
+        licm->assigned_by[key] = -1;
+        licm->loop_reads[key] = 0;
+        licm->exposed[key] = 0;
+    }
+}
+
+static void count_read(LoopInvariantMotion* licm, TACOperand operand) {
+    int key = tac_operand_key(operand);
+    if (key >= 0) {
+        touch(licm, key);
+        licm->loop_reads[key]++;
+    }
+}
+
+// True when instruction a runs before instruction b on every path to b
+static int runs_before(LoopInvariantMotion* licm, CFG* cfg, int start, int a, int b) {
+    int block_a = licm->instruction_block[a - start];
+    int block_b = licm->instruction_block[b - start];
+    return block_a == block_b ? a < b : cfg_dominates(cfg, block_a, block_b);
+}
+
+// Mark operand exposed when its assignment in the loop may not have run
+// by the time instruction reads it
+static void check_read(LoopInvariantMotion* licm, CFG* cfg, int start, TACOperand operand, int instruction) {
+    int key = tac_operand_key(operand);
+    if (key >= 0 && licm->assignments[key] > 0 &&
+        (licm->assignments[key] > 1 || !runs_before(licm, cfg, start, licm->assigned_by[key], instruction))) {
+        licm->exposed[key] = 1;
+    }
+}
+
+// The value of operand is the same everywhere in the loop and in the
+// preheader: it is a literal, the loop does not assign it, or the loop's
+// only assignment to it is being hoisted ahead of the reader
+static int is_invariant(LoopInvariantMotion* licm, TACOperand operand, int has_call, int start) {
+    int key = tac_operand_key(operand);
+    if (key < 0) {
+        return 1;
+    }
+    if (has_call && !tac_is_temp(operand)) {
+        return 0;
+    }
+    if (licm->stamp[key] != licm->mark || licm->assignments[key] == 0) {
+        return 1;
+    }
+    return licm->assignments[key] == 1 && licm->hoisted[licm->assigned_by[key] - start] == licm->mark;
+}
+
+// add and sub trap on overflow unless they wrap, as does the sub that compares for == and
+// !=, and div traps on a zero divisor, so these only move when they ran
+// anyway. Only the opcode and the operands tell: every binary operation
+// assigns a newFloat() temporary, integer ones included. One with a float
+// literal is done by the float unit, which does not trap.
+static int can_fault(TACInstruction* instr) {
+    if (instr->arg1.kind == OPERAND_FLOAT || instr->arg2.kind == OPERAND_FLOAT) {
+        return 0;
+    }
+    switch (instr->opcode) {
+        case TAC_ADD:
+        case TAC_SUB:
+            return !instr->wraps;
+        case TAC_EQ:
+        case TAC_NE:
+            return 1;
+        case TAC_DIV:
+            return instr->arg2.kind != OPERAND_INT || instr->arg2.int_value == 0;
+    }
+    return 0;
+}
+
+// True when block dominates every block the loop can be left from, so
+// whatever it assigns holds after the loop
+static int dominates_exits(LoopInvariantMotion* licm, CFG* cfg, int block, int exit_count) {
+    if (licm->exit_mark[block] != licm->mark) {
+        licm->exit_mark[block] = licm->mark;
+        licm->exits_dominated[block] = 1;
+        for (int e = 0; e < exit_count; e++) {
+            if (!cfg_dominates(cfg, block, licm->exits[e])) {
+                licm->exits_dominated[block] = 0;
+                break;
+            }
+        }
+    }
+    return licm->exits_dominated[block];
+}
+
+static int compare_ints(const void* a, const void* b) {
+    return *(const int*) a - *(const int*) b;
+}
+
+// Hoist what can be hoisted out of the natural loop l, whose preheader is
+// block preheader, to the end of that block. Returns how many instructions
+// it hoisted.
+static int hoist_loop(LoopInvariantMotion* licm, CFG* cfg, TACBuffer* tac, int l, int preheader) {
+    Loop* loop = &cfg->loops[l];
+    int start = cfg->blocks[0].first;
+    int* blocks = &cfg->loop_blocks[loop->block_start];
+    int mark = ++licm->mark;
+
+    // Count the assignments and reads of each operand in the loop, note
+    // the blocks it can be left from and whether it makes a call
+    int exit_count = 0;
+    int has_call = 0;
+    for (int k = 0; k < loop->block_count; k++) {
+        licm->in_loop[blocks[k]] = mark;
+    }
+    for (int k = 0; k < loop->block_count; k++) {
+        BasicBlock* block = &cfg->blocks[blocks[k]];
+        for (int s = 0; s < 2; s++) {
+            if (block->successors[s] >= 0 && licm->in_loop[block->successors[s]] != mark) {
+                grow_array((void**) &licm->exits, &licm->exit_capacity, exit_count + 1, sizeof(int));
+                licm->exits[exit_count++] = blocks[k];
+                break;
+            }
+        }
+        for (int i = block->first; i < block->end; i++) {
+            TACInstruction* instr = &tac->items[i];
+            count_read(licm, instr->arg1);
+            count_read(licm, instr->arg2);
+            has_call |= instr->opcode == TAC_PARAM;
+            int key = tac_operand_key(instr->result);
+            if (key >= 0) {
+                touch(licm, key);
+                licm->assignments[key]++;
+                licm->assigned_by[key] = i;
+            }
+        }
+    }
+    for (int k = 0; k < loop->block_count; k++) {
+        BasicBlock* block = &cfg->blocks[blocks[k]];
+        for (int i = block->first; i < block->end; i++) {
+            check_read(licm, cfg, start, tac->items[i].arg1, i);
+            check_read(licm, cfg, start, tac->items[i].arg2, i);
+        }
+    }
+
+    // Go through the loop in dominator order, so an instruction is looked
+    // at after those it reads from
+    grow_array((void**) &licm->order, &licm->order_capacity, loop->block_count, sizeof(int));
+    for (int k = 0; k < loop->block_count; k++) {
+        licm->order[k] = licm->dom_position[blocks[k]];
+    }
+    qsort(licm->order, loop->block_count, sizeof(int), compare_ints);
+    int hoisted = 0;
+    for (int k = 0; k < loop->block_count; k++) {
+        int b = cfg->dom_order[licm->order[k]];
+        if (b < preheader) {
+            continue;   // Rewriting in place needs code to move up only
+        }
+        for (int i = cfg->blocks[b].first; i < cfg->blocks[b].end; i++) {
+            TACInstruction* instr = &tac->items[i];
+            if (licm->hoisted[i - start] || (instr->opcode != TAC_COPY && !tac_is_binary(instr))) {
+                continue;
+            }
+            int key = tac_operand_key(instr->result);
+            if (instr->result.kind == OPERAND_ELEMENT || (has_call && !tac_is_temp(instr->result)) ||
+                licm->assignments[key] != 1 || licm->exposed[key] ||
+                !is_invariant(licm, instr->arg1, has_call, start) ||
+                !is_invariant(licm, instr->arg2, has_call, start)) {
+                continue;
+            }
+            // Running it in the preheader runs it when the loop would
+            // have been left before it; that only matters when its result
+            // is read after the loop or it can fault
+            if (!dominates_exits(licm, cfg, b, exit_count) &&
+                (!tac_is_temp(instr->result) || licm->loop_reads[key] != licm->reads[key] || can_fault(instr))) {
+                continue;
+            }
+            licm->hoisted[i - start] = mark;
+            grow_array((void**) &licm->copies, &licm->copy_capacity, licm->copy_count + 1, sizeof(TACInstruction));
+            licm->copies[licm->copy_count] = *instr;
+            licm->copies[licm->copy_count++].is_optimized = 1;
+            hoisted++;
+        }
+    }
+    return hoisted;
+}
+
+// One pass over the recorded loops, inner ones first. Returns how many
+// instructions moved.
+static int hoist_round(LoopInvariantMotion* licm, CFG* cfg, TACBuffer* tac, TACLoop* loops, int loop_count) {
+    int start = cfg->blocks[0].first;
+    int count = tac->count - start;
+    int capacity = licm->instruction_capacity;
+    grow_array((void**) &licm->instruction_block, &capacity, count, sizeof(int));
+    capacity = licm->instruction_capacity;
+    grow_array((void**) &licm->hoisted, &capacity, count, sizeof(int));
+    licm->instruction_capacity = capacity;
+    int block_capacity = licm->block_capacity;
+    grow_array((void**) &licm->in_loop, &block_capacity, cfg->block_count, sizeof(int));
+    block_capacity = licm->block_capacity;
+    grow_array((void**) &licm->exit_mark, &block_capacity, cfg->block_count, sizeof(int));
+    block_capacity = licm->block_capacity;
+    grow_array((void**) &licm->exits_dominated, &block_capacity, cfg->block_count, sizeof(char));
+    block_capacity = licm->block_capacity;
+    grow_array((void**) &licm->moved_start, &block_capacity, cfg->block_count, sizeof(int));
+    block_capacity = licm->block_capacity;
+    grow_array((void**) &licm->moved_end, &block_capacity, cfg->block_count, sizeof(int));
+    block_capacity = licm->block_capacity;
+    grow_array((void**) &licm->dom_position, &block_capacity, cfg->block_count, sizeof(int));
+    licm->block_capacity = block_capacity;
+
+    // Marks only grow, so what is left from an earlier round never matches
+    for (int b = 0; b < cfg->block_count; b++) {
+        licm->in_loop[b] = 0;
+        licm->exit_mark[b] = 0;
+        licm->moved_start[b] = 0;
+        licm->moved_end[b] = 0;
+        for (int i = cfg->blocks[b].first; i < cfg->blocks[b].end; i++) {
+            licm->instruction_block[i - start] = b;
+            licm->hoisted[i - start] = 0;
+        }
+    }
+    for (int d = 0; d < cfg->reachable_count; d++) {
+        licm->dom_position[cfg->dom_order[d]] = d;
+    }
+    for (int i = start; i < tac->count; i++) {
+        int key = tac_operand_key(tac->items[i].arg1);
+        if (key >= 0) {
+            licm->reads[key]++;
+        }
+        key = tac_operand_key(tac->items[i].arg2);
+        if (key >= 0) {
+            licm->reads[key]++;
+        }
+    }
+
+    int moved = 0;
+    licm->copy_count = 0;
+    for (int k = loop_count - 1; k >= 0; k--) {
+        int header = cfg_label_block(cfg, tac, loops[k].header);
+        int preheader = cfg_label_block(cfg, tac, loops[k].preheader);
+        if (header < 0 || preheader < 0 || cfg->blocks[header].rpo < 0) {
+            continue;   // Optimized away
+        }
+        int l = cfg->blocks[header].loop;
+        BasicBlock* block = &cfg->blocks[preheader];
+        if (l < 0 || cfg->loops[l].header != header ||
+            block->successors[0] != header || block->successors[1] >= 0) {
+            continue;
+        }
+        // Control must come into the loop through the preheader only
+        int entries = 0;
+        BasicBlock* head = &cfg->blocks[header];
+        for (int p = 0; p < head->predecessor_count; p++) {
+            int pred = cfg->predecessors[head->predecessor_start + p];
+            if (cfg->blocks[pred].rpo >= 0 && !cfg_dominates(cfg, header, pred)) {
+                entries++;
+            }
+        }
+        if (entries != 1 || cfg_dominates(cfg, header, preheader)) {
+            continue;
+        }
+        if (licm->rounds == 1) {
+            licm->loops++;
+        }
+        licm->moved_start[preheader] = licm->copy_count;
+        moved += hoist_loop(licm, cfg, tac, l, preheader);
+        licm->moved_end[preheader] = licm->copy_count;
+    }
+
+    for (int i = start; i < tac->count; i++) {
+        int key = tac_operand_key(tac->items[i].arg1);
+        if (key >= 0) {
+            licm->reads[key] = 0;
+        }
+        key = tac_operand_key(tac->items[i].arg2);
+        if (key >= 0) {
+            licm->reads[key] = 0;
+        }
+    }
+    if (moved == 0) {
+        return 0;
+    }
+
+    // Write the code out again with the hoisted instructions at the end
+    // of their preheaders, ahead of a jump there. Everything moves up to a
+    // block before the one it was in and the count stays the same, so
+    // going from the end, nothing is written over before it is read.
+    int w = tac->count;
+    for (int b = cfg->block_count - 1; b >= 0; b--) {
+        BasicBlock* block = &cfg->blocks[b];
+        int end = block->end;
+        if (licm->moved_end[b] > licm->moved_start[b] && tac->items[end - 1].opcode == TAC_JUMP) {
+            tac->items[--w] = tac->items[--end];
+        }
+        for (int k = licm->moved_end[b]; k > licm->moved_start[b]; k--) {
+            tac->items[--w] = licm->copies[k - 1];
+        }
+        for (int i = end - 1; i >= block->first; i--) {
+            if (!licm->hoisted[i - start]) {
+                tac->items[--w] = tac->items[i];
+            }
+        }
+    }
+    return moved;
+}
+
+int licm_run(LoopInvariantMotion* licm, CFG* cfg, TACBuffer* tac, TACLoop* loops, int loop_count,
+             int key_count, int label_count) {
+    licm->loops = 0;
+    licm->moved = 0;
+    licm->rounds = 0;
+    if (cfg->block_count == 0 || cfg->loop_count == 0 || loop_count == 0) {
+        return 0;
+    }
+    int start = cfg->blocks[0].first;
+    if (key_count > licm->key_capacity) {
+        int capacity = licm->key_capacity;
+        grow_array((void**) &licm->stamp, &capacity, key_count, sizeof(int));
+        capacity = licm->key_capacity;
+        grow_array((void**) &licm->assignments, &capacity, key_count, sizeof(int));
+        capacity = licm->key_capacity;
+        grow_array((void**) &licm->assigned_by, &capacity, key_count, sizeof(int));
+        capacity = licm->key_capacity;
+        grow_array((void**) &licm->loop_reads, &capacity, key_count, sizeof(int));
+        capacity = licm->key_capacity;
+        grow_array((void**) &licm->exposed, &capacity, key_count, sizeof(char));
+        int old_capacity = licm->key_capacity;
+        capacity = licm->key_capacity;
+        grow_array((void**) &licm->reads, &capacity, key_count, sizeof(int));
+        memset(licm->stamp + old_capacity, 0, (capacity - old_capacity) * sizeof(int));
+        memset(licm->reads + old_capacity, 0, (capacity - old_capacity) * sizeof(int));
+        licm->key_capacity = capacity;
+    }
+
+    for (;;) {
+        licm->rounds++;
+        int moved = hoist_round(licm, cfg, tac, loops, loop_count);
+        if (moved == 0) {
+            break;
+        }
+        licm->moved += moved;
+        cfg_build(cfg, tac, start, label_count);
+    }
+    return licm->moved;
+}
+
+void licm_free(LoopInvariantMotion* licm) {
+    free(licm->stamp);
+    free(licm->assignments);
+    free(licm->assigned_by);
+    free(licm->loop_reads);
+    free(licm->exposed);
+    free(licm->reads);
+    free(licm->in_loop);
+    free(licm->exit_mark);
+    free(licm->exits_dominated);
+    free(licm->moved_start);
+    free(licm->moved_end);
+    free(licm->dom_position);
+    free(licm->exits);
+    free(licm->order);
+    free(licm->instruction_block);
+    free(licm->hoisted);
+    free(licm->copies);
+    memset(licm, 0, sizeof(LoopInvariantMotion));
+}
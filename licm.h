@@ -0,0 +1,73 @@
+#ifndef LICM_H
+#define LICM_H
+
+#include "cfg.h"
+
+// Loop-invariant code motion over the while loops semantic analysis
+// recorded. An assignment in a loop is invariant when each operand is a
+// literal, is not assigned in the loop, or is assigned only by an
+// instruction already hoisted; it moves to the end of the loop's
+// preheader when
+//   - it is the only assignment to its result in the loop,
+//   - every read of the result in the loop comes after it, and
+//   - it runs whenever the loop exits, or its result is a temporary read
+//     nowhere else and the operation cannot fault, so running it once more
+//     than before is harmless.
+// Named variables are memory, so a load of a global is hoisted like any
+// other operand: when the loop does not assign it. A call shows up only as
+// its params, and a loop with one may change any named variable; calls are
+// not translated yet and one without arguments leaves nothing to go by.
+//
+// Inner loops are done before the loops containing them, and whatever
+// moved into an inner preheader is tried again for the outer loop once
+// the graph is rebuilt, until nothing moves.
+typedef struct {
+    // Indexed by tac_operand_key(); counts are for the loop being done and
+    // valid only where stamp holds its mark
+    int* stamp;
+    int* assignments;       // In the loop
+    int* assigned_by;       // The instruction, when there is only one
+    int* loop_reads;
+    char* exposed;          // Read in the loop where assigned_by may not have run
+    int* reads;             // Anywhere in the graph
+    int key_capacity;
+
+    // Indexed by block
+    int* in_loop;           // Mark of the loop being done
+    int* exit_mark;         // Mark for which exits_dominated is valid
+    char* exits_dominated;  // The block dominates every exit of the loop
+    int* moved_start;       // Slice of copies hoisted to the end of the block
+    int* moved_end;
+    int* dom_position;      // In CFG.dom_order
+    int block_capacity;
+    int* exits;             // Blocks of the loop with an edge leaving it
+    int exit_capacity;
+    int* order;             // Positions of the loop's blocks in dom_order, sorted
+    int order_capacity;
+
+    // Indexed by instruction from the graph's first on
+    int* instruction_block;
+    int* hoisted;           // Mark of the loop it was hoisted from, 0 for none
+    int instruction_capacity;
+
+    TACInstruction* copies; // Of the hoisted instructions, by preheader
+    int copy_count;
+    int copy_capacity;
+    int mark;
+
+    // What licm_run() did
+    int loops;              // Recorded loops found in the graph
+    int moved;              // Instructions hoisted, counting each move out of a loop
+    int rounds;
+} LoopInvariantMotion;
+
+// Hoist the invariant instructions of loops out of the instructions cfg
+// was built from. key_count bounds tac_operand_key() of their operands and
+// label_count the label numbers. The graph is rebuilt after each round
+// that moves anything, so it matches the instructions on return. Returns
+// the number of instructions moved.
+int licm_run(LoopInvariantMotion* licm, CFG* cfg, TACBuffer* tac, TACLoop* loops, int loop_count,
+             int key_count, int label_count);
+void licm_free(LoopInvariantMotion* licm);
+
+#endif // LICM_H
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "liveness.h"
+#include "arena.h"
+
+int liveness_variable(Liveness* live, TACOperand operand) {
+    if (!tac_is_temp(operand)) {
+        return -1;
+    }
+    int key = tac_operand_key(operand);
+    if (key >= live->key_capacity) {
+        return -1;
+    }
+    int v = live->variable_of_key[key];
+    if (v >= 0 && v < live->variable_count && live->keys[v] == key) {
+        return v;
+    }
+    return -1;
+}
+
+static int add_variable(Liveness* live, TACOperand operand) {
+    int v = liveness_variable(live, operand);
+    if (v >= 0 || !tac_is_temp(operand)) {
+        return v;
+    }
+    if (live->variable_count == live->variable_capacity) {
+        // The three arrays share variable_capacity
+        int capacity = live->variable_capacity;
+        grow_array((void**) &live->keys, &capacity, live->variable_count + 1, sizeof(int));
+        capacity = live->variable_capacity;
+        grow_array((void**) &live->global_index, &capacity, live->variable_count + 1, sizeof(int));
+        capacity = live->variable_capacity;
+        grow_array((void**) &live->assigned_in, &capacity, live->variable_count + 1, sizeof(int));
+        live->variable_capacity = capacity;
+    }
+    v = live->variable_count++;
+    live->keys[v] = tac_operand_key(operand);
+    live->global_index[v] = 0;
+    live->assigned_in[v] = 0;
+    live->variable_of_key[live->keys[v]] = v;
+    return v;
+}
+
+// Number the temporaries and find the global ones. Until the bits are
+// numbered, global_index holds whether a variable is read before its block
+// assigns it.
+static void find_globals(Liveness* live, CFG* cfg, TACBuffer* tac) {
+    live->variable_count = 0;
+    for (int b = 0; b < cfg->block_count; b++) {
+        for (int i = cfg->blocks[b].first; i < cfg->blocks[b].end; i++) {
+            TACInstruction* instr = &tac->items[i];
+            if (instr->is_dead) {
+                continue;
+            }
+            TACOperand* operands[3] = { &instr->arg1, &instr->arg2, &instr->result };
+            for (int o = 0; o < 3; o++) {
+                int v = add_variable(live, *operands[o]);
+                if (v < 0) {
+                    continue;
+                }
+                if (o < 2) {
+                    live->global_index[v] |= live->assigned_in[v] != b + 1;
+                } else {
+                    live->assigned_in[v] = b + 1;
+                }
+            }
+        }
+    }
+
+    live->global_count = 0;
+    for (int v = 0; v < live->variable_count; v++) {
+        live->global_index[v] = live->global_index[v] ? live->global_count++ : -1;
+    }
+}
+
+// Set the use and def bits of every block
+static void find_uses(Liveness* live, CFG* cfg, TACBuffer* tac) {
+    for (int b = 0; b < cfg->block_count; b++) {
+        LiveWord* use = &live->use[(size_t) b * live->words];
+        LiveWord* def = &live->def[(size_t) b * live->words];
+        for (int i = cfg->blocks[b].first; i < cfg->blocks[b].end; i++) {
+            TACInstruction* instr = &tac->items[i];
+            if (instr->is_dead) {
+                continue;
+            }
+            TACOperand* args[2] = { &instr->arg1, &instr->arg2 };
+            for (int a = 0; a < 2; a++) {
+                int v = liveness_variable(live, *args[a]);
+                if (v >= 0 && live->global_index[v] >= 0 && !liveness_test(def, live->global_index[v])) {
+                    liveness_set(use, live->global_index[v]);
+                }
+            }
+            int v = liveness_variable(live, instr->result);
+            if (v >= 0 && live->global_index[v] >= 0) {
+                liveness_set(def, live->global_index[v]);
+            }
+        }
+    }
+}
+
+// live_out(b) is the union of live_in over b's successors, and live_in(b)
+// is use(b) plus whatever of live_out(b) the block does not assign. Blocks
+// are queued in reverse order, which suits a backward problem, and a block
+// whose live_in grows queues its predecessors again.
+static void solve(Liveness* live, CFG* cfg) {
+    int words = live->words;
+    int count = cfg->block_count;
+    memcpy(live->live_in, live->use, (size_t) count * words * sizeof(LiveWord));
+    memset(live->live_out, 0, (size_t) count * words * sizeof(LiveWord));
+    for (int b = 0; b < count; b++) {
+        live->queue[b] = count - 1 - b;
+        live->queued[b] = 1;
+    }
+
+    int head = 0;
+    int pending = count;
+    live->iterations = 0;
+    while (pending > 0) {
+        int b = live->queue[head];
+        head = head + 1 == count ? 0 : head + 1;
+        pending--;
+        live->queued[b] = 0;
+        live->iterations++;
+
+        BasicBlock* block = &cfg->blocks[b];
+        LiveWord* out = &live->live_out[(size_t) b * words];
+        LiveWord* in = &live->live_in[(size_t) b * words];
+        LiveWord* use = &live->use[(size_t) b * words];
+        LiveWord* def = &live->def[(size_t) b * words];
+        for (int s = 0; s < 2; s++) {
+            if (block->successors[s] >= 0) {
+                LiveWord* succ_in = &live->live_in[(size_t) block->successors[s] * words];
+                for (int w = 0; w < words; w++) {
+                    out[w] |= succ_in[w];
+                }
+            }
+        }
+        int changed = 0;
+        for (int w = 0; w < words; w++) {
+            LiveWord word = use[w] | (out[w] & ~def[w]);
+            changed |= word != in[w];
+            in[w] = word;
+        }
+        if (!changed) {
+            continue;
+        }
+        for (int p = 0; p < block->predecessor_count; p++) {
+            int pred = cfg->predecessors[block->predecessor_start + p];
+            if (!live->queued[pred]) {
+                live->queued[pred] = 1;
+                live->queue[(head + pending) % count] = pred;
+                pending++;
+            }
+        }
+    }
+}
+
+void liveness_build(Liveness* live, CFG* cfg, TACBuffer* tac, int key_count) {
+    if (key_count > live->key_capacity) {
+        int old_capacity = live->key_capacity;
+        grow_array((void**) &live->variable_of_key, &live->key_capacity, key_count, sizeof(int));
+        memset(live->variable_of_key + old_capacity, 0, (live->key_capacity - old_capacity) * sizeof(int));
+    }
+    if (cfg->block_count > live->block_capacity) {
+        int capacity = live->block_capacity;
+        grow_array((void**) &live->queue, &capacity, cfg->block_count, sizeof(int));
+        capacity = live->block_capacity;
+        grow_array((void**) &live->queued, &capacity, cfg->block_count, sizeof(char));
+        live->block_capacity = capacity;
+    }
+    find_globals(live, cfg, tac);
+
+    live->words = (live->global_count + 63) / 64;
+    live->iterations = 0;
+    size_t size = (size_t) cfg->block_count * live->words;
+    live->complete = size <= LIVENESS_MAX_WORDS;
+    if (!live->complete || size == 0) {
+        return;
+    }
+    if (size > live->set_capacity) {
+        LiveWord** sets[] = { &live->use, &live->def, &live->live_in, &live->live_out };
+        for (int s = 0; s < 4; s++) {
+            free(*sets[s]);
+            *sets[s] = malloc(size * sizeof(LiveWord));
+            if (*sets[s] == NULL) {
+                fprintf(stderr, "Memory allocation failed for liveness\n");
+                exit(1);
+            }
+        }
+        live->set_capacity = size;
+    }
+    memset(live->use, 0, size * sizeof(LiveWord));
+    memset(live->def, 0, size * sizeof(LiveWord));
+    find_uses(live, cfg, tac);
+    solve(live, cfg);
+}
+
+void liveness_free(Liveness* live) {
+    free(live->variable_of_key);
+    free(live->keys);
+    free(live->global_index);
+    free(live->assigned_in);
+    free(live->use);
+    free(live->def);
+    free(live->live_in);
+    free(live->live_out);
+    free(live->queue);
+    free(live->queued);
+    memset(live, 0, sizeof(Liveness));
+}
@@ -0,0 +1,74 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include <stdint.h>
+#include "cfg.h"
+
+// Bitsets larger than this many words each fall back to block-local
+// liveness, see Liveness.complete
+#define LIVENESS_MAX_WORDS (1 << 22)
+
+typedef uint64_t LiveWord;
+
+// Which temporaries are live at the ends of the blocks of a CFG. Named
+// variables are not tracked: they live in memory that later segments read,
+// so they are live everywhere.
+//
+// Temporaries get dense numbers. Only the ones read in some block before
+// that block assigns them, the global ones, can be live across a block
+// boundary, so the per-block sets have a bit for those alone and the rest
+// are handled by a scan of their block. The sets are solved backwards
+// with a worklist, a word at a time.
+typedef struct {
+    int* variable_of_key;   // tac_operand_key() -> variable, checked against keys[]
+    int key_capacity;
+    int* keys;              // Variable -> tac_operand_key()
+    int* global_index;      // Variable -> bit in the block sets, -1 for local variables
+    int* assigned_in;       // Scratch: block + 1 that last assigned the variable
+    int variable_count;
+    int variable_capacity;
+    int global_count;
+
+    // Unless complete is clear, in which case the sets were too large and
+    // every global variable must be taken to be live everywhere
+    int complete;
+    int words;              // Per set
+    LiveWord* use;          // Read before being assigned in the block
+    LiveWord* def;          // Assigned in the block
+    LiveWord* live_in;
+    LiveWord* live_out;
+    size_t set_capacity;    // In words, of each of the four
+    int iterations;         // Blocks the worklist processed
+
+    // Scratch, indexed by block
+    int* queue;
+    char* queued;
+    int block_capacity;
+} Liveness;
+
+// Solve liveness for the instructions cfg was built from, skipping the
+// ones marked is_dead. key_count bounds tac_operand_key() of their operands.
+void liveness_build(Liveness* live, CFG* cfg, TACBuffer* tac, int key_count);
+void liveness_free(Liveness* live);
+
+// Dense number of a temporary, -1 for anything else or a temporary the
+// instructions don't mention
+int liveness_variable(Liveness* live, TACOperand operand);
+
+static inline LiveWord* liveness_out(Liveness* live, int block) {
+    return &live->live_out[(size_t) block * live->words];
+}
+
+static inline int liveness_test(LiveWord* set, int bit) {
+    return (set[bit / 64] >> (bit % 64)) & 1;
+}
+
+static inline void liveness_set(LiveWord* set, int bit) {
+    set[bit / 64] |= (LiveWord) 1 << (bit % 64);
+}
+
+static inline void liveness_clear(LiveWord* set, int bit) {
+    set[bit / 64] &= ~((LiveWord) 1 << (bit % 64));
+}
+
+#endif // LIVENESS_H
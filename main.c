@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "compiler.h"
+#include "server.h"
+#include "trace.h"
+
+// Command line driver. The compiler itself lives in libcompiler.a; this
+// file only handles options, output names and the -j thread pool.
+
+void printUsage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] <source file>...\n", program);
+    fprintf(stderr, "  -v, -vv, -vvv     trace every phase at info, debug or verbose level\n");
+    fprintf(stderr, "  --trace=LIST      trace selected phases, e.g. --trace=lex,sema:3\n");
+    fprintf(stderr, "                    phases: lex parse sema tac opt codegen all\n");
+    fprintf(stderr, "  --stream          compile each top-level statement as soon as it is parsed\n");
+    fprintf(stderr, "  --dump-tac        also write the three-address code to output.tac\n");
+    fprintf(stderr, "  --dump-optimized  also write the optimized three-address code to optimized.tac\n");
+    fprintf(stderr, "  --dump-cfg        also write the optimized control-flow graph to cfg.dot\n");
+    fprintf(stderr, "  -j N              compile all the files on N threads; a.cm is written to\n");
+    fprintf(stderr, "                    a.asm, and the dumps to a.tac, a.optimized.tac and a.dot\n");
+    fprintf(stderr, "  --serve=SOCKET    run as a compile server on a Unix socket, see ./client\n");
+    fprintf(stderr, "  --serve           run as a compile server on stdin and stdout\n");
+}
+
+// Output name for a -j input: the input path with its extension replaced,
+// so dir/a.cm gives dir/a.tac, dir/a.optimized.tac, dir/a.dot and dir/a.asm
+char* outputPath(const char* input, const char* extension) {
+    const char* base = strrchr(input, '/');
+    const char* dot = strrchr(base != NULL ? base : input, '.');
+    size_t stem = dot != NULL ? (size_t)(dot - input) : strlen(input);
+    char* path = malloc(stem + strlen(extension) + 1);
+    memcpy(path, input, stem);
+    strcpy(path + stem, extension);
+    return path;
+}
+
+// Inputs shared by the -j worker threads. Each worker takes the next file,
+// compiles it with a context of its own and adds to the totals.
+typedef struct {
+    char** paths;
+    int count;
+    int next;
+    int stream_mode;
+    int dump_tac;
+    int dump_optimized;
+    int dump_cfg;
+    int failed;
+    long lines;
+    pthread_mutex_t lock;
+} BatchJobs;
+
+int compileFile(BatchJobs* jobs, const char* path, long* lines) {
+    CompilerContext* ctx = malloc(sizeof(CompilerContext));
+    compiler_init(ctx);
+    ctx->stream_mode = jobs->stream_mode;
+    ctx->dump_tac = jobs->dump_tac;
+    ctx->dump_optimized = jobs->dump_optimized;
+    ctx->dump_cfg = jobs->dump_cfg;
+    char* tac_path = outputPath(path, ".tac");
+    char* optimized_path = outputPath(path, ".optimized.tac");
+    char* cfg_path = outputPath(path, ".dot");
+    char* asm_path = outputPath(path, ".asm");
+    ctx->tac_path = tac_path;
+    ctx->optimized_path = optimized_path;
+    ctx->cfg_path = cfg_path;
+    ctx->asm_path = asm_path;
+
+    int result = 1;
+    if (source_open(&ctx->source, path) != 0) {
+        perror(path);
+    } else {
+        *lines = source_count_lines(&ctx->source);
+        result = compileSource(ctx);
+    }
+    if (result != 0) {
+        fprintf(stderr, "%s: compilation failed\n", path);
+    }
+
+    compiler_free(ctx);
+    free(tac_path);
+    free(optimized_path);
+    free(cfg_path);
+    free(asm_path);
+    free(ctx);
+    return result;
+}
+
+void* compileWorker(void* arg) {
+    BatchJobs* jobs = arg;
+    for (;;) {
+        pthread_mutex_lock(&jobs->lock);
+        int index = jobs->next++;
+        pthread_mutex_unlock(&jobs->lock);
+        if (index >= jobs->count) {
+            return NULL;
+        }
+
+        long lines = 0;
+        int result = compileFile(jobs, jobs->paths[index], &lines);
+
+        pthread_mutex_lock(&jobs->lock);
+        jobs->failed += result != 0;
+        jobs->lines += lines;
+        pthread_mutex_unlock(&jobs->lock);
+    }
+}
+
+// Wall-clock seconds; clock() would add up the CPU time of every thread
+double wallTime(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// -j mode: compile every input on a pool of thread_count threads
+int compileFiles(char** paths, int count, int thread_count, int stream_mode, int dump_tac, int dump_optimized, int dump_cfg) {
+    BatchJobs jobs = { paths, count, 0, stream_mode, dump_tac, dump_optimized, dump_cfg, 0, 0 };
+    pthread_mutex_init(&jobs.lock, NULL);
+    if (thread_count > count) {
+        thread_count = count;
+    }
+
+    double start = wallTime();
+    pthread_t* threads = malloc(thread_count * sizeof(pthread_t));
+    int started = 0;
+    for (int i = 1; i < thread_count; i++) {
+        if (pthread_create(&threads[started], NULL, compileWorker, &jobs) == 0) {
+            started++;
+        }
+    }
+    compileWorker(&jobs);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = wallTime() - start;
+    free(threads);
+    pthread_mutex_destroy(&jobs.lock);
+
+    printf("Compiled %d files (%d failed), %ld lines in %f seconds on %d threads: %.1f files/s, %.0f lines/s\n",
+           count, jobs.failed, jobs.lines, elapsed, started + 1,
+           elapsed > 0 ? count / elapsed : 0.0, elapsed > 0 ? jobs.lines / elapsed : 0.0);
+    return jobs.failed != 0;
+}
+
+int main(int argc, char** argv) {
+
+    clock_t start_time = clock();
+    char** inputs = malloc(argc * sizeof(char*));
+    int input_count = 0;
+    int stream_mode = 0;
+    int dump_tac = 0;
+    int dump_optimized = 0;
+    int dump_cfg = 0;
+    int thread_count = 0;
+    int serve = 0;
+    const char* serve_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            trace_set_all(TRACE_LEVEL_INFO);
+        } else if (strcmp(argv[i], "-vv") == 0) {
+            trace_set_all(TRACE_LEVEL_DEBUG);
+        } else if (strcmp(argv[i], "-vvv") == 0) {
+            trace_set_all(TRACE_LEVEL_VERBOSE);
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            if (trace_parse_option(argv[i] + 8) != 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream_mode = 1;
+        } else if (strcmp(argv[i], "--dump-tac") == 0) {
+            dump_tac = 1;
+        } else if (strcmp(argv[i], "--dump-optimized") == 0) {
+            dump_optimized = 1;
+        } else if (strcmp(argv[i], "--dump-cfg") == 0) {
+            dump_cfg = 1;
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            serve = 1;
+        } else if (strncmp(argv[i], "--serve=", 8) == 0) {
+            serve = 1;
+            serve_path = argv[i] + 8;
+        } else if (strncmp(argv[i], "-j", 2) == 0) {
+            const char* count = argv[i][2] != '\0' ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : "");
+            thread_count = atoi(count);
+            if (thread_count <= 0) {
+                fprintf(stderr, "Error: -j needs a positive thread count\n");
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Error: unknown option %s\n", argv[i]);
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            inputs[input_count++] = argv[i];
+        }
+    }
+
+    if (serve) {
+        free(inputs);
+        return server_run(serve_path);
+    }
+
+    if (thread_count > 0 || input_count > 1) {
+        if (input_count == 0) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        int result = compileFiles(inputs, input_count, thread_count > 0 ? thread_count : 1,
+                                  stream_mode, dump_tac, dump_optimized, dump_cfg);
+        free(inputs);
+        return result;
+    }
+
+    static CompilerContext context;
+    CompilerContext* ctx = &context;
+    compiler_init(ctx);
+    ctx->stream_mode = stream_mode;
+    ctx->dump_tac = dump_tac;
+    ctx->dump_optimized = dump_optimized;
+    ctx->dump_cfg = dump_cfg;
+
+    if (input_count == 1) {
+        if (source_open(&ctx->source, inputs[0]) != 0) {
+            perror(inputs[0]);
+            return 1;
+        }
+    } else if (source_read_stream(&ctx->source, stdin) != 0) {
+        perror("stdin");
+        return 1;
+    }
+    free(inputs);
+
+    if (compileSource(ctx) != 0) {
+        return 1;
+    }
+    compiler_free(ctx);
+
+    clock_t end_time = clock();
+    double time_elapsed = (double) (end_time - start_time) / CLOCKS_PER_SEC;
+    printf("\n\nCompilation time: %f seconds\n", time_elapsed);
+
+
+    return 0;
+}
@@ -1,375 +1,513 @@
-
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include "compiler.h"
+#include "trace.h"
 
-#define MAX_INSTRUCTIONS 100
-#define MAX_ARRAY_SIZE 10
-
-
-typedef struct {
-    char op[4];
-    char arg1[10];
-    char arg2[10];
-    char result[10];
-    int is_dead;
-    int is_optimized;
-    int is_preserved; 
-} TACInstruction;
-
-void print_instructions(TACInstruction* instructions, int num_instructions);
+void print_instructions(CompilerContext* ctx, TACInstruction* instructions, int num_instructions);
 
-// Function declaration for read_TAC
-int read_TAC(const char* filename, TACInstruction* instructions);
-
-int is_number(const char* str) {
-    char* endptr;
-    strtol(str, &endptr, 10);
-    return *endptr == '\0';
+// Bound on tac_operand_key() of every operand the segment can mention
+static int key_count(CompilerContext* ctx) {
+    int names = ctx->atoms.entry_count > ctx->sema.temp_var_count ? ctx->atoms.entry_count : ctx->sema.temp_var_count;
+    return 2 * names + 2;
 }
 
-// Make sure the read_TAC function is implemented in this file
-int read_TAC(const char* filename, TACInstruction* instructions) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        perror("Could not open file");
-        return -1;
-    }
-
-    int count = 0;
-    char line[100];
-    while (count < MAX_INSTRUCTIONS && fgets(line, sizeof(line), file)) {
-        line[strcspn(line, "\n")] = 0;
-        if (sscanf(line, "%s = %s %s %s", instructions[count].result, instructions[count].arg1, instructions[count].op, instructions[count].arg2) == 4) {
-            instructions[count].is_dead = 0;
-            instructions[count].is_optimized = 0;
-            instructions[count].is_preserved = 0; // Initialize preservation flag
-        } else if (sscanf(line, "%s = %s", instructions[count].result, instructions[count].arg1) == 2) {
-            instructions[count].op[0] = '\0';
-            instructions[count].arg2[0] = '\0';
-            instructions[count].is_dead = 0;
-            instructions[count].is_optimized = 0;
-            instructions[count].is_preserved = 0; // Initialize preservation flag
-        } else if (strncmp(line, "print", 5) == 0) {
-            sscanf(line, "print %s", instructions[count].arg1);
-            strcpy(instructions[count].result, "print");
-            instructions[count].op[0] = '\0';
-            instructions[count].arg2[0] = '\0';
-            instructions[count].is_dead = 0;
-            instructions[count].is_optimized = 0;
-            instructions[count].is_preserved = 0; // Initialize preservation flag
-            
-        } else if (strncmp(line, "ifFalse", 7) == 0) {
-            sscanf(line, "ifFalse %s goto %s", instructions[count].arg1, instructions[count].arg2);
-            strcpy(instructions[count].result, "ifFalse");
-            instructions[count].op[0] = '\0';
-            instructions[count].is_dead = 0;
-            instructions[count].is_optimized = 0;
-            instructions[count].is_preserved = 1;  // Preserve conditional jumps
-            count++;
-        }
-        else if (strncmp(line, "label", 5) == 0) {
-            sscanf(line, "label %s", instructions[count].arg1);
-            strcpy(instructions[count].result, "label");
-            instructions[count].op[0] = '\0';
-            instructions[count].arg2[0] = '\0';
-            instructions[count].is_dead = 0;
-            instructions[count].is_optimized = 0;
-            instructions[count].is_preserved = 1;  // Preserve labels
-            count++;
-        }
-        else if (strncmp(line, "j", 1) == 0) {
-            sscanf(line, "j %s", instructions[count].arg1);
-            strcpy(instructions[count].result, "j");
-            instructions[count].op[0] = '\0';
-            instructions[count].arg2[0] = '\0';
-            instructions[count].is_dead = 0;
-            instructions[count].is_optimized = 0;
-            instructions[count].is_preserved = 1;  // Preserve jumps
-            count++;
-        }
-
-        else {
-            continue;
-        }
-        printf("Read instruction: %s = %s %s %s\n", instructions[count].result, instructions[count].arg1, instructions[count].op, instructions[count].arg2);
-        count++;
+int evaluate_constant_expression(int value1, int value2, TACOpcode opcode) {
+    switch (opcode) {
+        case TAC_ADD: return value1 + value2;
+        case TAC_SUB: return value1 - value2;
+        case TAC_MUL: return value1 * value2;
+        case TAC_DIV: if (value2 != 0) return value1 / value2; break;
+        default: break;
     }
+    return value1; // Default case or invalid operation
+}
 
-    fclose(file);
-    return count;
+// Turn an instruction into result = arg1
+static void make_copy(TACInstruction* instr) {
+    instr->opcode = TAC_COPY;
+    instr->arg2 = tac_none();
+    instr->is_optimized = 1;
 }
 
-int evaluate_constant_expression(int value1, int value2, const char* op) {
-    if (strcmp(op, "+") == 0) return value1 + value2;
-    if (strcmp(op, "-") == 0) return value1 - value2;
-    if (strcmp(op, "*") == 0) return value1 * value2;
-    if (strcmp(op, "/") == 0 && value2 != 0) return value1 / value2;
-    return value1; // Default case or invalid operation
+static int is_constant(TACOperand operand, int value) {
+    return operand.kind == OPERAND_INT && operand.int_value == value;
 }
 
-void constant_folding(TACInstruction* instructions, int* num_instructions) {
-    for (int i = 0; i < *num_instructions; i++) {
-        if (instructions[i].op[0] != '\0') {
-            int arg1_val, arg2_val;
-            if (is_number(instructions[i].arg1) && is_number(instructions[i].arg2)) {
-                // Both operands are constants
-                int result = evaluate_constant_expression(atoi(instructions[i].arg1), atoi(instructions[i].arg2), instructions[i].op);
-                sprintf(instructions[i].arg1, "%d", result);
-                instructions[i].op[0] = '\0';
-                instructions[i].arg2[0] = '\0';
-                instructions[i].is_optimized = 1;
-            }
+void constant_folding(CompilerContext* ctx, TACInstruction* instructions, int num_instructions) {
+    for (int i = 0; i < num_instructions; i++) {
+        TACInstruction* instr = &instructions[i];
+        if (instr->opcode >= TAC_ADD && instr->opcode <= TAC_DIV &&
+            instr->arg1.kind == OPERAND_INT && instr->arg2.kind == OPERAND_INT) {
+            // Both operands are constants
+            int result = evaluate_constant_expression(instr->arg1.int_value, instr->arg2.int_value, instr->opcode);
+            instr->arg1 = tac_int(result);
+            make_copy(instr);
         }
     }
 }
 
 
-void algebraic_simplification(TACInstruction* instructions, int* num_instructions) {
-    for (int i = 0; i < *num_instructions; i++) {
-        if (strcmp(instructions[i].op, "+") == 0 || strcmp(instructions[i].op, "-") == 0) {
-            if (strcmp(instructions[i].arg2, "0") == 0) {
+static void simplify_to_copy(CompilerContext* ctx, TACInstruction* instr) {
+    make_copy(instr);
+    if (TRACE_ON(TRACE_OPT, TRACE_LEVEL_DEBUG)) {
+        char line[256];
+        tac_format(&ctx->atoms, instr, line, sizeof(line));
+        trace_printf("Simplified: %s\n", line);
+    }
+}
+
+void algebraic_simplification(CompilerContext* ctx, TACInstruction* instructions, int num_instructions) {
+    for (int i = 0; i < num_instructions; i++) {
+        TACInstruction* instr = &instructions[i];
+        if (instr->opcode == TAC_ADD || instr->opcode == TAC_SUB) {
+            if (is_constant(instr->arg2, 0)) {
                 // Simplification: x + 0 -> x or x - 0 -> x
-                instructions[i].op[0] = '\0';
-                instructions[i].arg2[0] = '\0';
-                instructions[i].is_optimized = 1;
-                printf("Simplified: %s = %s\n", instructions[i].result, instructions[i].arg1);
+                simplify_to_copy(ctx, instr);
             }
-        } else if (strcmp(instructions[i].op, "*") == 0) {
-            if (strcmp(instructions[i].arg1, "1") == 0) {
+        } else if (instr->opcode == TAC_MUL) {
+            if (is_constant(instr->arg1, 1)) {
                 // Simplification: 1 * x -> x
-                strcpy(instructions[i].arg1, instructions[i].arg2);
-                instructions[i].op[0] = '\0';
-                instructions[i].arg2[0] = '\0';
-                instructions[i].is_optimized = 1;
-                printf("Simplified: %s = %s\n", instructions[i].result, instructions[i].arg1);
-            } else if (strcmp(instructions[i].arg2, "1") == 0) {
+                instr->arg1 = instr->arg2;
+                simplify_to_copy(ctx, instr);
+            } else if (is_constant(instr->arg2, 1)) {
                 // Simplification: x * 1 -> x
-                instructions[i].op[0] = '\0';
-                instructions[i].arg2[0] = '\0';
-                instructions[i].is_optimized = 1;
-                printf("Simplified: %s = %s\n", instructions[i].result, instructions[i].arg1);
+                simplify_to_copy(ctx, instr);
             }
         }
     }
 }
 
-void copy_propagation(TACInstruction* instructions, int* num_instructions) {
-    for (int i = 0; i < *num_instructions; i++) {
+static int is_commutative(TACOpcode opcode) {
+    return opcode == TAC_ADD || opcode == TAC_MUL || opcode == TAC_EQ ||
+           opcode == TAC_NE || opcode == TAC_AND || opcode == TAC_OR;
+}
 
-        // Skip propagation for variables used in conditions
-        if (strncmp(instructions[i].result, "f", 1) == 0) {
-            continue;
-        }
-        
-        if (instructions[i].op[0] == '\0' && !is_number(instructions[i].arg1)) {
-            for (int j = i + 1; j < *num_instructions; j++) {
-                // Don't propagate into conditional statements
-                if (strncmp(instructions[j].result, "f", 1) == 0) {
-                    continue;
-                }
-                
-                if (strcmp(instructions[j].arg1, instructions[i].result) == 0) {
-                    strcpy(instructions[j].arg1, instructions[i].arg1);
-                    instructions[j].is_optimized = 1;
-                }
-                if (strcmp(instructions[j].arg2, instructions[i].result) == 0) {
-                    strcpy(instructions[j].arg2, instructions[i].arg1);
-                    instructions[j].is_optimized = 1;
-                }
-                if (strcmp(instructions[j].result, instructions[i].result) == 0) {
-                    break;
-                }
-            }
-        }
+// An operand as part of an expression key: literals by kind and bits, and
+// anything with an SSA value by the value number of that value. Returns 0
+// for an operand held in memory, which has no number.
+static int key_operand(OptimizerState* opt, TACOperand operand, int value, unsigned char* kind, int* number) {
+    if (operand.kind == OPERAND_INT || operand.kind == OPERAND_FLOAT) {
+        *kind = operand.kind;
+        *number = operand.number;
+        return 1;
+    }
+    if (value == SSA_NO_VALUE) {
+        return 0;
+    }
+    *kind = OPERAND_NONE;
+    *number = opt->value_number[value];
+    return 1;
+}
 
-        if (strchr(instructions[i].result, '[')) {
-            // Handle array assignments like arr[t0] = t1
-            for (int j = i + 1; j < *num_instructions; j++) {
-                if (strcmp(instructions[j].result, "print") == 0 &&
-                    strstr(instructions[j].arg1, instructions[i].result) != NULL) {
-                    // If an array element is being printed, check if it can be optimized
-                    if (is_number(instructions[i].arg2)) {
-                        // Directly replace array access with constant value
-                        strcpy(instructions[j].arg1, instructions[i].arg2);
-                        instructions[j].is_optimized = 1;
-                    } else if (is_number(instructions[i].arg1)) {
-                        // If the array index is constant, propagate the value directly
-                        sprintf(instructions[j].arg1, "%s", instructions[i].arg2);
-                        instructions[j].is_optimized = 1;
-                    }
-                }
-            }
-        } else if (strchr(instructions[i].arg1, '[')) {
-            // Handle array loads (e.g., arr[0]) and propagate known constant values
-            for (int j = i + 1; j < *num_instructions; j++) {
-                if (strcmp(instructions[j].result, instructions[i].arg1) == 0) {
-                    // If the array element value is known (from a previous assignment), replace it
-                    if (is_number(instructions[i].arg2)) {
-                        strcpy(instructions[j].arg1, instructions[i].arg2);
-                        instructions[j].is_optimized = 1;
-                    }
-                }
-            }
-        }
+// Key of the expression an assignment computes, 0 if it has none.
+// Commutative operands are put in a fixed order and a > b is keyed as
+// b < a, so the ways of writing one expression get one key.
+static int expression_key(OptimizerState* opt, TACInstruction* instr, int* values, Expression* key) {
+    memset(key, 0, sizeof(Expression));
+    key->opcode = instr->opcode;
+    key->wraps = instr->wraps;
+    if (!key_operand(opt, instr->arg1, values[1], &key->kind1, &key->number1)) {
+        return 0;
+    }
+    if (instr->opcode == TAC_COPY) {
+        return 1;
+    }
+    if (!key_operand(opt, instr->arg2, values[2], &key->kind2, &key->number2)) {
+        return 0;
+    }
+    int swap = instr->opcode == TAC_GT ||
+               (is_commutative(instr->opcode) &&
+                (key->kind1 > key->kind2 || (key->kind1 == key->kind2 && key->number1 > key->number2)));
+    if (instr->opcode == TAC_GT) {
+        key->opcode = TAC_LT;
+    }
+    if (swap) {
+        unsigned char kind = key->kind1;
+        int number = key->number1;
+        key->kind1 = key->kind2;
+        key->number1 = key->number2;
+        key->kind2 = kind;
+        key->number2 = number;
     }
+    return 1;
 }
 
+static unsigned int hash_expression(Expression* key) {
+    unsigned int hash = key->opcode * 2 + key->wraps;
+    hash = hash * 31 + key->kind1;
+    hash = hash * 0x9e3779b1u + (unsigned int) key->number1;
+    hash = hash * 31 + key->kind2;
+    hash = hash * 0x9e3779b1u + (unsigned int) key->number2;
+    return hash ^ (hash >> 15);
+}
 
-void dead_code_elimination(TACInstruction* instructions, int* num_instructions) {
-    int used_instructions[MAX_INSTRUCTIONS] = {0};
-
-    // Track if an instruction is used later
-    for (int i = 0; i < *num_instructions; i++) {
-        // Mark all instructions used in control flow as used
-        if (strcmp(instructions[i].result, "ifFalse") == 0 ||
-            strcmp(instructions[i].result, "label") == 0 ||
-            strncmp(instructions[i].result, "f", 1) == 0) {
-            used_instructions[i] = 1;
-            
-            // Mark all variables used in conditions as used
-            for (int j = 0; j < i; j++) {
-                if (strcmp(instructions[j].result, instructions[i].arg1) == 0 ||
-                    strcmp(instructions[j].result, instructions[i].arg2) == 0) {
-                    used_instructions[j] = 1;
-                    // Also preserve the original variable assignments
-                    for (int k = 0; k < j; k++) {
-                        if (strcmp(instructions[k].result, instructions[j].arg1) == 0 ||
-                            strcmp(instructions[k].result, instructions[j].arg2) == 0) {
-                            used_instructions[k] = 1;
-                        }
-                    }
-                }
-            }
-        }
-        
-        // Original dependency tracking
-        if (!instructions[i].is_dead && !instructions[i].is_preserved) {
-
-            for (int j = i + 1; j < *num_instructions; j++) {
-                if (strcmp(instructions[j].arg1, instructions[i].result) == 0 ||
-                    strcmp(instructions[j].arg2, instructions[i].result) == 0 ||
-                    (strcmp(instructions[j].result, "print") == 0 &&
-                     strcmp(instructions[j].arg1, instructions[i].result) == 0)) {
-                    used_instructions[i] = 1;
-                    break;
-                }
-            }
+// Newest entry of the expression table holding the key, -1 if none does
+static int find_expression(OptimizerState* opt, Expression* key) {
+    int e = opt->buckets[hash_expression(key) & (opt->bucket_count - 1)];
+    while (e >= 0) {
+        Expression* entry = &opt->expressions[e];
+        if (entry->opcode == key->opcode && entry->wraps == key->wraps && entry->kind1 == key->kind1 && entry->number1 == key->number1 &&
+            entry->kind2 == key->kind2 && entry->number2 == key->number2) {
+            return e;
         }
+        e = entry->next;
     }
+    return -1;
+}
 
-    // Mark instructions as dead
+// Link expressions[e] in at the head of its bucket
+static void link_expression(OptimizerState* opt, int e) {
+    int* bucket = &opt->buckets[hash_expression(&opt->expressions[e]) & (opt->bucket_count - 1)];
+    opt->expressions[e].next = *bucket;
+    *bucket = e;
+}
 
-    for (int i = 0; i < *num_instructions; i++) {
-        if (!used_instructions[i] && !instructions[i].is_preserved) {
-            instructions[i].is_dead = 1;
-            instructions[i].is_optimized = 1;
+// Push an entry for the key, ahead of any older one for the same key.
+// The buckets stay at least as many as the entries.
+static void push_expression(OptimizerState* opt, Expression* key, int leader) {
+    grow_array((void**) &opt->expressions, &opt->expression_capacity, opt->expression_count + 1, sizeof(Expression));
+    opt->expressions[opt->expression_count] = *key;
+    opt->expressions[opt->expression_count].leader = leader;
+    opt->expression_count++;
+    if (opt->expression_count > opt->bucket_count) {
+        int count = 2 * opt->bucket_count;
+        grow_array((void**) &opt->buckets, &opt->bucket_capacity, count, sizeof(int));
+        opt->bucket_count = count;
+        for (int b = 0; b < count; b++) {
+            opt->buckets[b] = -1;
+        }
+        for (int e = 0; e < opt->expression_count; e++) {
+            link_expression(opt, e);
         }
+    } else {
+        link_expression(opt, opt->expression_count - 1);
     }
 }
 
+// Drop the entries pushed since the table held count. The newest entry is
+// always the head of its bucket.
+static void pop_expressions(OptimizerState* opt, int count) {
+    while (opt->expression_count > count) {
+        Expression* entry = &opt->expressions[--opt->expression_count];
+        opt->buckets[hash_expression(entry) & (opt->bucket_count - 1)] = entry->next;
+    }
+}
 
-void write_TAC(const char* filename, TACInstruction* instructions, int num_instructions) {
-    FILE* file = fopen(filename, "w");
-    if (!file) {
-        perror("Could not open file");
-        return;
+static void push_log(OptimizerState* opt, int* log_count, int a, int b) {
+    grow_array((void**) &opt->log, &opt->log_capacity, *log_count + 2, sizeof(int));
+    opt->log[(*log_count)++] = a;
+    opt->log[(*log_count)++] = b;
+}
+
+// Dominator-based value numbering on the SSA form. Every value gets the
+// number of the first value known to hold the same word: a copy gets the
+// number of its source, and an expression found in the table gets the
+// value that computed it first, its leader. The table is scoped to the
+// dominator tree, so an expression is only found redundant where the
+// instruction that computed it dominates, which within a block is local
+// value numbering.
+//
+// A redundant expression becomes a copy of its leader, and any use of a
+// value is rewritten to its leader. Both need the leader to still be the
+// current value of its variable, which keeps the form conventional: no two
+// versions of a variable are live at once. That also makes this copy
+// propagation. Where the leader was reassigned, the later value takes its
+// place in the table. Array elements are loads from memory and get no
+// number.
+void value_numbering(CompilerContext* ctx, CFG* cfg, SSAForm* ssa, TACInstruction* instructions) {
+    OptimizerState* opt = &ctx->opt;
+    grow_array((void**) &opt->value_number, &opt->value_capacity, ssa->value_count, sizeof(int));
+    grow_array((void**) &opt->current, &opt->variable_capacity, ssa->variable_count, sizeof(int));
+    grow_array((void**) &opt->path, &opt->path_capacity, cfg->reachable_count, 3 * sizeof(int));
+    for (int v = 0; v < ssa->value_count; v++) {
+        opt->value_number[v] = v;
+    }
+    for (int v = 0; v < ssa->variable_count; v++) {
+        opt->current[v] = v;    // The value on entry
     }
 
-    for (int i = 0; i < num_instructions; i++) {
-        if (!instructions[i].is_dead) {
-            if (strcmp(instructions[i].result, "print") == 0) {
-                fprintf(file, "print %s\n", instructions[i].arg1);
-            } else if (strcmp(instructions[i].result, "ifFalse") == 0) {
-                fprintf(file, "ifFalse %s goto %s\n", instructions[i].arg1, instructions[i].arg2);
-            } else if (strcmp(instructions[i].result, "label") == 0) {
-                fprintf(file, "label %s\n", instructions[i].arg1);
-            } else if (strcmp(instructions[i].result, "j") == 0) {
-                fprintf(file, "j %s\n", instructions[i].arg1);
-            } else if (instructions[i].op[0] != '\0') {
-                fprintf(file, "%s = %s %s %s\n", instructions[i].result, instructions[i].arg1, instructions[i].op, instructions[i].arg2);
-            } else {
-                fprintf(file, "%s = %s\n", instructions[i].result, instructions[i].arg1);
+    opt->expression_count = 0;
+    if (opt->bucket_count == 0) {
+        opt->bucket_count = 1024;
+        grow_array((void**) &opt->buckets, &opt->bucket_capacity, opt->bucket_count, sizeof(int));
+    }
+    for (int b = 0; b < opt->bucket_count; b++) {
+        opt->buckets[b] = -1;
+    }
+    opt->redundant = 0;
+    opt->redundant_local = 0;
+    opt->operands_replaced = 0;
+
+    // The dominator tree path to the block being visited, each block with
+    // the log position and the table size on entering it. The log holds
+    // the values that assignments replaced.
+    int depth = 0;
+    int log_count = 0;
+    for (int d = 0; d < cfg->reachable_count; d++) {
+        int b = cfg->dom_order[d];
+        BasicBlock* block = &cfg->blocks[b];
+        while (depth > 0 && opt->path[3 * (depth - 1)] != block->idom) {
+            depth--;
+            while (log_count > opt->path[3 * depth + 1]) {
+                log_count -= 2;
+                opt->current[opt->log[log_count]] = opt->log[log_count + 1];
             }
+            pop_expressions(opt, opt->path[3 * depth + 2]);
+        }
+        opt->path[3 * depth] = b;
+        opt->path[3 * depth + 1] = log_count;
+        opt->path[3 * depth + 2] = opt->expression_count;
+        depth++;
+
+        for (int p = ssa->block_phis[b]; p < ssa->block_phis[b + 1]; p++) {
+            Phi* phi = &ssa->phis[p];
+            push_log(opt, &log_count, phi->variable, opt->current[phi->variable]);
+            opt->current[phi->variable] = phi->value;
         }
-    }
-
-    fclose(file);
-}
 
+        for (int i = block->first; i < block->end; i++) {
+            TACInstruction* instr = &instructions[i];
+            int* values = &ssa->values[3 * (i - ssa->start)];
 
-void optimize_TAC(const char* input_filename, const char* output_filename) {
-    TACInstruction instructions[MAX_INSTRUCTIONS];
-    int num_instructions = read_TAC(input_filename, instructions);
-    if (num_instructions == -1) {
-        return;
-    }
+            TACOperand* args[2] = { &instr->arg1, &instr->arg2 };
+            for (int a = 0; a < 2; a++) {
+                int value = values[1 + a];
+                if (value == SSA_NO_VALUE) {
+                    continue;
+                }
+                int leader = opt->value_number[value];
+                int variable = ssa->value_variable[leader];
+                if (leader != value && opt->current[variable] == leader) {
+                    *args[a] = ssa->variables[variable].operand;
+                    values[1 + a] = leader;
+                    instr->is_optimized = 1;
+                    opt->operands_replaced++;
+                }
+            }
 
-    constant_folding(instructions, &num_instructions);
-    algebraic_simplification(instructions, &num_instructions);
-    copy_propagation(instructions, &num_instructions);
+            int value = values[0];
+            if (value == SSA_NO_VALUE) {
+                continue;
+            }
+            Expression key;
+            if (instr->opcode == TAC_COPY && values[1] != SSA_NO_VALUE) {
+                // The source is current here, its leader may not be
+                opt->value_number[value] = values[1];
+            } else if (expression_key(opt, instr, values, &key)) {
+                int e = find_expression(opt, &key);
+                int leader = e < 0 ? SSA_NO_VALUE : opt->expressions[e].leader;
+                int variable = e < 0 ? -1 : ssa->value_variable[leader];
+                if (e >= 0 && instr->opcode == TAC_COPY) {
+                    // A literal is cheaper to copy than its leader
+                    opt->value_number[value] = leader;
+                } else if (e >= 0 && opt->current[variable] == leader) {
+                    instr->opcode = TAC_COPY;
+                    instr->arg1 = ssa->variables[variable].operand;
+                    instr->arg2 = tac_none();
+                    instr->is_optimized = 1;
+                    values[1] = leader;
+                    values[2] = SSA_NO_VALUE;
+                    if (tac_same(instr->result, instr->arg1)) {
+                        instr->is_dead = 1;     // x = x
+                    }
+                    opt->value_number[value] = leader;
+                    opt->redundant++;
+                    opt->redundant_local += ssa->value_def[leader] >= block->first;
+                } else {
+                    push_expression(opt, &key, value);
+                }
+            }
 
-    // Mark print instructions as preserved
-    for (int i = 0; i < num_instructions; i++) {
-        if (strcmp(instructions[i].result, "print") == 0) {
-            instructions[i].is_preserved = 1;
+            int variable = ssa->value_variable[value];
+            push_log(opt, &log_count, variable, opt->current[variable]);
+            opt->current[variable] = value;
         }
     }
+}
 
-        // Mark control flow instructions and their dependencies as preserved
-    for (int i = 0; i < num_instructions; i++) {
-        // Preserve labels
-        if (strncmp(instructions[i].result, "label", 5) == 0) {
-            instructions[i].is_preserved = 1;
-        }
-        // Preserve conditional jumps and their conditions
-        if (strncmp(instructions[i].result, "f", 1) == 0) {
-            instructions[i].is_preserved = 1;
-            // Preserve variables used in condition
-            for (int j = 0; j < i; j++) {
-                if (strcmp(instructions[j].result, instructions[i].arg1) == 0 ||
-                    strcmp(instructions[j].result, instructions[i].arg2) == 0) {
-                    instructions[j].is_preserved = 1;
+
+// Remove assignments to temporaries that are dead: not read on any path
+// before they are assigned again. Each block is scanned backwards from the
+// temporaries live at its end, so the temporaries feeding a removed
+// instruction in the same block go with it. One that fed it from another
+// block may now be dead as well, so liveness is solved again until a round
+// removes no reader of a global temporary. Returns the number of rounds.
+int dead_code_elimination(CompilerContext* ctx, CFG* cfg) {
+    OptimizerState* opt = &ctx->opt;
+    Liveness* live = &ctx->live;
+    TACBuffer* tac = &ctx->tac;
+    int rounds = 0;
+    int again;
+    do {
+        liveness_build(live, cfg, tac, key_count(ctx));
+        rounds++;
+        again = 0;
+        grow_array((void**) &opt->live_now, &opt->live_now_capacity, live->words, sizeof(LiveWord));
+        grow_array((void**) &opt->local_live, &opt->local_live_capacity, live->variable_count, sizeof(int));
+        memset(opt->local_live, 0, live->variable_count * sizeof(int));
+
+        for (int b = 0; b < cfg->block_count; b++) {
+            BasicBlock* block = &cfg->blocks[b];
+            if (live->words > 0) {
+                if (live->complete) {
+                    memcpy(opt->live_now, liveness_out(live, b), live->words * sizeof(LiveWord));
+                } else {
+                    memset(opt->live_now, 0xff, live->words * sizeof(LiveWord));
                 }
             }
-        }
-    }
 
+            // Global temporaries are live while their bit is set, local
+            // ones while local_live holds the block + 1
+            for (int i = block->end - 1; i >= block->first; i--) {
+                TACInstruction* instr = &tac->items[i];
+                if (instr->is_dead) {
+                    continue;
+                }
+                int v = liveness_variable(live, instr->result);
+                if (v >= 0) {
+                    int bit = live->global_index[v];
+                    if (bit >= 0 ? !liveness_test(opt->live_now, bit) : opt->local_live[v] != b + 1) {
+                        instr->is_dead = 1;
+                        instr->is_optimized = 1;
+                        int arg1 = liveness_variable(live, instr->arg1);
+                        int arg2 = liveness_variable(live, instr->arg2);
+                        again |= (arg1 >= 0 && live->global_index[arg1] >= 0) ||
+                                 (arg2 >= 0 && live->global_index[arg2] >= 0);
+                        continue;
+                    }
+                    if (bit >= 0) {
+                        liveness_clear(opt->live_now, bit);
+                    } else {
+                        opt->local_live[v] = 0;
+                    }
+                }
 
-    for (int i = 0; i < num_instructions; i++) {
-        if (strcmp(instructions[i].result, "ifFalse") == 0) {
-            for (int j = 0; j < i; j++) {
-                if (strcmp(instructions[j].result, instructions[i].arg1) == 0) {
-                    instructions[j].is_preserved = 1;
-                    for (int k = 0; k < j; k++) {
-                        if (strcmp(instructions[k].result, instructions[j].arg1) == 0 ||
-                            strcmp(instructions[k].result, instructions[j].arg2) == 0) {
-                            instructions[k].is_preserved = 1;
-                        }
+                TACOperand* args[2] = { &instr->arg1, &instr->arg2 };
+                for (int a = 0; a < 2; a++) {
+                    int u = liveness_variable(live, *args[a]);
+                    if (u < 0) {
+                        continue;
+                    }
+                    if (live->global_index[u] >= 0) {
+                        liveness_set(opt->live_now, live->global_index[u]);
+                    } else {
+                        opt->local_live[u] = b + 1;
                     }
                 }
             }
-            instructions[i].is_preserved = 1;
         }
+    } while (again && live->complete);
+    return rounds;
+}
+
+
+// Optimize ctx->tac from instruction start on, in place. Instructions the
+// passes remove are dropped from the buffer.
+void optimize_TAC_segment(CompilerContext* ctx, int start) {
+    TACBuffer* tac = &ctx->tac;
+    TACInstruction* instructions = &tac->items[start];
+    int num_instructions = tac->count - start;
+
+    constant_folding(ctx, instructions, num_instructions);
+    algebraic_simplification(ctx, instructions, num_instructions);
+
+    // Neither pass above changes control flow, so one graph and one SSA
+    // form serve the passes below
+    cfg_build(&ctx->cfg, tac, start, ctx->sema.temp_var_count);
+    TRACE(TRACE_OPT, TRACE_LEVEL_INFO, "%d blocks, %d edges, %d loops\n",
+          ctx->cfg.block_count, ctx->cfg.edge_count, ctx->cfg.loop_count);
+    clock_t ssa_start = clock();
+    ssa_build(&ctx->ssa, &ctx->cfg, tac, key_count(ctx));
+    TRACE(TRACE_OPT, TRACE_LEVEL_INFO, "SSA form: %d variables, %d values, %d phis in %f seconds\n",
+          ctx->ssa.variable_count, ctx->ssa.value_count, ctx->ssa.phi_count,
+          (double) (clock() - ssa_start) / CLOCKS_PER_SEC);
+    if (TRACE_ON(TRACE_OPT, TRACE_LEVEL_VERBOSE)) {
+        ssa_write(stdout, &ctx->atoms, &ctx->ssa, &ctx->cfg, tac);
+    }
+    value_numbering(ctx, &ctx->cfg, &ctx->ssa, tac->items);
+    TRACE(TRACE_OPT, TRACE_LEVEL_INFO, "Value numbering: %d redundant expressions, %d of them within a block, %d operands replaced\n",
+          ctx->opt.redundant, ctx->opt.redundant_local, ctx->opt.operands_replaced);
+    clock_t sccp_start = clock();
+    sccp_run(&ctx->sccp, &ctx->cfg, &ctx->ssa, tac);
+    TRACE(TRACE_OPT, TRACE_LEVEL_INFO, "Constant propagation: %d folded, %d operands, %d branches and %d unreachable instructions removed in %f seconds\n",
+          ctx->sccp.folded, ctx->sccp.propagated, ctx->sccp.branches_removed, ctx->sccp.unreachable_removed,
+          (double) (clock() - sccp_start) / CLOCKS_PER_SEC);
+    // Operands it made constant may simplify now
+    algebraic_simplification(ctx, instructions, num_instructions);
+    // The passes keep the form conventional, so leaving SSA is forgetting
+    // the values and phis: the TAC still names every variable.
+
+    // Loop-invariant code motion, strength reduction and partial
+    // redundancy elimination move code between blocks, so they work on a
+    // graph without the branches and blocks constant propagation removed.
+    // The copies the last two leave of their temporaries go through value
+    // numbering again, which propagates them.
+    tac_compact(tac, start);
+    cfg_build(&ctx->cfg, tac, start, ctx->sema.temp_var_count);
+    clock_t licm_start = clock();
+    licm_run(&ctx->licm, &ctx->cfg, tac, ctx->sema.loops, ctx->sema.loop_count,
+             key_count(ctx), ctx->sema.temp_var_count);
+    TRACE(TRACE_OPT, TRACE_LEVEL_INFO, "Loop-invariant code motion: %d loops, %d instructions hoisted, %d rounds in %f seconds\n",
+          ctx->licm.loops, ctx->licm.moved, ctx->licm.rounds, (double) (clock() - licm_start) / CLOCKS_PER_SEC);
+    clock_t induction_start = clock();
+    int reduced = induction_run(&ctx->induction, &ctx->cfg, tac, ctx->sema.loops, ctx->sema.loop_count,
+                                key_count(ctx), &ctx->sema.temp_var_count);
+    TRACE(TRACE_OPT, TRACE_LEVEL_INFO, "Induction variables: %d loops, %d basic, %d multiplications reduced to %d temporaries, %d exit tests replaced, %d rounds in %f seconds\n",
+          ctx->induction.loops, ctx->induction.basic, ctx->induction.multiplies, ctx->induction.temporaries,
+          ctx->induction.tests, ctx->induction.rounds,
+          (double) (clock() - induction_start) / CLOCKS_PER_SEC);
+    ctx->sema.loop_count = 0;
+    clock_t pre_start = clock();
+    int moved = pre_run(&ctx->pre, &ctx->cfg, tac, key_count(ctx), &ctx->sema.temp_var_count);
+    TRACE(TRACE_OPT, TRACE_LEVEL_INFO, "Partial redundancy elimination: %d candidates%s, %d inserted, %d deleted, %d edges split, %d passes in %f seconds\n",
+          ctx->pre.candidate_count, ctx->pre.skipped ? " (too many for block sets)" : "",
+          ctx->pre.inserted, ctx->pre.deleted, ctx->pre.split, ctx->pre.iterations,
+          (double) (clock() - pre_start) / CLOCKS_PER_SEC);
+    if (moved || reduced) {
+        cfg_build(&ctx->cfg, tac, start, ctx->sema.temp_var_count);
+        ssa_build(&ctx->ssa, &ctx->cfg, tac, key_count(ctx));
+        value_numbering(ctx, &ctx->cfg, &ctx->ssa, tac->items);
     }
 
-    dead_code_elimination(instructions, &num_instructions);
+    clock_t dce_start = clock();
+    int rounds = dead_code_elimination(ctx, &ctx->cfg);
+    TRACE(TRACE_OPT, TRACE_LEVEL_INFO, "Dead code elimination: %d rounds, %d temporaries, %d global%s, %d blocks solved in %f seconds\n",
+          rounds, ctx->live.variable_count, ctx->live.global_count, ctx->live.complete ? "" : " (too many for block sets)",
+          ctx->live.iterations, (double) (clock() - dce_start) / CLOCKS_PER_SEC);
+    tac_compact(tac, start);
+    TRACE(TRACE_OPT, TRACE_LEVEL_INFO, "Optimized %d instructions, %d removed\n",
+          num_instructions, num_instructions - (tac->count - start));
+
+    if (TRACE_ON(TRACE_OPT, TRACE_LEVEL_DEBUG)) {
+        print_instructions(ctx, &tac->items[start], tac->count - start);
+    }
+}
+
+void optimize_TAC(CompilerContext* ctx) {
+    optimize_TAC_segment(ctx, 0);
+}
 
-    write_TAC(output_filename, instructions, num_instructions);
+void free_optimizer_state(CompilerContext* ctx) {
+    OptimizerState* opt = &ctx->opt;
+    free(opt->value_number);
+    free(opt->expressions);
+    free(opt->buckets);
+    free(opt->current);
+    free(opt->path);
+    free(opt->log);
+    free(opt->live_now);
+    free(opt->local_live);
+    memset(opt, 0, sizeof(OptimizerState));
 }
 
 
-void print_instructions(TACInstruction* instructions, int num_instructions) {
+void print_instructions(CompilerContext* ctx, TACInstruction* instructions, int num_instructions) {
+    char line[256];
     for (int i = 0; i < num_instructions; i++) {
-        if (!instructions[i].is_dead) {
-            if (strcmp(instructions[i].result, "print") == 0) {
-                printf("print %s\n", instructions[i].arg1);
-            } else if (instructions[i].op[0] != '\0') {
-                printf("%s = %s %s %s\n", instructions[i].result, instructions[i].arg1, instructions[i].op, instructions[i].arg2);
-            } else {
-                printf("%s = %s\n", instructions[i].result, instructions[i].arg1);
-            }
-        }
+        tac_format(&ctx->atoms, &instructions[i], line, sizeof(line));
+        printf("%s\n", line);
     }
     printf("\n");
 }
@@ -1,6 +1,59 @@
 #ifndef OPTIMIZER_H
 #define OPTIMIZER_H
 
-void optimize_TAC(const char* tac_input_file, const char* tac_output_file);
+#include "AST.h"
+#include "tac.h"
+#include "ssa.h"
+#include "liveness.h"
+
+// Scratch tables of the optimizer passes. They grow with the program and
+// are kept for the next segment and the next compilation.
+// An expression as value_numbering() keys it: the opcode and each operand
+// as a literal or a value number, see key_operand()
+typedef struct {
+    unsigned char opcode;
+    unsigned char wraps;        // See TACInstruction
+    unsigned char kind1;        // OPERAND_INT or OPERAND_FLOAT, OPERAND_NONE for a value number
+    unsigned char kind2;
+    int number1;
+    int number2;
+    int leader;                 // SSA value that computed it
+    int next;                   // Older entry in the same bucket, -1 for none
+} Expression;
+
+typedef struct {
+    // Indexed by SSA value and variable, see value_numbering()
+    int* value_number;          // First value known to hold the same word
+    int value_capacity;
+    int* current;               // Value of the variable at the point reached
+    int variable_capacity;
+    int* path;                  // Dominator tree path: block, log position and table size
+    int path_capacity;
+    int* log;                   // Undo log of the walk
+    int log_capacity;
+    Expression* expressions;    // A stack, the entries of the blocks on the path
+    int expression_count;
+    int expression_capacity;
+    int* buckets;               // Newest entry per hash, a power of two of them
+    int bucket_count;
+    int bucket_capacity;
+    int redundant;              // Counts of the last run
+    int redundant_local;
+    int operands_replaced;
+
+    // See dead_code_elimination()
+    LiveWord* live_now;         // Global temporaries live at the point reached
+    int live_now_capacity;
+    int* local_live;            // Indexed by liveness variable
+    int local_live_capacity;
+} OptimizerState;
+
+// Optimize ctx->tac in place. Every pass is linear in the number of
+// instructions, or near it, and the instructions they remove are
+// compacted out.
+void optimize_TAC(CompilerContext* ctx);
+void optimize_TAC_segment(CompilerContext* ctx, int start);
+
+void free_optimizer_state(CompilerContext* ctx);
 
 #endif // OPTIMIZER_H
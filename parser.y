@@ -8,51 +8,45 @@
 #include "AST.h"
 #include "optimizer.h"
 #include "code_generator.h"
+#include "trace.h"
+#include "source.h"
+#include "compiler.h"
 #include "parser.tab.h"
 #define LT 300
 #define GT 301
 
 
 
-extern int yylex();
-extern int yyparse();
-extern int yylineno;
-extern FILE* yyin;
+int yylex(YYSTYPE* yylval, void* scanner);
 
-struct symbol_table_entry {
-    char* name;
-    char* type;
-    char* value;
-    int is_array;
-    int array_size;
-    char* scope;
-};
+void compileTopLevel(CompilerContext* ctx, ASTNode* program, ASTNode* stmt);
 
+// Line of the token the lexer returned last
+int currentLine(CompilerContext* ctx) {
+    return source_line(&ctx->source, ctx->token_offset);
+}
 
-ASTNode* root = NULL; // Root of the AST
-char* current_scope = "global"; // Global variable to track the current scope
-
-void yyerror(const char* s) {
-    fprintf(stderr, "Parse error: %s\n", s);
-    exit(1);
+void yyerror(void* scanner, CompilerContext* ctx, const char* s) {
+    fprintf(ctx->diagnostics, "Parse error: %s at line %d\n", s, currentLine(ctx));
+    compiler_fatal(ctx);
 }
 
-void syntaxError(const char *message) {
-    fprintf(stderr, "Syntax error: %s at line %d\n", message, yylineno);
+void syntaxError(CompilerContext* ctx, const char *message) {
+    fprintf(ctx->diagnostics, "Syntax error: %s at line %d\n", message, currentLine(ctx));
 }
 
-void semanticError(const char *message) {
-    fprintf(stderr, "Semantic error: %s at line %d\n", message, yylineno);
+void semanticError(CompilerContext* ctx, const char *message) {
+    fprintf(ctx->diagnostics, "Semantic error: %s at line %d\n", message, currentLine(ctx));
 }
 
-char** extractParamTypes(ASTNode** params, int count) {
-    char** types = malloc(count * sizeof(char*));
+Atom* extractParamTypes(CompilerContext* ctx, ASTNode** params, int count) {
+    Atom* types = malloc(count * sizeof(Atom));
     for (int i = 0; i < count; i++) {
-        if (params[i]->id != NULL) {
-            types[i] = strdup(params[i]->id);
+        if (params[i]->param.paramType != NULL) {
+            types[i] = params[i]->param.paramType->atom;
         } else {
-            fprintf(stderr, "Error: Parameter id is NULL at index %d\n", i);
-            types[i] = NULL; // Handle the NULL case appropriately
+            fprintf(ctx->diagnostics, "Error: Parameter type is NULL at index %d\n", i);
+            types[i] = ATOM_NONE; // Handle the NULL case appropriately
         }
     }
     return types;
@@ -60,25 +54,35 @@ char** extractParamTypes(ASTNode** params, int count) {
 
 %}
 
+%code requires {
+#include "compiler.h"
+}
+
+// The parser and scanner keep no state of their own; everything lives in
+// the CompilerContext
+%define api.pure full
+%parse-param {void* scanner} {CompilerContext* ctx}
+%lex-param {void* scanner}
+
 // Declare the union for storing various types, including ASTNode pointers
 %union {
     int intval;        // For int
     float floatval;    // For float
-    char* strval;      // For identifiers, types, etc.
+    int atom;          // Interned identifiers, types and booleans (an Atom)
     struct ASTNode* node;     // For AST nodes
 }
 
 %token WRITE IF ELSE RETURN WHILE FUNCTION VAR
 %token <intval> INT 
 %token <floatval> FLOAT
-%token <strval> TYPE IDENTIFIER BOOLVAL
+%token <atom> TYPE IDENTIFIER BOOLVAL
 %token <char> SEMICOLON EQ PLUS MINUS MULT DIVIDE
 %token <char> LPAREN RPAREN LBRACKET RBRACKET LBRACE RBRACE COMMA
 %token LT GT EQTO NEQTO AND OR NOT
 
 
 
-%type <node> program statements statement expression declaration assignment write_statement if_statement while_statement return_statement function_declaration variable_declaration parameter_list parameters argument_list
+%type <node> program top_statements statements statement expression declaration assignment write_statement if_statement while_statement return_statement function_declaration variable_declaration parameter_list parameters argument_list
 
 %left OR
 %left AND
@@ -92,26 +96,40 @@ char** extractParamTypes(ASTNode** params, int count) {
 // Grammar rules remain unchanged
 
 program:
-    statements
+    top_statements
     {
-        root = createProgramNode($1); // Assign root to the program node
-        printf("Program parsed successfully!\n");
+        ctx->root = createProgramNode(ctx, $1); // Assign root to the program node
+        TRACE(TRACE_PARSE, TRACE_LEVEL_INFO, "Program parsed successfully!\n");
+    }
+    | error {syntaxError(ctx, "Invalid program structure"); YYABORT; }
+    ;
+
+// The program's own statement list. Every statement is handed to
+// compileTopLevel the moment it is reduced, before the next one is parsed.
+top_statements:
+    top_statements statement
+    {
+        $$ = $1;
+        compileTopLevel(ctx, $$, $2);
+    }
+    | /* empty */
+    {
+        $$ = createStatementsNode(ctx, NULL, 0);
+        ctx->top_level_mark = arena_mark(&ctx->ast_arena);
     }
-    | error {syntaxError("Invalid program structure"); YYABORT; }
     ;
 
 statements:
     statements statement
     {
         $$ = $1;
-        $$->statements.stmts = realloc($$->statements.stmts, ($$->statements.count + 1) * sizeof(ASTNode*));
-        $$->statements.stmts[$$->statements.count++] = $2;
+        nodeListAppend(ctx, &$$->statements, $2);
     }
     | statement
     {
-        $$ = createStatementsNode(&$1, 1);
+        $$ = createStatementsNode(ctx, &$1, 1);
     }
-    | /* empty */ { $$ = createStatementsNode(NULL, 0); }
+    | /* empty */ { $$ = createStatementsNode(ctx, NULL, 0); }
     ;
 
 
@@ -120,153 +138,115 @@ statement:
     declaration
     {
         $$ = $1;
-        printf("Declaration statement parsed.\n");
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Declaration statement parsed.\n");
     }
     | assignment
     {
         $$ = $1;
-        printf("Assignment statement parsed.\n");
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Assignment statement parsed.\n");
     }
     | write_statement
     {
         $$ = $1;
-        printf("Write statement parsed.\n");
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Write statement parsed.\n");
     }
     | if_statement
     {
         $$ = $1;
-        printf("If statement parsed.\n");
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "If statement parsed.\n");
     }
     | while_statement
     {
         $$ = $1;
-        printf("While statement parsed.\n");
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "While statement parsed.\n");
     }
     | return_statement
     {
         $$ = $1;
-        printf("Return statement parsed.\n");
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Return statement parsed.\n");
     }
     | function_declaration
     {
         $$ = $1;
-        printf("Function declaration parsed.\n");
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Function declaration parsed.\n");
     }
     | variable_declaration
     {
         $$ = $1;
-        printf("Variable declaration parsed.\n");
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Variable declaration parsed.\n");
     }
     ;
 
 declaration:
     TYPE IDENTIFIER SEMICOLON
     {
-        $$ = createDeclarationNode(createIdentifierNode($1), createIdentifierNode($2));
-        printf("Declaration of variable '%s' of type '%s'.\n", $2, $1);
-        insert_symbol($2, $1, "null", 0, "null");
-        print_symbol_table();
+        $$ = createDeclarationNode(ctx, createIdentifierNode(ctx, $1), createIdentifierNode(ctx, $2));
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Declaration of variable '%s' of type '%s'.\n", atom_name(&ctx->atoms, $2), atom_name(&ctx->atoms, $1));
     }
     | TYPE LBRACKET INT RBRACKET IDENTIFIER SEMICOLON
     {
-        printf("Array declaration of '%s' with size %d of type '%s'.\n", $5, $3, $1);
-        $$ = createArrayDeclarationNode(createIdentifierNode($5), $1, $3);
-        insert_array_symbol($5, $1, $3, current_scope); // Insert into symbol table
-        print_symbol_table();
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Array declaration of '%s' with size %d of type '%s'.\n", atom_name(&ctx->atoms, $5), $3, atom_name(&ctx->atoms, $1));
+        $$ = createArrayDeclarationNode(ctx, $5, $1, $3);
     }
     ;
 
 variable_declaration:
     VAR IDENTIFIER TYPE SEMICOLON
     {
-        $$ = createVariableDeclarationNode(createIdentifierNode($2), createIdentifierNode($3));
-        printf("Variable declaration: %s of type %s in scope '%s'\n", $2, $3, current_scope);
-        insert_symbol($2, $3, "null", 0, "null"); // Use current_scope
-        print_symbol_table();
-        free($2);
-        free($3);
+        $$ = createVariableDeclarationNode(ctx, createIdentifierNode(ctx, $2), createIdentifierNode(ctx, $3));
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Variable declaration: %s of type %s in scope '%s'\n", atom_name(&ctx->atoms, $2), atom_name(&ctx->atoms, $3), atom_name(&ctx->atoms, ctx->current_scope));
     }
     ;
 
 function_declaration:
-    FUNCTION TYPE IDENTIFIER LPAREN parameter_list RPAREN LBRACE statements RBRACE
+    FUNCTION TYPE IDENTIFIER LPAREN parameter_list RPAREN LBRACE
     {
-        printf("DEBUG: Processing full function declaration for %s\n", $3);
+        ctx->current_scope = $3;
+    }
+    statements RBRACE
+    {
+        ctx->current_scope = ATOM_GLOBAL;
+
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Processing full function declaration for %s\n", atom_name(&ctx->atoms, $3));
 
         // Create the nodes for function declaration
-        printf("DEBUG: Creating function declaration for %s\n", $3);
-        ASTNode* idNode = createIdentifierNode($3);
-        ASTNode* returnTypeNode = createIdentifierNode($2);
-        printf("DEBUG: Created identifier and return type nodes\n");
-        printf("DEBUG: Parameter list node: %p\n", (void*)$5);
-        printf("DEBUG: Statements node: %p\n", (void*)$8);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Creating function declaration for %s\n", atom_name(&ctx->atoms, $3));
+        ASTNode* idNode = createIdentifierNode(ctx, $3);
+        ASTNode* returnTypeNode = createIdentifierNode(ctx, $2);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Created identifier and return type nodes\n");
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Parameter list node: %p\n", (void*)$5);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Statements node: %p\n", (void*)$9);
 
         // Create function declaration node
-        $$ = createFunctionDeclarationNode(idNode, $5, returnTypeNode, $8);
-        printf("DEBUG: createFunctionDeclarationNode returned: %p\n", (void*)$$);
+        $$ = createFunctionDeclarationNode(ctx, idNode, $5, returnTypeNode, $9);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: createFunctionDeclarationNode returned: %p\n", (void*)$$);
          if ($$ == NULL) {
-            yyerror("Failed to create function declaration node");
+            yyerror(scanner, ctx, "Failed to create function declaration node");
             YYABORT;
         }
 
-          printf("DEBUG: Function declaration node created successfully\n");
-        printf("DEBUG: Node type: %d\n", $$->type);
-        printf("DEBUG: Node id: %s\n", $$->id);
-        printf("DEBUG: Node left (parameters): %p\n", (void*)$$->left);
-        printf("DEBUG: Node right (return type): %p\n", (void*)$$->right);
-        printf("DEBUG: Node statements count: %d\n", $$->statements.count);
-        printf("Full function declaration parsed: %s\n", $3);
-
-        // Extract and store parameter types
-        char** paramTypes = extractParamTypes($5->parameters.params, $5->parameters.count);
-        insert_symbol($3, "function", paramTypes, $5->parameters.count, $2);
-        freeParamTypes(paramTypes, $5->parameters.count);
-
-        printf("DEBUG: Function declaration node created successfully\n");
-        printf("Full function declaration parsed: %s\n", $3);
-
-
-        // Add the function declaration to the program's AST
-        printf("DEBUG: About to add function declaration to AST\n");
-        printf("DEBUG: Root node address: %p\n", (void*)root);
-        if (root == NULL) {
-            printf("DEBUG: Creating new program node as root\n");
-            ASTNode* stmtNode = createStatementsNode(&$$, 1);
-            root = createProgramNode(stmtNode);
-            printf("DEBUG: New program node created as root\n");
-        } else {
-            printf("DEBUG: Adding function to existing program node\n");
-            ASTNode* newStatements = createStatementsNode(&$$, 1);
-            root->statements.stmts = realloc(root->statements.stmts, 
-                                             (root->statements.count + 1) * sizeof(ASTNode*));
-            if (root->statements.stmts == NULL) {
-                yyerror("Memory allocation failed when adding function to program");
-                YYABORT;
-            }
-            root->statements.stmts[root->statements.count++] = newStatements->statements.stmts[0];
-            free(newStatements);
-            printf("DEBUG: Function added to existing program node\n");
-        }
-        printf("DEBUG: Function declaration added to AST\n");
+          TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Function declaration node created successfully\n");
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Node type: %d\n", $$->type);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Node id: %s\n", atom_name(&ctx->atoms, $$->atom));
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Node left (parameters): %p\n", (void*)$$->left);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Node right (return type): %p\n", (void*)$$->right);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Node statements count: %d\n", $$->statements.count);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Full function declaration parsed: %s\n", atom_name(&ctx->atoms, $3));
 
+        // Declarations enter the symbol table during name resolution
     }
     | FUNCTION TYPE IDENTIFIER LPAREN parameter_list RPAREN SEMICOLON
     {
-        printf("DEBUG: Processing function prototype for %s\n", $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "DEBUG: Processing function prototype for %s\n", atom_name(&ctx->atoms, $3));
 
         // Create the nodes for function prototype
-        ASTNode* idNode = createIdentifierNode($3);
-        ASTNode* returnTypeNode = createIdentifierNode($2);
+        ASTNode* idNode = createIdentifierNode(ctx, $3);
+        ASTNode* returnTypeNode = createIdentifierNode(ctx, $2);
 
         // Create function prototype node
-        $$ = createFunctionPrototypeNode(idNode, $5, returnTypeNode);
-
-        // Extract and store parameter types
-        char** paramTypes = extractParamTypes($5->parameters.params, $5->parameters.count);
-        insert_symbol($3, "function", paramTypes, $5->parameters.count, $2);
-        freeParamTypes(paramTypes, $5->parameters.count);
+        $$ = createFunctionPrototypeNode(ctx, idNode, $5, returnTypeNode);
 
-        printf("Function prototype parsed: %s\n", $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Function prototype parsed: %s\n", atom_name(&ctx->atoms, $3));
     }
     ;
 
@@ -276,7 +256,7 @@ parameter_list:
     parameters
     | /* empty */
     {
-        $$ = createParametersNode(NULL, 0); // Empty parameter list
+        $$ = createParametersNode(ctx, NULL, 0); // Empty parameter list
     }
     ;
 
@@ -284,19 +264,12 @@ parameters:
     parameters COMMA TYPE IDENTIFIER
     {
         $$ = $1;
-        $$->parameters.params = realloc($$->parameters.params, ($$->parameters.count + 1) * sizeof(ASTNode*));
-        $$->parameters.params[$$->parameters.count++] = createParameterNode(createIdentifierNode($4), createIdentifierNode($3));
-        free($3);
-        free($4);
+        nodeListAppend(ctx, &$$->parameters, createParameterNode(ctx, createIdentifierNode(ctx, $4), createIdentifierNode(ctx, $3)));
     }
     | TYPE IDENTIFIER
     {
-        ASTNode* paramNode = createParameterNode(createIdentifierNode($2), createIdentifierNode($1));
-        ASTNode** params = malloc(sizeof(ASTNode*));
-        params[0] = paramNode;
-        $$ = createParametersNode(params, 1);
-        free($1);
-        free($2);
+        ASTNode* paramNode = createParameterNode(ctx, createIdentifierNode(ctx, $2), createIdentifierNode(ctx, $1));
+        $$ = createParametersNode(ctx, &paramNode, 1);
     }
 
     ;
@@ -306,14 +279,13 @@ parameters:
 assignment:
     IDENTIFIER EQ expression SEMICOLON
     {
-        $$ = createAssignmentNode(createIdentifierNode($1), $3);
-        printf("Assignment to variable '%s' in scope '%s'.\n", $1, current_scope);
-        free($1);
+        $$ = createAssignmentNode(ctx, createIdentifierNode(ctx, $1), $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Assignment to variable '%s' in scope '%s'.\n", atom_name(&ctx->atoms, $1), atom_name(&ctx->atoms, ctx->current_scope));
     }
     | IDENTIFIER LBRACKET expression RBRACKET EQ expression SEMICOLON
     {
-        $$ = createArrayAssignmentNode($1, $3, $6);
-        printf("Array Assignment: %s[%s] = %s.\n", $1, $3, $6);
+        $$ = createArrayAssignmentNode(ctx, $1, $3, $6);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Array Assignment: %s[%p] = %p.\n", atom_name(&ctx->atoms, $1), (void*)$3, (void*)$6);
     }
     ;
 
@@ -321,156 +293,154 @@ assignment:
 write_statement:
     WRITE expression SEMICOLON
     {
-        $$ = createWriteNode($2);
-        printf("Write statement encountered.\n");
+        $$ = createWriteNode(ctx, $2);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Write statement encountered.\n");
     }
     ;
 
 if_statement:
     IF LPAREN expression RPAREN LBRACE statements RBRACE
     {
-        $$ = createIfNode($3, $6, NULL);
-        printf("If statement with no else branch parsed.\n");
+        $$ = createIfNode(ctx, $3, $6, NULL);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "If statement with no else branch parsed.\n");
     }
     | IF LPAREN expression RPAREN LBRACE statements RBRACE ELSE LBRACE statements RBRACE
     {
-        $$ = createIfNode($3, $6, $10);
-        printf("If-else statement parsed.\n");
+        $$ = createIfNode(ctx, $3, $6, $10);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "If-else statement parsed.\n");
     }
     ;
 
 while_statement:
     WHILE LPAREN expression RPAREN LBRACE statements RBRACE
     {
-        $$ = createWhileNode($3, $6);
-        printf("while statements parsed.\n");
+        $$ = createWhileNode(ctx, $3, $6);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "while statements parsed.\n");
     }
 
 return_statement:
     RETURN expression SEMICOLON
     {
-        $$ = createReturnNode($2);
-        printf("Return statement parsed.\n");
+        $$ = createReturnNode(ctx, $2);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Return statement parsed.\n");
     }
     ;
 
 expression:
     INT 
     {
-        $$ = createIntegerNode($1);
-        printf("Integer expression: %d\n", $1);
+        $$ = createIntegerNode(ctx, $1);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Integer expression: %d\n", $1);
     }
     | FLOAT 
     {
-        $$ = createFloatNode($1);
-        printf("Float expression: %f\n", $1);
+        $$ = createFloatNode(ctx, $1);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Float expression: %f\n", $1);
     }
     | expression LT expression
     {
-        $$ = createBinaryOpNode("<", $1, $3);
-        printf("Less than expression parsed.\n");
+        $$ = createBinaryOpNode(ctx, "<", $1, $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Less than expression parsed.\n");
     }
     | expression GT expression
     {
-        $$ = createBinaryOpNode(">", $1, $3);
-        printf("Greater than expression parsed.\n");
+        $$ = createBinaryOpNode(ctx, ">", $1, $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Greater than expression parsed.\n");
     }
     | expression EQTO expression
     {
-        $$ = createBinaryOpNode("==", $1, $3);
-        printf("Equal to expression parsed.\n");
+        $$ = createBinaryOpNode(ctx, "==", $1, $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Equal to expression parsed.\n");
     }
     | expression NEQTO expression
     {
-        $$ = createBinaryOpNode("!=", $1, $3);
-        printf("Not Equal ot expression parsed.\n");
+        $$ = createBinaryOpNode(ctx, "!=", $1, $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Not Equal ot expression parsed.\n");
     }
     | IDENTIFIER
     {
-        $$ = createIdentifierNode($1);
-        printf("Identifier expression: %s\n", $1);
-        free($1);
+        $$ = createIdentifierNode(ctx, $1);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Identifier expression: %s\n", atom_name(&ctx->atoms, $1));
     }
 
     | IDENTIFIER LPAREN argument_list RPAREN
     {
-        $$ = createFunctionCallNode($1, $3);
-        printf("Function call expression: %s\n", $1);
+        $$ = createFunctionCallNode(ctx, $1, $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Function call expression: %s\n", atom_name(&ctx->atoms, $1));
     }
 
     | BOOLVAL
     {
-        $$ = createBooleanNode($1);
-        printf("Boolean expression: %s\n", $1);
-        free($1);
+        $$ = createBooleanNode(ctx, $1);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Boolean expression: %s\n", atom_name(&ctx->atoms, $1));
     }
     | expression PLUS expression
     {
-        $$ = createBinaryOpNode("+", $1, $3);
-        printf("Addition expression parsed.\n");
+        $$ = createBinaryOpNode(ctx, "+", $1, $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Addition expression parsed.\n");
     }
     | expression MINUS expression
     {
-        $$ = createBinaryOpNode("-", $1, $3);
-        printf("Subtraction expression parsed.\n");
+        $$ = createBinaryOpNode(ctx, "-", $1, $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Subtraction expression parsed.\n");
     }
     | expression MULT expression
     {
-        $$ = createBinaryOpNode("*", $1, $3);
-        printf("Multiplication expression parsed.\n");
+        $$ = createBinaryOpNode(ctx, "*", $1, $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Multiplication expression parsed.\n");
     }
     | expression DIVIDE expression
     {
-        $$ = createBinaryOpNode("/", $1, $3);
-        printf("Division expression parsed.\n");
+        $$ = createBinaryOpNode(ctx, "/", $1, $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Division expression parsed.\n");
     }
     | expression AND expression
     {
-        $$ = createBinaryOpNode("AND", $1, $3);
-        printf("Logical AND expression parsed.\n");
+        $$ = createBinaryOpNode(ctx, "AND", $1, $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Logical AND expression parsed.\n");
     }
     | expression OR expression
     {
-        $$ = createBinaryOpNode("OR", $1, $3);
-        printf("Logical OR expression parsed.\n");
+        $$ = createBinaryOpNode(ctx, "OR", $1, $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Logical OR expression parsed.\n");
     }
     | NOT expression
     {
-        $$ = createUnaryOpNode($2);
-        printf("Logical NOT expression parsed.\n");
+        $$ = createUnaryOpNode(ctx, $2);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Logical NOT expression parsed.\n");
     }
     | LPAREN expression RPAREN
     {
         // $$ = $2;
-        printf("Parenthesized expression parsed.\n");
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Parenthesized expression parsed.\n");
     }
     | IDENTIFIER LBRACKET INT RBRACKET
     {
-        $$ = createArrayAccessNode($1, $3);
-        printf("Array access: %s[%s].\n", $1, $3);
+        $$ = createArrayAccessNode(ctx, $1, $3);
+        TRACE(TRACE_PARSE, TRACE_LEVEL_DEBUG, "Array access: %s[%d].\n", atom_name(&ctx->atoms, $1), $3);
     }
     ;
 
     argument_list:
     /* empty */
     {
-        $$ = createArgumentListNode(NULL, 0);
+        $$ = createArgumentListNode(ctx, NULL, 0);
     }
     | expression
     {
-        $$ = createArgumentListNode(&$1, 1);
+        $$ = createArgumentListNode(ctx, &$1, 1);
     }
     | argument_list COMMA expression
     {
-        $$ = appendArgumentNode($1, $3);
+        $$ = appendArgumentNode(ctx, $1, $3);
     }
     ;
 
 %% 
 
-int lookupSymbolValue(char* id) {
-    struct symbol_table_entry* entry = lookup_symbol(id);
-    if (entry != NULL) {
+int lookupSymbolValue(CompilerContext* ctx, ASTNode* id) {
+    Symbol* entry = symbol_at(&ctx->symbols, id->value.symbol);
+    if (entry != NULL && entry->value != NULL) {
         return atoi(entry->value);
     }
     return 0;
@@ -486,9 +456,9 @@ int evaluateExpression(ASTNode* expr) {
             return expr->value.intValue;
             
         case NODE_TYPE_FUNCTION_CALL:
-            if (strcmp(expr->id, "add") == 0) {
-                int arg1 = evaluateExpression(expr->funcCall.arguments->argumentList.args[0]);
-                int arg2 = evaluateExpression(expr->funcCall.arguments->argumentList.args[1]);
+            if (expr->atom == ATOM_ADD) {
+                int arg1 = evaluateExpression(expr->funcCall.arguments->argumentList.items[0]);
+                int arg2 = evaluateExpression(expr->funcCall.arguments->argumentList.items[1]);
                 return arg1 + arg2;
             }
             break;
@@ -498,11 +468,11 @@ int evaluateExpression(ASTNode* expr) {
 
 
 int executeFunctionCall(ASTNode* node) {
-    if (strcmp(node->id, "add") == 0) {
+    if (node->atom == ATOM_ADD) {
         // Get the argument values
         ASTNode* args = node->funcCall.arguments;
-        int arg1 = evaluateExpression(args->argumentList.args[0]);
-        int arg2 = evaluateExpression(args->argumentList.args[1]);
+        int arg1 = evaluateExpression(args->argumentList.items[0]);
+        int arg2 = evaluateExpression(args->argumentList.items[1]);
         return arg1 + arg2;
     }
     return 0;
@@ -510,33 +480,34 @@ int executeFunctionCall(ASTNode* node) {
 
 
 
-void executeStatement(ASTNode* stmt) {
+void executeStatement(CompilerContext* ctx, ASTNode* stmt) {
     if (!stmt) return;
     
     switch(stmt->type) {
         case NODE_TYPE_DECLARATION:
-            printf("Executing declaration\n");
+            // The resolver gave the local its symbol, which holds its value
+            TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "Executing declaration\n");
             break;
             
         case NODE_TYPE_ASSIGNMENT: {
-            printf("Executing assignment\n");
-            if (stmt->left && stmt->left->id) {
+            TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "Executing assignment\n");
+            if (stmt->left && stmt->left->atom != ATOM_NONE) {
                 int value = evaluateExpression(stmt->right);
                 char value_str[32];
                 snprintf(value_str, 32, "%d", value);
                 // Update symbol table with the new value
-                update_symbol_value(stmt->left->id, value_str);
+                update_symbol_value(&ctx->symbols, stmt->left->value.symbol, value_str);
             }
             break;
         }
         
         case NODE_TYPE_WRITE:
-            printf("Executing write statement\n");
-            if (stmt->left && stmt->left->id) {
-                struct symbol_table_entry* entry = lookup_symbol(stmt->left->id);
+            TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "Executing write statement\n");
+            if (stmt->left && stmt->left->type == NODE_TYPE_IDENTIFIER) {
+                Symbol* entry = symbol_at(&ctx->symbols, stmt->left->value.symbol);
                 if (entry && entry->value) {
                     int value = atoi(entry->value);
-                    printf("Output: %d\n", value);
+                    TRACE(TRACE_SEMA, TRACE_LEVEL_INFO, "Output: %d\n", value);
                 }
             }
             break;
@@ -544,80 +515,218 @@ void executeStatement(ASTNode* stmt) {
 }
 
 
-void executeMain(ASTNode* root) {
+int isMainFunction(ASTNode* stmt) {
+    return stmt->type == NODE_TYPE_FUNCTION_DECLARATION && stmt->atom == ATOM_MAIN;
+}
+
+void executeFunction(CompilerContext* ctx, ASTNode* function) {
+    TRACE(TRACE_SEMA, TRACE_LEVEL_INFO, "Executing main function...\n");
+    for (int j = 0; j < function->statements.count; j++) {
+        executeStatement(ctx, function->statements.items[j]);
+    }
+}
+
+void executeMain(CompilerContext* ctx, ASTNode* root) {
     if (!root) return;
     
     for (int i = 0; i < root->statements.count; i++) {
-        ASTNode* stmt = root->statements.stmts[i];
-        if (stmt->type == NODE_TYPE_FUNCTION_DECLARATION && 
-            stmt->id != NULL && 
-            strcmp(stmt->id, "main") == 0) {
-            printf("Executing main function...\n");
-            for (int j = 0; j < stmt->statements.count; j++) {
-                executeStatement(stmt->statements.stmts[j]);
-            }
+        ASTNode* stmt = root->statements.items[i];
+        if (isMainFunction(stmt)) {
+            executeFunction(ctx, stmt);
             return;
         }
     }
-    printf("Error: No main function found\n");
+    fprintf(ctx->diagnostics, "Error: No main function found\n");
 }
 
 
+// Write the graph of the optimized TAC from start on to the --dump-cfg
+// output. The optimizer's own graph is stale once DCE has removed
+// instructions, so it is rebuilt.
+void writeCFG(CompilerContext* ctx, int start, const char* name) {
+    cfg_build(&ctx->cfg, &ctx->tac, start, ctx->sema.temp_var_count);
+    cfg_write_dot(ctx->cfg_file, &ctx->atoms, &ctx->cfg, &ctx->tac, name);
+}
 
-int main(int argc, char** argv) {
 
-    clock_t start_time = clock();
+// Streaming mode. Each statement's AST is dropped once it has been analyzed
+// and its TAC collects in ctx->tac, which is optimized and translated in
+// segments: a segment ends after each function, so statements between
+// functions are still optimized together. Only the pending segment's TAC is
+// kept in memory.
+void flushSegment(CompilerContext* ctx) {
+    int start = ctx->stream.segment_start;
+    if (start < 0) {
+        return;
+    }
 
-    if (argc > 1) {
-        if (!(yyin = fopen(argv[1], "r"))) {
-            perror(argv[1]);
-            return 1;
-        }
+    if (ctx->tac_file != NULL) {
+        tac_write(ctx->tac_file, &ctx->atoms, &ctx->tac, start);
+    }
+    clock_t phase_start = clock();
+    optimize_TAC_segment(ctx, start);
+    ctx->stream.opt_time += clock() - phase_start;
+    if (ctx->optimized_file != NULL) {
+        tac_write(ctx->optimized_file, &ctx->atoms, &ctx->tac, start);
+    }
+    if (ctx->cfg_file != NULL) {
+        char name[32];
+        snprintf(name, sizeof(name), "segment %d", ctx->stream.segment_count);
+        writeCFG(ctx, start, name);
     }
 
-    printf("Starting parser...\n");
-    int parse_result = yyparse();
-    if (parse_result == 0) {
-        printf("Parsing completed successfully.\n");
-    } else {
-        printf("Parsing failed.\n");
-        return 1;
+    phase_start = clock();
+    generateCodeSegment(ctx, start, ctx->asm_file);
+    ctx->stream.codegen_time += clock() - phase_start;
+
+    tac_truncate(&ctx->tac, start);
+    ctx->stream.segment_start = -1;
+    ctx->stream.segment_count++;
+}
+
+void compileTopLevel(CompilerContext* ctx, ASTNode* program, ASTNode* stmt) {
+    if (!ctx->stream_mode) {
+        nodeListAppend(ctx, &program->statements, stmt);
+        return;
+    }
+
+    if (TRACE_ON(TRACE_PARSE, TRACE_LEVEL_DEBUG)) {
+        printAST(ctx, stmt, 1);
+    }
+
+    clock_t phase_start = clock();
+    int symbol_count = ctx->symbols.count;
+    resolveTopLevel(ctx, stmt);
+    int start = analyzeTopLevel(ctx, stmt);
+    if (isMainFunction(stmt)) {
+        executeFunction(ctx, stmt);
+        ctx->stream.found_main = 1;
+    }
+    // Nothing refers to the statement's locals once it has been analyzed
+    release_closed_symbols(&ctx->symbols, symbol_count);
+    ctx->stream.sema_time += clock() - phase_start;
+
+    if (ctx->stream.segment_start < 0) {
+        ctx->stream.segment_start = start;
+    }
+    if (stmt->type == NODE_TYPE_FUNCTION_DECLARATION) {
+        flushSegment(ctx);
     }
 
+    ctx->stream.item_count++;
+    arena_release(&ctx->ast_arena, ctx->top_level_mark);
+}
+
+void beginStreaming(CompilerContext* ctx) {
+    TRACE(TRACE_SEMA, TRACE_LEVEL_INFO, "-------------Starting semantic analysis--------------------------\n");
+    compiler_open_outputs(ctx);
+    beginSemanticAnalysis(ctx);
+    beginCodeGeneration(ctx->asm_file);
+}
+
+void endStreaming(CompilerContext* ctx) {
+    flushSegment(ctx);
+    endSemanticAnalysis(ctx);
+    if (!ctx->stream.found_main) {
+        fprintf(ctx->diagnostics, "Error: No main function found\n");
+    }
+    endCodeGeneration(ctx->asm_file);
+
+    TRACE(TRACE_PARSE, TRACE_LEVEL_INFO, "Streamed %d top-level statements in %d segments.\n",
+          ctx->stream.item_count, ctx->stream.segment_count);
+    TRACE(TRACE_SEMA, TRACE_LEVEL_INFO, "Resolved %d names, %d undeclared.\n", ctx->resolve.resolved, ctx->resolve.unresolved);
+    TRACE(TRACE_SEMA, TRACE_LEVEL_INFO, "Semantic analysis completed in %f seconds.\n", (double) ctx->stream.sema_time / CLOCKS_PER_SEC);
+    TRACE(TRACE_OPT, TRACE_LEVEL_INFO, "TAC optimization completed in %f seconds.\n", (double) ctx->stream.opt_time / CLOCKS_PER_SEC);
+    TRACE(TRACE_CODEGEN, TRACE_LEVEL_INFO, "Code generation completed in %f seconds.\n", (double) ctx->stream.codegen_time / CLOCKS_PER_SEC);
+}
+
+
+
+// Seconds elapsed since start, used for the per-phase timings
+double phaseTime(clock_t start) {
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Batch mode: every phase runs over the whole program
+void compileProgram(CompilerContext* ctx) {
     // Print the AST
-    printf("Abstract Syntax Tree (AST):\n");
-    printAST(root, 0);  // Start printing from the root node with indentation level 0
+    if (TRACE_ON(TRACE_PARSE, TRACE_LEVEL_DEBUG)) {
+        printf("Abstract Syntax Tree (AST):\n");
+        printAST(ctx, ctx->root, 0);  // Start printing from the root node with indentation level 0
+    }
+
+    // Bind every name to its declaration
+    clock_t phase_start = clock();
+    performNameResolution(ctx, ctx->root);
+    TRACE(TRACE_SEMA, TRACE_LEVEL_INFO, "Name resolution completed in %f seconds.\n", phaseTime(phase_start));
 
     // Perform semantic analysis
-    performSemanticAnalysis(root);
+    phase_start = clock();
+    compiler_open_outputs(ctx);
+    performSemanticAnalysis(ctx, ctx->root);
 
     // Execute main function
-    executeMain(root);
+    executeMain(ctx, ctx->root);
+    TRACE(TRACE_SEMA, TRACE_LEVEL_INFO, "Semantic analysis completed in %f seconds.\n", phaseTime(phase_start));
+
+    if (ctx->tac_file != NULL) {
+        tac_write(ctx->tac_file, &ctx->atoms, &ctx->tac, 0);
+    }
 
     // Optimize TAC
-    printf("Optimizing TAC...\n");
-    optimize_TAC("output.tac", "optimized.tac");
-    printf("TAC optimization completed.\n");
+    TRACE(TRACE_OPT, TRACE_LEVEL_INFO, "Optimizing TAC...\n");
+    phase_start = clock();
+    optimize_TAC(ctx);
+    TRACE(TRACE_OPT, TRACE_LEVEL_INFO, "TAC optimization completed in %f seconds.\n", phaseTime(phase_start));
+    if (ctx->optimized_file != NULL) {
+        tac_write(ctx->optimized_file, &ctx->atoms, &ctx->tac, 0);
+    }
+    if (ctx->cfg_file != NULL) {
+        writeCFG(ctx, 0, "program");
+    }
 
     // Generate MIPS code
+    phase_start = clock();
+    generateCode(ctx, ctx->asm_file);
+    TRACE(TRACE_CODEGEN, TRACE_LEVEL_INFO, "Code generation completed in %f seconds.\n", phaseTime(phase_start));
+}
 
-    FILE* output_file = fopen("output.asm", "w");
-    if (output_file == NULL) {
-        fprintf(stderr, "Error opening output file\n");
+// Compile ctx->source into the context's output files and return 0 on
+// success. Errors anywhere in the pipeline come back here through
+// compiler_fatal(), so a bad input only fails its own compilation.
+int compileSource(CompilerContext* ctx) {
+    jmp_buf fatal;
+    lexer_init(ctx);
+    ctx->fatal_jump = &fatal;
+    if (setjmp(fatal) != 0) {
+        ctx->fatal_jump = NULL;
+        compiler_close_outputs(ctx);
+        lexer_free(ctx);
         return 1;
     }
-    generateCode("output.tac", output_file);
-
-    fclose(output_file);
 
-    // Print or traverse the AST here if needed
-    clean_up_symbol_table();
-    freeASTNode(root);
+    if (ctx->stream_mode) {
+        beginStreaming(ctx);
+    }
 
-    clock_t end_time = clock();
-    double time_elapsed = (double) (end_time - start_time) / CLOCKS_PER_SEC;
-    printf("\n\nCompilation time: %f seconds\n", time_elapsed);
+    TRACE(TRACE_PARSE, TRACE_LEVEL_INFO, "Starting parser...\n");
+    clock_t phase_start = clock();
+    if (yyparse(ctx->scanner, ctx) != 0) {
+        fprintf(ctx->diagnostics, "Parsing failed.\n");
+        compiler_fatal(ctx);
+    }
+    TRACE(TRACE_PARSE, TRACE_LEVEL_INFO, "Parsing completed successfully in %f seconds.\n", phaseTime(phase_start));
+    TRACE(TRACE_LEX, TRACE_LEVEL_INFO, "Interned %d distinct names using %zu bytes.\n",
+          atom_count(&ctx->atoms) - 1, intern_memory_used(&ctx->atoms));
 
+    if (ctx->stream_mode) {
+        endStreaming(ctx);
+    } else {
+        compileProgram(ctx);
+    }
 
+    ctx->fatal_jump = NULL;
+    compiler_close_outputs(ctx);
+    lexer_free(ctx);
     return 0;
 }
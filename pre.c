@@ -0,0 +1,709 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pre.h"
+#include "arena.h"
+
+#define OCCURRENCE_UPWARD 1     // First computation in its block, before any operand is assigned
+#define OCCURRENCE_DOWNWARD 2   // Last computation in its block, after every assignment to an operand
+
+// Where the computations inserted on an edge go
+typedef enum {
+    PLACE_END,              // The source has one successor: at its end, before a jump
+    PLACE_START,            // The target has one predecessor: at its start, after its labels
+    PLACE_FALL_THROUGH,     // Right after the ifFalse, where only the fall-through edge runs
+    PLACE_SPLIT             // A new block the ifFalse goes to instead, which jumps on to the target
+} Placement;
+
+static LiveWord* block_set(PartialRedundancy* pre, LiveWord* sets, int block) {
+    return &sets[(size_t) block * pre->words];
+}
+
+static LiveWord* edge_set(PartialRedundancy* pre, int block, int slot) {
+    return &pre->later[(size_t) (2 * block + slot) * pre->words];
+}
+
+static int is_commutative(TACOpcode opcode) {
+    return opcode == TAC_ADD || opcode == TAC_MUL || opcode == TAC_EQ ||
+           opcode == TAC_NE || opcode == TAC_AND || opcode == TAC_OR;
+}
+
+static int operand_less(TACOperand a, TACOperand b) {
+    return a.kind != b.kind ? a.kind < b.kind : a.number < b.number;
+}
+
+// Array elements are left alone, like everything ssa_build() keeps in memory
+static int is_candidate(TACInstruction* instr) {
+    return !instr->is_dead && tac_is_binary(instr) &&
+           instr->arg1.kind != OPERAND_ELEMENT && instr->arg2.kind != OPERAND_ELEMENT;
+}
+
+static PREExpression expression_key(TACInstruction* instr) {
+    PREExpression key;
+    key.opcode = instr->opcode;
+    key.wraps = instr->wraps;
+    key.arg1 = instr->arg1;
+    key.arg2 = instr->arg2;
+    if (key.opcode == TAC_GT || (is_commutative(key.opcode) && operand_less(key.arg2, key.arg1))) {
+        key.opcode = key.opcode == TAC_GT ? TAC_LT : key.opcode;
+        key.arg1 = instr->arg2;
+        key.arg2 = instr->arg1;
+    }
+    key.count = 0;
+    key.id = -1;
+    key.temp = tac_none();
+    return key;
+}
+
+static unsigned int hash_expression(PREExpression* key) {
+    unsigned int hash = key->opcode * 2 + key->wraps;
+    hash = hash * 31 + key->arg1.kind;
+    hash = hash * 0x9e3779b1u + (unsigned int) key->arg1.number;
+    hash = hash * 31 + key->arg2.kind;
+    hash = hash * 0x9e3779b1u + (unsigned int) key->arg2.number;
+    return hash ^ (hash >> 15);
+}
+
+// Number the expressions the reachable blocks compute. The ones computed
+// at least twice get a bit; an expression computed once has no redundancy
+// to remove.
+static void find_expressions(PartialRedundancy* pre, CFG* cfg, TACBuffer* tac) {
+    int start = cfg->blocks[0].first;
+    int count = tac->count - start;
+    int capacity = pre->instruction_capacity;
+    grow_array((void**) &pre->expression_of, &capacity, count, sizeof(int));
+    capacity = pre->instruction_capacity;
+    grow_array((void**) &pre->occurrence, &capacity, count, sizeof(char));
+    pre->instruction_capacity = capacity;
+
+    int binaries = 0;
+    for (int i = start; i < tac->count; i++) {
+        binaries += is_candidate(&tac->items[i]);
+    }
+    int size = 64;
+    while (size < 2 * binaries) {
+        size *= 2;
+    }
+    grow_array((void**) &pre->table, &pre->table_capacity, size, sizeof(int));
+    memset(pre->table, -1, size * sizeof(int));
+
+    pre->expression_count = 0;
+    for (int b = 0; b < cfg->block_count; b++) {
+        int reachable = cfg->blocks[b].rpo >= 0;
+        for (int i = cfg->blocks[b].first; i < cfg->blocks[b].end; i++) {
+            TACInstruction* instr = &tac->items[i];
+            pre->expression_of[i - start] = -1;
+            pre->occurrence[i - start] = 0;
+            if (!reachable || !is_candidate(instr)) {
+                continue;
+            }
+            PREExpression key = expression_key(instr);
+            unsigned int slot = hash_expression(&key) & (size - 1);
+            while (pre->table[slot] >= 0) {
+                PREExpression* e = &pre->expressions[pre->table[slot]];
+                if (e->opcode == key.opcode && e->wraps == key.wraps && e->arg1.kind == key.arg1.kind && e->arg1.number == key.arg1.number &&
+                    e->arg2.kind == key.arg2.kind && e->arg2.number == key.arg2.number) {
+                    break;
+                }
+                slot = (slot + 1) & (size - 1);
+            }
+            if (pre->table[slot] < 0) {
+                grow_array((void**) &pre->expressions, &pre->expression_capacity, pre->expression_count + 1,
+                           sizeof(PREExpression));
+                pre->expressions[pre->expression_count] = key;
+                pre->table[slot] = pre->expression_count++;
+            }
+            pre->expressions[pre->table[slot]].count++;
+            pre->expression_of[i - start] = pre->table[slot];
+        }
+    }
+
+    pre->candidate_count = 0;
+    for (int e = 0; e < pre->expression_count; e++) {
+        if (pre->expressions[e].count < 2) {
+            continue;
+        }
+        capacity = pre->candidate_capacity;
+        grow_array((void**) &pre->candidates, &capacity, pre->candidate_count + 1, sizeof(int));
+        capacity = pre->candidate_capacity;
+        grow_array((void**) &pre->last_computation, &capacity, pre->candidate_count + 1, sizeof(int));
+        pre->candidate_capacity = capacity;
+        pre->expressions[e].id = pre->candidate_count;
+        pre->candidates[pre->candidate_count++] = e;
+    }
+}
+
+// Dense number of an operand some candidate reads, -1 for any other
+static int operand_index(PartialRedundancy* pre, TACOperand operand) {
+    int key = tac_operand_key(operand);
+    if (key < 0 || key >= pre->key_capacity) {
+        return -1;
+    }
+    int o = pre->operand_of_key[key];
+    if (o >= 0 && o < pre->operand_count && pre->operand_keys[o] == key) {
+        return o;
+    }
+    return -1;
+}
+
+// Number the operands of the candidates and list the candidates reading
+// each, which are the ones an assignment to it kills
+static void find_readers(PartialRedundancy* pre, int key_count) {
+    if (key_count > pre->key_capacity) {
+        int old_capacity = pre->key_capacity;
+        grow_array((void**) &pre->operand_of_key, &pre->key_capacity, key_count, sizeof(int));
+        memset(pre->operand_of_key + old_capacity, 0, (pre->key_capacity - old_capacity) * sizeof(int));
+    }
+    pre->operand_count = 0;
+    int reads = 0;
+    for (int c = 0; c < pre->candidate_count; c++) {
+        PREExpression* e = &pre->expressions[pre->candidates[c]];
+        TACOperand args[2] = { e->arg1, e->arg2 };
+        for (int a = 0; a < 2; a++) {
+            int key = tac_operand_key(args[a]);
+            if (key < 0 || (a == 1 && tac_same(args[0], args[1]))) {
+                continue;
+            }
+            reads++;
+            if (operand_index(pre, args[a]) < 0) {
+                grow_array((void**) &pre->operand_keys, &pre->operand_capacity, pre->operand_count + 1, sizeof(int));
+                pre->operand_keys[pre->operand_count] = key;
+                pre->operand_of_key[key] = pre->operand_count++;
+            }
+        }
+    }
+
+    grow_array((void**) &pre->reader_start, &pre->reader_start_capacity, pre->operand_count + 1, sizeof(int));
+    grow_array((void**) &pre->readers, &pre->reader_capacity, reads, sizeof(int));
+    memset(pre->reader_start, 0, (pre->operand_count + 1) * sizeof(int));
+    for (int pass = 0; pass < 2; pass++) {
+        // The first pass counts the readers of each operand, the second
+        // fills the slices in, moving each start to the end of its slice,
+        // which is the start of the next one
+        for (int c = 0; c < pre->candidate_count; c++) {
+            PREExpression* e = &pre->expressions[pre->candidates[c]];
+            TACOperand args[2] = { e->arg1, e->arg2 };
+            for (int a = 0; a < 2; a++) {
+                int o = operand_index(pre, args[a]);
+                if (o < 0 || (a == 1 && tac_same(args[0], args[1]))) {
+                    continue;
+                }
+                if (pass == 0) {
+                    pre->reader_start[o + 1]++;
+                } else {
+                    pre->readers[pre->reader_start[o]++] = c;
+                }
+            }
+        }
+        if (pass == 0) {
+            for (int o = 0; o < pre->operand_count; o++) {
+                pre->reader_start[o + 1] += pre->reader_start[o];
+            }
+        }
+    }
+    for (int o = pre->operand_count; o > 0; o--) {
+        pre->reader_start[o] = pre->reader_start[o - 1];
+    }
+    pre->reader_start[0] = 0;
+}
+
+// The upward, downward and kill sets of every reachable block, and which
+// computations are the upward and downward ones
+static void find_local_sets(PartialRedundancy* pre, CFG* cfg, TACBuffer* tac) {
+    int start = cfg->blocks[0].first;
+    for (int r = 0; r < cfg->reachable_count; r++) {
+        int b = cfg->rpo_order[r];
+        LiveWord* upward = block_set(pre, pre->upward, b);
+        LiveWord* downward = block_set(pre, pre->downward, b);
+        LiveWord* kill = block_set(pre, pre->kill, b);
+        for (int i = cfg->blocks[b].first; i < cfg->blocks[b].end; i++) {
+            TACInstruction* instr = &tac->items[i];
+            int e = pre->expression_of[i - start];
+            if (e >= 0 && pre->expressions[e].id >= 0) {
+                int bit = pre->expressions[e].id;
+                if (!liveness_test(kill, bit) && !liveness_test(upward, bit)) {
+                    liveness_set(upward, bit);
+                    pre->occurrence[i - start] |= OCCURRENCE_UPWARD;
+                }
+                liveness_set(downward, bit);
+                pre->last_computation[bit] = i;
+            }
+            int o = instr->is_dead || !tac_is_assignment(instr) ? -1 : operand_index(pre, instr->result);
+            if (o < 0) {
+                continue;
+            }
+            for (int k = pre->reader_start[o]; k < pre->reader_start[o + 1]; k++) {
+                liveness_set(kill, pre->readers[k]);
+                liveness_clear(downward, pre->readers[k]);
+            }
+        }
+        for (int bit = 0; bit < pre->candidate_count; bit++) {
+            if (downward[bit / 64] == 0) {
+                bit |= 63;
+            } else if (liveness_test(downward, bit)) {
+                pre->occurrence[pre->last_computation[bit] - start] |= OCCURRENCE_DOWNWARD;
+            }
+        }
+    }
+}
+
+// The slot of the edge from pred to block
+static int slot_to(CFG* cfg, int pred, int block) {
+    return cfg->blocks[pred].successors[0] == block ? 0 : 1;
+}
+
+// Store value in set, returning whether that changed it
+static int store(LiveWord* set, LiveWord value, int w) {
+    int changed = set[w] != value;
+    set[w] = value;
+    return changed;
+}
+
+// Availability, anticipability, later and needed, each solved round-robin
+// over the reachable blocks in the order that suits its direction. The
+// entry has an edge from outside the graph, along which nothing is
+// available and everything anticipated at the entry is earliest.
+static void solve(PartialRedundancy* pre, CFG* cfg) {
+    int words = pre->words;
+    size_t size = (size_t) cfg->block_count * words;
+    LiveWord* in = pre->scratch;
+    memset(pre->avail_out, 0xff, size * sizeof(LiveWord));
+    memset(pre->ant_in, 0xff, size * sizeof(LiveWord));
+    memset(pre->later_in, 0xff, size * sizeof(LiveWord));
+    memset(pre->later, 0xff, 2 * size * sizeof(LiveWord));
+    memset(pre->needed_in, 0, size * sizeof(LiveWord));
+    memset(pre->needed_out, 0, size * sizeof(LiveWord));
+    pre->iterations = 0;
+
+    // Available on exit: computed downward, or available on entry and not
+    // killed. Available on entry means available on exit from every
+    // predecessor.
+    int changed;
+    do {
+        changed = 0;
+        pre->iterations++;
+        for (int r = 0; r < cfg->reachable_count; r++) {
+            int b = cfg->rpo_order[r];
+            BasicBlock* block = &cfg->blocks[b];
+            memset(in, b == 0 ? 0 : 0xff, words * sizeof(LiveWord));
+            for (int p = 0; p < block->predecessor_count; p++) {
+                int pred = cfg->predecessors[block->predecessor_start + p];
+                if (cfg->blocks[pred].rpo >= 0) {
+                    LiveWord* out = block_set(pre, pre->avail_out, pred);
+                    for (int w = 0; w < words; w++) {
+                        in[w] &= out[w];
+                    }
+                }
+            }
+            LiveWord* out = block_set(pre, pre->avail_out, b);
+            LiveWord* downward = block_set(pre, pre->downward, b);
+            LiveWord* kill = block_set(pre, pre->kill, b);
+            for (int w = 0; w < words; w++) {
+                changed |= store(out, downward[w] | (in[w] & ~kill[w]), w);
+            }
+        }
+    } while (changed);
+
+    // Anticipated on entry: computed upward, or anticipated on exit and
+    // not killed. Anticipated on exit means anticipated on entry to every
+    // successor, and nothing is at a block without any.
+    do {
+        changed = 0;
+        pre->iterations++;
+        for (int r = cfg->reachable_count - 1; r >= 0; r--) {
+            int b = cfg->rpo_order[r];
+            BasicBlock* block = &cfg->blocks[b];
+            LiveWord* out = block_set(pre, pre->ant_out, b);
+            memset(out, block->successors[0] < 0 && block->successors[1] < 0 ? 0 : 0xff, words * sizeof(LiveWord));
+            for (int s = 0; s < 2; s++) {
+                if (block->successors[s] >= 0) {
+                    LiveWord* succ_in = block_set(pre, pre->ant_in, block->successors[s]);
+                    for (int w = 0; w < words; w++) {
+                        out[w] &= succ_in[w];
+                    }
+                }
+            }
+            LiveWord* ant_in = block_set(pre, pre->ant_in, b);
+            LiveWord* upward = block_set(pre, pre->upward, b);
+            LiveWord* kill = block_set(pre, pre->kill, b);
+            for (int w = 0; w < words; w++) {
+                changed |= store(ant_in, upward[w] | (out[w] & ~kill[w]), w);
+            }
+        }
+    } while (changed);
+
+    // An expression is earliest on an edge when it is anticipated at the
+    // target but not available from the source, and could not have been
+    // computed any earlier than the source's exit. Later on an edge: earliest
+    // there, or later on entry to the source and not computed in it. Later
+    // on entry means later on every edge in.
+    do {
+        changed = 0;
+        pre->iterations++;
+        for (int r = 0; r < cfg->reachable_count; r++) {
+            int b = cfg->rpo_order[r];
+            BasicBlock* block = &cfg->blocks[b];
+            if (b == 0) {
+                memcpy(in, block_set(pre, pre->ant_in, 0), words * sizeof(LiveWord));
+            } else {
+                memset(in, 0xff, words * sizeof(LiveWord));
+            }
+            for (int p = 0; p < block->predecessor_count; p++) {
+                int pred = cfg->predecessors[block->predecessor_start + p];
+                if (cfg->blocks[pred].rpo >= 0) {
+                    LiveWord* later = edge_set(pre, pred, slot_to(cfg, pred, b));
+                    for (int w = 0; w < words; w++) {
+                        in[w] &= later[w];
+                    }
+                }
+            }
+            LiveWord* later_in = block_set(pre, pre->later_in, b);
+            for (int w = 0; w < words; w++) {
+                changed |= store(later_in, in[w], w);
+            }
+
+            LiveWord* avail_out = block_set(pre, pre->avail_out, b);
+            LiveWord* ant_out = block_set(pre, pre->ant_out, b);
+            LiveWord* upward = block_set(pre, pre->upward, b);
+            LiveWord* kill = block_set(pre, pre->kill, b);
+            for (int s = 0; s < 2; s++) {
+                if (block->successors[s] < 0) {
+                    continue;
+                }
+                LiveWord* later = edge_set(pre, b, s);
+                LiveWord* succ_ant_in = block_set(pre, pre->ant_in, block->successors[s]);
+                for (int w = 0; w < words; w++) {
+                    LiveWord earliest = succ_ant_in[w] & ~avail_out[w] & (kill[w] | ~ant_out[w]);
+                    changed |= store(later, earliest | (later_in[w] & ~upward[w]), w);
+                }
+            }
+        }
+    } while (changed);
+
+    // Computations go on the edges where an expression is later but not
+    // later on entry to the target, and the upward computations of a block
+    // it isn't later on entry to are deleted. The temporary is needed on
+    // entry where a deletion reads it before the block computes the
+    // expression or kills it, and on exit where a successor needs it
+    // without an insertion on the edge. Insertions and computations that
+    // nothing needs are left out.
+    do {
+        changed = 0;
+        pre->iterations++;
+        for (int r = cfg->reachable_count - 1; r >= 0; r--) {
+            int b = cfg->rpo_order[r];
+            BasicBlock* block = &cfg->blocks[b];
+            LiveWord* out = block_set(pre, pre->needed_out, b);
+            for (int s = 0; s < 2; s++) {
+                if (block->successors[s] < 0) {
+                    continue;
+                }
+                LiveWord* later = edge_set(pre, b, s);
+                LiveWord* succ_later_in = block_set(pre, pre->later_in, block->successors[s]);
+                LiveWord* succ_needed_in = block_set(pre, pre->needed_in, block->successors[s]);
+                for (int w = 0; w < words; w++) {
+                    changed |= store(out, out[w] | (succ_needed_in[w] & ~(later[w] & ~succ_later_in[w])), w);
+                }
+            }
+            LiveWord* needed_in = block_set(pre, pre->needed_in, b);
+            LiveWord* later_in = block_set(pre, pre->later_in, b);
+            LiveWord* upward = block_set(pre, pre->upward, b);
+            LiveWord* downward = block_set(pre, pre->downward, b);
+            LiveWord* kill = block_set(pre, pre->kill, b);
+            for (int w = 0; w < words; w++) {
+                changed |= store(needed_in, (upward[w] & ~later_in[w]) | (out[w] & ~downward[w] & ~kill[w]), w);
+            }
+        }
+    } while (changed);
+}
+
+// Where the computations inserted on the edge from block to its
+// successor in slot go
+static Placement placement(CFG* cfg, int block, int slot) {
+    int succ = cfg->blocks[block].successors[slot];
+    if (cfg->blocks[block].successors[1] < 0) {
+        return PLACE_END;
+    }
+    // The entry is also entered from outside the graph
+    if (succ != 0 && cfg->blocks[succ].predecessor_count == 1) {
+        return PLACE_START;
+    }
+    return slot == 0 ? PLACE_FALL_THROUGH : PLACE_SPLIT;
+}
+
+// Fill scratch with the expressions inserted on the edge from block to its
+// successor in slot. Returns whether there are any.
+static int insertions(PartialRedundancy* pre, CFG* cfg, int block, int slot) {
+    int succ = cfg->blocks[block].successors[slot];
+    if (succ < 0 || cfg->blocks[block].rpo < 0) {
+        return 0;
+    }
+    LiveWord* later = edge_set(pre, block, slot);
+    LiveWord* later_in = block_set(pre, pre->later_in, succ);
+    LiveWord* needed_in = block_set(pre, pre->needed_in, succ);
+    LiveWord any = 0;
+    for (int w = 0; w < pre->words; w++) {
+        pre->scratch[w] = later[w] & ~later_in[w] & needed_in[w];
+        any |= pre->scratch[w];
+    }
+    return any != 0;
+}
+
+static void emit(PartialRedundancy* pre, TACInstruction instr) {
+    grow_array((void**) &pre->output, &pre->output_capacity, pre->output_count + 1, sizeof(TACInstruction));
+    pre->output[pre->output_count++] = instr;
+}
+
+static void emit_new(PartialRedundancy* pre, TACOpcode opcode, TACOperand result, TACOperand arg1, TACOperand arg2) {
+    TACInstruction instr;
+    instr.opcode = opcode;
+    instr.is_dead = 0;
+    instr.is_optimized = 1;
+    instr.wraps = 0;
+    instr.result = result;
+    instr.arg1 = arg1;
+    instr.arg2 = arg2;
+    emit(pre, instr);
+}
+
+// The temporary of the candidate with bit, made the first time it is needed
+static TACOperand expression_temp(PartialRedundancy* pre, int bit, int* temp_count) {
+    PREExpression* e = &pre->expressions[pre->candidates[bit]];
+    if (e->temp.kind == OPERAND_NONE) {
+        e->temp = tac_operand(OPERAND_TEMP, (*temp_count)++);
+    }
+    return e->temp;
+}
+
+// Emit the computations scratch holds, each into its temporary
+static void emit_insertions(PartialRedundancy* pre, int* temp_count) {
+    for (int bit = 0; bit < pre->candidate_count; bit++) {
+        if (pre->scratch[bit / 64] == 0) {
+            bit |= 63;
+        } else if (liveness_test(pre->scratch, bit)) {
+            PREExpression* e = &pre->expressions[pre->candidates[bit]];
+            emit_new(pre, e->opcode, expression_temp(pre, bit, temp_count), e->arg1, e->arg2);
+            pre->output[pre->output_count - 1].wraps = e->wraps;
+            pre->inserted++;
+        }
+    }
+}
+
+static void emit_edge(PartialRedundancy* pre, CFG* cfg, int block, int slot, int* temp_count) {
+    if (insertions(pre, cfg, block, slot)) {
+        emit_insertions(pre, temp_count);
+    }
+}
+
+// Emit the blocks split off edges that go after anchor: each is the
+// label the ifFalse now goes to, the code of the edge and a jump to the
+// old target, which the last one can leave out when that is next
+static void emit_splits(PartialRedundancy* pre, CFG* cfg, TACBuffer* tac, int anchor, int* temp_count) {
+    for (int edge = pre->split_head[anchor]; edge >= 0; edge = pre->split_next[edge]) {
+        int succ = cfg->blocks[edge / 2].successors[edge % 2];
+        emit_new(pre, TAC_LABEL, tac_none(), pre->split_labels[edge], tac_none());
+        emit_edge(pre, cfg, edge / 2, edge % 2, temp_count);
+        if (pre->split_next[edge] >= 0 || succ != anchor + 1) {
+            emit_new(pre, TAC_JUMP, tac_none(), tac->items[cfg->blocks[succ].first].arg1, tac_none());
+        }
+    }
+}
+
+// Emit block b: its instructions with the deletions made and the
+// computations a successor needs made into the temporaries, and the code
+// of the edges that goes in it
+static void emit_block(PartialRedundancy* pre, CFG* cfg, TACBuffer* tac, int b, int* temp_count) {
+    BasicBlock* block = &cfg->blocks[b];
+    int start = cfg->blocks[0].first;
+    int i = block->first;
+    while (i < block->end && tac->items[i].opcode == TAC_LABEL) {
+        emit(pre, tac->items[i++]);
+    }
+    if (block->rpo < 0) {
+        for (; i < block->end; i++) {
+            emit(pre, tac->items[i]);
+        }
+        return;
+    }
+    if (block->predecessor_count == 1) {
+        int pred = cfg->predecessors[block->predecessor_start];
+        int slot = slot_to(cfg, pred, b);
+        if (placement(cfg, pred, slot) == PLACE_START) {
+            emit_edge(pre, cfg, pred, slot, temp_count);
+        }
+    }
+
+    LiveWord* later_in = block_set(pre, pre->later_in, b);
+    LiveWord* needed_out = block_set(pre, pre->needed_out, b);
+    int end = block->end;
+    TACOpcode last = tac->items[end - 1].opcode;
+    if (end > i && (last == TAC_JUMP || last == TAC_IFFALSE)) {
+        end--;
+    }
+    for (; i < end; i++) {
+        TACInstruction instr = tac->items[i];
+        int e = pre->expression_of[i - start];
+        int bit = e >= 0 ? pre->expressions[e].id : -1;
+        int occurrence = pre->occurrence[i - start];
+        if (bit >= 0 && (occurrence & OCCURRENCE_UPWARD) && !liveness_test(later_in, bit)) {
+            instr.arg1 = expression_temp(pre, bit, temp_count);
+            instr.arg2 = tac_none();
+            instr.opcode = TAC_COPY;
+            instr.is_optimized = 1;
+            pre->deleted++;
+        } else if (bit >= 0 && (occurrence & OCCURRENCE_DOWNWARD) && liveness_test(needed_out, bit)) {
+            TACOperand temp = expression_temp(pre, bit, temp_count);
+            TACInstruction computation = instr;
+            computation.result = temp;
+            computation.is_optimized = 1;
+            emit(pre, computation);
+            instr.arg1 = temp;
+            instr.arg2 = tac_none();
+            instr.opcode = TAC_COPY;
+            instr.is_optimized = 1;
+        }
+        emit(pre, instr);
+    }
+
+    if (block->successors[1] < 0) {
+        emit_edge(pre, cfg, b, 0, temp_count);
+    }
+    if (end < block->end) {
+        TACInstruction terminator = tac->items[end];
+        if (pre->split_labels[2 * b + 1].kind != OPERAND_NONE) {
+            terminator.arg2 = pre->split_labels[2 * b + 1];
+            terminator.is_optimized = 1;
+        }
+        emit(pre, terminator);
+    }
+    if (block->successors[1] >= 0 && placement(cfg, b, 0) == PLACE_FALL_THROUGH) {
+        emit_edge(pre, cfg, b, 0, temp_count);
+    }
+}
+
+int pre_run(PartialRedundancy* pre, CFG* cfg, TACBuffer* tac, int key_count, int* temp_count) {
+    pre->candidate_count = 0;
+    pre->iterations = 0;
+    pre->skipped = 0;
+    pre->inserted = 0;
+    pre->deleted = 0;
+    pre->split = 0;
+    if (cfg->block_count == 0) {
+        return 0;
+    }
+    find_expressions(pre, cfg, tac);
+    if (pre->candidate_count == 0) {
+        return 0;
+    }
+
+    pre->words = (pre->candidate_count + 63) / 64;
+    size_t size = (size_t) cfg->block_count * pre->words;
+    if (size > PRE_MAX_WORDS) {
+        pre->skipped = 1;
+        return 0;
+    }
+    if (size > pre->set_capacity) {
+        LiveWord** sets[] = { &pre->upward, &pre->downward, &pre->kill, &pre->avail_out, &pre->ant_in,
+                              &pre->ant_out, &pre->later_in, &pre->later, &pre->needed_in, &pre->needed_out };
+        for (int s = 0; s < (int) (sizeof(sets) / sizeof(sets[0])); s++) {
+            free(*sets[s]);
+            *sets[s] = malloc((sets[s] == &pre->later ? 2 : 1) * size * sizeof(LiveWord));
+            if (*sets[s] == NULL) {
+                fprintf(stderr, "Memory allocation failed for partial redundancy elimination\n");
+                exit(1);
+            }
+        }
+        pre->set_capacity = size;
+    }
+    grow_array((void**) &pre->scratch, &pre->scratch_capacity, pre->words, sizeof(LiveWord));
+    memset(pre->upward, 0, size * sizeof(LiveWord));
+    memset(pre->downward, 0, size * sizeof(LiveWord));
+    memset(pre->kill, 0, size * sizeof(LiveWord));
+    find_readers(pre, key_count);
+    find_local_sets(pre, cfg, tac);
+    solve(pre, cfg);
+
+    // Give the edges that need it a block of their own. Control must not
+    // fall into one, so it goes after a block ending in a jump: the one
+    // before the target, which it can fall into in turn, else the last
+    // such block, else after the end of the graph, which is jumped over.
+    int count = cfg->block_count;
+    int capacity = pre->edge_capacity;
+    grow_array((void**) &pre->split_labels, &capacity, 2 * count + 1, sizeof(TACOperand));
+    capacity = pre->edge_capacity;
+    grow_array((void**) &pre->split_next, &capacity, 2 * count + 1, sizeof(int));
+    capacity = pre->edge_capacity;
+    grow_array((void**) &pre->split_head, &capacity, 2 * count + 1, sizeof(int));
+    pre->edge_capacity = capacity;
+    int last_jump = count;
+    for (int b = 0; b < count; b++) {
+        pre->split_head[b] = -1;
+        pre->split_labels[2 * b] = tac_none();
+        pre->split_labels[2 * b + 1] = tac_none();
+        if (tac->items[cfg->blocks[b].end - 1].opcode == TAC_JUMP) {
+            last_jump = b;
+        }
+    }
+    pre->split_head[count] = -1;
+    for (int b = 0; b < count; b++) {
+        if (cfg->blocks[b].successors[1] >= 0 && placement(cfg, b, 1) == PLACE_SPLIT && insertions(pre, cfg, b, 1)) {
+            int succ = cfg->blocks[b].successors[1];
+            int anchor = succ > 0 && tac->items[cfg->blocks[succ - 1].end - 1].opcode == TAC_JUMP ? succ - 1 : last_jump;
+            pre->split_labels[2 * b + 1] = tac_operand(OPERAND_LABEL, (*temp_count)++);
+            pre->split_next[2 * b + 1] = pre->split_head[anchor];
+            pre->split_head[anchor] = 2 * b + 1;
+            pre->split++;
+        }
+    }
+
+    pre->output_count = 0;
+    for (int b = 0; b < count; b++) {
+        emit_block(pre, cfg, tac, b, temp_count);
+        emit_splits(pre, cfg, tac, b, temp_count);
+    }
+    if (pre->split_head[count] >= 0) {
+        TACOperand end = tac_operand(OPERAND_LABEL, (*temp_count)++);
+        if (pre->output[pre->output_count - 1].opcode != TAC_JUMP) {
+            emit_new(pre, TAC_JUMP, tac_none(), end, tac_none());
+        }
+        emit_splits(pre, cfg, tac, count, temp_count);
+        emit_new(pre, TAC_LABEL, tac_none(), end, tac_none());
+    }
+    if (pre->inserted == 0 && pre->deleted == 0) {
+        return 0;
+    }
+    tac_truncate(tac, cfg->blocks[0].first);
+    for (int i = 0; i < pre->output_count; i++) {
+        *tac_append(tac, TAC_COPY, tac_none(), tac_none(), tac_none()) = pre->output[i];
+    }
+    return 1;
+}
+
+void pre_free(PartialRedundancy* pre) {
+    free(pre->expressions);
+    free(pre->table);
+    free(pre->candidates);
+    free(pre->last_computation);
+    free(pre->expression_of);
+    free(pre->occurrence);
+    free(pre->operand_of_key);
+    free(pre->operand_keys);
+    free(pre->reader_start);
+    free(pre->readers);
+    free(pre->upward);
+    free(pre->downward);
+    free(pre->kill);
+    free(pre->avail_out);
+    free(pre->ant_in);
+    free(pre->ant_out);
+    free(pre->later_in);
+    free(pre->later);
+    free(pre->needed_in);
+    free(pre->needed_out);
+    free(pre->scratch);
+    free(pre->split_labels);
+    free(pre->split_next);
+    free(pre->split_head);
+    free(pre->output);
+    memset(pre, 0, sizeof(PartialRedundancy));
+}
@@ -0,0 +1,101 @@
+#ifndef PRE_H
+#define PRE_H
+
+#include "cfg.h"
+#include "liveness.h"
+
+// Sets larger than this many words each are not built and pre_run()
+// leaves the code alone
+#define PRE_MAX_WORDS (1 << 18)
+
+// A binary expression as partial redundancy elimination sees it: by opcode
+// and operands, with commutative operands in a fixed order and a > b
+// written b < a
+typedef struct {
+    unsigned char opcode;
+    unsigned char wraps;    // See TACInstruction
+    TACOperand arg1;
+    TACOperand arg2;
+    int count;              // Computations of it in reachable blocks
+    int id;                 // Bit in the sets, -1 for an expression computed only once
+    TACOperand temp;        // Carries it between blocks, OPERAND_NONE until one is needed
+} PREExpression;
+
+// Lazy code motion (Knoop, Ruething and Steffen) over the blocks of a CFG.
+// Availability and anticipability give the earliest edges a computation
+// can move up to; "later" then pushes it down as far as it goes without
+// adding a computation to any path. The expression is computed on the edges
+// where it stops, into a new temporary, and the computations made
+// redundant copy that temporary instead. Expressions are lexical: the
+// analysis is over the TAC, not the SSA form, and assigning an operand
+// kills every expression that reads it.
+typedef struct {
+    PREExpression* expressions;
+    int expression_count;
+    int expression_capacity;
+    int* table;             // Open addressing over expressions, -1 for empty
+    int table_capacity;
+    int* candidates;        // Bit -> expression
+    int* last_computation;  // Bit -> instruction, scratch while scanning a block
+    int candidate_count;
+    int candidate_capacity;
+    int* expression_of;     // From the graph's first instruction on, -1 for none
+    char* occurrence;       // Same index, OCCURRENCE_UPWARD and OCCURRENCE_DOWNWARD
+    int instruction_capacity;
+
+    // The operands candidates read, densely numbered, and the candidates
+    // reading each one
+    int* operand_of_key;    // tac_operand_key() -> operand, checked against operand_keys[]
+    int key_capacity;
+    int* operand_keys;
+    int operand_count;
+    int operand_capacity;
+    int* reader_start;      // Readers of operand o are [reader_start[o], reader_start[o + 1])
+    int reader_start_capacity;
+    int* readers;
+    int reader_capacity;
+
+    // Sets of words each, per block, except later, which is per block and
+    // successor slot
+    int words;
+    LiveWord* upward;       // Computed before any operand is assigned
+    LiveWord* downward;     // Computed after the last assignment to an operand
+    LiveWord* kill;         // An operand is assigned
+    LiveWord* avail_out;
+    LiveWord* ant_in;
+    LiveWord* ant_out;
+    LiveWord* later_in;
+    LiveWord* later;
+    LiveWord* needed_in;    // The temporary must hold the expression on entry
+    LiveWord* needed_out;
+    size_t set_capacity;    // In words, of each per-block set
+    LiveWord* scratch;      // One set
+    int scratch_capacity;
+    int iterations;         // Passes over the blocks, all four problems together
+
+    // Edges that get a block of their own, as 2 * block + slot
+    TACOperand* split_labels;
+    int* split_next;        // Next edge split off after the same block, -1 at the end
+    int* split_head;        // By block: first edge split off after it, -1 for none; the last for after the graph
+    int edge_capacity;
+
+    TACInstruction* output;
+    int output_count;
+    int output_capacity;
+
+    // What pre_run() did
+    int skipped;            // Set when the sets would have been too large
+    int inserted;           // Computations placed on edges
+    int deleted;            // Computations replaced by a copy of the temporary
+    int split;
+} PartialRedundancy;
+
+// Move the computations of the instructions cfg was built from to their
+// latest safe points and remove the ones that become redundant. key_count
+// bounds tac_operand_key() of their operands; new temporaries and labels
+// are numbered from *temp_count on. Returns nonzero when the instructions
+// changed, which leaves the graph stale.
+int pre_run(PartialRedundancy* pre, CFG* cfg, TACBuffer* tac, int key_count, int* temp_count);
+void pre_free(PartialRedundancy* pre);
+
+#endif // PRE_H
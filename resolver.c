@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "compiler.h"
+#include "trace.h"
+
+// Name resolution. One walk over the tree enters every declaration into the
+// symbol table, in source order and with a scope per function body, and
+// stores the index of the symbol each name refers to in the node. The
+// semantic analyzer and the interpreter only follow those indices.
+
+static void resolveNode(CompilerContext* ctx, ASTNode* node);
+
+// Bind a use of a name to the innermost declaration visible here
+static void resolveUse(CompilerContext* ctx, ASTNode* node) {
+    node->value.symbol = find_symbol(&ctx->symbols, node->atom);
+    if (node->value.symbol >= 0) {
+        ctx->resolve.resolved++;
+    } else {
+        ctx->resolve.unresolved++;
+        TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: '%s' is not declared\n", atom_name(&ctx->atoms, node->atom));
+    }
+}
+
+// Declare the variable named by the identifier node id in the current scope
+// and bind id to it. A redeclaration is reported and binds to the earlier one.
+static void declareVariable(CompilerContext* ctx, ASTNode* id, Atom type) {
+    insert_symbol(&ctx->symbols, id->atom, type, NULL, 0, ATOM_NONE);
+    id->value.symbol = find_symbol(&ctx->symbols, id->atom);
+    TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: Declared '%s' of type '%s' in scope '%s'\n",
+          atom_name(&ctx->atoms, id->atom), atom_name(&ctx->atoms, type), atom_name(&ctx->atoms, scope_name(&ctx->symbols)));
+}
+
+static void declareFunction(CompilerContext* ctx, Atom name, ASTNode* parameters, Atom returnType) {
+    Atom* paramTypes = extractParamTypes(ctx, parameters->parameters.items, parameters->parameters.count);
+    insert_symbol(&ctx->symbols, name, ATOM_FUNCTION, paramTypes, parameters->parameters.count, returnType);
+    freeParamTypes(paramTypes, parameters->parameters.count);
+}
+
+static void resolveFunctionDeclaration(CompilerContext* ctx, ASTNode* node) {
+    if (node->left == NULL || node->right == NULL) {
+        return;  // Reported by the semantic analyzer
+    }
+
+    // A prototype seen earlier has already entered the function, the
+    // definition only marks it as defined
+    Symbol* existing = lookup_symbol(&ctx->symbols, node->atom);
+    if (existing == NULL || existing->type != ATOM_FUNCTION || existing->is_initialized) {
+        declareFunction(ctx, node->atom, node->left, node->right->atom);
+    }
+    node->value.symbol = find_symbol(&ctx->symbols, node->atom);
+    symbol_at(&ctx->symbols, node->value.symbol)->is_initialized = 1;
+
+    // Parameters and locals are only visible in the body. The caller's
+    // arguments initialize the parameters.
+    push_scope(&ctx->symbols, node->atom);
+    for (int i = 0; i < node->left->parameters.count; i++) {
+        ASTNode* param = node->left->parameters.items[i];
+        if (param != NULL && param->param.identifier != NULL && param->param.paramType != NULL) {
+            declareVariable(ctx, param->param.identifier, param->param.paramType->atom);
+            Symbol* symbol = symbol_at(&ctx->symbols, param->param.identifier->value.symbol);
+            if (symbol != NULL) {
+                symbol->is_initialized = 1;
+            }
+        }
+    }
+    for (int i = 0; i < node->statements.count; i++) {
+        resolveNode(ctx, node->statements.items[i]);
+    }
+    pop_scope(&ctx->symbols);
+}
+
+static void resolveNode(CompilerContext* ctx, ASTNode* node) {
+    if (node == NULL) {
+        return;
+    }
+
+    switch (node->type) {
+        case NODE_TYPE_PROGRAM:
+        case NODE_TYPE_STATEMENT:
+            for (int i = 0; i < node->statements.count; i++) {
+                resolveNode(ctx, node->statements.items[i]);
+            }
+            break;
+        case NODE_TYPE_DECLARATION:
+            declareVariable(ctx, node->right, node->left->atom);
+            break;
+        case NODE_TYPE_VARIABLE_DECLARATION:
+            declareVariable(ctx, node->varDecl.identifier, node->varDecl.varType->atom);
+            break;
+        case NODE_TYPE_ARRAY_DECLARATION:
+            insert_array_symbol(&ctx->symbols, node->atom, node->varDecl.varType->atom, node->varDecl.arraySize, scope_name(&ctx->symbols));
+            break;
+        case NODE_TYPE_FUNCTION_PROTOTYPE:
+            declareFunction(ctx, node->funcProto.identifier->atom, node->funcProto.parameters, node->funcProto.returnType->atom);
+            node->funcProto.identifier->value.symbol = find_symbol(&ctx->symbols, node->funcProto.identifier->atom);
+            break;
+        case NODE_TYPE_FUNCTION_DECLARATION:
+            resolveFunctionDeclaration(ctx, node);
+            break;
+        case NODE_TYPE_IDENTIFIER:
+            resolveUse(ctx, node);
+            break;
+        case NODE_TYPE_FUNCTION_CALL:
+            resolveUse(ctx, node);
+            resolveNode(ctx, node->funcCall.arguments);
+            break;
+        case NODE_TYPE_ARGUMENT_LIST:
+            for (int i = 0; i < node->argumentList.count; i++) {
+                resolveNode(ctx, node->argumentList.items[i]);
+            }
+            break;
+        case NODE_TYPE_ASSIGNMENT:
+        case NODE_TYPE_BINARY_OP:
+        case NODE_TYPE_WHILE:
+            resolveNode(ctx, node->left);
+            resolveNode(ctx, node->right);
+            break;
+        case NODE_TYPE_IF:
+            resolveNode(ctx, node->left);
+            resolveNode(ctx, node->right);
+            resolveNode(ctx, node->elseNode);
+            break;
+        case NODE_TYPE_WRITE:
+        case NODE_TYPE_RETURN:
+        case NODE_TYPE_UNARY_OP:
+            resolveNode(ctx, node->left);
+            break;
+        case NODE_TYPE_ARRAY_ASSIGNMENT:
+            resolveNode(ctx, node->assignedValue);
+            break;
+        default:
+            // Literals, and array accesses whose index is a constant
+            break;
+    }
+}
+
+void resolveTopLevel(CompilerContext* ctx, ASTNode* node) {
+    resolveNode(ctx, node);
+}
+
+void performNameResolution(CompilerContext* ctx, ASTNode* root) {
+    resolveNode(ctx, root);
+
+    TRACE(TRACE_SEMA, TRACE_LEVEL_INFO, "Resolved %d names, %d undeclared.\n", ctx->resolve.resolved, ctx->resolve.unresolved);
+    if (TRACE_ON(TRACE_SEMA, TRACE_LEVEL_VERBOSE)) print_symbol_table(&ctx->symbols);
+}
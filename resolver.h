@@ -0,0 +1,20 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "AST.h"
+
+// Per-compilation counts kept by the name resolver
+typedef struct {
+    int resolved;       // Uses bound to a symbol
+    int unresolved;     // Uses of names that were never declared
+} ResolveState;
+
+// Enter every declaration of the tree into the symbol table and bind each
+// identifier, call and function node to its symbol through value.symbol.
+// Later phases use that index instead of looking the name up again.
+void performNameResolution(CompilerContext* ctx, ASTNode* root);
+
+// Streaming mode: resolve one top-level statement
+void resolveTopLevel(CompilerContext* ctx, ASTNode* node);
+
+#endif // RESOLVER_H
@@ -0,0 +1,480 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "sccp.h"
+#include "arena.h"
+
+static LatticeValue lattice_value(LatticeState state, int word, int is_float) {
+    LatticeValue value;
+    value.state = state;
+    value.is_float = is_float;
+    value.word = word;
+    return value;
+}
+
+static int float_bits(float value) {
+    int word;
+    memcpy(&word, &value, sizeof(word));
+    return word;
+}
+
+static float bits_float(int word) {
+    float value;
+    memcpy(&value, &word, sizeof(value));
+    return value;
+}
+
+// The code generator writes float literals with %f, so the float the
+// program really holds is the one that text reads back as
+static float assembled_float(float value) {
+    char text[64];
+    snprintf(text, sizeof(text), "%f", value);
+    return strtof(text, NULL);
+}
+
+// True when a float survives being written as a literal
+static int is_exact_literal(float value) {
+    char text[64];
+    snprintf(text, sizeof(text), "%f", value);
+    return value - value == 0 &&
+           float_bits(strtof(text, NULL)) == float_bits(value) &&
+           float_bits((float) strtod(text, NULL)) == float_bits(value);
+}
+
+// The state of an operand: literals are constants, a variable or temporary
+// has the state of its value, and an operand without one is in memory
+static LatticeValue operand_state(ConstantPropagation* sccp, TACOperand operand, int value) {
+    if (operand.kind == OPERAND_INT) {
+        return lattice_value(LATTICE_CONSTANT, operand.int_value, 0);
+    }
+    if (operand.kind == OPERAND_FLOAT) {
+        return lattice_value(LATTICE_CONSTANT, float_bits(assembled_float(operand.float_value)), 1);
+    }
+    if (value == SSA_NO_VALUE) {
+        return lattice_value(LATTICE_VARYING, 0, 0);
+    }
+    return sccp->lattice[value];
+}
+
+static LatticeValue meet(LatticeValue a, LatticeValue b) {
+    if (a.state == LATTICE_UNDEFINED) {
+        return b;
+    }
+    if (b.state == LATTICE_UNDEFINED) {
+        return a;
+    }
+    if (a.state == LATTICE_CONSTANT && b.state == LATTICE_CONSTANT &&
+        a.word == b.word && a.is_float == b.is_float) {
+        return a;
+    }
+    return lattice_value(LATTICE_VARYING, 0, 0);
+}
+
+// Compute a binary operation on two constants the way the generated code
+// does: in floats when either operand is a float literal, on the words
+// otherwise. Whatever the code generator rejects or the target may trap
+// on stays varying: add and sub that overflow and do not wrap, == and !=
+// whose sub overflows, and division by zero or of INT_MIN by -1.
+static LatticeValue fold(TACInstruction* instr, LatticeValue a, LatticeValue b) {
+    LatticeValue varying = lattice_value(LATTICE_VARYING, 0, 0);
+    if (instr->arg1.kind == OPERAND_FLOAT || instr->arg2.kind == OPERAND_FLOAT) {
+        if (instr->opcode > TAC_DIV || instr->arg1.kind == OPERAND_INT || instr->arg2.kind == OPERAND_INT) {
+            return varying;
+        }
+        float x = bits_float(a.word);
+        float y = bits_float(b.word);
+        float result;
+        switch (instr->opcode) {
+            case TAC_ADD: result = x + y; break;
+            case TAC_SUB: result = x - y; break;
+            case TAC_MUL: result = x * y; break;
+            default:
+                if (y == 0) {
+                    return varying;
+                }
+                result = x / y;
+                break;
+        }
+        return lattice_value(LATTICE_CONSTANT, float_bits(result), 1);
+    }
+
+    // mul and the instructions marked wraps wrap around
+    unsigned int x = a.word;
+    unsigned int y = b.word;
+    long long sum = (long long) a.word + b.word;
+    long long difference = (long long) a.word - b.word;
+    int result;
+    switch (instr->opcode) {
+        case TAC_ADD:
+            if (!instr->wraps && sum != (int) (x + y)) {
+                return varying;
+            }
+            result = (int) (x + y);
+            break;
+        case TAC_SUB:
+            if (!instr->wraps && difference != (int) (x - y)) {
+                return varying;
+            }
+            result = (int) (x - y);
+            break;
+        case TAC_MUL: result = (int) (x * y); break;
+        case TAC_DIV:
+            if (b.word == 0 || (a.word == INT_MIN && b.word == -1)) {
+                return varying;
+            }
+            result = a.word / b.word;
+            break;
+        case TAC_LT: result = a.word < b.word; break;
+        case TAC_GT: result = a.word > b.word; break;
+        case TAC_EQ:
+        case TAC_NE:
+            if (difference != (int) (x - y)) {
+                return varying;
+            }
+            result = (a.word == b.word) == (instr->opcode == TAC_EQ);
+            break;
+        default: return varying;
+    }
+    return lattice_value(LATTICE_CONSTANT, result, 0);
+}
+
+static LatticeValue evaluate(ConstantPropagation* sccp, TACInstruction* instr, int* values) {
+    LatticeValue a = operand_state(sccp, instr->arg1, values[1]);
+    if (instr->opcode == TAC_COPY) {
+        return a;
+    }
+    if (instr->opcode > TAC_NE) {
+        return lattice_value(LATTICE_VARYING, 0, 0);
+    }
+    LatticeValue b = operand_state(sccp, instr->arg2, values[2]);
+    if (a.state == LATTICE_VARYING || b.state == LATTICE_VARYING) {
+        return lattice_value(LATTICE_VARYING, 0, 0);
+    }
+    if (a.state == LATTICE_UNDEFINED || b.state == LATTICE_UNDEFINED) {
+        return lattice_value(LATTICE_UNDEFINED, 0, 0);
+    }
+    return fold(instr, a, b);
+}
+
+// Lower value to its meet with state, queueing its uses if that changed it
+static void lower(ConstantPropagation* sccp, int value, LatticeValue state) {
+    LatticeValue old = sccp->lattice[value];
+    LatticeValue new_state = meet(old, state);
+    if (new_state.state == old.state && new_state.word == old.word && new_state.is_float == old.is_float) {
+        return;
+    }
+    sccp->lattice[value] = new_state;
+    sccp->value_work[sccp->value_work_count++] = value;
+}
+
+static void mark_edge(ConstantPropagation* sccp, CFG* cfg, int block, int target) {
+    BasicBlock* from = &cfg->blocks[block];
+    int slot = from->successors[0] == target ? 0 : 1;
+    if (target < 0 || from->successors[slot] != target || sccp->executable[2 * block + slot]) {
+        return;
+    }
+    sccp->executable[2 * block + slot] = 1;
+    sccp->edge_work[sccp->edge_work_count++] = 2 * block + slot;
+}
+
+// Make the edges out of a block executable that its last instruction can
+// take with what is known so far
+static void visit_branch(ConstantPropagation* sccp, CFG* cfg, SSAForm* ssa, TACBuffer* tac, int block) {
+    BasicBlock* b = &cfg->blocks[block];
+    TACInstruction* last = &tac->items[b->end - 1];
+    if (last->opcode != TAC_IFFALSE) {
+        mark_edge(sccp, cfg, block, b->successors[0]);
+        mark_edge(sccp, cfg, block, b->successors[1]);
+        return;
+    }
+    LatticeValue condition = operand_state(sccp, last->arg1, ssa_value(ssa, b->end - 1, 1));
+    int next = block + 1 < cfg->block_count ? block + 1 : -1;
+    if (condition.state == LATTICE_VARYING || (condition.state == LATTICE_CONSTANT && condition.word == 0)) {
+        mark_edge(sccp, cfg, block, cfg_label_block(cfg, tac, last->arg2));
+    }
+    if (condition.state == LATTICE_VARYING || (condition.state == LATTICE_CONSTANT && condition.word != 0)) {
+        mark_edge(sccp, cfg, block, next);
+    }
+}
+
+static void visit_instruction(ConstantPropagation* sccp, CFG* cfg, SSAForm* ssa, TACBuffer* tac, int block, int i) {
+    int* values = &ssa->values[3 * (i - ssa->start)];
+    if (values[0] != SSA_NO_VALUE) {
+        lower(sccp, values[0], evaluate(sccp, &tac->items[i], values));
+    }
+    if (i == cfg->blocks[block].end - 1) {
+        visit_branch(sccp, cfg, ssa, tac, block);
+    }
+}
+
+// A phi meets the values coming in over the executable edges only
+static void visit_phi(ConstantPropagation* sccp, CFG* cfg, SSAForm* ssa, int p) {
+    Phi* phi = &ssa->phis[p];
+    BasicBlock* block = &cfg->blocks[phi->block];
+    LatticeValue state = lattice_value(LATTICE_UNDEFINED, 0, 0);
+    for (int k = 0; k < block->predecessor_count; k++) {
+        int pred = cfg->predecessors[block->predecessor_start + k];
+        int slot = cfg->blocks[pred].successors[0] == phi->block ? 0 : 1;
+        if (sccp->executable[2 * pred + slot]) {
+            state = meet(state, sccp->lattice[ssa->phi_args[phi->arg_start + k]]);
+        }
+    }
+    lower(sccp, phi->value, state);
+}
+
+// Index the uses of every value, in the reachable blocks only: the others
+// were never renamed. Also note the block of every reachable instruction.
+static void find_uses(ConstantPropagation* sccp, CFG* cfg, SSAForm* ssa) {
+    grow_array((void**) &sccp->use_start, &sccp->use_start_capacity, ssa->value_count + 1, sizeof(int));
+    int* start = sccp->use_start;
+    memset(start, 0, (ssa->value_count + 1) * sizeof(int));
+    grow_array((void**) &sccp->instruction_block, &sccp->instruction_capacity,
+         cfg->blocks[cfg->block_count - 1].end - ssa->start, sizeof(int));
+
+    // Count into start[v + 1], turn the counts into offsets, then fill
+    // moving start[v] up to the end of v's uses, and shift back
+    for (int pass = 0; pass < 2; pass++) {
+        for (int d = 0; d < cfg->reachable_count; d++) {
+            int b = cfg->rpo_order[d];
+            BasicBlock* block = &cfg->blocks[b];
+            for (int i = block->first; i < block->end; i++) {
+                sccp->instruction_block[i - ssa->start] = b;
+                for (int slot = 1; slot <= 2; slot++) {
+                    int v = ssa_value(ssa, i, slot);
+                    if (v == SSA_NO_VALUE) {
+                        continue;
+                    }
+                    if (pass == 0) {
+                        start[v + 1]++;
+                    } else {
+                        sccp->uses[start[v]++] = i;
+                    }
+                }
+            }
+            for (int p = ssa->block_phis[b]; p < ssa->block_phis[b + 1]; p++) {
+                for (int k = 0; k < block->predecessor_count; k++) {
+                    if (cfg->blocks[cfg->predecessors[block->predecessor_start + k]].rpo < 0) {
+                        continue;
+                    }
+                    int v = ssa->phi_args[ssa->phis[p].arg_start + k];
+                    if (pass == 0) {
+                        start[v + 1]++;
+                    } else {
+                        sccp->uses[start[v]++] = -1 - p;
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            for (int v = 0; v < ssa->value_count; v++) {
+                start[v + 1] += start[v];
+            }
+            grow_array((void**) &sccp->uses, &sccp->use_capacity, start[ssa->value_count], sizeof(int));
+        } else {
+            memmove(start + 1, start, ssa->value_count * sizeof(int));
+            start[0] = 0;
+        }
+    }
+}
+
+// Propagate until no edge becomes executable and no value drops. A value
+// drops at most twice, so each use is visited a bounded number of times.
+static void solve(ConstantPropagation* sccp, CFG* cfg, SSAForm* ssa, TACBuffer* tac) {
+    for (int v = 0; v < ssa->value_count; v++) {
+        sccp->lattice[v] = lattice_value(ssa->value_def[v] == -1 ? LATTICE_VARYING : LATTICE_UNDEFINED, 0, 0);
+    }
+    memset(sccp->visited, 0, cfg->block_count);
+    memset(sccp->executable, 0, 2 * cfg->block_count);
+    sccp->edge_work_count = 0;
+    sccp->value_work_count = 0;
+
+    // The entry is reached by an edge of its own
+    sccp->edge_work[sccp->edge_work_count++] = -1;
+    while (sccp->edge_work_count > 0 || sccp->value_work_count > 0) {
+        if (sccp->edge_work_count > 0) {
+            int edge = sccp->edge_work[--sccp->edge_work_count];
+            int b = edge < 0 ? 0 : cfg->blocks[edge / 2].successors[edge % 2];
+            for (int p = ssa->block_phis[b]; p < ssa->block_phis[b + 1]; p++) {
+                visit_phi(sccp, cfg, ssa, p);
+            }
+            if (!sccp->visited[b]) {
+                sccp->visited[b] = 1;
+                for (int i = cfg->blocks[b].first; i < cfg->blocks[b].end; i++) {
+                    visit_instruction(sccp, cfg, ssa, tac, b, i);
+                }
+            }
+            continue;
+        }
+
+        int v = sccp->value_work[--sccp->value_work_count];
+        for (int u = sccp->use_start[v]; u < sccp->use_start[v + 1]; u++) {
+            int use = sccp->uses[u];
+            if (use < 0) {
+                if (sccp->visited[ssa->phis[-1 - use].block]) {
+                    visit_phi(sccp, cfg, ssa, -1 - use);
+                }
+                continue;
+            }
+            int b = sccp->instruction_block[use - ssa->start];
+            if (sccp->visited[b]) {
+                visit_instruction(sccp, cfg, ssa, tac, b, use);
+            }
+        }
+    }
+}
+
+typedef enum {
+    USE_INT,        // Read as a word, in an integer instruction, a print or a condition
+    USE_FLOAT,      // Read as a float, in an operation with a float literal
+    USE_COPY        // Copied to the result whatever it holds
+} UseKind;
+
+// The literal to write for a constant where it is read as kind, or 0 when
+// there is none that reads the same
+static int constant_operand(LatticeValue state, UseKind kind, TACOperand* operand) {
+    if (state.state != LATTICE_CONSTANT) {
+        return 0;
+    }
+    if (!state.is_float && kind != USE_FLOAT) {
+        *operand = tac_int(state.word);
+        return 1;
+    }
+    if (state.is_float && kind != USE_INT && is_exact_literal(bits_float(state.word))) {
+        *operand = tac_float(bits_float(state.word));
+        return 1;
+    }
+    return 0;
+}
+
+static void rewrite(ConstantPropagation* sccp, CFG* cfg, SSAForm* ssa, TACBuffer* tac) {
+    for (int b = 0; b < cfg->block_count; b++) {
+        BasicBlock* block = &cfg->blocks[b];
+        for (int i = block->first; i < block->end; i++) {
+            TACInstruction* instr = &tac->items[i];
+            int* values = &ssa->values[3 * (i - ssa->start)];
+            if (!sccp->visited[b]) {
+                if (!instr->is_dead) {
+                    instr->is_dead = 1;
+                    instr->is_optimized = 1;
+                    sccp->unreachable_removed++;
+                }
+                continue;
+            }
+
+            TACOperand literal;
+            if (values[0] != SSA_NO_VALUE &&
+                !(instr->opcode == TAC_COPY && (instr->arg1.kind == OPERAND_INT || instr->arg1.kind == OPERAND_FLOAT)) &&
+                constant_operand(sccp->lattice[values[0]], USE_COPY, &literal)) {
+                instr->opcode = TAC_COPY;
+                instr->arg1 = literal;
+                instr->arg2 = tac_none();
+                instr->is_optimized = 1;
+                values[1] = SSA_NO_VALUE;
+                values[2] = SSA_NO_VALUE;
+                sccp->folded++;
+                continue;
+            }
+
+            if (instr->opcode == TAC_IFFALSE) {
+                LatticeValue condition = operand_state(sccp, instr->arg1, values[1]);
+                if (condition.state == LATTICE_CONSTANT) {
+                    if (condition.word == 0) {
+                        instr->opcode = TAC_JUMP;
+                        instr->arg1 = instr->arg2;
+                        instr->arg2 = tac_none();
+                    } else {
+                        instr->is_dead = 1;
+                    }
+                    instr->is_optimized = 1;
+                    values[1] = SSA_NO_VALUE;
+                    sccp->branches_removed++;
+                }
+                continue;
+            }
+
+            UseKind kind = USE_INT;
+            if (instr->opcode == TAC_COPY) {
+                kind = USE_COPY;
+            } else if (tac_is_binary(instr) && (instr->arg1.kind == OPERAND_FLOAT || instr->arg2.kind == OPERAND_FLOAT)) {
+                kind = USE_FLOAT;
+            }
+            TACOperand* args[2] = { &instr->arg1, &instr->arg2 };
+            for (int a = 0; a < 2; a++) {
+                if (values[1 + a] != SSA_NO_VALUE && constant_operand(sccp->lattice[values[1 + a]], kind, &literal)) {
+                    *args[a] = literal;
+                    values[1 + a] = SSA_NO_VALUE;
+                    instr->is_optimized = 1;
+                    sccp->propagated++;
+                }
+            }
+        }
+    }
+}
+
+// Remove jumps and ifFalse whose target follows them with only labels and
+// removed instructions between: they go where falling through would. Folded
+// branches and removed blocks leave many of them.
+static void remove_fallthrough_jumps(ConstantPropagation* sccp, TACBuffer* tac, int start) {
+    for (int i = start; i < tac->count; i++) {
+        TACInstruction* instr = &tac->items[i];
+        if (instr->is_dead || (instr->opcode != TAC_JUMP && instr->opcode != TAC_IFFALSE)) {
+            continue;
+        }
+        TACOperand target = instr->opcode == TAC_JUMP ? instr->arg1 : instr->arg2;
+        for (int j = i + 1; j < tac->count; j++) {
+            TACInstruction* next = &tac->items[j];
+            if (next->is_dead) {
+                continue;
+            }
+            if (next->opcode != TAC_LABEL) {
+                break;
+            }
+            if (tac_same(next->arg1, target)) {
+                instr->is_dead = 1;
+                instr->is_optimized = 1;
+                sccp->branches_removed++;
+                break;
+            }
+        }
+    }
+}
+
+void sccp_run(ConstantPropagation* sccp, CFG* cfg, SSAForm* ssa, TACBuffer* tac) {
+    sccp->folded = 0;
+    sccp->propagated = 0;
+    sccp->branches_removed = 0;
+    sccp->unreachable_removed = 0;
+    if (cfg->reachable_count == 0) {
+        return;
+    }
+    grow_array((void**) &sccp->lattice, &sccp->lattice_capacity, ssa->value_count, sizeof(LatticeValue));
+    if (cfg->block_count > sccp->block_capacity) {
+        int capacity = sccp->block_capacity;
+        grow_array((void**) &sccp->visited, &capacity, cfg->block_count, sizeof(char));
+        capacity = sccp->block_capacity;
+        grow_array((void**) &sccp->executable, &capacity, cfg->block_count, 2 * sizeof(char));
+        sccp->block_capacity = capacity;
+    }
+
+    // Every edge is queued once and every value at most twice
+    grow_array((void**) &sccp->edge_work, &sccp->edge_work_capacity, 2 * cfg->block_count + 1, sizeof(int));
+    grow_array((void**) &sccp->value_work, &sccp->value_work_capacity, 2 * ssa->value_count, sizeof(int));
+
+    find_uses(sccp, cfg, ssa);
+    solve(sccp, cfg, ssa, tac);
+    rewrite(sccp, cfg, ssa, tac);
+    remove_fallthrough_jumps(sccp, tac, ssa->start);
+}
+
+void sccp_free(ConstantPropagation* sccp) {
+    free(sccp->lattice);
+    free(sccp->use_start);
+    free(sccp->uses);
+    free(sccp->instruction_block);
+    free(sccp->visited);
+    free(sccp->executable);
+    free(sccp->edge_work);
+    free(sccp->value_work);
+    memset(sccp, 0, sizeof(ConstantPropagation));
+}
@@ -0,0 +1,71 @@
+#ifndef SCCP_H
+#define SCCP_H
+
+#include "ssa.h"
+
+// Sparse conditional constant propagation over the SSA form of a CFG.
+// Every value starts out undefined and is lowered to a constant or to
+// varying as the blocks reaching it are found executable; a branch on a
+// constant only makes one of its edges executable, so constants reach
+// across branches and around loops that a plain dataflow pass would give
+// up on.
+//
+// Constants are the 32-bit words the generated code would hold. A word
+// made by a float literal or float operation is marked is_float, since the
+// code generator reads such a word as a float only in a float operation.
+
+typedef enum {
+    LATTICE_UNDEFINED,      // No executable definition reaches the value yet
+    LATTICE_CONSTANT,
+    LATTICE_VARYING
+} LatticeState;
+
+typedef struct {
+    unsigned char state;    // LatticeState
+    unsigned char is_float;
+    int word;
+} LatticeValue;
+
+typedef struct {
+    LatticeValue* lattice;  // Indexed by SSA value
+    int lattice_capacity;
+
+    // Where each value is used: an instruction, or -1 - phi for a phi
+    int* use_start;         // Uses of value v are [use_start[v], use_start[v + 1])
+    int use_start_capacity;
+    int* uses;
+    int use_capacity;
+    int* instruction_block; // From the graph's first instruction on
+    int instruction_capacity;
+
+    // Indexed by block, and by block and successor slot for the edges
+    char* visited;
+    char* executable;
+    int block_capacity;
+
+    // Edges to visit, as 2 * block + slot, and values whose state dropped
+    int* edge_work;
+    int edge_work_count;
+    int edge_work_capacity;
+    int* value_work;
+    int value_work_count;
+    int value_work_capacity;
+
+    // What sccp_run() changed
+    int folded;             // Assignments turned into copies of a constant
+    int propagated;         // Operands replaced by a constant
+    int branches_removed;   // ifFalse made jumps or removed, jumps removed
+    int unreachable_removed;
+} ConstantPropagation;
+
+// Find the constants of the instructions cfg and ssa were built from and
+// rewrite them: assignments of a constant become copies of it, operands
+// holding one are replaced by it where the code generator reads them the
+// same way, ifFalse on a constant is removed or made a jump, and blocks
+// never found executable are marked is_dead, as are the jumps that are left
+// going to the next instruction. The graph and the form are left as they
+// were, so they may have edges and uses the TAC no longer has.
+void sccp_run(ConstantPropagation* sccp, CFG* cfg, SSAForm* ssa, TACBuffer* tac);
+void sccp_free(ConstantPropagation* sccp);
+
+#endif // SCCP_H
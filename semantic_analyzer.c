@@ -1,291 +1,138 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "AST.h"
-#include "symbol_table.h"
-
-FILE* tac_file;
-int temp_var_count = 0;
-
-#define MAX_IDENTIFIERS 100
-struct {
-    char name[20];
-    int temp_var;
-} id_to_temp[MAX_IDENTIFIERS];
-int id_to_temp_count = 0;
-
-char* newTemp() {
-    char* temp = (char*)malloc(10);
-    sprintf(temp, "t%d", temp_var_count++);
-    return temp;
+#include "compiler.h"
+#include "trace.h"
+
+// Intern the name of a new temporary and remember which operand it is
+static Atom makeTemp(CompilerContext* ctx, const char* format, TACOperandKind kind) {
+    SemanticState* sema = &ctx->sema;
+    char temp[16];
+    int number = sema->temp_var_count++;
+    sprintf(temp, format, number);
+    Atom atom = intern(&ctx->atoms, temp);
+
+    if (atom >= sema->temp_operand_capacity) {
+        int capacity = sema->temp_operand_capacity ? sema->temp_operand_capacity : 1024;
+        while (capacity <= atom) {
+            capacity *= 2;
+        }
+        sema->temp_operands = realloc(sema->temp_operands, capacity * sizeof(TACOperand));
+        if (sema->temp_operands == NULL) {
+            fprintf(stderr, "Memory allocation failed for temporaries\n");
+            exit(1);
+        }
+        memset(sema->temp_operands + sema->temp_operand_capacity, 0, (capacity - sema->temp_operand_capacity) * sizeof(TACOperand));
+        sema->temp_operand_capacity = capacity;
+    }
+    sema->temp_operands[atom] = tac_operand(kind, number);
+    return atom;
 }
 
-char* newFloat() {
-    char* temp = (char*)malloc(10);
-    sprintf(temp, "f%d", temp_var_count++);
-    return temp;
+Atom newTemp(CompilerContext* ctx) {
+    return makeTemp(ctx, "t%d", OPERAND_TEMP);
 }
 
-void generateTACLine(const char* tac_line) {
-    fprintf(tac_file, "%s\n", tac_line);
+Atom newFloat(CompilerContext* ctx) {
+    return makeTemp(ctx, "f%d", OPERAND_FLOAT_TEMP);
 }
 
-void generateTAC(ASTNode* node) {
-    if (node == NULL) {
-        return;
-    }
-
-    char tac_line[100];
-    switch (node->type) {
-        case NODE_TYPE_PROGRAM:
-            for (int i = 0; i < node->statements.count; i++) {
-                generateTAC(node->statements.stmts[i]);
-            }
-            break;
-        case NODE_TYPE_DECLARATION:
-            // Declarations are not output to TAC
-            break;
-        case NODE_TYPE_ASSIGNMENT:
-            // Generate TAC for the right-hand side first
-            generateTAC(node->right);  
-            generateTAC(node->left);  // Make sure to evaluate the left identifier
-            
-            // Ensure the right side produces a temp variable
-            if (node->right->temp_var_name != NULL) {
-                sprintf(tac_line, "%s = %s", node->left->id, node->right->temp_var_name);
-                printf("DEBUG: Assignment -> %s\n", tac_line);
-                generateTACLine(tac_line);
-            } else {
-                fprintf(stderr, "Error: Right-hand side of assignment does not produce a temp variable.\n");
-            }
-            break;
-        case NODE_TYPE_WRITE:
-            // Ensure that we're writing the identifier directly
-            sprintf(tac_line, "print %s", node->left->id);
-            printf("DEBUG: Write -> %s\n", tac_line);
-            generateTACLine(tac_line);
-            break;
-        case NODE_TYPE_BINARY_OP:
-            // Generate TAC for left and right operands first
-            generateTAC(node->left);
-            generateTAC(node->right);
-
-            char* temp;
-
-            // Check if both operands are constants
-            if (node->left->type == NODE_TYPE_INTEGER && node->right->type == NODE_TYPE_INTEGER) {
-                // Perform constant folding for integers
-                temp = newTemp();
-                int result = 0;
-                if (strcmp(node->op, "+") == 0) {
-                    result = node->left->value.intValue + node->right->value.intValue;
-                } else if (strcmp(node->op, "-") == 0) {
-                    result = node->left->value.intValue - node->right->value.intValue;
-                } else if (strcmp(node->op, "*") == 0) {
-                    result = node->left->value.intValue * node->right->value.intValue;
-                } else if (strcmp(node->op, "/") == 0) {
-                    result = node->left->value.intValue / node->right->value.intValue;
-                }
-                // Create a new temporary variable for the result
-                sprintf(tac_line, "%s = %d", temp, result);
-                printf("DEBUG: Constant Folding TAC -> %s\n", tac_line);
-                generateTACLine(tac_line);
-            } else if (node->left->type == NODE_TYPE_FLOAT && node->right->type == NODE_TYPE_FLOAT) {
-                // Perform constant folding for floats
-                temp = newFloat();
-                float result = 0.0f;
-                if (strcmp(node->op, "+") == 0) {
-                    result = node->left->value.floatValue + node->right->value.floatValue;
-                } else if (strcmp(node->op, "-") == 0) {
-                    result = node->left->value.floatValue - node->right->value.floatValue;
-                } else if (strcmp(node->op, "*") == 0) {
-                    result = node->left->value.floatValue * node->right->value.floatValue;
-                } else if (strcmp(node->op, "/") == 0) {
-                    result = node->left->value.floatValue / node->right->value.floatValue;
-                }
-
-                // Create a new temporary variable for the result
-                sprintf(tac_line, "%s = %f", temp, result);
-                printf("DEBUG: Constant Folding TAC -> %s\n", tac_line);
-                generateTACLine(tac_line);
-            } else {
-                temp = newFloat();
-                // Create a new temporary variable for the result of the binary operation
-                sprintf(tac_line, "%s = %s %s %s", temp, node->left->temp_var_name, node->op, node->right->temp_var_name);
-                printf("DEBUG: Binary Operation TAC -> %s\n", tac_line);
-                generateTACLine(tac_line);
-            }
-            node->temp_var_name = temp; // Store temp variable for further use
-            break;
-        case NODE_TYPE_IDENTIFIER:
-            // Check if the identifier has already been assigned a temp variable
-            if (node->temp_var_name == NULL) {
-                // If not, assign a new temp variable
-                char* temp = newTemp();
-                sprintf(tac_line, "%s = %s", temp, node->id);
-                generateTACLine(tac_line);
-                node->temp_var_name = temp;
-                printf("DEBUG: Identifier '%s' assigned to temp variable %s\n", node->id, temp);
-            }
-            break;
-        case NODE_TYPE_INTEGER:
-            char* int_temp = newTemp();
-            sprintf(tac_line, "%s = %d", int_temp, node->value.intValue);
-            printf("DEBUG: Integer -> %s\n", tac_line);
-            generateTACLine(tac_line);
-            node->temp_var_name = int_temp; // Store the temp variable name for further use
-            break;
-        case NODE_TYPE_FLOAT:
-            char* float_temp = newFloat();
-            sprintf(tac_line, "%s = %f", float_temp, node->value.floatValue);
-            printf("DEBUG: Float -> %s\n", tac_line);
-            generateTACLine(tac_line);
-            node->temp_var_name = float_temp;
-            break;
-        case NODE_TYPE_BOOLEAN:
-            char* bool_temp = newTemp();
-            int bool_val = 0;
-            if (strcmp(node->boolean_val, "true") == 0) {
-                bool_val = 1;
-            }
-            sprintf(tac_line, "%s = %s", bool_temp, bool_val);
-            printf("DEBUG: Boolean -> %s\n", tac_line);
-            generateTACLine(tac_line);
-            node->temp_var_name = bool_temp; 
-            break;
-        case NODE_TYPE_ARRAY_ACCESS: // Handle array access
-            // Assume node->array_id contains the array identifier and node->index contains the index expression
-            printf("------------------- index : %d -----------------\n", node->value.intValue);
-            generateTAC(node->value.intValue); // Generate TAC for the index
-            if (node->value.intValue != NULL) {
-                // Create a new temporary variable for accessing the array
-                char* temp = newTemp();
-                sprintf(tac_line, "%s = %s[%s]", temp, node->id, node->value.intValue);
-                printf("DEBUG: Array Access TAC -> %s\n", tac_line);
-                generateTACLine(tac_line);
-                node->temp_var_name = temp; // Store the temp variable for further use
-            } else {
-                fprintf(stderr, "Error: Index for array access does not produce a temp variable.\n");
-            }
-            break;
-        case NODE_TYPE_ARRAY_ASSIGNMENT: // Handle array assignments
-            // Assume node->array_id contains the array identifier and node->index contains the index expression
-            generateTAC(node->value.intValue); // Generate TAC for the index
-            generateTAC(node->right); // Generate TAC for the right-hand side (value to assign)
-
-            if (node->value.intValue != NULL && node->right->temp_var_name != NULL) {
-                sprintf(tac_line, "%s[%s] = %s", node->id, node->value.intValue, node->right->temp_var_name);
-                printf("DEBUG: Array Assignment TAC -> %s\n", tac_line);
-                generateTACLine(tac_line);
-            } else {
-                fprintf(stderr, "Error: Index or value for array assignment does not produce a temp variable.\n");
-            }
-            break;
-         case NODE_TYPE_FUNCTION_CALL:
-             printf("DEBUG: Generating TAC for function call to '%s'\n", node->id);
+// Labels are numbered along with the temporaries but have no atom
+TACOperand newLabel(CompilerContext* ctx) {
+    return tac_operand(OPERAND_LABEL, ctx->sema.temp_var_count++);
+}
 
-    // Evaluate each argument and generate TAC
-    for (int i = 0; i < node->funcCall.arguments->argumentList.count; i++) {
-        ASTNode* arg = node->funcCall.arguments->argumentList.args[i];
-        generateTAC(arg);  // Generate TAC for the argument
-        if (arg->temp_var_name != NULL) {
-            sprintf(tac_line, "param %s", arg->temp_var_name);
-            generateTACLine(tac_line);
-        } else {
-            fprintf(stderr, "Error: Argument does not produce a temp variable.\n");
-        }
+TACOperand operandOf(CompilerContext* ctx, Atom atom) {
+    if (atom < ctx->sema.temp_operand_capacity && ctx->sema.temp_operands[atom].kind != OPERAND_NONE) {
+        return ctx->sema.temp_operands[atom];
     }
+    return tac_variable(atom);
+}
 
-    // Generate TAC for the function call
-    char* result_temp = newTemp();
-    sprintf(tac_line, "%s = call %s, %d", result_temp, node->id, node->funcCall.arguments->argumentList.count);
-    generateTACLine(tac_line);
-
-    // Store the result temp variable for further use
-    node->temp_var_name = result_temp;
-            break;
-        default:
-            fprintf(stderr, "Error: Unknown node type %d in TAC generation\n", node->type);
+// Record a new loop with fresh labels and return its index. Loops are
+// recorded when lowering starts, so outer ones come first.
+static int newLoop(CompilerContext* ctx) {
+    SemanticState* sema = &ctx->sema;
+    if (sema->loop_count == sema->loop_capacity) {
+        sema->loop_capacity = sema->loop_capacity ? sema->loop_capacity * 2 : 64;
+        sema->loops = realloc(sema->loops, sema->loop_capacity * sizeof(TACLoop));
+        if (sema->loops == NULL) {
+            fprintf(stderr, "Memory allocation failed for loops\n");
             exit(1);
+        }
     }
-
-     // Recursively process child nodes
-    if (node->left) {
-        generateTAC(node->left);
-    }
-    if (node->right) {
-        generateTAC(node->right);
-    }
+    TACLoop* loop = &sema->loops[sema->loop_count];
+    loop->preheader = newLabel(ctx);
+    loop->header = newLabel(ctx);
+    loop->latch = newLabel(ctx);
+    loop->exit = newLabel(ctx);
+    return sema->loop_count++;
 }
 
+void freeSemanticState(CompilerContext* ctx) {
+    free(ctx->sema.temp_operands);
+    free(ctx->sema.loops);
+    memset(&ctx->sema, 0, sizeof(SemanticState));
+}
 
+// Record the temporary that holds a node's value
+void setNodeTemp(ASTNode* node, Atom temp) {
+    node->temp_var = temp;
+}
 
-void updateIdToTemp(const char* id, int temp_var) {
-    for (int i = 0; i < id_to_temp_count; i++) {
-        if (strcmp(id_to_temp[i].name, id) == 0) {
-            id_to_temp[i].temp_var = temp_var;
-            return;
-        }
-    }
-    if (id_to_temp_count < MAX_IDENTIFIERS) {
-        strcpy(id_to_temp[id_to_temp_count].name, id);
-        id_to_temp[id_to_temp_count].temp_var = temp_var;
-        id_to_temp_count++;
+// Append an instruction to the compilation's TAC
+void generateTACInstruction(CompilerContext* ctx, TACOpcode opcode, TACOperand result, TACOperand arg1, TACOperand arg2) {
+    TACInstruction* instr = tac_append(&ctx->tac, opcode, result, arg1, arg2);
+    if (TRACE_ON(TRACE_TAC, TRACE_LEVEL_DEBUG)) {
+        char line[256];
+        tac_format(&ctx->atoms, instr, line, sizeof(line));
+        trace_printf("TAC: %s\n", line);
     }
 }
 
-int getIdIndex(const char* id) {
-    if (id == NULL) {
-        fprintf(stderr, "Error: NULL id passed to getIdIndex\n");
-        return -1;
-    }
-    for (int i = 0; i < id_to_temp_count; i++) {
-        if (id_to_temp[i].name != NULL && strcmp(id_to_temp[i].name, id) == 0) {
-            return i;
-        }
-    }
-    return -1;
+// result = value for an integer literal
+void generateTACConstant(CompilerContext* ctx, Atom result, int value) {
+    generateTACInstruction(ctx, TAC_COPY, operandOf(ctx, result), tac_int(value), tac_none());
+}
+
+// Emit a one-operand instruction: print, ifFalse's condition and so on
+static void generateTACUse(CompilerContext* ctx, TACOpcode opcode, Atom arg) {
+    generateTACInstruction(ctx, opcode, tac_none(), operandOf(ctx, arg), tac_none());
 }
 
-void analyzeNode(ASTNode* node);
 
-void analyzeFunctionCall(ASTNode* node) {
+
+void analyzeNode(CompilerContext* ctx, ASTNode* node);
+
+void analyzeFunctionCall(CompilerContext* ctx, ASTNode* node) {
     if (node == NULL) {
-        fprintf(stderr, "Error: NULL node in function call analysis\n");
+        fprintf(ctx->diagnostics, "Error: NULL node in function call analysis\n");
         return;
     }
 
-    char* functionName = node->id;
-    Symbol* functionSymbol = lookup_symbol(functionName);
-    
     // Evaluate each argument and generate TAC
     for (int i = 0; i < node->funcCall.arguments->argumentList.count; i++) {
-        ASTNode* arg = node->funcCall.arguments->argumentList.args[i];
-        analyzeNode(arg);
-        char tac_line[100];
-        sprintf(tac_line, "param %s", arg->temp_var_name);
-        generateTACLine(tac_line);
+        ASTNode* arg = node->funcCall.arguments->argumentList.items[i];
+        analyzeNode(ctx, arg);
+        generateTACUse(ctx, TAC_PARAM, arg->temp_var);
     }
 
     // For add function, generate direct addition TAC
-    if (strcmp(functionName, "add") == 0) {
-        char* result_temp = newTemp();
-        char tac_line[100];
-        sprintf(tac_line, "%s = %s + %s", 
-            result_temp,
-            node->funcCall.arguments->argumentList.args[0]->temp_var_name,
-            node->funcCall.arguments->argumentList.args[1]->temp_var_name);
-        generateTACLine(tac_line);
-        node->temp_var_name = result_temp;
+    if (node->atom == ATOM_ADD) {
+        Atom result_temp = newTemp(ctx);
+        generateTACInstruction(ctx, TAC_ADD, operandOf(ctx, result_temp),
+            operandOf(ctx, node->funcCall.arguments->argumentList.items[0]->temp_var),
+            operandOf(ctx, node->funcCall.arguments->argumentList.items[1]->temp_var));
+        setNodeTemp(node, result_temp);
     }
 }
 
 
 
 
-void analyzeProgram(ASTNode* node) {
+void analyzeProgram(CompilerContext* ctx, ASTNode* node) {
     for (int i = 0; i < node->statements.count; i++) {
-        analyzeNode(node->statements.stmts[i]);
+        analyzeNode(ctx, node->statements.items[i]);
     }
 }
 
@@ -293,502 +140,456 @@ void analyzeDeclaration(ASTNode* node) {
     // Declarations are not output to TAC
 }
 
-void analyzeAssignment(ASTNode* node) {
+void analyzeAssignment(CompilerContext* ctx, ASTNode* node) {
     if (node == NULL || node->left == NULL || node->right == NULL) {
-        fprintf(stderr, "Error: NULL node in assignment analysis\n");
+        fprintf(ctx->diagnostics, "Error: NULL node in assignment analysis\n");
         return;
     }
 
-    printf("DEBUG: Analyzing assignment for %s\n", node->left->id);
-    analyzeNode(node->right);  // Analyze the right-hand side to get temp_var_name
+    TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: Analyzing assignment for %s\n", atom_name(&ctx->atoms, node->left->atom));
+    analyzeNode(ctx, node->right);  // Analyze the right-hand side to get its temp
 
-    if (node->right->temp_var_name == NULL) {
-        fprintf(stderr, "Error: Right-hand side of assignment does not produce a temp variable.\n");
+    if (node->right->temp_var == ATOM_NONE) {
+        fprintf(ctx->diagnostics, "Error: Right-hand side of assignment does not produce a temp variable.\n");
         return;
     }
 
     
     // Update initialization status in the symbol table
-    Symbol* symbol = lookup_symbol(node->left->id);
+    Symbol* symbol = symbol_at(&ctx->symbols, node->left->value.symbol);
     if (symbol) {
         symbol->is_initialized = 1;
     }
 
-    char tac_line[100];
-    sprintf(tac_line, "%s = %s", node->left->id, node->right->temp_var_name);
-    generateTACLine(tac_line);
+    generateTACInstruction(ctx, TAC_COPY, tac_variable(node->left->atom), operandOf(ctx, node->right->temp_var), tac_none());
 
-    node->left->temp_var_name = node->right->temp_var_name;  // Assign temp_var_name to the left-hand side
-    updateIdToTemp(node->left->id, getIdIndex(node->right->temp_var_name));
+    setNodeTemp(node->left, node->right->temp_var);  // Assign the temp to the left-hand side
 }
 
 
-void analyzeWrite(ASTNode* node) {
-    analyzeNode(node->left);
+void analyzeWrite(CompilerContext* ctx, ASTNode* node) {
+    analyzeNode(ctx, node->left);
 
-    char tac_line[100];
-    if (node->left->temp_var_name != NULL) {
-        sprintf(tac_line, "print %s", node->left->temp_var_name);
+    if (node->left->temp_var != ATOM_NONE) {
+        generateTACUse(ctx, TAC_PRINT, node->left->temp_var);
     } else {
-        sprintf(tac_line, "print %s", node->left->id);
+        generateTACUse(ctx, TAC_PRINT, node->left->atom);
     }
-    generateTACLine(tac_line);
 }
 
-void analyzeBinaryOp(ASTNode* node) {
-    analyzeNode(node->left);
-    analyzeNode(node->right);
+void analyzeBinaryOp(CompilerContext* ctx, ASTNode* node) {
+    analyzeNode(ctx, node->left);
+    analyzeNode(ctx, node->right);
 
-    char* temp = newFloat();
-    char tac_line[100];
+    Atom temp = newFloat(ctx);
 
-    if (node->left->temp_var_name == NULL || node->right->temp_var_name == NULL) {
-                fprintf(stderr, "Error: Uninitialized variable in binary operation %s %s %s\n",
-                node->left->temp_var_name ? node->left->temp_var_name : "NULL",
+    if (node->left->temp_var == ATOM_NONE || node->right->temp_var == ATOM_NONE) {
+                fprintf(ctx->diagnostics, "Error: Uninitialized variable in binary operation %s %s %s\n",
+                node->left->temp_var != ATOM_NONE ? atom_name(&ctx->atoms, node->left->temp_var) : "NULL",
                 node->op,
-                node->right->temp_var_name ? node->right->temp_var_name : "NULL");
-        exit(1);
+                node->right->temp_var != ATOM_NONE ? atom_name(&ctx->atoms, node->right->temp_var) : "NULL");
+        compiler_fatal(ctx);
     }
 
 
-    printf("DEBUG: Left operand value: %s\n", node->left->temp_var_name);
-    printf("DEBUG: Right operand value: %s\n", node->right->temp_var_name);
+    TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: Left operand value: %s\n", atom_name(&ctx->atoms, node->left->temp_var));
+    TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: Right operand value: %s\n", atom_name(&ctx->atoms, node->right->temp_var));
 
-    sprintf(tac_line, "%s = %s %s %s", temp, node->left->temp_var_name, node->op, node->right->temp_var_name);
-    generateTACLine(tac_line);
+    int opcode = tac_binary_opcode(node->op);
+    if (opcode < 0) {
+        fprintf(ctx->diagnostics, "Error: Unknown operator %s\n", node->op);
+        compiler_fatal(ctx);
+    }
+    generateTACInstruction(ctx, opcode, operandOf(ctx, temp), operandOf(ctx, node->left->temp_var), operandOf(ctx, node->right->temp_var));
 
-    node->temp_var_name = temp;
-    updateIdToTemp(temp, getIdIndex(temp));
+    setNodeTemp(node, temp);
 }
 
 
-void analyzeIdentifier(ASTNode* node) {
-    if (node == NULL || node->id == NULL) {
-        fprintf(stderr, "Error: NULL node or identifier in analyzeIdentifier\n");
+void analyzeIdentifier(CompilerContext* ctx, ASTNode* node) {
+    if (node == NULL || node->atom == ATOM_NONE) {
+        fprintf(ctx->diagnostics, "Error: NULL node or identifier in analyzeIdentifier\n");
         return;
     }
 
-    printf("DEBUG: Analyzing identifier '%s'\n", node->id);
+    TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: Analyzing identifier '%s'\n", atom_name(&ctx->atoms, node->atom));
 
-    int index = getIdIndex(node->id);
-    if (index != -1) {
-        node->temp_var_name = id_to_temp[index].name;
-        printf("DEBUG: Found existing temp variable for '%s': %s\n", node->id, node->temp_var_name);
+    // The resolver bound the name to its declaration. Once the variable has
+    // been assigned it is read by name.
+    Symbol* symbol = symbol_at(&ctx->symbols, node->value.symbol);
+    if (symbol != NULL && symbol->is_initialized) {
+        setNodeTemp(node, node->atom);
+        TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: Found existing temp variable for '%s': %s\n", atom_name(&ctx->atoms, node->atom), atom_name(&ctx->atoms, node->temp_var));
     } else {
         // Initialize uninitialized variables with a default value (e.g., 0)
-        char* temp = newTemp();
-        char tac_line[100];
-        sprintf(tac_line, "%s = 0", temp);
-        generateTACLine(tac_line);
+        Atom temp = newTemp(ctx);
+        generateTACConstant(ctx, temp, 0);
 
-        node->temp_var_name = temp;
-        updateIdToTemp(node->id, getIdIndex(temp));
+        setNodeTemp(node, temp);
+        if (symbol != NULL) {
+            symbol->is_initialized = 1;
+        }
 
-        fprintf(stderr, "Warning: Initializing uninitialized variable %s to 0\n", node->id);
-        printf("DEBUG: Initialized '%s' with temp variable: %s\n", node->id, temp);
+        fprintf(ctx->diagnostics, "Warning: Initializing uninitialized variable %s to 0\n", atom_name(&ctx->atoms, node->atom));
+        TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: Initialized '%s' with temp variable: %s\n", atom_name(&ctx->atoms, node->atom), atom_name(&ctx->atoms, temp));
     }
 }
 
 
 
 // Function to analyze function declarations
-void analyzeFunctionDeclaration(ASTNode* node) {
+void analyzeFunctionDeclaration(CompilerContext* ctx, ASTNode* node) {
     if (node == NULL) {
-        fprintf(stderr, "Error: NULL node in function declaration analysis\n");
+        fprintf(ctx->diagnostics, "Error: NULL node in function declaration analysis\n");
         return;
     }
 
     // Check that the node is indeed a function declaration
     if (node->type != NODE_TYPE_FUNCTION_DECLARATION) {
-        fprintf(stderr, "Error: Node is not a function declaration\n");
+        fprintf(ctx->diagnostics, "Error: Node is not a function declaration\n");
         return;
     }
 
     // Check the function identifier
-    if (node->id == NULL) {
-        fprintf(stderr, "Error: Function declaration missing identifier\n");
+    if (node->atom == ATOM_NONE) {
+        fprintf(ctx->diagnostics, "Error: Function declaration missing identifier\n");
         return;
     }
 
     // Check parameters
     if (node->left != NULL) {
         // Analyze parameters (node->left should be the parameters node)
-        analyzeNode(node->left);
+        analyzeNode(ctx, node->left);
     } else {
-        fprintf(stderr, "Error: Function declaration missing parameters\n");
+        fprintf(ctx->diagnostics, "Error: Function declaration missing parameters\n");
         return;
     }
 
-    // Check return type
-    if (node->right != NULL && node->right->id != NULL) {
-        // Analyze return type (node->right should be the return type node)
-        analyzeNode(node->right);
-    } else {
-        fprintf(stderr, "Error: Function declaration missing return type\n");
+    // Check return type. It names a type, so it produces no TAC.
+    if (node->right == NULL || node->right->atom == ATOM_NONE) {
+        fprintf(ctx->diagnostics, "Error: Function declaration missing return type\n");
         return;
     }
 
     // Check function body
     if (node->statements.count > 0) {
         for (int i = 0; i < node->statements.count; i++) {
-            analyzeNode(node->statements.stmts[i]);
+            analyzeNode(ctx, node->statements.items[i]);
         }
     }
 
-    // Extract parameter types
-    char** paramTypes = extractParamTypes(node->left->parameters.params, node->left->parameters.count);
-    if (paramTypes == NULL) {
-        fprintf(stderr, "Error: Failed to extract parameter types\n");
-        return;
-    }
-
-    // Insert function into symbol table
-    insert_symbol(node->id, "function", paramTypes, node->left->parameters.count, node->right->id);
-    freeParamTypes(paramTypes, node->left->parameters.count);
-
     // Debugging: Print the function details
-    printf("DEBUG: Function '%s' with return type '%s' and %d parameters inserted into symbol table.\n",
-           node->id, node->right->id, node->left->parameters.count);
+    TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: Function '%s' with return type '%s' and %d parameters analyzed.\n",
+           atom_name(&ctx->atoms, node->atom), atom_name(&ctx->atoms, node->right->atom), node->left->parameters.count);
 }
 
-void analyzeParameters(ASTNode* node) {
+void analyzeParameters(CompilerContext* ctx, ASTNode* node) {
     if (node == NULL) {
-        fprintf(stderr, "Error: NULL node in parameters analysis\n");
+        fprintf(ctx->diagnostics, "Error: NULL node in parameters analysis\n");
         return;
     }
 
     // Check that the node is indeed a parameters node
     if (node->type != NODE_TYPE_PARAMETERS) {
-        fprintf(stderr, "Error: Node is not a parameters node\n");
+        fprintf(ctx->diagnostics, "Error: Node is not a parameters node\n");
         return;
     }
 
     // Iterate over each parameter and analyze it
     for (int i = 0; i < node->parameters.count; i++) {
-        ASTNode* param = node->parameters.params[i];
+        ASTNode* param = node->parameters.items[i];
         if (param != NULL) {
-            analyzeNode(param);
+            analyzeNode(ctx, param);
         } else {
-            fprintf(stderr, "Error: NULL parameter at index %d\n", i);
+            fprintf(ctx->diagnostics, "Error: NULL parameter at index %d\n", i);
         }
     }
 }
 
-void analyzeParameter(ASTNode* node) {
+void analyzeParameter(CompilerContext* ctx, ASTNode* node) {
     if (node == NULL) {
-        fprintf(stderr, "Error: NULL node in parameter analysis\n");
+        fprintf(ctx->diagnostics, "Error: NULL node in parameter analysis\n");
         return;
     }
 
     // Check that the node is indeed a parameter node
     if (node->type != NODE_TYPE_PARAMETER) {
-        fprintf(stderr, "Error: Node is not a parameter node\n");
+        fprintf(ctx->diagnostics, "Error: Node is not a parameter node\n");
         return;
     }
 
     // Check the parameter identifier
-    if (node->param.identifier == NULL || node->param.identifier->id == NULL) {
-        fprintf(stderr, "Error: Parameter missing identifier\n");
+    if (node->param.identifier == NULL || node->param.identifier->atom == ATOM_NONE) {
+        fprintf(ctx->diagnostics, "Error: Parameter missing identifier\n");
         return;
     }
 
     // Check the parameter type
-    if (node->param.paramType == NULL || node->param.paramType->id == NULL) {
-        fprintf(stderr, "Error: Parameter missing type\n");
+    if (node->param.paramType == NULL || node->param.paramType->atom == ATOM_NONE) {
+        fprintf(ctx->diagnostics, "Error: Parameter missing type\n");
         return;
     }
 
     // Additional checks can be added here as needed
 }
 
-void analyzeReturn(ASTNode* node) {
+void analyzeReturn(CompilerContext* ctx, ASTNode* node) {
     if (node == NULL) {
-        fprintf(stderr, "Error: NULL node in return analysis\n");
+        fprintf(ctx->diagnostics, "Error: NULL node in return analysis\n");
         return;
     }
 
     if (node->type != NODE_TYPE_RETURN) {
-        fprintf(stderr, "Error: Node is not a return node\n");
+        fprintf(ctx->diagnostics, "Error: Node is not a return node\n");
         return;
     }
 
     if (node->left != NULL) {
-        analyzeNode(node->left);
-        if (node->left->temp_var_name != NULL) {
-            char tac_line[100];
-            sprintf(tac_line, "return %s", node->left->temp_var_name);
-            generateTACLine(tac_line);
-            printf("DEBUG: Return statement with temp variable %s\n", node->left->temp_var_name);
+        analyzeNode(ctx, node->left);
+        if (node->left->temp_var != ATOM_NONE) {
+            generateTACUse(ctx, TAC_RETURN, node->left->temp_var);
+            TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: Return statement with temp variable %s\n", atom_name(&ctx->atoms, node->left->temp_var));
         } else {
-            fprintf(stderr, "Error: Return expression does not produce a temp variable.\n");
+            fprintf(ctx->diagnostics, "Error: Return expression does not produce a temp variable.\n");
         }
     } else {
-        fprintf(stderr, "Error: Return statement missing expression\n");
+        fprintf(ctx->diagnostics, "Error: Return statement missing expression\n");
     }
 }
 
 
-void analyzeArgumentList(ASTNode* node) {
+void analyzeArgumentList(CompilerContext* ctx, ASTNode* node) {
     if (node == NULL) {
-        fprintf(stderr, "Error: NULL node in argument list analysis\n");
+        fprintf(ctx->diagnostics, "Error: NULL node in argument list analysis\n");
         return;
     }
 
     for (int i = 0; i < node->argumentList.count; i++) {
-        ASTNode* arg = node->argumentList.args[i];
-        analyzeNode(arg);  // Analyze each argument
-        if (arg->temp_var_name == NULL) {
-            fprintf(stderr, "Error: Argument %d does not produce a temp variable.\n", i);
+        ASTNode* arg = node->argumentList.items[i];
+        analyzeNode(ctx, arg);  // Analyze each argument
+        if (arg->temp_var == ATOM_NONE) {
+            fprintf(ctx->diagnostics, "Error: Argument %d does not produce a temp variable.\n", i);
         }
     }
 }
 
 
-void analyzeArrayDeclaration(ASTNode* node) {
+void analyzeArrayDeclaration(CompilerContext* ctx, ASTNode* node) {
     // Array declarations don't output TAC but could be tracked in the symbol table
-    printf("DEBUG: Array declaration of %s with type %s and size %d\n", node->id, node->varDecl.varType, node->varDecl.arraySize);
+    TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: Array declaration of %s with type %s and size %d\n", atom_name(&ctx->atoms, node->atom), atom_name(&ctx->atoms, node->varDecl.varType->atom), node->varDecl.arraySize);
 }
 
-void analyzeArrayAccess(ASTNode* node) {
+void analyzeArrayAccess(CompilerContext* ctx, ASTNode* node) {
     // First, analyze the index expression to get the temp variable for the index
-    analyzeNode(node->value.intValue);
+    analyzeNode(ctx, node->value.intValue);
 
-    printf("----------------- index : %d ----------------------\n", node->value.intValue);
+    TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "----------------- index : %d ----------------------\n", node->value.intValue);
 
     // Create a new temp variable to hold the accessed array value
-    char* temp = newTemp();
-    char tac_line[100];
+    Atom temp = newTemp(ctx);
+    char element[100];
 
     // Generate TAC for array access: temp = array[index]
-    sprintf(tac_line, "%s = %s[%d]", temp, node->id, node->value.intValue);
-    generateTACLine(tac_line);
+    sprintf(element, "%s[%d]", atom_name(&ctx->atoms, node->atom), node->value.intValue);
+    generateTACInstruction(ctx, TAC_COPY, operandOf(ctx, temp), tac_operand(OPERAND_ELEMENT, intern(&ctx->atoms, element)), tac_none());
 
     // Store the temp variable name for future use
-    node->temp_var_name = temp;
-
-    int temp_var_index = getIdIndex(temp);
-    updateIdToTemp(temp, temp_var_index);
+    setNodeTemp(node, temp);
 
-    printf("DEBUG: Array Access TAC -> %s\n", tac_line);
+    TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: Array Access TAC -> %s = %s\n", atom_name(&ctx->atoms, temp), element);
 }
 
-void analyzeArrayAssignment(ASTNode* node) {
+void analyzeArrayAssignment(CompilerContext* ctx, ASTNode* node) {
     // First, analyze the index and value expressions
-    analyzeNode(node->arrayIndex);
-    analyzeNode(node->assignedValue);
+    analyzeNode(ctx, node->arrayIndex);
+    analyzeNode(ctx, node->assignedValue);
 
-    char tac_line[100];
+    char element[100];
 
     // Generate TAC for array assignment: array[index] = value
-    sprintf(tac_line, "%s[%d] = %s", node->id, node->value.intValue, node->assignedValue->temp_var_name);
-    generateTACLine(tac_line);
+    sprintf(element, "%s[%d]", atom_name(&ctx->atoms, node->atom), node->value.intValue);
+    generateTACInstruction(ctx, TAC_COPY, tac_operand(OPERAND_ELEMENT, intern(&ctx->atoms, element)), operandOf(ctx, node->assignedValue->temp_var), tac_none());
 
-    printf("DEBUG: Array Assignment TAC -> %s\n", tac_line);
+    TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: Array Assignment TAC -> %s = %s\n", element, atom_name(&ctx->atoms, node->assignedValue->temp_var));
 }
 
 
-void analyzeNode(ASTNode* node) {
+void analyzeNode(CompilerContext* ctx, ASTNode* node) {
     if (node == NULL) {
-        fprintf(stderr, "Error: NULL node passed to analyzeNode\n");
+        fprintf(ctx->diagnostics, "Error: NULL node passed to analyzeNode\n");
         return; // Handle the error
     }
 
-    printf("DEBUG: analyzeNode node->type = %s\n", typeToString(node->type));
+    TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: analyzeNode node->type = %s\n", typeToString(node->type));
 
     switch (node->type) {
         case NODE_TYPE_PROGRAM:
-            analyzeProgram(node);
+            analyzeProgram(ctx, node);
             break;
         case NODE_TYPE_DECLARATION:
             analyzeDeclaration(node);
             break;
         case NODE_TYPE_ASSIGNMENT:
-            analyzeAssignment(node);
+            analyzeAssignment(ctx, node);
             break;
         case NODE_TYPE_WRITE:
-            analyzeWrite(node);
+            analyzeWrite(ctx, node);
             break;
         case NODE_TYPE_BINARY_OP:
-            analyzeBinaryOp(node);
+            analyzeBinaryOp(ctx, node);
             break;
         case NODE_TYPE_IDENTIFIER:
-            analyzeIdentifier(node);
-            printf("DEBUG: Identifier node %s has temp variable %s\n", node->id, node->temp_var_name);
+            analyzeIdentifier(ctx, node);
+            TRACE(TRACE_SEMA, TRACE_LEVEL_DEBUG, "DEBUG: Identifier node %s has temp variable %s\n", atom_name(&ctx->atoms, node->atom), atom_name(&ctx->atoms, node->temp_var));
             break;
 
         case NODE_TYPE_FUNCTION_DECLARATION:
-            analyzeFunctionDeclaration(node);
+            analyzeFunctionDeclaration(ctx, node);
             break;
         case NODE_TYPE_PARAMETERS:
-            analyzeParameters(node);
+            analyzeParameters(ctx, node);
             break;
         case NODE_TYPE_PARAMETER:
-            analyzeParameter(node);
+            analyzeParameter(ctx, node);
             break;
         case NODE_TYPE_RETURN:
-            analyzeReturn(node);
+            analyzeReturn(ctx, node);
             break;
         case NODE_TYPE_FUNCTION_CALL:
-            analyzeFunctionCall(node);
+            analyzeFunctionCall(ctx, node);
             break;
         case NODE_TYPE_ARGUMENT_LIST:
-            analyzeArgumentList(node);
+            analyzeArgumentList(ctx, node);
 
             break;
         case NODE_TYPE_INTEGER:
-            char* temp = newTemp();
-            char tac_line[100];
-            sprintf(tac_line, "%s = %d", temp, node->value.intValue);
-            generateTACLine(tac_line);
-            node->temp_var_name = temp;
-
-            int temp_var_index = getIdIndex(temp);
-            updateIdToTemp(temp, temp_var_index);
+            Atom temp = newTemp(ctx);
+            generateTACConstant(ctx, temp, node->value.intValue);
+            setNodeTemp(node, temp);
             break;
         case NODE_TYPE_FLOAT:
-            char* temp2 = newFloat();
-            char tac_line2[100];
-            sprintf(tac_line2, "%s = %f", temp2, node->value.floatValue);
-            generateTACLine(tac_line2);
-            node->temp_var_name = temp2;
-
-            int temp_var_index2 = getIdIndex(temp2);
-            updateIdToTemp(temp2, temp_var_index2);
+            Atom temp2 = newFloat(ctx);
+            generateTACInstruction(ctx, TAC_COPY, operandOf(ctx, temp2), tac_float(node->value.floatValue), tac_none());
+            setNodeTemp(node, temp2);
             break;
         case NODE_TYPE_BOOLEAN:
             {
-                char* temp = newTemp();
-                char tac_line[100];
+                Atom temp = newTemp(ctx);
 
                 int bool_val = 0;
-                if (strcmp(node->boolean_val, "true") == 0) {
+                if (node->atom == ATOM_TRUE) {
                     bool_val = 1;
                 }
 
 
-                sprintf(tac_line, "%s = %d", temp, bool_val);
-                generateTACLine(tac_line);
-                node->temp_var_name = temp;
-
-                int temp_var_index = getIdIndex(temp);
-                updateIdToTemp(temp, temp_var_index);
+                generateTACConstant(ctx, temp, bool_val);
+                setNodeTemp(node, temp);
             }
             break;
         case NODE_TYPE_ARRAY_DECLARATION:
-            analyzeArrayDeclaration(node);
+            analyzeArrayDeclaration(ctx, node);
             break;
         case NODE_TYPE_ARRAY_ACCESS:
-            analyzeArrayAccess(node);
+            analyzeArrayAccess(ctx, node);
             break;
         case NODE_TYPE_ARRAY_ASSIGNMENT:
-            analyzeArrayAssignment(node);
+            analyzeArrayAssignment(ctx, node);
             break;
         case NODE_TYPE_IF:
             // Analyze the condition
-            analyzeNode(node->left);
+            analyzeNode(ctx, node->left);
 
             // Generate TAC for if statement with proper conditional branching
-            char* skipLabel = newTemp();  // Label for skipping the if block
-            char* endLabel = newTemp();   // Label for the end of the entire if-else block
+            TACOperand skipLabel = newLabel(ctx);  // Label for skipping the if block
+            TACOperand endLabel = newLabel(ctx);   // Label for the end of the entire if-else block
 
             // Generate conditional jump - skip if condition is false
-            sprintf(tac_line, "ifFalse %s goto %s", node->left->temp_var_name, skipLabel);
-            generateTACLine(tac_line);
+            generateTACInstruction(ctx, TAC_IFFALSE, tac_none(), operandOf(ctx, node->left->temp_var), skipLabel);
 
             // Analyze the if body
-            analyzeNode(node->right);
+            analyzeNode(ctx, node->right);
 
             // Jump to the end of the if-else block after executing the if body
-            sprintf(tac_line, "j %s", endLabel);
-            generateTACLine(tac_line);
+            generateTACInstruction(ctx, TAC_JUMP, tac_none(), endLabel, tac_none());
 
             // Generate label for skipping the if body
-            sprintf(tac_line, "label %s", skipLabel);
-            generateTACLine(tac_line);
+            generateTACInstruction(ctx, TAC_LABEL, tac_none(), skipLabel, tac_none());
 
             // Analyze the else body
             if (node->elseNode != NULL) {
-                analyzeNode(node->elseNode);
+                analyzeNode(ctx, node->elseNode);
             }
 
             // Generate label for the end of the if-else block
-            sprintf(tac_line, "label %s", endLabel);
-            generateTACLine(tac_line);
+            generateTACInstruction(ctx, TAC_LABEL, tac_none(), endLabel, tac_none());
 
             break;
         case NODE_TYPE_WHILE:
-
-            // Catch infinite loops
-
-
-            char* condLabel = newTemp(); // loop condition label
-            char* exitLabel = newTemp(); // end loop label
-
-            // loop condition label
-            sprintf(tac_line, "label %s", condLabel);
-            generateTACLine(tac_line);
-
-            // analyze condition
-            analyzeNode(node->left);
-
-            // Generate conditional jump - skip if condition is false
-            sprintf(tac_line, "ifFalse %s goto %s", node->left->temp_var_name, exitLabel);
-            generateTACLine(tac_line);
-
-            // analyze statements
-            analyzeNode(node->right);
-
-            // analyze condition
-            analyzeNode(node->left);
-
-            // Generate conditional jump - skip if condition is false
-            sprintf(tac_line, "ifFalse %s goto %s", node->left->temp_var_name, exitLabel);
-            generateTACLine(tac_line);
-
-            // jump back to condition
-            sprintf(tac_line, "j %s", condLabel);
-            generateTACLine(tac_line);
-
-            // loop end label
-            sprintf(tac_line, "label %s", exitLabel);
-            generateTACLine(tac_line);
-
+            {
+                // The labels are copied out since the body may record
+                // loops of its own, see TACLoop for the shape
+                int index = newLoop(ctx);
+                TACLoop loop = ctx->sema.loops[index];
+
+                // The guard: skip the loop if the condition is false at the start
+                analyzeNode(ctx, node->left);
+                generateTACInstruction(ctx, TAC_IFFALSE, tac_none(), operandOf(ctx, node->left->temp_var), loop.exit);
+
+                generateTACInstruction(ctx, TAC_LABEL, tac_none(), loop.preheader, tac_none());
+                generateTACInstruction(ctx, TAC_LABEL, tac_none(), loop.header, tac_none());
+                analyzeNode(ctx, node->right);
+
+                // The latch: test the condition again and go round once more
+                generateTACInstruction(ctx, TAC_LABEL, tac_none(), loop.latch, tac_none());
+                analyzeNode(ctx, node->left);
+                generateTACInstruction(ctx, TAC_IFFALSE, tac_none(), operandOf(ctx, node->left->temp_var), loop.exit);
+                generateTACInstruction(ctx, TAC_JUMP, tac_none(), loop.header, tac_none());
+
+                generateTACInstruction(ctx, TAC_LABEL, tac_none(), loop.exit, tac_none());
+            }
             break;
 
         case NODE_TYPE_STATEMENT:
             // Process each statement in the block
             for (int i = 0; i < node->statements.count; i++) {
-                analyzeNode(node->statements.stmts[i]);
+                analyzeNode(ctx, node->statements.items[i]);
             }
             break;
 
 
 
         default:
-            fprintf(stderr, "Error: Unknown node type %d in semantic analysis\n", node->type);
-            exit(1);
+            fprintf(ctx->diagnostics, "Error: Unknown node type %d in semantic analysis\n", node->type);
+            compiler_fatal(ctx);
     }
 }
 
 
 
 
-void performSemanticAnalysis(ASTNode* root) {
-    printf("-------------Starting semantic analysis--------------------------\n");
-    init_symbol_table();
-
-    tac_file = fopen("output.tac", "w");
-    if (tac_file == NULL) {
-        perror("Error opening TAC output file");
-        exit(EXIT_FAILURE);
-    }
+// Reset the analyzer's state. TAC is appended to ctx->tac; streaming mode
+// then hands each top-level statement to analyzeTopLevel as soon as it is
+// reduced.
+void beginSemanticAnalysis(CompilerContext* ctx) {
+    ctx->sema.temp_var_count = 0;
+    ctx->sema.loop_count = 0;
+}
 
-    analyzeNode(root);
+// Analyze one top-level statement and return the index in ctx->tac of its
+// first instruction
+int analyzeTopLevel(CompilerContext* ctx, ASTNode* node) {
+    int start = ctx->tac.count;
+    analyzeNode(ctx, node);
+    return start;
+}
 
-    if (fclose(tac_file) != 0) {
-        perror("Error closing TAC output file");
-        exit(EXIT_FAILURE);
-    }
+void endSemanticAnalysis(CompilerContext* ctx) {
+    TRACE(TRACE_SEMA, TRACE_LEVEL_INFO, "TAC generation and semantic analysis completed successfully.\n");
+}
 
-    printf("TAC generation and semantic analysis completed successfully.\n");
+void performSemanticAnalysis(CompilerContext* ctx, ASTNode* root) {
+    TRACE(TRACE_SEMA, TRACE_LEVEL_INFO, "-------------Starting semantic analysis--------------------------\n");
+    beginSemanticAnalysis(ctx);
+    analyzeNode(ctx, root);
+    endSemanticAnalysis(ctx);
 }
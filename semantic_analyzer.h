@@ -2,14 +2,47 @@
 #define SEMANTIC_ANALYZER_H
 
 #include "AST.h"
+#include "tac.h"
 
-// Main function to perform semantic analysis
-void performSemanticAnalysis(ASTNode* root);
+// Per-compilation state of the semantic analyzer. Whether a variable has
+// been assigned yet is kept on its symbol, which the resolver bound the
+// identifier nodes to.
+typedef struct {
+    int temp_var_count;
 
-char* newTemp();
-char* newFloat();
+    // The operand of each atom made by newTemp() or newFloat(), indexed by
+    // atom and OPERAND_NONE for any other atom. Cleared by compiler_reset(),
+    // the storage kept.
+    TACOperand* temp_operands;
+    int temp_operand_capacity;
 
-// Function to write TAC to the file
-void generateTAC(const char* tac_line);
+    // While loops lowered since the optimizer last took them, each before
+    // the loops it contains
+    TACLoop* loops;
+    int loop_count;
+    int loop_capacity;
+} SemanticState;
+
+// Main function to perform semantic analysis. TAC is appended to ctx->tac.
+// Names must have been resolved by performNameResolution().
+void performSemanticAnalysis(CompilerContext* ctx, ASTNode* root);
+
+// Streaming mode: analyze the program one top-level statement at a time
+void beginSemanticAnalysis(CompilerContext* ctx);
+int analyzeTopLevel(CompilerContext* ctx, ASTNode* node);
+void endSemanticAnalysis(CompilerContext* ctx);
+
+Atom newTemp(CompilerContext* ctx);
+Atom newFloat(CompilerContext* ctx);
+TACOperand newLabel(CompilerContext* ctx);
+
+// The TAC operand of a node's temp_var: a temporary if newTemp() or
+// newFloat() made the atom, the variable it names otherwise
+TACOperand operandOf(CompilerContext* ctx, Atom atom);
+
+// Append one instruction to ctx->tac
+void generateTACInstruction(CompilerContext* ctx, TACOpcode opcode, TACOperand result, TACOperand arg1, TACOperand arg2);
+
+void freeSemanticState(CompilerContext* ctx);
 
 #endif // SEMANTIC_ANALYZER_H
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+#include "libcompiler.h"
+#include "trace.h"
+
+typedef struct {
+    CompileSession* session;
+    char* source;            // Request body, reused from one request to the next
+    size_t source_capacity;
+    int requests;
+    double compile_seconds;
+    int shutdown;
+} Server;
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Answer a request that was not compiled with status 1 and message as the
+// diagnostics
+static void send_error(FILE* out, const char* format, ...) {
+    char message[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    fprintf(stderr, "Server: %s", message);
+    fprintf(out, "result 1 0 %zu 0\n%s", strlen(message), message);
+    fflush(out);
+}
+
+// Read and answer one request. Returns 0 to keep going, -1 when the peer
+// has gone or sent something that is not a request.
+static int serve_request(Server* server, FILE* in, FILE* out) {
+    char header[128];
+    if (fgets(header, sizeof(header), in) == NULL) {
+        return -1;
+    }
+    if (strcmp(header, "shutdown\n") == 0) {
+        server->shutdown = 1;
+        return -1;
+    }
+
+    // %zu would take a sign and wrap a negative length around
+    size_t length;
+    char mode[16] = "";
+    if (strncmp(header, "compile ", 8) != 0 || !isdigit((unsigned char) header[8]) ||
+        sscanf(header, "compile %zu %15s", &length, mode) < 1) {
+        fprintf(stderr, "Server: bad request header: %s", header);
+        return -1;
+    }
+    // The body of a request that is refused is never read, so the
+    // connection cannot go on after one
+    if (length > SERVER_MAX_SOURCE) {
+        send_error(out, "Error: request of %zu bytes is over the limit of %zu\n", length, (size_t) SERVER_MAX_SOURCE);
+        return -1;
+    }
+    if (length + 1 > server->source_capacity) {
+        char* source = realloc(server->source, length + 1);
+        if (source == NULL) {
+            send_error(out, "Error: out of memory for a %zu byte request\n", length);
+            return -1;
+        }
+        server->source = source;
+        server->source_capacity = length + 1;
+    }
+    if (fread(server->source, 1, length, in) != length) {
+        return -1;
+    }
+
+    CompileOptions options = { strcmp(mode, "stream") == 0 };
+    CompileResult result;
+    double start = now_seconds();
+    compile_session_run(server->session, server->source, length, &options, &result);
+    double elapsed = now_seconds() - start;
+    server->requests++;
+    server->compile_seconds += elapsed;
+
+    fprintf(out, "result %d %zu %zu %ld\n", result.status, result.assembly_length,
+            result.diagnostics_length, (long)(elapsed * 1e6));
+    if (result.assembly_length > 0) {
+        fwrite(result.assembly, 1, result.assembly_length, out);
+    }
+    if (result.diagnostics_length > 0) {
+        fwrite(result.diagnostics, 1, result.diagnostics_length, out);
+    }
+    compile_result_free(&result);
+    return fflush(out) == 0 ? 0 : -1;
+}
+
+static void serve_stream(Server* server, FILE* in, FILE* out) {
+    while (!server->shutdown && serve_request(server, in, out) == 0) {
+    }
+}
+
+static int serve_socket(Server* server, const char* socket_path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Server: socket path too long: %s\n", socket_path);
+        return 1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+    unlink(socket_path);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 16) != 0) {
+        perror(socket_path);
+        close(listener);
+        return 1;
+    }
+    TRACE(TRACE_PARSE, TRACE_LEVEL_INFO, "Serving on %s\n", socket_path);
+
+    // Connections are served one at a time, each for as many requests as
+    // the client sends
+    while (!server->shutdown) {
+        int connection = accept(listener, NULL, NULL);
+        if (connection < 0) {
+            continue;
+        }
+        FILE* in = fdopen(connection, "r");
+        if (in == NULL) {
+            close(connection);
+            continue;
+        }
+        FILE* out = fdopen(dup(connection), "w");
+        if (out != NULL) {
+            serve_stream(server, in, out);
+            fclose(out);
+        }
+        fclose(in);
+    }
+
+    close(listener);
+    unlink(socket_path);
+    return 0;
+}
+
+int server_run(const char* socket_path) {
+    Server server;
+    memset(&server, 0, sizeof(server));
+    server.session = compile_session_create();
+    if (server.session == NULL) {
+        fprintf(stderr, "Server: could not create a compile session\n");
+        return 1;
+    }
+    // A client that disconnects mid-response must not end the server
+    signal(SIGPIPE, SIG_IGN);
+
+    int result = 0;
+    if (socket_path == NULL) {
+        serve_stream(&server, stdin, stdout);
+    } else {
+        result = serve_socket(&server, socket_path);
+    }
+
+    TRACE(TRACE_PARSE, TRACE_LEVEL_INFO, "Served %d requests, %f seconds compiling.\n",
+          server.requests, server.compile_seconds);
+    compile_session_free(server.session);
+    free(server.source);
+    return result;
+}
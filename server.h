@@ -0,0 +1,24 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+// Compile server. Requests and responses are framed the same way on a Unix
+// socket and on stdin/stdout:
+//
+//   request:   compile <length>[ stream]\n<length bytes of source>
+//              shutdown\n                  (stops a socket server)
+//   response:  result <status> <assembly length> <diagnostics length> <microseconds>\n
+//              <assembly><diagnostics>
+//
+// A request for more than SERVER_MAX_SOURCE bytes, or one there is no
+// memory for, is answered with status 1 and the reason as diagnostics, and
+// the connection is closed without reading its source.
+//
+// All requests are compiled by one warm CompileSession, see libcompiler.h.
+
+#define SERVER_MAX_SOURCE (64 << 20)
+
+// Serve on the Unix socket at socket_path, or on stdin/stdout when it is
+// NULL. Returns 0 after a shutdown request or the end of stdin.
+int server_run(const char* socket_path);
+
+#endif // SERVER_H
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "source.h"
+#include "trace.h"
+
+// Copy text that is already in memory, adding the two trailing NULs
+int source_from_buffer(SourceBuffer* source, const char* text, size_t length) {
+    memset(source, 0, sizeof(SourceBuffer));
+    source->data = malloc(length + 2);
+    if (source->data == NULL) {
+        return -1;
+    }
+    memcpy(source->data, text, length);
+    source->data[length] = '\0';
+    source->data[length + 1] = '\0';
+    source->length = length;
+    return 0;
+}
+
+// Read a stream to the end into a malloc'd buffer with two trailing NULs
+int source_read_stream(SourceBuffer* source, FILE* stream) {
+    size_t capacity = 65536;
+    memset(source, 0, sizeof(SourceBuffer));
+    source->data = malloc(capacity);
+    if (source->data == NULL) {
+        return -1;
+    }
+
+    size_t n;
+    while ((n = fread(source->data + source->length, 1, capacity - source->length - 2, stream)) > 0) {
+        source->length += n;
+        if (capacity - source->length - 2 == 0) {
+            capacity *= 2;
+            char* grown = realloc(source->data, capacity);
+            if (grown == NULL) {
+                free(source->data);
+                source->data = NULL;
+                return -1;
+            }
+            source->data = grown;
+        }
+    }
+    source->data[source->length] = '\0';
+    source->data[source->length + 1] = '\0';
+    TRACE(TRACE_LEX, TRACE_LEVEL_INFO, "Read %zu bytes of source from a stream\n", source->length);
+    return ferror(stream) ? -1 : 0;
+}
+
+// Map a source file. Returns 0 on success and -1 with errno set on failure.
+int source_open(SourceBuffer* source, const char* path) {
+    memset(source, 0, sizeof(SourceBuffer));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        FILE* stream = fdopen(fd, "r");
+        if (stream == NULL) {
+            close(fd);
+            return -1;
+        }
+        int result = source_read_stream(source, stream);
+        fclose(stream);
+        return result;
+    }
+
+    size_t length = (size_t)st.st_size;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t map_length = (length + 2 + page - 1) / page * page;
+
+    // Reserve zero-filled memory for the text plus the NULs, then map the
+    // file over the front of it. The mapping is private and writable because
+    // flex briefly writes a NUL after each token; only touched pages are copied.
+    char* base = mmap(NULL, map_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    if (mmap(base, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, map_length);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    madvise(base, length, MADV_SEQUENTIAL);
+
+    source->data = base;
+    source->length = length;
+    source->map_length = map_length;
+    TRACE(TRACE_LEX, TRACE_LEVEL_INFO, "Mapped %zu bytes of source from %s\n", length, path);
+    return 0;
+}
+
+// Index the line starts. Only done when a line number is first asked for,
+// normally because of an error, so a clean compile never scans for newlines.
+static void build_line_index(SourceBuffer* source) {
+    int capacity = 1024;
+    source->line_starts = malloc(capacity * sizeof(size_t));
+    source->line_starts[0] = 0;
+    source->line_count = 1;
+
+    const char* text = source->data;
+    const char* end = text + source->length;
+    for (const char* p = memchr(text, '\n', source->length); p != NULL;
+         p = memchr(p + 1, '\n', end - p - 1)) {
+        if (source->line_count == capacity) {
+            capacity *= 2;
+            source->line_starts = realloc(source->line_starts, capacity * sizeof(size_t));
+        }
+        source->line_starts[source->line_count++] = (size_t)(p + 1 - text);
+    }
+}
+
+// 1-based line containing the byte at offset
+int source_line(SourceBuffer* source, size_t offset) {
+    if (source->data == NULL) {
+        return 0;
+    }
+    if (source->line_starts == NULL) {
+        build_line_index(source);
+    }
+    int low = 0;
+    int high = source->line_count - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (source->line_starts[mid] <= offset) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low + 1;
+}
+
+// 1-based column of the byte at offset
+int source_column(SourceBuffer* source, size_t offset) {
+    int line = source_line(source, offset);
+    if (line == 0) {
+        return 0;
+    }
+    return (int)(offset - source->line_starts[line - 1]) + 1;
+}
+
+// Number of lines in the text, counted without building the line index
+int source_count_lines(SourceBuffer* source) {
+    if (source->length == 0) {
+        return 0;
+    }
+    int count = 0;
+    const char* end = source->data + source->length;
+    for (const char* p = memchr(source->data, '\n', source->length); p != NULL;
+         p = memchr(p + 1, '\n', end - p - 1)) {
+        count++;
+    }
+    return end[-1] == '\n' ? count : count + 1;
+}
+
+void source_close(SourceBuffer* source) {
+    if (source->map_length > 0) {
+        munmap(source->data, source->map_length);
+    } else {
+        free(source->data);
+    }
+    free(source->line_starts);
+    memset(source, 0, sizeof(SourceBuffer));
+}
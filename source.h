@@ -0,0 +1,26 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// The whole program text held in memory, followed by the two NUL bytes
+// flex's yy_scan_buffer() needs. Regular files are memory-mapped; anything
+// else (stdin, pipes, empty files) is read into a malloc'd buffer.
+typedef struct {
+    char* data;          // Source text, data[length] and data[length + 1] are '\0'
+    size_t length;       // Length of the text, excluding the NULs
+    size_t map_length;   // Bytes mapped, 0 when data was malloc'd
+    size_t* line_starts; // Offset of the first byte of each line, built on first use
+    int line_count;
+} SourceBuffer;
+
+int source_open(SourceBuffer* source, const char* path);
+int source_read_stream(SourceBuffer* source, FILE* stream);
+int source_from_buffer(SourceBuffer* source, const char* text, size_t length);
+int source_line(SourceBuffer* source, size_t offset);
+int source_column(SourceBuffer* source, size_t offset);
+int source_count_lines(SourceBuffer* source);
+void source_close(SourceBuffer* source);
+
+#endif // SOURCE_H
@@ -0,0 +1,388 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssa.h"
+#include "arena.h"
+
+static int variable_of(SSAForm* ssa, TACOperand operand) {
+    int key = tac_operand_key(operand);
+    if (key < 0) {
+        return -1;
+    }
+    int v = ssa->variable_of_key[key];
+    if (v >= 0 && v < ssa->variable_count && ssa->variables[v].key == key) {
+        return v;
+    }
+    grow_array((void**) &ssa->variables, &ssa->variable_capacity, ssa->variable_count + 1, sizeof(SSAVariable));
+    grow_array((void**) &ssa->current, &ssa->current_capacity, ssa->variable_count + 1, sizeof(int));
+    v = ssa->variable_count++;
+    ssa->current[v] = 0;
+    SSAVariable* variable = &ssa->variables[v];
+    variable->operand = operand;
+    variable->key = key;
+    variable->in_memory = 0;
+    variable->def_count = 0;
+    variable->exposed = 0;
+    ssa->variable_of_key[key] = v;
+    return v;
+}
+
+static void push_log(SSAForm* ssa, int* count, int a, int b) {
+    grow_array((void**) &ssa->log, &ssa->log_capacity, *count + 2, sizeof(int));
+    ssa->log[(*count)++] = a;
+    ssa->log[(*count)++] = b;
+}
+
+// Number the variables and find, for each, the blocks that assign it and
+// whether some block reads it before assigning it. The (variable, block)
+// pairs of the assignments go to the log.
+static int find_variables(SSAForm* ssa, CFG* cfg, TACBuffer* tac) {
+    int pairs = 0;
+    for (int b = 0; b < cfg->block_count; b++) {
+        for (int i = cfg->blocks[b].first; i < cfg->blocks[b].end; i++) {
+            TACInstruction* instr = &tac->items[i];
+            TACOperand* operands[3] = { &instr->arg1, &instr->arg2, &instr->result };
+            for (int o = 0; o < 3; o++) {
+                int v = variable_of(ssa, *operands[o]);
+                if (v < 0) {
+                    continue;
+                }
+                // current[] holds the block + 1 that last assigned the variable
+                SSAVariable* variable = &ssa->variables[v];
+                variable->in_memory |= operands[o]->kind == OPERAND_ELEMENT;
+                if (o < 2) {
+                    variable->exposed |= ssa->current[v] != b + 1;
+                } else if (ssa->current[v] != b + 1) {
+                    ssa->current[v] = b + 1;
+                    variable->def_count++;
+                    push_log(ssa, &pairs, v, b);
+                }
+            }
+        }
+    }
+    return pairs;
+}
+
+// Dominance frontiers by the method of Cooper, Harvey and Kennedy: walking
+// up the dominator tree from each predecessor of a join until its immediate
+// dominator adds the join to the frontier of every block passed. One pass
+// counts, a second fills the slices.
+static void find_frontiers(SSAForm* ssa, CFG* cfg) {
+    int* stamp = ssa->block_stamp;
+    grow_array((void**) &ssa->frontier_start, &ssa->frontier_start_capacity, cfg->block_count + 1, sizeof(int));
+    memset(ssa->frontier_start, 0, (cfg->block_count + 1) * sizeof(int));
+    memset(stamp, 0, cfg->block_count * sizeof(int));
+
+    for (int pass = 0; pass < 2; pass++) {
+        int mark = pass == 0 ? 1 : -1;  // Joins are stamped b + 1 in the first pass, -(b + 1) in the second
+        for (int i = 0; i < cfg->reachable_count; i++) {
+            int b = cfg->rpo_order[i];
+            BasicBlock* block = &cfg->blocks[b];
+            if (block->predecessor_count < 2) {
+                continue;
+            }
+            for (int p = 0; p < block->predecessor_count; p++) {
+                int runner = cfg->predecessors[block->predecessor_start + p];
+                if (cfg->blocks[runner].rpo < 0) {
+                    continue;
+                }
+                while (runner != block->idom && stamp[runner] != mark * (b + 1)) {
+                    stamp[runner] = mark * (b + 1);
+                    if (pass == 0) {
+                        ssa->frontier_start[runner + 1]++;
+                    } else {
+                        ssa->frontiers[ssa->block_work[runner]++] = b;
+                    }
+                    runner = cfg->blocks[runner].idom;
+                }
+            }
+        }
+
+        if (pass == 0) {
+            for (int b = 0; b < cfg->block_count; b++) {
+                ssa->frontier_start[b + 1] += ssa->frontier_start[b];
+                ssa->block_work[b] = ssa->frontier_start[b];
+            }
+            ssa->frontier_count = ssa->frontier_start[cfg->block_count];
+            grow_array((void**) &ssa->frontiers, &ssa->frontier_capacity, ssa->frontier_count, sizeof(int));
+        }
+    }
+}
+
+// Cytron's placement: a variable assigned in more than one block, or read
+// before it is assigned somewhere, gets a phi at the iterated dominance
+// frontier of the blocks assigning it. A variable assigned in one block
+// and only read after that in the same block never meets another version.
+// The (variable, block) pairs of the assignments are at log[0, pairs); the
+// phis are grouped by block.
+static void place_phis(SSAForm* ssa, CFG* cfg, int pairs) {
+    int variable_count = ssa->variable_count;
+
+    // Blocks assigning each variable, as slices stored in the log after
+    // the pairs
+    int def_start = pairs;
+    grow_array((void**) &ssa->log, &ssa->log_capacity, pairs + pairs / 2, sizeof(int));
+    int* defs = ssa->log + def_start;
+    int* starts = ssa->current;
+    memset(starts, 0, variable_count * sizeof(int));
+    for (int p = 0; p < pairs; p += 2) {
+        starts[ssa->log[p]]++;
+    }
+    int offset = 0;
+    for (int v = 0; v < variable_count; v++) {
+        int count = starts[v];
+        starts[v] = offset;
+        offset += count;
+    }
+    for (int p = 0; p < pairs; p += 2) {
+        defs[starts[ssa->log[p]]++] = ssa->log[p + 1];
+    }
+    // starts[v] is now the end of v's slice; it begins at the end of v - 1's
+
+    int* has_phi = ssa->block_stamp;
+    int* queued = ssa->block_work;
+    memset(has_phi, 0, cfg->block_count * sizeof(int));
+    memset(queued, 0, cfg->block_count * sizeof(int));
+    grow_array((void**) &ssa->block_phis, &ssa->block_phis_capacity, cfg->block_count + 1, sizeof(int));
+    memset(ssa->block_phis, 0, (cfg->block_count + 1) * sizeof(int));
+
+    int phi_pairs = def_start + pairs / 2;
+    int phi_end = phi_pairs;
+    for (int v = 0; v < variable_count; v++) {
+        SSAVariable* variable = &ssa->variables[v];
+        int first = v == 0 ? 0 : starts[v - 1];
+        if (variable->in_memory || variable->def_count == 0 ||
+            (variable->def_count == 1 && !variable->exposed)) {
+            continue;
+        }
+        int pending = 0;
+        for (int d = first; d < starts[v]; d++) {
+            int b = defs[d];
+            if (cfg->blocks[b].rpo >= 0) {
+                queued[b] = v + 1;
+                ssa->worklist[pending++] = b;
+            }
+        }
+        while (pending > 0) {
+            int b = ssa->worklist[--pending];
+            for (int f = ssa->frontier_start[b]; f < ssa->frontier_start[b + 1]; f++) {
+                int join = ssa->frontiers[f];
+                if (has_phi[join] == v + 1) {
+                    continue;
+                }
+                has_phi[join] = v + 1;
+                grow_array((void**) &ssa->log, &ssa->log_capacity, phi_end + 2, sizeof(int));
+                defs = ssa->log + def_start;
+                ssa->log[phi_end++] = v;
+                ssa->log[phi_end++] = join;
+                ssa->block_phis[join + 1]++;
+                if (queued[join] != v + 1) {
+                    queued[join] = v + 1;
+                    ssa->worklist[pending++] = join;
+                }
+            }
+        }
+    }
+
+    ssa->phi_count = (phi_end - phi_pairs) / 2;
+    grow_array((void**) &ssa->phis, &ssa->phi_capacity, ssa->phi_count, sizeof(Phi));
+    for (int b = 0; b < cfg->block_count; b++) {
+        ssa->block_phis[b + 1] += ssa->block_phis[b];
+        queued[b] = ssa->block_phis[b];
+    }
+    for (int p = phi_pairs; p < phi_end; p += 2) {
+        Phi* phi = &ssa->phis[queued[ssa->log[p + 1]]++];
+        phi->variable = ssa->log[p];
+        phi->block = ssa->log[p + 1];
+        phi->value = SSA_NO_VALUE;
+    }
+
+    // One argument per predecessor, filled in by the renaming
+    ssa->phi_arg_count = 0;
+    for (int p = 0; p < ssa->phi_count; p++) {
+        ssa->phis[p].arg_start = ssa->phi_arg_count;
+        ssa->phi_arg_count += cfg->blocks[ssa->phis[p].block].predecessor_count;
+    }
+    grow_array((void**) &ssa->phi_args, &ssa->phi_arg_capacity, ssa->phi_arg_count, sizeof(int));
+    for (int a = 0; a < ssa->phi_arg_count; a++) {
+        ssa->phi_args[a] = SSA_NO_VALUE;
+    }
+}
+
+static int new_value(SSAForm* ssa, int variable, int def) {
+    if (ssa->value_count == ssa->value_capacity) {
+        ssa->value_capacity = ssa->value_capacity ? 2 * ssa->value_capacity : 1024;
+        ssa->value_variable = realloc(ssa->value_variable, ssa->value_capacity * sizeof(int));
+        ssa->value_def = realloc(ssa->value_def, ssa->value_capacity * sizeof(int));
+        if (ssa->value_variable == NULL || ssa->value_def == NULL) {
+            fprintf(stderr, "Memory allocation failed for the SSA form\n");
+            exit(1);
+        }
+    }
+    ssa->value_variable[ssa->value_count] = variable;
+    ssa->value_def[ssa->value_count] = def;
+    return ssa->value_count++;
+}
+
+// Give every assignment a new value and tag every use with the value
+// reaching it, walking the dominator tree in preorder. current[] holds each
+// variable's value at the point reached; the log records what each
+// assignment replaced, so leaving a subtree restores the values of its
+// dominator. The walk keeps its path in worklist, with the log position
+// on entering each block in block_work.
+static void rename_values(SSAForm* ssa, CFG* cfg, TACBuffer* tac) {
+    int* current = ssa->current;
+    ssa->value_count = 0;
+    for (int v = 0; v < ssa->variable_count; v++) {
+        current[v] = new_value(ssa, v, -1);
+    }
+
+    int* path = ssa->worklist;
+    int* path_log = ssa->block_work;
+    int depth = 0;
+    int log_count = 0;
+    for (int d = 0; d < cfg->reachable_count; d++) {
+        int b = cfg->dom_order[d];
+        BasicBlock* block = &cfg->blocks[b];
+        while (depth > 0 && path[depth - 1] != block->idom) {
+            depth--;
+            while (log_count > path_log[depth]) {
+                log_count -= 2;
+                current[ssa->log[log_count]] = ssa->log[log_count + 1];
+            }
+        }
+        path[depth] = b;
+        path_log[depth] = log_count;
+        depth++;
+
+        for (int p = ssa->block_phis[b]; p < ssa->block_phis[b + 1]; p++) {
+            Phi* phi = &ssa->phis[p];
+            phi->value = new_value(ssa, phi->variable, -2 - p);
+            push_log(ssa, &log_count, phi->variable, current[phi->variable]);
+            current[phi->variable] = phi->value;
+        }
+
+        for (int i = block->first; i < block->end; i++) {
+            TACInstruction* instr = &tac->items[i];
+            int* values = &ssa->values[3 * (i - ssa->start)];
+            TACOperand* args[2] = { &instr->arg1, &instr->arg2 };
+            for (int a = 0; a < 2; a++) {
+                int v = variable_of(ssa, *args[a]);
+                if (v >= 0 && !ssa->variables[v].in_memory) {
+                    values[1 + a] = current[v];
+                }
+            }
+            int v = variable_of(ssa, instr->result);
+            if (v >= 0 && !ssa->variables[v].in_memory) {
+                values[0] = new_value(ssa, v, i);
+                push_log(ssa, &log_count, v, current[v]);
+                current[v] = values[0];
+            }
+        }
+
+        for (int s = 0; s < 2; s++) {
+            int succ = block->successors[s];
+            if (succ < 0) {
+                continue;
+            }
+            BasicBlock* target = &cfg->blocks[succ];
+            int position = 0;
+            while (cfg->predecessors[target->predecessor_start + position] != b) {
+                position++;
+            }
+            for (int p = ssa->block_phis[succ]; p < ssa->block_phis[succ + 1]; p++) {
+                ssa->phi_args[ssa->phis[p].arg_start + position] = current[ssa->phis[p].variable];
+            }
+        }
+    }
+}
+
+void ssa_build(SSAForm* ssa, CFG* cfg, TACBuffer* tac, int key_count) {
+    ssa->start = cfg->block_count > 0 ? cfg->blocks[0].first : tac->count;
+    int count = tac->count - ssa->start;
+    ssa->variable_count = 0;
+    ssa->phi_count = 0;
+    ssa->phi_arg_count = 0;
+    ssa->value_count = 0;
+    ssa->frontier_count = 0;
+
+    // Stale entries of variable_of_key are caught by the key check
+    if (key_count > ssa->key_capacity) {
+        int old_capacity = ssa->key_capacity;
+        grow_array((void**) &ssa->variable_of_key, &ssa->key_capacity, key_count, sizeof(int));
+        memset(ssa->variable_of_key + old_capacity, 0, (ssa->key_capacity - old_capacity) * sizeof(int));
+    }
+    if (cfg->block_count + 1 > ssa->block_scratch_capacity) {
+        int capacity = cfg->block_count + 1;
+        ssa->block_stamp = realloc(ssa->block_stamp, capacity * sizeof(int));
+        ssa->block_work = realloc(ssa->block_work, capacity * sizeof(int));
+        ssa->worklist = realloc(ssa->worklist, capacity * sizeof(int));
+        if (ssa->block_stamp == NULL || ssa->block_work == NULL || ssa->worklist == NULL) {
+            fprintf(stderr, "Memory allocation failed for the SSA form\n");
+            exit(1);
+        }
+        ssa->block_scratch_capacity = capacity;
+    }
+    grow_array((void**) &ssa->values, &ssa->values_capacity, 3 * count, sizeof(int));
+    for (int i = 0; i < 3 * count; i++) {
+        ssa->values[i] = SSA_NO_VALUE;
+    }
+    if (cfg->reachable_count == 0) {
+        return;
+    }
+
+    int pairs = find_variables(ssa, cfg, tac);
+    find_frontiers(ssa, cfg);
+    place_phis(ssa, cfg, pairs);
+    rename_values(ssa, cfg, tac);
+}
+
+void ssa_free(SSAForm* ssa) {
+    free(ssa->variables);
+    free(ssa->variable_of_key);
+    free(ssa->values);
+    free(ssa->value_variable);
+    free(ssa->value_def);
+    free(ssa->phis);
+    free(ssa->block_phis);
+    free(ssa->phi_args);
+    free(ssa->frontier_start);
+    free(ssa->frontiers);
+    free(ssa->current);
+    free(ssa->block_stamp);
+    free(ssa->block_work);
+    free(ssa->worklist);
+    free(ssa->log);
+    memset(ssa, 0, sizeof(SSAForm));
+}
+
+void ssa_write(FILE* file, InternTable* atoms, SSAForm* ssa, CFG* cfg, TACBuffer* tac) {
+    char line[256];
+    char name[64];
+    for (int b = 0; b < cfg->block_count; b++) {
+        BasicBlock* block = &cfg->blocks[b];
+        fprintf(file, "B%d:\n", b);
+        for (int p = ssa->block_phis[b]; p < ssa->block_phis[b + 1] && cfg->reachable_count > 0; p++) {
+            Phi* phi = &ssa->phis[p];
+            fprintf(file, "    v%d = phi %s(", phi->value,
+                    tac_operand_text(atoms, ssa->variables[phi->variable].operand, name, sizeof(name)));
+            for (int a = 0; a < block->predecessor_count; a++) {
+                fprintf(file, a == 0 ? "v%d" : ", v%d", ssa->phi_args[phi->arg_start + a]);
+            }
+            fprintf(file, ")\n");
+        }
+        for (int i = block->first; i < block->end; i++) {
+            tac_format(atoms, &tac->items[i], line, sizeof(line));
+            fprintf(file, "    %-32s", line);
+            const char* separator = " ;";
+            for (int slot = 0; slot < 3; slot++) {
+                int value = ssa_value(ssa, i, slot);
+                if (value != SSA_NO_VALUE) {
+                    fprintf(file, "%s %s v%d", separator, slot == 0 ? "defines" : "uses", value);
+                    separator = ",";
+                }
+            }
+            fprintf(file, "\n");
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef SSA_H
+#define SSA_H
+
+#include <stdio.h>
+#include "cfg.h"
+
+// Static single assignment form of the TAC a CFG covers. It is kept beside
+// the instructions instead of being written into them: every definition of
+// a variable or temporary is a numbered value, every use is tagged with the
+// value that reaches it, and phis sit at the iterated dominance frontiers
+// of the blocks that assign a variable.
+//
+// The TAC stays conventional SSA: a pass may only rewrite a use to a value
+// that is still the current one of its variable at that point, so the
+// versions of a variable never overlap. Leaving SSA is then dropping the
+// phis and the value numbers; no copies need to be inserted.
+
+#define SSA_NO_VALUE (-1)
+
+// Variables and temporaries the form renames. Arrays are memory that
+// element loads and stores reach too, so a variable also used as an array
+// keeps one name and its operands get SSA_NO_VALUE.
+typedef struct {
+    TACOperand operand;
+    int key;                // tac_operand_key() of the operand
+    int in_memory;
+    int def_count;          // Blocks that assign it
+    int exposed;            // Read in some block before that block assigns it
+} SSAVariable;
+
+typedef struct {
+    int variable;
+    int value;
+    int block;
+    int arg_start;          // Slice of SSAForm.phi_args, one value per predecessor of block in CFG order
+} Phi;
+
+typedef struct {
+    int start;              // First instruction of the CFG's range
+
+    SSAVariable* variables;
+    int variable_count;
+    int variable_capacity;
+    int* variable_of_key;   // tac_operand_key() -> variable, checked against variables[].key
+    int key_capacity;
+
+    // Values 0 to variable_count - 1 are the variables' values on entry.
+    // value_def holds the defining instruction, -1 for those entry values
+    // and -2 - phi for phis.
+    int* values;            // Three per instruction from start on, for result, arg1 and arg2
+    int values_capacity;
+    int* value_variable;
+    int* value_def;
+    int value_count;
+    int value_capacity;
+
+    Phi* phis;              // Grouped by block
+    int phi_count;
+    int phi_capacity;
+    int* block_phis;        // Phis of block b are [block_phis[b], block_phis[b + 1])
+    int block_phis_capacity;
+    int* phi_args;
+    int phi_arg_count;
+    int phi_arg_capacity;
+
+    // Dominance frontiers, one slice per block
+    int* frontier_start;
+    int frontier_start_capacity;
+    int* frontiers;
+    int frontier_count;
+    int frontier_capacity;
+
+    // Scratch, indexed by variable and by block
+    int* current;
+    int current_capacity;
+    int* block_stamp;
+    int* block_work;
+    int* worklist;
+    int block_scratch_capacity;
+    int* log;
+    int log_capacity;
+} SSAForm;
+
+// Build the SSA form of the instructions cfg was built from. key_count
+// bounds tac_operand_key() of their operands.
+void ssa_build(SSAForm* ssa, CFG* cfg, TACBuffer* tac, int key_count);
+void ssa_free(SSAForm* ssa);
+
+// Value tagged on operand slot (0 result, 1 arg1, 2 arg2) of instruction
+static inline int ssa_value(SSAForm* ssa, int instruction, int slot) {
+    return ssa->values[3 * (instruction - ssa->start) + slot];
+}
+
+// Write the instructions with their values and the phis, block by block
+void ssa_write(FILE* file, InternTable* atoms, SSAForm* ssa, CFG* cfg, TACBuffer* tac);
+
+#endif // SSA_H
@@ -2,118 +2,243 @@
 #include <stdlib.h>
 #include <string.h>
 #include "symbol_table.h"
+#include "trace.h"
+
+// Initialize an empty symbol table. Names are printed through atoms and
+// errors are reported to errors.
+void init_symbol_table(SymbolTable* table, InternTable* atoms, FILE* errors) {
+    memset(table, 0, sizeof(SymbolTable));
+    table->atoms = atoms;
+    table->errors = errors;
+}
 
-#define TABLE_SIZE 100
+// Index of the first symbol of the innermost scope
+static int scope_first(SymbolTable* table) {
+    return table->scope_count > 0 ? table->scopes[table->scope_count - 1].first : 0;
+}
 
-Symbol symbol_table[TABLE_SIZE];
-int symbol_count = 0;
+// Function the innermost scope belongs to, ATOM_GLOBAL outside functions
+Atom scope_name(SymbolTable* table) {
+    return table->scope_count > 0 ? table->scopes[table->scope_count - 1].name : ATOM_GLOBAL;
+}
 
-// Initialize the symbol table
-void init_symbol_table() {
-    symbol_count = 0;
+// Make room for one more symbol named name and return it, linked in front
+// of any outer symbol with the same name
+static Symbol* add_symbol(SymbolTable* table, Atom name) {
+    if (table->count == table->capacity) {
+        table->capacity = table->capacity ? table->capacity * 2 : 256;
+        table->symbols = realloc(table->symbols, table->capacity * sizeof(Symbol));
+        if (table->symbols == NULL) {
+            fprintf(stderr, "Memory allocation failed for the symbol table\n");
+            exit(1);
+        }
+    }
+    if (name >= table->slot_capacity) {
+        int new_capacity = table->slot_capacity ? table->slot_capacity : 256;
+        while (new_capacity <= name) {
+            new_capacity *= 2;
+        }
+        table->slots = realloc(table->slots, new_capacity * sizeof(int));
+        if (table->slots == NULL) {
+            fprintf(stderr, "Memory allocation failed for the symbol table\n");
+            exit(1);
+        }
+        for (int i = table->slot_capacity; i < new_capacity; i++) {
+            table->slots[i] = -1;
+        }
+        table->slot_capacity = new_capacity;
+    }
+
+    Symbol* symbol = &table->symbols[table->count];
+    memset(symbol, 0, sizeof(Symbol));
+    symbol->name = name;
+    symbol->scope = scope_name(table);
+    symbol->shadowed = table->slots[name];
+    table->slots[name] = table->count;
+    table->count++;
+    return symbol;
+}
+
+static void release_symbol(Symbol* symbol) {
+    if (symbol->functionInfo != NULL) {
+        free(symbol->functionInfo->paramTypes);
+        free(symbol->functionInfo);
+    }
+    free(symbol->value);
 }
 
 // Insert a new symbol
 // Update insert_symbol to handle values
-void insert_symbol(char *name, char *type, char** paramTypes, int paramCount, char* returnType) {
-    if (name == NULL || type == NULL) {
-        fprintf(stderr, "Error: NULL name or type passed to insert_symbol\n");
+void insert_symbol(SymbolTable* table, Atom name, Atom type, Atom* paramTypes, int paramCount, Atom returnType) {
+    if (name == ATOM_NONE || type == ATOM_NONE) {
+        fprintf(table->errors, "Error: NULL name or type passed to insert_symbol\n");
         return;
     }
 
-    // Check for redeclaration
-    if (lookup_symbol(name) != NULL) {
-        printf("Error: redeclaration of %s\n", name);
+    // Check for redeclaration. Hiding a name from an outer scope is fine.
+    if (lookup_local_symbol(table, name) != NULL) {
+        fprintf(table->errors, "Error: redeclaration of %s\n", atom_name(table->atoms, name));
         return;
     }
 
     // Insert new symbol
-    symbol_table[symbol_count].name = strdup(name);
-    symbol_table[symbol_count].type = strdup(type);
+    Symbol* symbol = add_symbol(table, name);
+    symbol->type = type;
 
-    if (strcmp(type, "function") == 0 && paramTypes != NULL) {
-        symbol_table[symbol_count].functionInfo = malloc(sizeof(FunctionInfo));
-        symbol_table[symbol_count].functionInfo->name = strdup(name);
-        symbol_table[symbol_count].functionInfo->returnType = returnType ? strdup(returnType) : NULL;
-        symbol_table[symbol_count].functionInfo->paramTypes = malloc(sizeof(char*) * paramCount);
-        symbol_table[symbol_count].functionInfo->paramCount = paramCount;
+    if (type == ATOM_FUNCTION && paramTypes != NULL) {
+        symbol->functionInfo = malloc(sizeof(FunctionInfo));
+        symbol->functionInfo->name = name;
+        symbol->functionInfo->returnType = returnType;
+        symbol->functionInfo->paramTypes = malloc(sizeof(Atom) * paramCount);
+        symbol->functionInfo->paramCount = paramCount;
 
         for (int i = 0; i < paramCount; i++) {
-            symbol_table[symbol_count].functionInfo->paramTypes[i] = 
-                paramTypes[i] ? strdup(paramTypes[i]) : strdup("unknown");
+            symbol->functionInfo->paramTypes[i] = paramTypes[i];
         }
-    } else {
-        symbol_table[symbol_count].functionInfo = NULL;
     }
-
-    symbol_count++;
 }
 
 
 // Insert a new array symbol
-void insert_array_symbol(char *name, char *type, int size, char *scope) {
+void insert_array_symbol(SymbolTable* table, Atom name, Atom type, int size, Atom scope) {
     // Check for redeclaration
-    if (lookup_symbol(name) != NULL) {  // Compare to NULL instead of -1
-        printf("Error: redeclaration of array %s\n", name);
+    if (lookup_local_symbol(table, name) != NULL) {
+        fprintf(table->errors, "Error: redeclaration of array %s\n", atom_name(table->atoms, name));
         return;
     }
 
     // Insert new array symbol
-    symbol_table[symbol_count].name = strdup(name);
-    symbol_table[symbol_count].type = strdup(type);
-    symbol_table[symbol_count].scope = strdup(scope);
-    symbol_table[symbol_count].is_array = 1;    // This is an array
-    symbol_table[symbol_count].array_size = size; // Size of the array, 0 for dynamic arrays
-
-    symbol_count++;
+    Symbol* symbol = add_symbol(table, name);
+    symbol->type = type;
+    symbol->scope = scope;
+    symbol->is_array = 1;    // This is an array
+    symbol->array_size = size; // Size of the array, 0 for dynamic arrays
 }
 
 
 // Add this function implementation
-void update_symbol_value(char* name, char* value) {
-    Symbol* entry = lookup_symbol(name);
+void update_symbol_value(SymbolTable* table, int index, char* value) {
+    Symbol* entry = symbol_at(table, index);
     if (entry) {
-        entry->type = strdup(value);  // Using the 'type' field to store the value
+        free(entry->value);
+        entry->value = strdup(value);
     }
 }
 
 
+// Open a scope for the body of function name. Symbols inserted until the
+// matching pop_scope() are local to it and may hide outer ones.
+void push_scope(SymbolTable* table, Atom name) {
+    if (table->scope_count == table->scope_capacity) {
+        table->scope_capacity = table->scope_capacity ? table->scope_capacity * 2 : 16;
+        table->scopes = realloc(table->scopes, table->scope_capacity * sizeof(SymbolScope));
+        if (table->scopes == NULL) {
+            fprintf(stderr, "Memory allocation failed for the symbol table\n");
+            exit(1);
+        }
+    }
+    table->scopes[table->scope_count].first = table->count;
+    table->scopes[table->scope_count].name = name;
+    table->scope_count++;
+}
 
-// Lookup a symbol by name
-Symbol* lookup_symbol(char *name) {
-    for (int i = 0; i < symbol_count; i++) {
-        if (strcmp(symbol_table[i].name, name) == 0) {
-            printf("DEBUG: Found symbol: %s, Type: %s\n", name, symbol_table[i].type);
-            return &symbol_table[i];  // Found, return pointer to symbol
+// Close the innermost scope, uncovering the symbols its locals hid. The
+// locals stay in the table under their indices until they are released;
+// the cost is one step per local, nothing depends on the size of the table.
+void pop_scope(SymbolTable* table) {
+    if (table->scope_count == 0) {
+        return;
+    }
+    int first = table->scopes[--table->scope_count].first;
+    for (int i = table->count - 1; i >= first; i--) {
+        Symbol* symbol = &table->symbols[i];
+        if (table->slots[symbol->name] == i) {
+            table->slots[symbol->name] = symbol->shadowed;
         }
     }
-    return NULL;  // Not found
+}
+
+// Release the locals of closed scopes from index first on, moving the
+// symbols that are still visible down to fill the gap. Only valid at the
+// global level, where no visible symbol shadows another.
+void release_closed_symbols(SymbolTable* table, int first) {
+    int kept = first;
+    for (int i = first; i < table->count; i++) {
+        Symbol* symbol = &table->symbols[i];
+        if (table->slots[symbol->name] == i) {
+            table->slots[symbol->name] = kept;
+            table->symbols[kept++] = *symbol;
+        } else {
+            release_symbol(symbol);
+        }
+    }
+    table->count = kept;
+}
+
+
+// Index of the innermost visible symbol called name, -1 if there is none
+int find_symbol(SymbolTable* table, Atom name) {
+    if (name <= ATOM_NONE || name >= table->slot_capacity) {
+        return -1;
+    }
+    return table->slots[name];
+}
+
+// Symbol at an index returned by find_symbol(), NULL for -1
+Symbol* symbol_at(SymbolTable* table, int index) {
+    return index >= 0 ? &table->symbols[index] : NULL;
+}
+
+// Lookup a symbol by name, innermost scope first
+Symbol* lookup_symbol(SymbolTable* table, Atom name) {
+    int index = find_symbol(table, name);
+    if (index < 0) {
+        return NULL;  // Not found
+    }
+    Symbol* symbol = &table->symbols[index];
+    TRACE(TRACE_SEMA, TRACE_LEVEL_VERBOSE, "DEBUG: Found symbol: %s, Type: %s\n",
+          atom_name(table->atoms, name), atom_name(table->atoms, symbol->type));
+    return symbol;
+}
+
+// Lookup a symbol declared in the innermost scope only
+Symbol* lookup_local_symbol(SymbolTable* table, Atom name) {
+    if (name <= ATOM_NONE || name >= table->slot_capacity || table->slots[name] < scope_first(table)) {
+        return NULL;
+    }
+    return &table->symbols[table->slots[name]];
 }
 
 // Print symbol table
-void print_symbol_table() {
+void print_symbol_table(SymbolTable* table) {
     printf("Symbol Table:\n");
     printf("Index\tName\t\tType\t\tScope\t\tArray\t\tSize\n");
     printf("----------------------------------------------------------------------------\n");
 
-    for (int i = 0; i < symbol_count; i++) {
-        printf("%d\t%s\t\t%s\t\t%s\t\t%s\t\t%d\n", i, symbol_table[i].name, symbol_table[i].type,
-               symbol_table[i].scope, symbol_table[i].is_array ? "Yes" : "No", symbol_table[i].array_size);
+    for (int i = 0; i < table->count; i++) {
+        printf("%d\t%s\t\t%s\t\t%s\t\t%s\t\t%d\n", i, atom_name(table->atoms, table->symbols[i].name), atom_name(table->atoms, table->symbols[i].type),
+               atom_name(table->atoms, table->symbols[i].scope), table->symbols[i].is_array ? "Yes" : "No", table->symbols[i].array_size);
     }
 }
 
-void freeParamTypes(char** paramTypes, int count) {
-    for (int i = 0; i < count; i++) {
-        free(paramTypes[i]);
-    }
+void freeParamTypes(Atom* paramTypes, int count) {
     free(paramTypes);
 }
 
-// Clean up symbol table
-void clean_up_symbol_table() {
-    for (int i = 0; i < symbol_count; i++) {
-        free(symbol_table[i].name);
-        free(symbol_table[i].type);
-        free(symbol_table[i].scope);
+// Empty the symbol table, keeping its memory for reuse
+void clean_up_symbol_table(SymbolTable* table) {
+    for (int i = 0; i < table->count; i++) {
+        table->slots[table->symbols[i].name] = -1;
+        release_symbol(&table->symbols[i]);
     }
-}
\ No newline at end of file
+    table->count = 0;
+    table->scope_count = 0;
+}
+
+void free_symbol_table(SymbolTable* table) {
+    clean_up_symbol_table(table);
+    free(table->symbols);
+    free(table->slots);
+    free(table->scopes);
+    init_symbol_table(table, table->atoms, table->errors);
+}
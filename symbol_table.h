@@ -1,37 +1,72 @@
 #ifndef SYMBOL_TABLE_H
 #define SYMBOL_TABLE_H
 
-#define TABLE_SIZE 100
+#include <stdio.h>
+#include "intern.h"
 
 // Define FunctionInfo structure
 typedef struct {
-    char* name;
-    char* returnType;
-    char** paramTypes;
+    Atom name;
+    Atom returnType;
+    Atom* paramTypes;
     int paramCount;
 } FunctionInfo;
 
 typedef struct {
-    char *name;     // Identifier name
-    char *type;     // Type (int, float, etc.)
+    Atom name;      // Identifier name
+    Atom type;      // Type (int, float, etc.)
     int is_initialized; // New field to track initialization status
     FunctionInfo* functionInfo;
-    char *scope;
+    Atom scope;
     int is_array;
     int array_size;
      char* value;
+    int shadowed;   // Index of the outer symbol this one hides, -1 if none
 } Symbol;
 
-// Declare symbol table functions
-void init_symbol_table();
-void insert_symbol(char *name, char *type, char** paramTypes, int paramCount, char* returnType);
-Symbol* lookup_symbol(char *name);  // Ensure this matches the definition in symbol_table.c
-void insert_array_symbol(char *name, char *type, int size, char *scope);
-void print_symbol_table();
-void freeParamTypes(char** paramTypes, int count);
-void clean_up_symbol_table();
+// A scope opened by push_scope()
+typedef struct {
+    int first;      // Index of the scope's first symbol
+    Atom name;      // Function the scope belongs to
+} SymbolScope;
+
+// Symbols are kept in declaration order, innermost scope last. Names are
+// atoms, which are small dense integers, so slots maps a name straight to
+// the index of its innermost visible symbol without hashing or probing.
+// Closing a scope only hides its locals: the name resolver stores symbol
+// indices in the AST, and later phases use them after the scope is gone.
+typedef struct {
+    Symbol* symbols;
+    int count;
+    int capacity;
+    int* slots;             // Atom -> index in symbols, -1 when undeclared
+    int slot_capacity;
+    SymbolScope* scopes;    // Open scopes, not counting the global one
+    int scope_count;
+    int scope_capacity;
+    InternTable* atoms;     // Pool the symbol names belong to
+    FILE* errors;           // Where redeclarations are reported
+} SymbolTable;
+
+// Declare symbol table functions. A Symbol* stays valid until the next
+// insert, a symbol index until its symbol is released.
+void init_symbol_table(SymbolTable* table, InternTable* atoms, FILE* errors);
+void insert_symbol(SymbolTable* table, Atom name, Atom type, Atom* paramTypes, int paramCount, Atom returnType);
+Symbol* lookup_symbol(SymbolTable* table, Atom name);  // Ensure this matches the definition in symbol_table.c
+Symbol* lookup_local_symbol(SymbolTable* table, Atom name);
+int find_symbol(SymbolTable* table, Atom name);
+Symbol* symbol_at(SymbolTable* table, int index);
+void insert_array_symbol(SymbolTable* table, Atom name, Atom type, int size, Atom scope);
+void push_scope(SymbolTable* table, Atom name);
+void pop_scope(SymbolTable* table);
+Atom scope_name(SymbolTable* table);
+void release_closed_symbols(SymbolTable* table, int first);
+void print_symbol_table(SymbolTable* table);
+void freeParamTypes(Atom* paramTypes, int count);
+void clean_up_symbol_table(SymbolTable* table);
+void free_symbol_table(SymbolTable* table);
 // Add this function declaration
-void update_symbol_value(char* name, char* value);
+void update_symbol_value(SymbolTable* table, int index, char* value);
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tac.h"
+
+#define TAC_INITIAL_CAPACITY 1024
+
+TACInstruction* tac_append(TACBuffer* tac, TACOpcode opcode, TACOperand result, TACOperand arg1, TACOperand arg2) {
+    if (tac->count >= tac->capacity) {
+        tac->capacity = tac->capacity ? tac->capacity * 2 : TAC_INITIAL_CAPACITY;
+        tac->items = realloc(tac->items, tac->capacity * sizeof(TACInstruction));
+        if (tac->items == NULL) {
+            fprintf(stderr, "Memory allocation failed for TAC\n");
+            exit(1);
+        }
+    }
+    TACInstruction* instr = &tac->items[tac->count++];
+    instr->opcode = opcode;
+    instr->is_dead = 0;
+    instr->is_optimized = 0;
+    instr->wraps = 0;
+    instr->result = result;
+    instr->arg1 = arg1;
+    instr->arg2 = arg2;
+    return instr;
+}
+
+// Drop every instruction from count on. The memory is kept for reuse.
+void tac_truncate(TACBuffer* tac, int count) {
+    if (count < tac->count) {
+        tac->count = count;
+    }
+}
+
+int tac_compact(TACBuffer* tac, int start) {
+    int kept = start;
+    for (int i = start; i < tac->count; i++) {
+        if (!tac->items[i].is_dead) {
+            tac->items[kept++] = tac->items[i];
+        }
+    }
+    int removed = tac->count - kept;
+    tac->count = kept;
+    return removed;
+}
+
+void tac_free(TACBuffer* tac) {
+    free(tac->items);
+    tac->items = NULL;
+    tac->count = 0;
+    tac->capacity = 0;
+}
+
+// Binary operators in opcode order, from TAC_ADD on
+static const char* binary_symbols[] = { "+", "-", "*", "/", "<", ">", "==", "!=", "AND", "OR" };
+
+int tac_binary_opcode(const char* op) {
+    for (int i = 0; i <= TAC_OR - TAC_ADD; i++) {
+        if (strcmp(op, binary_symbols[i]) == 0) {
+            return TAC_ADD + i;
+        }
+    }
+    return -1;
+}
+
+const char* tac_opcode_symbol(TACOpcode opcode) {
+    if (opcode >= TAC_ADD && opcode <= TAC_OR) {
+        return binary_symbols[opcode - TAC_ADD];
+    }
+    return "";
+}
+
+const char* tac_operand_text(InternTable* atoms, TACOperand operand, char* buffer, size_t size) {
+    switch (operand.kind) {
+        case OPERAND_TEMP:
+        case OPERAND_LABEL:
+            snprintf(buffer, size, "t%d", operand.number);
+            return buffer;
+        case OPERAND_FLOAT_TEMP:
+            snprintf(buffer, size, "f%d", operand.number);
+            return buffer;
+        case OPERAND_VARIABLE:
+        case OPERAND_ELEMENT:
+            return atom_name(atoms, operand.name);
+        case OPERAND_INT:
+            snprintf(buffer, size, "%d", operand.int_value);
+            return buffer;
+        case OPERAND_FLOAT:
+            snprintf(buffer, size, "%f", operand.float_value);
+            return buffer;
+    }
+    return "";
+}
+
+int tac_format(InternTable* atoms, TACInstruction* instr, char* buffer, size_t size) {
+    char result_text[64], arg1_text[64], arg2_text[64];
+    const char* arg1 = tac_operand_text(atoms, instr->arg1, arg1_text, sizeof(arg1_text));
+    switch (instr->opcode) {
+        case TAC_PRINT:
+            return snprintf(buffer, size, "print %s", arg1);
+        case TAC_IFFALSE:
+            return snprintf(buffer, size, "ifFalse %s goto %s", arg1, tac_operand_text(atoms, instr->arg2, arg2_text, sizeof(arg2_text)));
+        case TAC_LABEL:
+            return snprintf(buffer, size, "label %s", arg1);
+        case TAC_JUMP:
+            return snprintf(buffer, size, "j %s", arg1);
+        case TAC_PARAM:
+            return snprintf(buffer, size, "param %s", arg1);
+        case TAC_RETURN:
+            return snprintf(buffer, size, "return %s", arg1);
+    }
+    const char* result = tac_operand_text(atoms, instr->result, result_text, sizeof(result_text));
+    if (instr->opcode != TAC_COPY) {
+        return snprintf(buffer, size, "%s = %s %s %s%s", result, arg1, tac_opcode_symbol(instr->opcode),
+                        tac_operand_text(atoms, instr->arg2, arg2_text, sizeof(arg2_text)),
+                        instr->wraps ? " (wraps)" : "");
+    }
+    return snprintf(buffer, size, "%s = %s", result, arg1);
+}
+
+void tac_write(FILE* file, InternTable* atoms, TACBuffer* tac, int start) {
+    char line[256];
+    for (int i = start; i < tac->count; i++) {
+        tac_format(atoms, &tac->items[i], line, sizeof(line));
+        fprintf(file, "%s\n", line);
+    }
+}
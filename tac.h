@@ -0,0 +1,160 @@
+#ifndef TAC_H
+#define TAC_H
+
+#include <stdio.h>
+#include "intern.h"
+
+typedef enum {
+    TAC_COPY,       // result = arg1
+    TAC_ADD,        // result = arg1 op arg2, from TAC_ADD up to TAC_OR
+    TAC_SUB,
+    TAC_MUL,
+    TAC_DIV,
+    TAC_LT,
+    TAC_GT,
+    TAC_EQ,
+    TAC_NE,
+    TAC_AND,
+    TAC_OR,
+    TAC_PRINT,      // print arg1
+    TAC_IFFALSE,    // ifFalse arg1 goto arg2
+    TAC_LABEL,      // label arg1
+    TAC_JUMP,       // j arg1
+    TAC_PARAM,      // param arg1
+    TAC_RETURN      // return arg1
+} TACOpcode;
+
+typedef enum {
+    OPERAND_NONE,
+    OPERAND_TEMP,           // t12, made by newTemp()
+    OPERAND_FLOAT_TEMP,     // f3, made by newFloat() for float literals and the result of every
+                            // binary operation, integer ones included
+    OPERAND_LABEL,          // Numbered along with the temporaries, written t12 too
+    OPERAND_VARIABLE,       // A named variable
+    OPERAND_ELEMENT,        // An array element, named like "a[3]"
+    OPERAND_INT,
+    OPERAND_FLOAT
+} TACOperandKind;
+
+// An operand, tagged with its kind. Two operands are the same when their
+// kinds and the bits of the union are equal, so no comparison needs text.
+typedef struct {
+    unsigned char kind;     // TACOperandKind
+    union {
+        int number;         // Temporaries and labels
+        Atom name;          // Variables and array elements
+        int int_value;
+        float float_value;
+    };
+} TACOperand;
+
+// One three-address instruction. Operands an opcode doesn't use are
+// OPERAND_NONE, so is result for anything that doesn't assign.
+typedef struct {
+    unsigned char opcode;   // TACOpcode
+    char is_dead;           // Marked by the optimizer for tac_compact() to remove
+    char is_optimized;
+    char wraps;             // TAC_ADD or TAC_SUB that wraps around on overflow like mul
+                            // instead of trapping; only the optimizer makes these
+    TACOperand result;
+    TACOperand arg1;
+    TACOperand arg2;
+} TACInstruction;
+
+// The labels of a while loop, recorded as semantic analysis lowers it.
+// A copy of the condition, the guard, branches to exit; otherwise control
+// falls through preheader into header, where the body starts. The body is
+// followed by latch, which tests the condition again and jumps back to
+// header, so code placed after preheader runs once each time the loop is
+// entered and only then.
+typedef struct {
+    TACOperand preheader;
+    TACOperand header;
+    TACOperand latch;
+    TACOperand exit;
+} TACLoop;
+
+// The TAC of a compilation, in program order. Semantic analysis appends to
+// it, the optimizer rewrites it in place and the code generator reads it.
+typedef struct {
+    TACInstruction* items;
+    int count;
+    int capacity;
+} TACBuffer;
+
+static inline TACOperand tac_operand(TACOperandKind kind, int number) {
+    TACOperand operand;
+    operand.kind = kind;
+    operand.number = number;
+    return operand;
+}
+
+static inline TACOperand tac_float(float value) {
+    TACOperand operand;
+    operand.kind = OPERAND_FLOAT;
+    operand.float_value = value;
+    return operand;
+}
+
+#define tac_none() tac_operand(OPERAND_NONE, 0)
+#define tac_int(value) tac_operand(OPERAND_INT, (value))
+#define tac_variable(atom) tac_operand(OPERAND_VARIABLE, (atom))
+
+// True when both operands are present and the same
+static inline int tac_same(TACOperand a, TACOperand b) {
+    return a.kind != OPERAND_NONE && a.kind == b.kind && a.number == b.number;
+}
+
+static inline int tac_is_temp(TACOperand operand) {
+    return operand.kind == OPERAND_TEMP || operand.kind == OPERAND_FLOAT_TEMP;
+}
+
+// Dense index of an operand that holds a value, for tables indexed by
+// operand: 2 * number for temporaries and 2 * atom + 1 for variables and
+// array elements. -1 for immediates, labels and OPERAND_NONE.
+static inline int tac_operand_key(TACOperand operand) {
+    switch (operand.kind) {
+        case OPERAND_TEMP:
+        case OPERAND_FLOAT_TEMP:
+            return 2 * operand.number;
+        case OPERAND_VARIABLE:
+        case OPERAND_ELEMENT:
+            return 2 * operand.name + 1;
+    }
+    return -1;
+}
+
+// True for the opcodes that assign to result
+static inline int tac_is_assignment(TACInstruction* instr) {
+    return instr->opcode < TAC_PRINT;
+}
+
+static inline int tac_is_binary(TACInstruction* instr) {
+    return instr->opcode >= TAC_ADD && instr->opcode <= TAC_OR;
+}
+
+TACInstruction* tac_append(TACBuffer* tac, TACOpcode opcode, TACOperand result, TACOperand arg1, TACOperand arg2);
+void tac_truncate(TACBuffer* tac, int count);
+
+// Remove the instructions marked is_dead from start on, keeping the order
+// of the others. Returns how many were removed.
+int tac_compact(TACBuffer* tac, int start);
+void tac_free(TACBuffer* tac);
+
+// Opcode of a binary operator as the parser spells it, -1 if there is none
+int tac_binary_opcode(const char* op);
+
+// The operator of a binary opcode as written in listings
+const char* tac_opcode_symbol(TACOpcode opcode);
+
+// Text of an operand. Names point into the intern table, everything else
+// is formatted into buffer.
+const char* tac_operand_text(InternTable* atoms, TACOperand operand, char* buffer, size_t size);
+
+// Format one instruction as a line of text, without the newline
+int tac_format(InternTable* atoms, TACInstruction* instr, char* buffer, size_t size);
+
+// Write instructions [start, count) one per line. This is the format of the --dump-tac and --dump-optimized files.
+void tac_write(FILE* file, InternTable* atoms, TACBuffer* tac, int start);
+
+#endif // TAC_H
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "compiler.h"
+
+// Scaling benchmark for the back end. Builds TAC of the shapes semantic
+// analysis produces (assignments of constants and sums, prints, if-else
+// and chains of copies) straight into a context, skipping the parser, and
+// times optimize_TAC() and generateCode() on it. With no arguments it runs
+// 1k to 10M instructions; per-instruction times should stay flat.
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static TACOperand new_operand(CompilerContext* ctx, TACOperandKind kind) {
+    return tac_operand(kind, ctx->sema.temp_var_count++);
+}
+
+static void build_program(CompilerContext* ctx, int count) {
+    Atom variables[8];
+    char name[8];
+    for (int i = 0; i < 8; i++) {
+        sprintf(name, "v%d", i);
+        variables[i] = intern(&ctx->atoms, name);
+    }
+
+    TACBuffer* tac = &ctx->tac;
+    for (int i = 0; tac->count < count; i++) {
+        TACOperand a = tac_variable(variables[i % 8]);
+        TACOperand b = tac_variable(variables[(i * 3 + 1) % 8]);
+        TACOperand t = new_operand(ctx, OPERAND_TEMP);
+        switch (i % 5) {
+            case 0:     // a = 42
+                tac_append(tac, TAC_COPY, t, tac_int(i % 97), tac_none());
+                tac_append(tac, TAC_COPY, a, t, tac_none());
+                break;
+            case 1: {   // a = b + 3
+                TACOperand sum = new_operand(ctx, OPERAND_FLOAT_TEMP);
+                tac_append(tac, TAC_COPY, t, tac_int(3), tac_none());
+                tac_append(tac, TAC_ADD, sum, b, t);
+                tac_append(tac, TAC_COPY, a, sum, tac_none());
+                break;
+            }
+            case 2:     // write a
+                tac_append(tac, TAC_PRINT, tac_none(), a, tac_none());
+                break;
+            case 3: {   // if (a < b) { b = 1; }
+                TACOperand condition = new_operand(ctx, OPERAND_FLOAT_TEMP);
+                TACOperand skip = new_operand(ctx, OPERAND_LABEL);
+                TACOperand end = new_operand(ctx, OPERAND_LABEL);
+                tac_append(tac, TAC_LT, condition, a, b);
+                tac_append(tac, TAC_IFFALSE, tac_none(), condition, skip);
+                tac_append(tac, TAC_COPY, t, tac_int(1), tac_none());
+                tac_append(tac, TAC_COPY, b, t, tac_none());
+                tac_append(tac, TAC_JUMP, tac_none(), end, tac_none());
+                tac_append(tac, TAC_LABEL, tac_none(), skip, tac_none());
+                tac_append(tac, TAC_LABEL, tac_none(), end, tac_none());
+                break;
+            }
+            case 4: {   // b = a, through two temporaries
+                TACOperand u = new_operand(ctx, OPERAND_TEMP);
+                tac_append(tac, TAC_COPY, t, a, tac_none());
+                tac_append(tac, TAC_COPY, u, t, tac_none());
+                tac_append(tac, TAC_COPY, b, u, tac_none());
+                break;
+            }
+        }
+    }
+}
+
+static void run(int count) {
+    CompilerContext ctx;
+    compiler_init(&ctx);
+    build_program(&ctx, count);
+    int before = ctx.tac.count;
+
+    double start = now_seconds();
+    optimize_TAC(&ctx);
+    double optimized = now_seconds();
+    FILE* sink = fopen("/dev/null", "w");
+    generateCode(&ctx, sink);
+    fclose(sink);
+    double generated = now_seconds();
+
+    printf("%9d instructions, %9d after optimization: optimize %8.3f s (%6.1f ns each), codegen %8.3f s (%6.1f ns each)\n",
+           before, ctx.tac.count, optimized - start, (optimized - start) * 1e9 / before,
+           generated - optimized, (generated - optimized) * 1e9 / before);
+    compiler_free(&ctx);
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            run(atoi(argv[i]));
+        }
+        return 0;
+    }
+    for (int count = 1000; count <= 10000000; count *= 10) {
+        run(count);
+    }
+    return 0;
+}
@@ -0,0 +1,30 @@
+#!/bin/sh
+# Dynamic cycle benchmark: compile each tests/*.cm that is not expected to
+# trap and print the cycles it runs for in mips_sim.py, under the latency
+# model the code generator's cost table assumes, and their total. Run it
+# with two compilers to compare them.
+#
+#   tests/cycles.sh [COMPILER]   (COMPILER defaults to ./compiler)
+
+tests=$(cd "$(dirname "$0")" && pwd)
+compiler=$(cd "$(dirname "${1:-./compiler}")" && pwd)/$(basename "${1:-./compiler}")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+total=0
+for source in "$tests"/*.cm; do
+    name=$(basename "$source" .cm)
+    if grep -q '^trap:' "$tests/$name.expected"; then
+        continue
+    fi
+    rm -f "$work/output.asm"
+    if ! (cd "$work" && "$compiler" "$source" >/dev/null 2>&1) ||
+       ! python3 "$tests/mips_sim.py" -y "$work/output.asm" >/dev/null 2>"$work/cycles"; then
+        echo "$name: failed"
+        exit 1
+    fi
+    cycles=$(tail -n 1 "$work/cycles")
+    printf '%10d  %s\n' "$cycles" "$name"
+    total=$((total + cycles))
+done
+printf '%10d  total\n' "$total"
@@ -0,0 +1,319 @@
+#!/usr/bin/env python3
+# Differential fuzzer for the optimizer and the code generator.
+#
+#   fuzz.py [-n COUNT] [-s FIRST_SEED] [-k DIR] [-y] [COMPILER]
+#
+# Generates COUNT random programs (default 500) from consecutive seeds,
+# compiles each with COMPILER (default ./compiler), runs it in mips_sim.py
+# and compares what it prints with a reference interpreter of the source.
+# The interpreter does what the unoptimized code does: + and - trap on
+# overflow, and so do == and != (the code generator compares with sub),
+# * wraps, and / truncates and traps on a zero divisor. A program the
+# interpreter traps on is only counted, since optimization may move the
+# trap or drop it, but a compiled program must never trap or print
+# anything else when its source does not trap. Failing programs are kept
+# in DIR (default fuzz-failures) as seed<N>.cm. -y also sums the cycles.
+#
+# The programs nest while loops up to three deep over induction variables
+# that step up or down before or after the loop body, with bounds that may
+# leave a loop running zero times, and multiply and divide by values that
+# may be zero, negative or large enough to overflow. p, q, r and s are set
+# through a loop so that they are not constants to the optimizer.
+
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import mips_sim  # noqa: E402
+
+VARIABLES = ['a', 'b', 'c', 'd', 'e']
+INPUTS = ['p', 'q', 'r', 's']
+SMALL = [-3, -2, -1, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9]
+FACTORS = ['2', '3', '4', '7', '9', 'k', '46341', '65536', '1073741824', '2147483647']
+LARGE = SMALL + [46341, 65536, 100000, 1 << 30, 2147483647, -2147483647]
+STEP_LIMIT = 200000
+
+
+class Trap(Exception):
+    pass
+
+
+def wrap(value):
+    value &= 0xffffffff
+    return value - (1 << 32) if value >> 31 else value
+
+
+def checked(value):
+    if value != wrap(value):
+        raise Trap()
+    return value
+
+
+class Generator:
+    def __init__(self, seed):
+        self.random = random.Random(seed)
+        self.loop_depth = 0
+        self.counted = set()
+        self.lines = []
+
+    def atom(self, first=False):
+        r = self.random.random()
+        if r < 0.4 and self.loop_depth:
+            iv = 'i%d' % self.random.randrange(self.loop_depth)
+            if first or iv not in self.counted:
+                return iv
+        if r < 0.8:
+            return self.random.choice(VARIABLES + INPUTS + ['k'])
+        return str(self.random.randint(0, 9))
+
+    # Terms of a sum, each a list of factors, since there are no
+    # parentheses: [(op, [(op, atom), ...]), ...]
+    def expression(self):
+        terms = []
+        for t in range(self.random.choice([1, 1, 2, 2, 3])):
+            factors = [('*', self.atom(True))]
+            if factors[0][1] in self.counted:
+                factors.append(('*', str(self.random.choice(FACTORS))))
+            for f in range(self.random.choice([0, 1, 1, 2])):
+                factors.append((self.random.choice(['*', '*', '*', '/']), self.atom()))
+            terms.append(('+' if t == 0 else self.random.choice(['+', '-']), factors))
+        return terms
+
+    def condition(self):
+        names = VARIABLES + ['i%d' % n for n in range(self.loop_depth) if 'i%d' % n not in self.counted]
+        return (self.random.choice(names), self.random.choice(['<', '>', '==', '!=']), self.atom())
+
+    def statements(self, depth):
+        body = []
+        for _ in range(self.random.randint(1, 4)):
+            r = self.random.random()
+            if r < 0.2:
+                body.append(('write', self.expression()))
+            elif r < 0.55:
+                body.append(('assign', self.random.choice(VARIABLES), self.expression()))
+            elif r < 0.7 and depth < 3:
+                then = self.statements(depth + 1)
+                other = self.statements(depth + 1) if self.random.random() < 0.5 else None
+                body.append(('if', self.condition(), then, other))
+            elif depth < 3 and self.loop_depth < 3:
+                body.extend(self.loop(depth))
+        return body
+
+    def loop(self, depth):
+        iv = 'i%d' % self.loop_depth
+        down = self.random.random() < 0.3
+        step = self.random.choice(['1', '2'] if down else ['1', '2', '3', 'k'])
+        bound = self.random.choice(['0', '1', '5', 'p', 'q'] if down else ['0', '3', '7', 'p', 'q'])
+        start = [('+', [('*', self.random.choice(['5', '9', 'q'] if down else ['0', '1', 'p']))])]
+        # A counted loop has literal bounds and multiplies its variable by a
+        # factor the loop does not change on every iteration, reading it
+        # nowhere else, so the exit test can move to the reduced temporary
+        counted = self.random.random() < 0.4
+        if counted:
+            step = self.random.choice(['1', '2', '3'])
+            bound = self.random.choice(['0', '1', '5'] if down else ['0', '3', '7', '40'])
+            start = [('+', [('*', self.random.choice(['5', '9', '40'] if down else ['0', '1']))])]
+            if not down and self.random.random() < 0.3:
+                start.append(('-', [('*', '4')]))
+            self.counted.add(iv)
+        update = ('assign', iv, [('+', [('*', iv)]), ('-' if down else '+', [('*', step)])])
+        self.loop_depth += 1
+        body = self.statements(depth + 1)
+        self.loop_depth -= 1
+        self.counted.discard(iv)
+        if counted:
+            product = [('+', [('*', iv), ('*', self.random.choice(FACTORS))])]
+            body.insert(self.random.randint(0, len(body)), ('assign', self.random.choice(VARIABLES), product))
+        body = [update] + body if self.random.random() < 0.5 else body + [update]
+        loop = [('assign', iv, start), ('while', (iv, '>' if down else '<', bound), body)]
+        # The value the variable leaves with, which the loop may no longer
+        # compute
+        return loop + [('write', [('+', [('*', iv)])])] if counted else loop
+
+    def program(self):
+        self.lines = ['function void main() {']
+        names = VARIABLES + INPUTS + ['i0', 'i1', 'i2', 'k', 'n']
+        self.lines += ['    int %s;' % name for name in names]
+        values = {}
+        # An input is set to n * value, or 0 - n * -value, on the last of
+        # two iterations, when n is 1
+        for name in INPUTS:
+            value = values[name] = self.random.choice(SMALL if name in ('p', 'q') else LARGE)
+            product = 'n * %d' % value if value >= 0 else '0 - n * %d' % -value
+            self.lines += ['    n = 0;', '    while (n < 2) {', '        %s = %s;' % (name, product),
+                           '        n = n + 1;', '    }']
+        for name in VARIABLES + ['i0', 'i1', 'i2']:
+            values[name] = self.random.randint(0, 9)
+            self.lines.append('    %s = %d;' % (name, values[name]))
+        values['k'] = self.random.randint(1, 3)
+        values['n'] = 2
+        self.lines.append('    k = %d;' % values['k'])
+        body = self.statements(0) + [('write', [('+', [('*', name)])]) for name in VARIABLES + ['i0', 'i1', 'i2']]
+        self.render(body, 1)
+        self.lines.append('}')
+        return '\n'.join(self.lines) + '\n', body, values
+
+    def render(self, body, indent):
+        pad = '    ' * indent
+        for statement in body:
+            kind = statement[0]
+            if kind == 'write':
+                self.lines.append('%swrite %s;' % (pad, text(statement[1])))
+            elif kind == 'assign':
+                self.lines.append('%s%s = %s;' % (pad, statement[1], text(statement[2])))
+            elif kind == 'if':
+                self.lines.append('%sif (%s %s %s) {' % ((pad,) + statement[1]))
+                self.render(statement[2], indent + 1)
+                if statement[3] is not None:
+                    self.lines.append('%s} else {' % pad)
+                    self.render(statement[3], indent + 1)
+                self.lines.append('%s}' % pad)
+            else:
+                self.lines.append('%swhile (%s %s %s) {' % ((pad,) + statement[1]))
+                self.render(statement[2], indent + 1)
+                self.lines.append('%s}' % pad)
+
+
+def text(terms):
+    out = ''
+    for t, (sign, factors) in enumerate(terms):
+        product = ' '.join((atom if f == 0 else '%s %s' % (op, atom)) for f, (op, atom) in enumerate(factors))
+        out += product if t == 0 else ' %s %s' % (sign, product)
+    return out
+
+
+class Interpreter:
+    def __init__(self, values):
+        self.values = dict(values)
+        self.output = []
+        self.steps = 0
+
+    def atom(self, atom):
+        return int(atom) if atom[0].isdigit() else self.values[atom]
+
+    def evaluate(self, terms):
+        total = None
+        for sign, factors in terms:
+            value = None
+            for op, atom in factors:
+                operand = self.atom(atom)
+                if value is None:
+                    value = operand
+                elif op == '*':
+                    value = wrap(value * operand)
+                else:
+                    if operand == 0:
+                        raise Trap()
+                    quotient = abs(value) // abs(operand)
+                    value = checked(quotient if (value < 0) == (operand < 0) else -quotient)
+            if total is None:
+                total = value
+            else:
+                total = checked(total + value if sign == '+' else total - value)
+        return total
+
+    def test(self, condition):
+        x, op, atom = condition
+        x = self.values[x]
+        y = self.atom(atom)
+        if op == '<':
+            return x < y
+        if op == '>':
+            return x > y
+        difference = checked(x - y)
+        return difference == 0 if op == '==' else difference != 0
+
+    def run(self, body):
+        for statement in body:
+            self.steps += 1
+            if self.steps > STEP_LIMIT:
+                raise Trap()
+            kind = statement[0]
+            if kind == 'write':
+                self.output.append('%d\n' % self.evaluate(statement[1]))
+            elif kind == 'assign':
+                self.values[statement[1]] = self.evaluate(statement[2])
+            elif kind == 'if':
+                if self.test(statement[1]):
+                    self.run(statement[2])
+                elif statement[3] is not None:
+                    self.run(statement[3])
+            else:
+                while self.test(statement[1]):
+                    self.run(statement[2])
+
+
+class Output:
+    def __init__(self):
+        self.parts = []
+
+    def write(self, part):
+        self.parts.append(part)
+
+
+def main():
+    args = sys.argv[1:]
+    count, first, keep, cycles, compiler = 500, 1, 'fuzz-failures', '-y' in args, './compiler'
+    positional = []
+    i = 0
+    while i < len(args):
+        if args[i] in ('-n', '-s', '-k') and i + 1 < len(args):
+            if args[i] == '-n':
+                count = int(args[i + 1])
+            elif args[i] == '-s':
+                first = int(args[i + 1])
+            else:
+                keep = args[i + 1]
+            i += 2
+            continue
+        if args[i] != '-y':
+            positional.append(args[i])
+        i += 1
+    if positional:
+        compiler = positional[0]
+    compiler = os.path.abspath(compiler)
+
+    compared = trapping = failed = total_cycles = 0
+    with tempfile.TemporaryDirectory() as work:
+        for seed in range(first, first + count):
+            source, body, values = Generator(seed).program()
+            interpreter = Interpreter(values)
+            try:
+                interpreter.run(body)
+                expected = ''.join(interpreter.output)
+            except Trap:
+                trapping += 1
+                continue
+            compared += 1
+            path = os.path.join(work, 'fuzz.cm')
+            with open(path, 'w') as file:
+                file.write(source)
+            asm = os.path.join(work, 'output.asm')
+            if os.path.exists(asm):
+                os.remove(asm)
+            subprocess.run([compiler, path], cwd=work, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+            output = Output()
+            try:
+                program, labels = mips_sim.parse(asm)
+                steps, program_cycles = mips_sim.run(program, labels, output)
+                actual = ''.join(output.parts)
+                total_cycles += program_cycles
+            except (mips_sim.Trap, OSError, KeyError) as error:
+                actual = ''.join(output.parts) + 'trap: %s\n' % error
+            if actual != expected:
+                failed += 1
+                os.makedirs(keep, exist_ok=True)
+                with open(os.path.join(keep, 'seed%d.cm' % seed), 'w') as file:
+                    file.write(source)
+                print('seed %d: wrong output, kept in %s' % (seed, os.path.join(keep, 'seed%d.cm' % seed)))
+    print('%d programs: %d compared, %d failed, %d trap in the reference' % (count, compared, failed, trapping))
+    if cycles:
+        print('%d cycles' % total_cycles)
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+# Simulator for the MIPS subset the code generator emits, used by run.sh.
+#
+#   mips_sim.py [-c | -y] output.asm
+#
+# Runs the program from main and prints what it writes. Like SPIM, add, sub
+# and addi trap on signed overflow and div traps on a zero divisor (and on
+# the overflow of INT_MIN / -1); a trap prints "trap: <reason>" to standard
+# error and exits with status 2. -c also prints the number of instructions
+# run to standard error, -y the cycles under the latency model below, which
+# is the one the code generator's cost table assumes.
+
+import struct
+import sys
+
+CYCLES = {'mul': 10, 'mult': 10, 'div': 35, 'mul.s': 4, 'div.s': 12}
+STEP_LIMIT = 100_000_000
+
+
+class Trap(Exception):
+    pass
+
+
+def wrap(value):
+    value &= 0xffffffff
+    return value - (1 << 32) if value >> 31 else value
+
+
+def checked(value):
+    if value != wrap(value):
+        raise Trap('arithmetic overflow')
+    return value
+
+
+def float_bits(value):
+    return struct.unpack('<i', struct.pack('<f', value))[0]
+
+
+def bits_float(bits):
+    return struct.unpack('<f', struct.pack('<i', bits))[0]
+
+
+def parse(path):
+    program = []
+    labels = {}
+    in_text = False
+    with open(path) as source:
+        for line in source:
+            line = line.split('#')[0].strip()
+            if not line:
+                continue
+            if line == '.text':
+                in_text = True
+            elif line.startswith('.'):
+                continue
+            elif line.endswith(':'):
+                labels[line[:-1]] = len(program)
+            elif in_text:
+                op, _, rest = line.partition(' ')
+                program.append((op, [arg.strip() for arg in rest.split(',')] if rest else []))
+    return program, labels
+
+
+def run(program, labels, output):
+    regs = {'$zero': 0, '$sp': 0x7fffeffc}
+    fregs = {}
+    memory = {}
+    count = 0
+    cycles = 0
+
+    def reg(name):
+        return regs.get(name, 0)
+
+    def address(operand):
+        offset, _, base = operand.partition('(')
+        return int(offset) + reg(base[:-1])
+
+    def set_reg(name, value):
+        if name != '$zero':
+            regs[name] = value
+
+    pc = labels['main']
+    while pc < len(program):
+        op, args = program[pc]
+        pc += 1
+        count += 1
+        cycles += CYCLES.get(op, 1)
+        if count > STEP_LIMIT:
+            raise Trap('step limit')
+
+        if op == 'li':
+            set_reg(args[0], wrap(int(args[1])))
+        elif op == 'la':
+            set_reg(args[0], 0x10010000)
+        elif op == 'lw':
+            set_reg(args[0], memory.get(address(args[1]), 0))
+        elif op == 'sw':
+            memory[address(args[1])] = reg(args[0])
+        elif op == 'move':
+            set_reg(args[0], reg(args[1]))
+        elif op == 'addi':
+            set_reg(args[0], checked(reg(args[1]) + int(args[2])))
+        elif op == 'add':
+            set_reg(args[0], checked(reg(args[1]) + reg(args[2])))
+        elif op == 'sub':
+            set_reg(args[0], checked(reg(args[1]) - reg(args[2])))
+        elif op == 'addu':
+            set_reg(args[0], wrap(reg(args[1]) + reg(args[2])))
+        elif op == 'subu':
+            set_reg(args[0], wrap(reg(args[1]) - reg(args[2])))
+        elif op == 'mul':
+            set_reg(args[0], wrap(reg(args[1]) * reg(args[2])))
+        elif op == 'div':
+            x, y = reg(args[1]), reg(args[2])
+            if y == 0:
+                raise Trap('division by zero')
+            quotient = abs(x) // abs(y)
+            set_reg(args[0], checked(quotient if (x < 0) == (y < 0) else -quotient))
+        elif op == 'mult':
+            product = reg(args[0]) * reg(args[1])
+            regs['$lo'] = wrap(product)
+            regs['$hi'] = wrap(product >> 32)
+        elif op == 'mfhi':
+            set_reg(args[0], regs.get('$hi', 0))
+        elif op == 'mflo':
+            set_reg(args[0], regs.get('$lo', 0))
+        elif op == 'sll':
+            set_reg(args[0], wrap(reg(args[1]) << int(args[2])))
+        elif op == 'sra':
+            set_reg(args[0], reg(args[1]) >> int(args[2]))
+        elif op == 'srl':
+            set_reg(args[0], wrap((reg(args[1]) & 0xffffffff) >> int(args[2])))
+        elif op == 'slt':
+            set_reg(args[0], int(reg(args[1]) < reg(args[2])))
+        elif op == 'seq':
+            set_reg(args[0], int(reg(args[1]) == reg(args[2])))
+        elif op == 'sne':
+            set_reg(args[0], int(reg(args[1]) != reg(args[2])))
+        elif op == 'li.s':
+            fregs[args[0]] = float_bits(float(args[1]))
+        elif op == 'l.s':
+            fregs[args[0]] = memory.get(address(args[1]), 0)
+        elif op == 's.s':
+            memory[address(args[1])] = fregs.get(args[0], 0)
+        elif op in ('add.s', 'sub.s', 'mul.s', 'div.s'):
+            x, y = bits_float(fregs.get(args[1], 0)), bits_float(fregs.get(args[2], 0))
+            if op == 'add.s':
+                result = x + y
+            elif op == 'sub.s':
+                result = x - y
+            elif op == 'mul.s':
+                result = x * y
+            else:
+                result = x / y if y else float('inf') if x > 0 else float('-inf') if x < 0 else float('nan')
+            fregs[args[0]] = float_bits(result)
+        elif op == 'beq':
+            if reg(args[0]) == reg(args[1]):
+                pc = labels[args[2]]
+        elif op == 'bne':
+            if reg(args[0]) != reg(args[1]):
+                pc = labels[args[2]]
+        elif op == 'j':
+            pc = labels[args[0]]
+        elif op == 'syscall':
+            service = reg('$v0')
+            if service == 1:
+                output.write(str(reg('$a0')))
+            elif service == 2:
+                output.write('%g' % bits_float(fregs.get('$f12', 0)))
+            elif service == 4:
+                output.write('\n')
+            elif service == 10:
+                break
+        else:
+            raise SystemExit('mips_sim: unknown instruction %s' % op)
+    return count, cycles
+
+
+def main():
+    paths = [arg for arg in sys.argv[1:] if not arg.startswith('-')]
+    if len(paths) != 1:
+        raise SystemExit('usage: mips_sim.py [-c | -y] output.asm')
+    program, labels = parse(paths[0])
+    try:
+        count, cycles = run(program, labels, sys.stdout)
+    except Trap as trap:
+        sys.stdout.flush()
+        sys.stderr.write('trap: %s\n' % trap)
+        return 2
+    if '-y' in sys.argv:
+        sys.stderr.write('%d\n' % cycles)
+    elif '-c' in sys.argv:
+        sys.stderr.write('%d\n' % count)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,71 @@
+#!/bin/sh
+# Compile each tests/*.cm, whole and with --stream, run it with mips_sim.py
+# and compare what it prints, a trap included, with tests/<name>.expected.
+# Then compile them all in one --serve process, twice over, and compare the
+# assembly with what a compiler started for each alone writes.
+#
+#   tests/run.sh [COMPILER]      (COMPILER defaults to ./compiler)
+
+tests=$(cd "$(dirname "$0")" && pwd)
+compiler=$(cd "$(dirname "${1:-./compiler}")" && pwd)/$(basename "${1:-./compiler}")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+failed=0
+count=0
+for source in "$tests"/*.cm; do
+    name=$(basename "$source" .cm)
+    for mode in "" --stream; do
+        count=$((count + 1))
+        rm -f "$work/output.asm"
+        if ! (cd "$work" && "$compiler" $mode "$source" >/dev/null 2>"$work/compile.err"); then
+            echo "FAIL $name${mode:+ $mode}: does not compile"
+            cat "$work/compile.err"
+            failed=$((failed + 1))
+            continue
+        fi
+        python3 "$tests/mips_sim.py" "$work/output.asm" >"$work/actual" 2>&1
+        if ! diff -u "$tests/$name.expected" "$work/actual" >"$work/diff"; then
+            echo "FAIL $name${mode:+ $mode}"
+            cat "$work/diff"
+            failed=$((failed + 1))
+        fi
+    done
+done
+
+# Each compilation the server does starts from the state the one before it
+# left warm, which must not show in the assembly
+for source in "$tests"/*.cm "$tests"/*.cm; do
+    printf 'compile %d\n' "$(wc -c <"$source")"
+    cat "$source"
+done >"$work/requests"
+"$compiler" --serve <"$work/requests" >"$work/responses" 2>/dev/null
+python3 -c '
+import sys
+data = open(sys.argv[1], "rb").read()
+position = served = 0
+while position < len(data):
+    end = data.index(b"\n", position)
+    assembly, diagnostics = map(int, data[position:end].split()[2:4])
+    position = end + 1
+    with open("%s%d.asm" % (sys.argv[2], served), "wb") as out:
+        out.write(data[position:position + assembly])
+    position += assembly + diagnostics
+    served += 1
+' "$work/responses" "$work/served"
+served=0
+for source in "$tests"/*.cm "$tests"/*.cm; do
+    name=$(basename "$source" .cm)
+    count=$((count + 1))
+    rm -f "$work/output.asm"
+    (cd "$work" && "$compiler" "$source" >/dev/null 2>&1)
+    if ! cmp -s "$work/output.asm" "$work/served$served.asm"; then
+        echo "FAIL $name served"
+        diff -u "$work/output.asm" "$work/served$served.asm" 2>&1 | head -20
+        failed=$((failed + 1))
+    fi
+    served=$((served + 1))
+done
+
+echo "$((count - failed)) of $count passed"
+[ "$failed" -eq 0 ]
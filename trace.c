@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "trace.h"
+
+unsigned char trace_levels[TRACE_CATEGORY_COUNT] = {0};
+
+static const char* category_names[TRACE_CATEGORY_COUNT] = {
+    "lex", "parse", "sema", "tac", "opt", "codegen"
+};
+
+const char* trace_category_name(TraceCategory category) {
+    if (category < 0 || category >= TRACE_CATEGORY_COUNT) {
+        return "unknown";
+    }
+    return category_names[category];
+}
+
+void trace_printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+void trace_set_all(TraceLevel level) {
+    for (int i = 0; i < TRACE_CATEGORY_COUNT; i++) {
+        trace_levels[i] = level;
+    }
+}
+
+// Parse a comma separated list such as "lex,sema:2,all:1".
+// A category without a level is enabled at TRACE_LEVEL_DEBUG.
+// Returns 0 on success, -1 if the list contains an unknown category.
+int trace_parse_option(const char* spec) {
+    char* copy = strdup(spec);
+    int status = 0;
+
+    for (char* item = strtok(copy, ","); item != NULL; item = strtok(NULL, ",")) {
+        int level = TRACE_LEVEL_DEBUG;
+        char* colon = strchr(item, ':');
+        if (colon != NULL) {
+            *colon = '\0';
+            level = atoi(colon + 1);
+            if (level < TRACE_LEVEL_OFF) level = TRACE_LEVEL_OFF;
+            if (level > TRACE_LEVEL_VERBOSE) level = TRACE_LEVEL_VERBOSE;
+        }
+
+        if (strcmp(item, "all") == 0) {
+            trace_set_all(level);
+            continue;
+        }
+
+        int found = 0;
+        for (int i = 0; i < TRACE_CATEGORY_COUNT; i++) {
+            if (strcmp(item, category_names[i]) == 0) {
+                trace_levels[i] = level;
+                found = 1;
+                break;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "Error: unknown trace category '%s'\n", item);
+            status = -1;
+        }
+    }
+
+    free(copy);
+    return status;
+}
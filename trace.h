@@ -0,0 +1,51 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+
+// Compiler phases that can produce trace output
+typedef enum {
+    TRACE_LEX,
+    TRACE_PARSE,
+    TRACE_SEMA,
+    TRACE_TAC,
+    TRACE_OPT,
+    TRACE_CODEGEN,
+    TRACE_CATEGORY_COUNT
+} TraceCategory;
+
+// Trace levels, each one includes everything below it
+typedef enum {
+    TRACE_LEVEL_OFF = 0,
+    TRACE_LEVEL_INFO = 1,     // Phase summaries and timings
+    TRACE_LEVEL_DEBUG = 2,    // One line per node / instruction
+    TRACE_LEVEL_VERBOSE = 3   // Per-token and per-operand detail
+} TraceLevel;
+
+// Highest level compiled into the binary. Build with -DTRACE_MAX_LEVEL=0
+// to remove every trace call entirely.
+#ifndef TRACE_MAX_LEVEL
+#define TRACE_MAX_LEVEL TRACE_LEVEL_VERBOSE
+#endif
+
+extern unsigned char trace_levels[TRACE_CATEGORY_COUNT];
+
+// True when output for the given category and level is enabled. The level is
+// always a constant, so the first test folds away at compile time.
+#define TRACE_ON(cat, level) \
+    ((level) <= TRACE_MAX_LEVEL && trace_levels[cat] >= (level))
+
+// Arguments are only evaluated when the trace is enabled
+#define TRACE(cat, level, ...) \
+    do { \
+        if (TRACE_ON(cat, level)) { \
+            trace_printf(__VA_ARGS__); \
+        } \
+    } while (0)
+
+void trace_printf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void trace_set_all(TraceLevel level);
+int trace_parse_option(const char* spec);
+const char* trace_category_name(TraceCategory category);
+
+#endif // TRACE_H